@@ -1,5 +1,4 @@
-#version 300 es
-precision highp float;
+#version 410 core
 
 in vec3 fragPos;
 
@@ -11,4 +10,4 @@ void main()
 {
     vec3 delta = fragPos -lightPos;
     gl_FragDepth = length(delta) / lightFarPlane;
-}
\ No newline at end of file
+}
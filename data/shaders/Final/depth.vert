@@ -1,15 +1,15 @@
-#version 300 es
-precision highp float;
+#version 410 core
 
 layout (location = 0) in vec3 aPos;
 
-uniform mat4 lightSpaceMatrix;
-uniform mat4 model;
-
-out vec3 fragPos;
+// Per object, written in the frame data ring.
+layout (std140) uniform ShadowObjectBlock
+{
+    mat4 model;
+    int faceMask;
+};
 
 void main()
 {
-    gl_Position = lightSpaceMatrix * model * vec4(aPos, 1.0);
-    fragPos = vec3(model * vec4(aPos, 1.0));
-}  
+    gl_Position = model * vec4(aPos, 1.0);
+}
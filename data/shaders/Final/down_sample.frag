@@ -17,6 +17,18 @@ in vec2 texCoords;
 uniform sampler2D srcTexture;
 
 uniform vec2 srcResolution;
+// Luminance under which the source is ignored, negative for every level
+// after the first one.
+uniform float threshold;
+
+// The bright pass is done on the taps of the first downsample, the scene
+// doesn't write a second target for it.
+vec3 BrightPass(vec2 uv)
+{
+    vec3 color = texture(srcTexture, uv).rgb;
+    float brightness = dot(color, vec3(0.2126, 0.7152, 0.0722));
+    return brightness > threshold ? color : vec3(0.0);
+}
 
 void main()
 {
@@ -31,22 +43,22 @@ void main()
     // - l - m -
     // g - h - i
     // === ('e' is the current texel) ===
-    vec3 a = texture(srcTexture, vec2(texCoords.x - 2.0*x, texCoords.y + 2.0*y)).rgb;
-    vec3 b = texture(srcTexture, vec2(texCoords.x, texCoords.y + 2.0*y)).rgb;
-    vec3 c = texture(srcTexture, vec2(texCoords.x + 2.0 * x, texCoords.y + 2.0 * y)).rgb;
+    vec3 a = BrightPass(vec2(texCoords.x - 2.0*x, texCoords.y + 2.0*y));
+    vec3 b = BrightPass(vec2(texCoords.x, texCoords.y + 2.0*y));
+    vec3 c = BrightPass(vec2(texCoords.x + 2.0 * x, texCoords.y + 2.0 * y));
 
-    vec3 d = texture(srcTexture, vec2(texCoords.x - 2.0 * x, texCoords.y)).rgb;
-    vec3 e = texture(srcTexture, vec2(texCoords.x, texCoords.y)).rgb;
-    vec3 f = texture(srcTexture, vec2(texCoords.x + 2.0 * x, texCoords.y)).rgb;
+    vec3 d = BrightPass(vec2(texCoords.x - 2.0 * x, texCoords.y));
+    vec3 e = BrightPass(vec2(texCoords.x, texCoords.y));
+    vec3 f = BrightPass(vec2(texCoords.x + 2.0 * x, texCoords.y));
 
-    vec3 g = texture(srcTexture, vec2(texCoords.x - 2.0 * x, texCoords.y - 2.0 * y)).rgb;
-    vec3 h = texture(srcTexture, vec2(texCoords.x, texCoords.y - 2.0 * y)).rgb;
-    vec3 i = texture(srcTexture, vec2(texCoords.x + 2.0 * x, texCoords.y - 2.0 * y)).rgb;
+    vec3 g = BrightPass(vec2(texCoords.x - 2.0 * x, texCoords.y - 2.0 * y));
+    vec3 h = BrightPass(vec2(texCoords.x, texCoords.y - 2.0 * y));
+    vec3 i = BrightPass(vec2(texCoords.x + 2.0 * x, texCoords.y - 2.0 * y));
 
-    vec3 j = texture(srcTexture, vec2(texCoords.x - x, texCoords.y + y)).rgb;
-    vec3 k = texture(srcTexture, vec2(texCoords.x + x, texCoords.y + y)).rgb;
-    vec3 l = texture(srcTexture, vec2(texCoords.x - x, texCoords.y - y)).rgb;
-    vec3 m = texture(srcTexture, vec2(texCoords.x + x, texCoords.y - y)).rgb;
+    vec3 j = BrightPass(vec2(texCoords.x - x, texCoords.y + y));
+    vec3 k = BrightPass(vec2(texCoords.x + x, texCoords.y + y));
+    vec3 l = BrightPass(vec2(texCoords.x - x, texCoords.y - y));
+    vec3 m = BrightPass(vec2(texCoords.x + x, texCoords.y - y));
 
     // Apply weighted distribution:
     // 0.5 + 0.125 + 0.125 + 0.125 + 0.125 = 1
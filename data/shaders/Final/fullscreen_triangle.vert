@@ -0,0 +1,14 @@
+#version 300 es
+precision highp float;
+
+// One triangle covering the screen, drawn without vertex buffer: vertices
+// 0, 1 and 2 are at (-1, -1), (3, -1) and (-1, 3). Unlike a quad there is
+// no diagonal where the pixels are shaded twice.
+
+out vec2 texCoords;
+
+void main()
+{
+    texCoords = vec2(float((gl_VertexID << 1) & 2), float(gl_VertexID & 2));
+    gl_Position = vec4(texCoords * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -1,12 +1,12 @@
 #version 300 es
 precision highp float;
 
-layout(location = 0) out vec4 g_position_metallic;
-layout(location = 1) out vec4 g_normal_roughness;
-layout(location = 2) out vec4 g_albedo_ao;
+// The position is not stored, it is reconstructed from the depth buffer.
+layout(location = 0) out vec2 g_normal; // octahedral view space normal in [0, 1]
+layout(location = 1) out vec4 g_albedo;
+layout(location = 2) out vec4 g_metallic_roughness_ao;
 
 in vec2 texCoords;
-in vec3 fragPos;
 in mat3 TBN;
 
 // material parameters
@@ -16,17 +16,20 @@ uniform sampler2D metallicMap;
 uniform sampler2D roughnessMap;
 uniform sampler2D aoMap;
 
-void main() {
-    g_position_metallic.rgb = fragPos;
-    g_position_metallic.a = texture(metallicMap, texCoords).r;
+vec2 OctEncode(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return e;
+}
 
+void main() {
     vec3 normalTan = texture(normalMap, texCoords).rgb;
     normalTan = normalTan * 2.0 - 1.0;
 
-    g_normal_roughness.rgb = normalize(TBN * normalTan);
-    g_normal_roughness.a = texture(roughnessMap, texCoords).r;
-
-    g_albedo_ao.rgb = texture(albedoMap, texCoords).rgb;
-    g_albedo_ao.a = texture(aoMap, texCoords).r;
+    g_normal = OctEncode(normalize(TBN * normalTan)) * 0.5 + 0.5;
 
-}
\ No newline at end of file
+    g_albedo = vec4(texture(albedoMap, texCoords).rgb, 1.0);
+    g_metallic_roughness_ao = vec4(texture(metallicMap, texCoords).r,
+                                   texture(roughnessMap, texCoords).r,
+                                   texture(aoMap, texCoords).r, 1.0);
+}
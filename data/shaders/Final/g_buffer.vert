@@ -7,25 +7,27 @@ layout(location = 2) in vec3 aNormal;
 layout(location = 3) in vec3 aTangent;
 
 out vec2 texCoords;
-out vec3 fragPos;
 out mat3 TBN;
 
-uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
-uniform mat4 normalMatrix;
+// Recorded per object in the command buffers. The normal matrix is in
+// world space, shared with the other passes.
+layout(std140) uniform ObjectBlock {
+    mat4 model;
+    mat4 normalMatrix;
+};
 
 void main() {
     vec4 worldPos = model * vec4(aPos, 1.0);
-    vec4 viewpos = view * worldPos;
-    fragPos = vec3(viewpos);
     texCoords = aTexCoords;
 
-    mat3 normalMatrix = mat3(normalMatrix);
+    // The view has no scale, it rotates the normals as is.
+    mat3 viewNormalMatrix = mat3(view) * mat3(normalMatrix);
 
-    vec3 T = normalize(normalMatrix * normalize(aTangent));
-    vec3 N = normalize(normalMatrix * normalize(aNormal));
+    vec3 T = normalize(viewNormalMatrix * normalize(aTangent));
+    vec3 N = normalize(viewNormalMatrix * normalize(aNormal));
     T = normalize(T - dot(T, N) * N); //reorthogonalize the tangent
     vec3 B = normalize(cross(N, T));
 
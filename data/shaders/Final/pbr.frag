@@ -2,24 +2,32 @@
 precision highp float;
 
 layout (location = 0) out vec4 FragColor;
-layout (location = 1) out vec4 BrightColor;
 
 in vec2 texCoords;
 
 // IBL
-uniform samplerCube irradianceMap;
+// Irradiance as 9 spherical harmonics coefficients, rgb of each vec4.
+layout (std140) uniform IrradianceSh {
+    vec4 irradianceSh[9];
+};
 uniform samplerCube prefilterMap;
 uniform sampler2D brdfLUT;
 
-uniform sampler2D g_position_metallic;
-uniform sampler2D g_normal_roughness;
-uniform sampler2D g_albedo_ao;
+uniform sampler2D g_depth;
+uniform sampler2D g_normal; // octahedral view space normal in [0, 1]
+uniform sampler2D g_albedo;
+uniform sampler2D g_metallic_roughness_ao;
 
 // ssao
 uniform sampler2D ssao_tex;
 
 //shadow
-uniform samplerCube depth_tex;
+// Atlas of the 6 faces, shadowTiles holds the xy offset and size of each
+// face tile in atlas uv.
+uniform sampler2D depth_tex;
+uniform vec4 shadowTiles[6];
+uniform float shadowAtlasSize;
+uniform mat4 lightSpaceMatrices[6];
 
 uniform mat4 lightSpaceMatrix;
 
@@ -29,41 +37,100 @@ uniform float lightFarPlane;
 uniform vec3 lightPos;
 uniform vec3 lightColor;
 
+// clustered point lights
+// Row 0: world position and radius, row 1: color.
+uniform sampler2D pointLights;
+// Offset and count in the index list of each cluster, one row per slice.
+uniform highp usampler2D clusterLights;
+uniform highp usampler2D clusterLightIndices;
+uniform ivec2 clusterCount;
+uniform int clusterSliceCount;
+// slice = log(-view z) * x + y
+uniform vec2 clusterSliceScaleBias;
+
 uniform vec3 camPos;
 uniform mat4 inverse_view;
+uniform mat4 inverse_projection;
 
 const float PI = 3.14159265359;
 
 //shadow
+// Same face order as the light matrices: +x, -x, +y, -y, +z, -z.
+int ShadowFace(vec3 dir) {
+    vec3 a = abs(dir);
+    if (a.x >= a.y && a.x >= a.z) {
+        return dir.x > 0.0 ? 0 : 1;
+    }
+    if (a.y >= a.z) {
+        return dir.y > 0.0 ? 2 : 3;
+    }
+    return dir.z > 0.0 ? 4 : 5;
+}
+
 float PointLightShadowCalculation(vec3 fragWorldPos, vec3 worldNormal) {
     vec3 fragToLight = fragWorldPos - lightPos;
-    float currentDepth = length(fragToLight);
-    float closestDepth = texture(depth_tex, fragToLight).r;
-    closestDepth *= lightFarPlane;
     // get depth of current fragment from light's perspective
+    float currentDepth = length(fragToLight);
+
+    int face = ShadowFace(fragToLight);
+    vec4 clip = lightSpaceMatrices[face] * vec4(fragWorldPos, 1.0);
+    vec2 faceUv = clip.xy / clip.w * 0.5 + 0.5;
+    vec4 tile = shadowTiles[face];
+
+    // The filter taps stay inside the face tile, the neighbours in the atlas
+    // belong to other faces.
+    float texel = 1.0 / shadowAtlasSize;
+    vec2 tileMin = tile.xy + vec2(texel * 0.5);
+    vec2 tileMax = tile.xy + vec2(tile.z - texel * 0.5);
 
     float shadow  = 0.0;
     float bias = 0.03;
     const float samples = 4.0;
-    const float offset  = 0.1;
-    for(float x = -offset; x < offset; x += offset / (samples * 0.5))
+    for(float x = -1.5; x <= 1.5; x += 1.0)
     {
-        for(float y = -offset; y < offset; y += offset / (samples * 0.5))
+        for(float y = -1.5; y <= 1.5; y += 1.0)
         {
-            for(float z = -offset; z < offset; z += offset / (samples * 0.5))
-            {
-                float closestDepth = texture(depth_tex, fragToLight + vec3(x, y, z)).r;
-                closestDepth *= lightFarPlane;   // undo mapping [0;1]
-
-                if(currentDepth - bias > closestDepth)
-                    shadow += 1.0;
-            }
+            vec2 uv = clamp(tile.xy + faceUv * tile.z + vec2(x, y) * texel,
+                            tileMin, tileMax);
+            float closestDepth = texture(depth_tex, uv).r;
+            closestDepth *= lightFarPlane;   // undo mapping [0;1]
+
+            if(currentDepth - bias > closestDepth)
+                shadow += 1.0;
         }
     }
-    shadow /= (samples * samples * samples);
+    shadow /= (samples * samples);
     return shadow;
 }
 
+// ----------------------------------------------------------------------------
+vec3 OctDecode(vec2 e) {
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+// ----------------------------------------------------------------------------
+vec3 ViewPosition(vec2 uv, float depth) {
+    vec4 position = inverse_projection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    return position.xyz / position.w;
+}
+// ----------------------------------------------------------------------------
+// The coefficients hold the basis constants, only the polynomials are left.
+vec3 IrradianceFromSh(vec3 n)
+{
+    return irradianceSh[0].rgb
+         + irradianceSh[1].rgb * n.y
+         + irradianceSh[2].rgb * n.z
+         + irradianceSh[3].rgb * n.x
+         + irradianceSh[4].rgb * (n.x * n.y)
+         + irradianceSh[5].rgb * (n.y * n.z)
+         + irradianceSh[6].rgb * (3.0 * n.z * n.z - 1.0)
+         + irradianceSh[7].rgb * (n.x * n.z)
+         + irradianceSh[8].rgb * (n.x * n.x - n.y * n.y);
+}
 // ----------------------------------------------------------------------------
 float DistributionGGX(vec3 N, vec3 H, float roughness)
 {
@@ -110,21 +177,67 @@ vec3 fresnelSchlickRoughness(float cosTheta, vec3 F0, float roughness)
     return F0 + (max(vec3(1.0 - roughness), F0) - F0) * pow(clamp(1.0 - cosTheta, 0.0, 1.0), 5.0);
 }   
 // ----------------------------------------------------------------------------
+// Outgoing radiance of a light reaching the surface from L.
+vec3 CookTorrance(vec3 N, vec3 V, vec3 L, vec3 radiance, vec3 albedo,
+                  float metallic, float roughness, vec3 F0)
+{
+    vec3 H = normalize(V + L);
+    float NDF = DistributionGGX(N, H, roughness);
+    float G   = GeometrySmith(N, V, L, roughness);
+    vec3 F    = fresnelSchlick(max(dot(H, V), 0.0), F0);
+
+    vec3 specular = NDF * G * F / (4.0 * max(dot(N, V), 0.0) * max(dot(N, L), 0.0) + 0.0001);
+    vec3 kD = (vec3(1.0) - F) * (1.0 - metallic);
+    return (kD * albedo / PI + specular) * radiance * max(dot(N, L), 0.0);
+}
+// ----------------------------------------------------------------------------
+// Only the lights of the cluster of the pixel are evaluated.
+vec3 ClusteredLights(vec3 N, vec3 V, vec3 WorldPos, float viewZ, vec3 albedo,
+                     float metallic, float roughness, vec3 F0)
+{
+    int slice = clamp(int(log(max(-viewZ, 1e-4)) * clusterSliceScaleBias.x + clusterSliceScaleBias.y),
+                      0, clusterSliceCount - 1);
+    ivec2 tile = clamp(ivec2(texCoords * vec2(clusterCount)), ivec2(0), clusterCount - 1);
+    uvec2 range = texelFetch(clusterLights, ivec2(tile.x + tile.y * clusterCount.x, slice), 0).rg;
+    int indexWidth = textureSize(clusterLightIndices, 0).x;
+
+    vec3 Lo = vec3(0.0);
+    for (uint i = 0u; i < range.y; ++i)
+    {
+        int index = int(range.x + i);
+        int light = int(texelFetch(clusterLightIndices, ivec2(index % indexWidth, index / indexWidth), 0).r);
+        vec4 positionRadius = texelFetch(pointLights, ivec2(light, 0), 0);
+        vec3 toLight = positionRadius.xyz - WorldPos;
+        float distance2 = dot(toLight, toLight);
+        // Inverse square falloff windowed to reach 0 at the radius.
+        float ratio = distance2 / (positionRadius.w * positionRadius.w);
+        float window = clamp(1.0 - ratio * ratio, 0.0, 1.0);
+        float attenuation = window * window / (distance2 + 1.0);
+        if (attenuation <= 0.0)
+            continue;
+        vec3 radiance = texelFetch(pointLights, ivec2(light, 1), 0).rgb * attenuation;
+        Lo += CookTorrance(N, V, toLight * inversesqrt(distance2), radiance, albedo,
+                           metallic, roughness, F0);
+    }
+    return Lo;
+}
+// ----------------------------------------------------------------------------
 void main()
 {		
     // material properties
-    vec3 albedo = texture(g_albedo_ao, texCoords).rgb;
-    float metallic = texture(g_position_metallic, texCoords).a;
-    float roughness = texture(g_normal_roughness, texCoords).a;
-    float ao = texture(g_albedo_ao, texCoords).a;
+    vec3 albedo = texture(g_albedo, texCoords).rgb;
+    vec3 material = texture(g_metallic_roughness_ao, texCoords).rgb;
+    float metallic = material.r;
+    float roughness = material.g;
+    float ao = material.b;
 
     float ssao = texture(ssao_tex, texCoords).r;
     ao *= ssao;
 
     // input lighting data
-    vec3 N = texture(g_normal_roughness, texCoords).rgb;
+    vec3 N = OctDecode(texture(g_normal, texCoords).rg);
     N = mat3(inverse_view) * N;
-    vec3 ViewPos = texture(g_position_metallic, texCoords).rgb;
+    vec3 ViewPos = ViewPosition(texCoords, texture(g_depth, texCoords).r);
     vec4 WorldPosv4 = inverse_view * vec4(ViewPos,1.0);
     vec3 WorldPos = vec3(WorldPosv4);
     vec3 V = normalize(camPos - WorldPos);
@@ -172,6 +285,8 @@ float shadow = PointLightShadowCalculation(WorldPos, N);
 
         // add to outgoing radiance Lo
         Lo += (1.0-shadow)*(kD * albedo / PI + specular) * radiance * NdotL; // note that we already multiplied the BRDF by the Fresnel (kS) so we won't multiply by kS again
+
+    Lo += ClusteredLights(N, V, WorldPos, ViewPos.z, albedo, metallic, roughness, F0);
      
     
     // ambient lighting (we now use IBL as the ambient term)
@@ -181,7 +296,7 @@ float shadow = PointLightShadowCalculation(WorldPos, N);
      kD = 1.0 - kS;
     kD *= 1.0 - metallic;	  
     
-    vec3 irradiance = texture(irradianceMap, N).rgb;
+    vec3 irradiance = max(IrradianceFromSh(normalize(N)), vec3(0.0));
     vec3 diffuse      = irradiance * albedo;
     
     // sample both the pre-filter map and the BRDF lut and combine them together as per the Split-Sum approximation to get the IBL specular part.
@@ -194,12 +309,6 @@ float shadow = PointLightShadowCalculation(WorldPos, N);
     
     vec3 color = ambient + Lo;
 
-        float brightness = dot(FragColor.rgb, vec3(0.2126, 0.7152, 0.0722));
-    if(brightness > 1.0)
-        BrightColor = vec4(FragColor.rgb, 1.0);
-    else
-        BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
-
     FragColor = vec4(color , 1.0);
     
 }
\ No newline at end of file
@@ -0,0 +1,67 @@
+#version 300 es
+precision highp float;
+
+// Every full screen effect after the lighting in one pass. This is a
+// template: PostStack inserts a define per enabled effect after the version
+// line, a disabled effect is not compiled at all.
+
+out vec4 fragColor;
+
+in vec2 texCoords;
+
+uniform sampler2D hdrBuffer;
+
+#ifdef BLOOM
+// First two levels of the bloom chain, the last upsample step is done here
+// instead of in its own pass.
+uniform sampler2D bloomBlur;
+uniform sampler2D bloomBlurLow;
+uniform float filterRadius;
+
+uniform float bloomStrength; // range (0.03, 0.15) works really well.
+
+// Same tent filter as up_sample.frag.
+vec3 UpsampleLow(vec2 uv)
+{
+    float x = filterRadius;
+    float y = filterRadius;
+    vec3 upsample = texture(bloomBlurLow, uv).rgb * 4.0;
+    upsample += (texture(bloomBlurLow, uv + vec2(0.0, y)).rgb +
+                 texture(bloomBlurLow, uv + vec2(-x, 0.0)).rgb +
+                 texture(bloomBlurLow, uv + vec2(x, 0.0)).rgb +
+                 texture(bloomBlurLow, uv + vec2(0.0, -y)).rgb) * 2.0;
+    upsample += texture(bloomBlurLow, uv + vec2(-x, y)).rgb +
+                texture(bloomBlurLow, uv + vec2(x, y)).rgb +
+                texture(bloomBlurLow, uv + vec2(-x, -y)).rgb +
+                texture(bloomBlurLow, uv + vec2(x, -y)).rgb;
+    return upsample * (1.0 / 16.0);
+}
+#endif
+
+#ifdef TONEMAP
+// ACES filmic curve fitted by Krzysztof Narkowicz.
+vec3 Tonemap(vec3 color)
+{
+    color *= 0.6;
+    return (color * (2.51 * color + 0.03)) /
+           (color * (2.43 * color + 0.59) + 0.14);
+}
+#endif
+
+void main()
+{
+    vec3 color = texture(hdrBuffer, texCoords).rgb;
+#ifdef BLOOM
+    vec3 bloomColor = texture(bloomBlur, texCoords).rgb + UpsampleLow(texCoords);
+    color = mix(color, bloomColor, bloomStrength); // linear interpolation;
+#endif
+#ifdef TONEMAP
+    color = Tonemap(color);
+#endif
+    color = clamp(color, vec3(0.0), vec3(1.0));
+#ifdef GAMMA
+    const float gamma = 2.2;
+    color = pow(color, vec3(1.0 / gamma));
+#endif
+    fragColor = vec4(color, 1.0);
+}
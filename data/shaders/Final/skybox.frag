@@ -2,7 +2,6 @@
 precision highp float;
 
 layout (location = 0) out vec4 FragColor;
-layout (location = 1) out vec4 BrightColor;
 
 in vec3 WorldPos;
 
@@ -13,11 +12,4 @@ void main()
     vec3 envColor = texture(environmentMap, WorldPos).rgb;
     
     FragColor = vec4(envColor, 1.0);
-
-    float brightness = dot(FragColor.rgb, vec3(0.2126, 0.7152, 0.0722));
-    
-    if(brightness > 1.0)
-        BrightColor = vec4(FragColor.rgb, 1.0);
-    else
-        BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
 }
\ No newline at end of file
@@ -1,31 +1,61 @@
 #version 300 es
 precision highp float;
 
-layout (location = 0) out float fragColor;
+// Occlusion and view space depth, the depth guides the blur and upsample.
+layout (location = 0) out vec2 fragColor;
 
 in vec2 texCoords;
 
-uniform sampler2D g_position_metallic;
-uniform sampler2D g_normal_roughness;
+uniform sampler2D g_depth;
+uniform sampler2D g_normal;
 uniform sampler2D texNoise;
 
-const int kSampleCount = 64;
+const int kMaxSampleCount = 64;
+uniform int sampleCount;
 uniform float radius; // 0.5
 uniform float bias; // 0.025
 
-uniform vec3 samples[kSampleCount];
+uniform vec3 samples[kMaxSampleCount];
 
 // Tile noise texture over screen based on screen dimensions divided by noise size
 uniform vec2 noiseScale;
+// Rotation of the kernel around the normal, changed every frame by the
+// temporal mode so that consecutive frames take different samples.
+uniform float frameAngle;
 
 uniform mat4 projection;
+uniform mat4 inverse_projection;
+
+vec3 OctDecode(vec2 e) {
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+vec3 ViewPosition(vec2 uv, float depth) {
+    vec4 position = inverse_projection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    return position.xyz / position.w;
+}
+
+// The view space depth only depends on the window depth.
+float ViewDepth(float depth) {
+    vec4 position = inverse_projection * vec4(0.0, 0.0, depth * 2.0 - 1.0, 1.0);
+    return position.z / position.w;
+}
 
 void main()
 {
     // get input for SSAO algorithm
-    vec3 fragPos = texture(g_position_metallic, texCoords).rgb;
-    vec3 normal = normalize(texture(g_normal_roughness, texCoords).rgb);
+    vec3 fragPos = ViewPosition(texCoords, texture(g_depth, texCoords).r);
+    vec3 normal = OctDecode(texture(g_normal, texCoords).rg);
     vec3 randomVec = normalize(texture(texNoise, texCoords * noiseScale).rgb);
+    float c = cos(frameAngle);
+    float s = sin(frameAngle);
+    randomVec = vec3(c * randomVec.x - s * randomVec.y,
+                     s * randomVec.x + c * randomVec.y, 0.0);
 
     // create TBN change-of-basis matrix: from tangent-space to view-space
     vec3 tangent = normalize(randomVec - normal * dot(randomVec, normal));
@@ -34,8 +64,10 @@ void main()
 
     // iterate over the sample kernel and calculate occlusion factor
     float occlusion = 0.0;
-    for(int i = 0; i < kSampleCount; ++i)
+    for(int i = 0; i < kMaxSampleCount; ++i)
     {
+        if (i >= sampleCount)
+            break;
         // get sample position
         vec3 samplePos = TBN * samples[i]; // from tangent to view-space
         samplePos = fragPos + samplePos * radius;
@@ -47,13 +79,13 @@ void main()
         offset.xyz = offset.xyz * 0.5 + 0.5; // transform to range 0.0 - 1.0
 
         // get sample depth
-        float sampleDepth = texture(g_position_metallic, offset.xy).z; // get depth value of kernel sample
+        float sampleDepth = ViewDepth(texture(g_depth, offset.xy).r); // get depth value of kernel sample
 
         // range check & accumulate
         float rangeCheck = smoothstep(0.0, 1.0, radius / abs(fragPos.z - sampleDepth));
         occlusion += (sampleDepth >= samplePos.z + bias ? 1.0 : 0.0) * rangeCheck;
     }
-    occlusion = 1.0 - (occlusion / float(kSampleCount));
+    occlusion = 1.0 - (occlusion / float(sampleCount));
 
-    fragColor = occlusion;
+    fragColor = vec2(occlusion, fragPos.z);
 }
\ No newline at end of file
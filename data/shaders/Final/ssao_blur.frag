@@ -1,24 +1,61 @@
 #version 300 es
 precision highp float;
 
-layout (location = 0) out float fragColor;
+// Separable bilateral blur of the low resolution occlusion, run once
+// horizontally and once vertically. Taps across a depth or normal
+// discontinuity are ignored so that the occlusion doesn't halo around the
+// silhouettes.
+layout (location = 0) out vec2 fragColor;
 
 in vec2 texCoords;
 
-uniform sampler2D ssao_tex;
+uniform sampler2D ssao_tex; // rg = occlusion, view space depth
+uniform sampler2D g_normal; // octahedral view space normal in [0, 1]
+
+uniform ivec2 direction;
+uniform int radius;
+
+const int kMaxRadius = 8;
+// Relative depth difference at which a tap weight falls to 1 / e.
+const float kDepthTolerance = 0.05;
+const float kNormalPower = 8.0;
+
+vec3 OctDecode(vec2 e) {
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
 
 void main()
 {
-    vec2 texelSize = 1.0 / vec2(textureSize(ssao_tex, 0));
-    float result = 0.0;
-    for (int x = -2; x < 2; ++x)
+    ivec2 size = textureSize(ssao_tex, 0);
+    ivec2 center = ivec2(gl_FragCoord.xy);
+    vec2 centerSample = texelFetch(ssao_tex, center, 0).rg;
+    vec3 centerNormal = OctDecode(texture(g_normal, texCoords).rg);
+    float depthScale = 1.0 / (kDepthTolerance * max(abs(centerSample.y), 0.001));
+    float sigma = float(radius) * 0.5 + 0.5;
+
+    float sum = 0.0;
+    float weightSum = 0.0;
+    for (int i = -kMaxRadius; i <= kMaxRadius; ++i)
     {
-        for (int y = -2; y < 2; ++y)
-        {
-            vec2 offset = vec2(float(x), float(y)) * texelSize;
-            result += texture(ssao_tex, texCoords + offset).r;
-        }
+        if (abs(i) > radius)
+            continue;
+        ivec2 coord = clamp(center + direction * i, ivec2(0), size - 1);
+        vec2 tap = texelFetch(ssao_tex, coord, 0).rg;
+        vec2 tapUv = (vec2(coord) + 0.5) / vec2(size);
+        vec3 tapNormal = OctDecode(texture(g_normal, tapUv).rg);
+
+        float weight = exp(-float(i * i) / (2.0 * sigma * sigma));
+        weight *= exp(-abs(tap.y - centerSample.y) * depthScale);
+        weight *= pow(max(dot(centerNormal, tapNormal), 0.0), kNormalPower);
+        sum += tap.r * weight;
+        weightSum += weight;
     }
 
-    fragColor = result / (4.0 * 4.0);
-}
\ No newline at end of file
+    // The center tap always has a weight of 1.
+    fragColor = vec2(sum / weightSum, centerSample.y);
+}
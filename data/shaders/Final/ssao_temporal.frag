@@ -0,0 +1,77 @@
+#version 300 es
+precision highp float;
+
+// Blends the occlusion of this frame with the reprojected history. The
+// history is dropped where the surface it saw is not the current one: its
+// depth or its normal differs, or it was off screen.
+layout (location = 0) out vec4 fragColor; // occlusion, view space depth, octahedral world normal
+
+in vec2 texCoords;
+
+uniform sampler2D ssao_tex; // rg = occlusion, view space depth
+uniform sampler2D history_tex;
+uniform sampler2D g_depth;
+uniform sampler2D g_normal; // octahedral view space normal in [0, 1]
+
+uniform mat4 inverse_projection;
+uniform mat4 inverse_view;
+uniform mat4 prevView;
+uniform mat4 prevProjection;
+// Weight of this frame, 1 when there is no history yet.
+uniform float blendFactor;
+
+const float kDepthTolerance = 0.05;
+const float kNormalThreshold = 0.9;
+
+vec2 OctEncode(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return e;
+}
+
+vec3 OctDecode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+vec3 ViewPosition(vec2 uv, float depth) {
+    vec4 position = inverse_projection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    return position.xyz / position.w;
+}
+
+void main()
+{
+    vec2 current = texelFetch(ssao_tex, ivec2(gl_FragCoord.xy), 0).rg;
+    vec3 viewPos = ViewPosition(texCoords, texture(g_depth, texCoords).r);
+    vec3 worldNormal = normalize(mat3(inverse_view) *
+                                 OctDecode(texture(g_normal, texCoords).rg * 2.0 - 1.0));
+    vec3 worldPos = (inverse_view * vec4(viewPos, 1.0)).xyz;
+
+    vec4 prevViewPos = prevView * vec4(worldPos, 1.0);
+    vec4 prevClip = prevProjection * prevViewPos;
+    vec2 prevUv = prevClip.xy / prevClip.w * 0.5 + 0.5;
+
+    float alpha = blendFactor;
+    float occlusion = current.r;
+    bool onScreen = prevClip.w > 0.0 && all(greaterThanEqual(prevUv, vec2(0.0))) &&
+                    all(lessThanEqual(prevUv, vec2(1.0)));
+    if (onScreen && alpha < 1.0)
+    {
+        // Nearest texel, blending encoded normals across an edge is
+        // meaningless.
+        ivec2 size = textureSize(history_tex, 0);
+        ivec2 coord = clamp(ivec2(prevUv * vec2(size)), ivec2(0), size - 1);
+        vec4 history = texelFetch(history_tex, coord, 0);
+
+        bool sameDepth = abs(history.g - prevViewPos.z) <
+                         kDepthTolerance * max(abs(prevViewPos.z), 0.001);
+        bool sameNormal = dot(OctDecode(history.ba), worldNormal) > kNormalThreshold;
+        if (sameDepth && sameNormal)
+            occlusion = mix(history.r, current.r, alpha);
+    }
+
+    fragColor = vec4(occlusion, current.g, OctEncode(worldNormal));
+}
@@ -0,0 +1,73 @@
+#version 300 es
+precision highp float;
+
+// Joint bilateral upsample: the 4 low resolution texels around the pixel are
+// weighted by their bilinear weight times how close their depth and normal
+// are to the full resolution ones.
+layout (location = 0) out float fragColor;
+
+in vec2 texCoords;
+
+uniform sampler2D ssao_tex; // rg = occlusion, view space depth
+uniform sampler2D g_depth;
+uniform sampler2D g_normal; // octahedral view space normal in [0, 1]
+
+uniform mat4 inverse_projection;
+
+const float kDepthTolerance = 0.05;
+const float kNormalPower = 16.0;
+
+vec3 OctDecode(vec2 e) {
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+float ViewDepth(float depth) {
+    vec4 position = inverse_projection * vec4(0.0, 0.0, depth * 2.0 - 1.0, 1.0);
+    return position.z / position.w;
+}
+
+void main()
+{
+    ivec2 size = textureSize(ssao_tex, 0);
+    vec2 position = texCoords * vec2(size) - 0.5;
+    ivec2 base = ivec2(floor(position));
+    vec2 f = position - vec2(base);
+
+    float depth = ViewDepth(texture(g_depth, texCoords).r);
+    vec3 normal = OctDecode(texture(g_normal, texCoords).rg);
+    float depthScale = 1.0 / (kDepthTolerance * max(abs(depth), 0.001));
+
+    float sum = 0.0;
+    float weightSum = 0.0;
+    // Falls back to the closest depth when every tap is rejected.
+    float closest = 1.0;
+    float closestDistance = 1e30;
+    for (int i = 0; i < 4; ++i)
+    {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        ivec2 coord = clamp(base + offset, ivec2(0), size - 1);
+        vec2 tap = texelFetch(ssao_tex, coord, 0).rg;
+        vec2 tapUv = (vec2(coord) + 0.5) / vec2(size);
+        vec3 tapNormal = OctDecode(texture(g_normal, tapUv).rg);
+
+        vec2 bilinear = mix(1.0 - f, f, vec2(offset));
+        float depthDistance = abs(tap.y - depth);
+        float weight = bilinear.x * bilinear.y;
+        weight *= exp(-depthDistance * depthScale);
+        weight *= pow(max(dot(normal, tapNormal), 0.0), kNormalPower);
+        sum += tap.r * weight;
+        weightSum += weight;
+        if (depthDistance < closestDistance)
+        {
+            closestDistance = depthDistance;
+            closest = tap.r;
+        }
+    }
+
+    fragColor = weightSum > 1e-4 ? sum / weightSum : closest;
+}
@@ -6,6 +6,9 @@ in vec3 WorldPos;
 
 uniform samplerCube environmentMap;
 uniform float roughness;
+// Face size and last mip of the environment cubemap.
+uniform float environmentResolution;
+uniform float environmentMaxLevel;
 
 const float PI = 3.14159265359;
 // ----------------------------------------------------------------------------
@@ -91,11 +94,11 @@ void main()
             float HdotV = max(dot(H, V), 0.0);
             float pdf = D * NdotH / (4.0 * HdotV) + 0.0001; 
 
-            float resolution = 512.0; // resolution of source cubemap (per face)
+            float resolution = environmentResolution;
             float saTexel  = 4.0 * PI / (6.0 * resolution * resolution);
             float saSample = 1.0 / (float(SAMPLE_COUNT) * pdf + 0.0001);
 
-            float mipLevel = roughness == 0.0 ? 0.0 : 0.5 * log2(saSample / saTexel); 
+            float mipLevel = roughness == 0.0 ? 0.0 : clamp(0.5 * log2(saSample / saTexel), 0.0, environmentMaxLevel);
             
             prefilteredColor += textureLod(environmentMap, L, mipLevel).rgb * NdotL;
             totalWeight      += NdotL;
@@ -1,8 +1,9 @@
 #pragma once
+#include <condition_variable>
 #include <future>
 #include <memory>
+#include <mutex>
 #include <queue>
-#include <shared_mutex>
 #include <thread>
 
 enum class JobStatus : std::int8_t {
@@ -19,6 +20,7 @@ enum class JobType : std::int16_t {
   kMeshCreating,
   kModelLoading,
   kMainThread,
+  kCompute,
 };
 
 class Job {
@@ -35,6 +37,8 @@ class Job {
   void WaitUntilJobIsDone() const noexcept;
   [[nodiscrad]] bool AreDependencyDone() const noexcept;
   void AddDependency(const Job* dependency) noexcept;
+  // Makes a done job executable again, for the jobs run every frame.
+  void Reset() noexcept;
 
   [[nodiscard]] bool IsDone() const noexcept {
     return status_ == JobStatus::kDone;
@@ -57,11 +61,19 @@ class Job {
 
 class JobQueue {
  public:
-  void Pop() noexcept;
+  void Push(Job* job) noexcept;
+  // Blocks until a job is available, returns nullptr once the queue is closed.
+  [[nodiscard]] Job* Pop() noexcept;
+  // Returns nullptr instead of blocking when the queue is empty.
+  [[nodiscard]] Job* TryPop() noexcept;
+  void Open() noexcept;
+  void Close() noexcept;
 
  private:
   std::queue<Job*> jobs_;
-  std::shared_mutex mutex_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  bool is_closed_ = false;
 };
 
 class Worker {
@@ -85,8 +97,21 @@ class JobSystem {
 
   void JoinWorkers() noexcept;
 
+  // Compute workers stay alive between frames and share one queue, they run
+  // the per-frame data parallel work (culling...).
+  void LaunchComputeWorkers(int worker_count) noexcept;
+  void StopComputeWorkers() noexcept;
+  // Runs the jobs on the compute workers, the calling thread takes jobs from
+  // the queue too, then waits for the ones still running.
+  void RunComputeJobs(Job* const* jobs, std::size_t count) noexcept;
+  [[nodiscard]] int compute_worker_count() const noexcept {
+    return static_cast<int>(compute_workers_.size());
+  }
+
  private:
   std::vector<Worker> workers_{};
+  std::vector<std::thread> compute_workers_{};
+  JobQueue compute_jobs_{};
 
   std::queue<Job*> img_file_loading_jobs_{};
   std::queue<Job*> img_decompressing_jobs_{};
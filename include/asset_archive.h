@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+#include "JobSystem.h"
+#include "asset_archive_format.h"
+#include "file_utility.h"
+
+// Read only mapping of an archive written by the asset packer. The index is
+// used in place: opening maps the file and checks it, no entry data is
+// touched until the entry is unpacked.
+class AssetArchive {
+ public:
+  AssetArchive() noexcept = default;
+  AssetArchive(const AssetArchive& other) = delete;
+  AssetArchive& operator=(const AssetArchive& other) = delete;
+  ~AssetArchive() noexcept;
+
+  // False when the file is missing or isn't a valid archive.
+  bool Open(std::string_view path) noexcept;
+  void Close() noexcept;
+
+  [[nodiscard]] bool is_open() const noexcept { return header_ != nullptr; }
+  [[nodiscard]] std::uint32_t entry_count() const noexcept {
+    return header_ != nullptr ? header_->entry_count : 0;
+  }
+  [[nodiscard]] std::uint64_t file_size() const noexcept { return size_; }
+  [[nodiscard]] const AssetArchiveEntry& entry(
+      const std::uint32_t index) const noexcept {
+    return entries_[index];
+  }
+
+  // kAssetArchiveNoEntry when the path isn't packed.
+  [[nodiscard]] std::uint32_t Find(std::string_view path) const noexcept;
+  // Writes the entry(index).size bytes of the file. The mapping is read
+  // only, any number of threads can unpack at once.
+  bool Unpack(std::uint32_t index, unsigned char* out) const noexcept;
+  // Fills the buffer as LoadFileInBuffer does, empty on failure.
+  bool Unpack(std::uint32_t index, FileBuffer* file_buffer) const;
+
+ private:
+  const unsigned char* data_ = nullptr;
+  std::uint64_t size_ = 0;
+  const AssetArchiveHeader* header_ = nullptr;
+  const AssetArchiveEntry* entries_ = nullptr;
+  const std::uint32_t* buckets_ = nullptr;
+  const char* names_ = nullptr;
+#ifdef _WIN32
+  void* file_ = nullptr;
+  void* mapping_ = nullptr;
+#endif
+
+  [[nodiscard]] bool IsValid() const noexcept;
+  [[nodiscard]] std::string_view name(
+      const AssetArchiveEntry& entry) const noexcept {
+    return {names_ + entry.name_offset, entry.name_size};
+  }
+};
+
+// Unpacks one entry on a compute worker, in place of the ReadJob of a
+// loose file: the entries of a scene decompress in parallel.
+class UnpackAssetJob final : public Job {
+ public:
+  UnpackAssetJob(const AssetArchive* archive, std::uint32_t index,
+                 FileBuffer* file_buffer) noexcept;
+
+ private:
+  const AssetArchive* archive_ = nullptr;
+  std::uint32_t index_ = kAssetArchiveNoEntry;
+  FileBuffer* file_buffer_ = nullptr;
+
+  void Work() noexcept override;
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+// Layout of the archive written by the asset packer and mapped by
+// AssetArchive, in the byte order of the machine (little endian):
+//
+//   header | entry data | entries | buckets | names
+//
+// Every entry data starts on kAssetArchiveAlignment. The buckets are an
+// open addressing table of entry indices, probed linearly from the hash.
+inline constexpr std::uint32_t kAssetArchiveMagic = 0x4B415047;  // "GPAK"
+inline constexpr std::uint32_t kAssetArchiveVersion = 1;
+inline constexpr std::uint64_t kAssetArchiveAlignment = 64;
+inline constexpr std::uint32_t kAssetArchiveNoEntry = ~0u;
+
+struct AssetArchiveHeader {
+  std::uint32_t magic = kAssetArchiveMagic;
+  std::uint32_t version = kAssetArchiveVersion;
+  std::uint32_t entry_count = 0;
+  // Power of two, at least twice the entry count.
+  std::uint32_t bucket_count = 0;
+  std::uint64_t entries_offset = 0;
+  std::uint64_t buckets_offset = 0;
+  std::uint64_t names_offset = 0;
+  std::uint64_t names_size = 0;
+};
+
+enum AssetArchiveFlag : std::uint32_t {
+  // LZ4 block, the other entries are stored as is (png, jpg...).
+  kAssetArchiveCompressed = 1u << 0,
+};
+
+struct AssetArchiveEntry {
+  std::uint64_t hash = 0;
+  std::uint64_t offset = 0;
+  std::uint32_t packed_size = 0;
+  std::uint32_t size = 0;
+  std::uint32_t name_offset = 0;
+  std::uint32_t name_size = 0;
+  std::uint32_t flags = 0;
+  std::uint32_t padding = 0;
+};
+
+static_assert(sizeof(AssetArchiveHeader) == 48);
+static_assert(sizeof(AssetArchiveEntry) == 40);
+
+// FNV-1a of the path as the game opens it, "data/textures/...".
+constexpr std::uint64_t HashAssetPath(const std::string_view path) noexcept {
+  std::uint64_t hash = 0xcbf29ce484222325ull;
+  for (const char c : path) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
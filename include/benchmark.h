@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct BenchmarkOptions {
+  static constexpr int kDefaultFrameCount = 600;
+
+  bool is_enabled = false;
+  // Frames rendered and thrown away once the scene is loaded, for the
+  // caches, the shader compilation and the clocks to settle.
+  int warmup_frames = 60;
+  // 0 plays the whole camera path, or kDefaultFrameCount frames without one.
+  int frame_count = 0;
+  std::string report_path = "benchmark.json";
+  // Name or file of the recorded camera path replayed, see CameraPathFile().
+  // The camera stays still without one.
+  std::string camera_path{};
+};
+
+// Reads the benchmark argument at argv[index], moving index past its value.
+// Returns false when the argument isn't a benchmark one or lacks its value.
+bool ParseBenchmarkArgument(int argc, char** argv, int& index,
+                            BenchmarkOptions& options);
+
+// Nearest rank percentiles of the frame times, in milliseconds.
+struct FrameTimeStats {
+  std::size_t frame_count = 0;
+  float min = 0.f;
+  float mean = 0.f;
+  float p50 = 0.f;
+  float p90 = 0.f;
+  float p95 = 0.f;
+  float p99 = 0.f;
+  float max = 0.f;
+};
+
+[[nodiscard]] FrameTimeStats ComputeFrameTimeStats(
+    std::vector<float> milliseconds);
+
+struct BenchmarkTiming {
+  std::string name{};
+  float milliseconds = 0.f;
+};
+
+struct BenchmarkReport {
+  std::string renderer{};
+  std::string context{};
+  std::string camera_path{};
+  int width = 0;
+  int height = 0;
+  int warmup_frames = 0;
+  std::vector<float> frame_milliseconds{};
+  // Once, from the start of the engine to the first timed frame.
+  std::vector<BenchmarkTiming> startup_phases{};
+  // Per frame averages over the timed frames. The CPU zones are inclusive,
+  // a zone also counts the zones it calls.
+  std::vector<BenchmarkTiming> cpu_passes{};
+  std::vector<BenchmarkTiming> gpu_passes{};
+};
+
+// Returns false when the file can't be written.
+bool WriteBenchmarkReport(std::string_view path, const BenchmarkReport& report);
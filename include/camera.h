@@ -46,6 +46,9 @@ class Camera {
 
   void ProcessMouseScroll(float yoffset);
 
+  // Angles in degrees, used to replay a recorded path.
+  void SetOrientation(float yaw, float pitch);
+
  private:
   void updateCameraVectors();
 };
\ No newline at end of file
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "camera.h"
+
+// Camera state at a time of a path, in seconds from its start.
+struct CameraKey {
+  float time = 0.f;
+  glm::vec3 position = glm::vec3(0.f);
+  float yaw = YAW;
+  float pitch = PITCH;
+  float zoom = ZOOM;
+};
+
+// Camera track recorded from the live input and replayed with a fixed
+// timestep, so that two runs render the same frames. The keys are sparse
+// and played back through a Catmull-Rom spline.
+class CameraPath {
+ public:
+  // Seconds between two recorded keys, the spline fills the gaps.
+  static constexpr float kRecordInterval = 0.1f;
+
+  void Clear() noexcept;
+  // Adds a key when kRecordInterval went by since the last one. `time` must
+  // only increase.
+  void Record(float time, const Camera& camera);
+  // Adds the last camera state whatever the interval, to end the recording.
+  void Finish(float time, const Camera& camera);
+
+  [[nodiscard]] CameraKey Sample(float time) const noexcept;
+  // Moves the camera where the path is at `time`, clamped to the path.
+  void Apply(float time, Camera& camera) const noexcept;
+
+  [[nodiscard]] bool empty() const noexcept { return keys_.empty(); }
+  [[nodiscard]] float duration() const noexcept {
+    return keys_.empty() ? 0.f : keys_.back().time;
+  }
+  [[nodiscard]] const std::vector<CameraKey>& keys() const noexcept {
+    return keys_;
+  }
+
+  // Binary file of the keys. Return false when the file can't be written or
+  // isn't a valid path.
+  bool Save(std::string_view path) const;
+  bool Load(std::string_view path);
+
+ private:
+  std::vector<CameraKey> keys_{};
+};
+
+// File of a named camera path, e.g. "data/camera_paths/<name>.campath". A
+// name that already is a file path is returned as is.
+[[nodiscard]] std::string CameraPathFile(std::string_view name);
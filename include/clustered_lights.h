@@ -0,0 +1,153 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "JobSystem.h"
+
+// Lights are tested by batches of kLightBatchSize, one SIMD lane per light.
+static constexpr std::size_t kLightBatchSize = 8;
+
+// Point light without shadow, its contribution falls to 0 at `radius`.
+struct PointLight {
+  glm::vec3 position = glm::vec3(0.f);
+  float radius = 1.f;
+  glm::vec3 color = glm::vec3(1.f);
+};
+
+// The view frustum split in screen tiles and depth slices. The slices are
+// exponential so that the clusters stay about as deep as they are wide.
+struct ClusterGrid {
+  static constexpr int kCountX = 16;
+  static constexpr int kCountY = 9;
+  static constexpr int kCountZ = 24;
+  static constexpr int kSliceClusterCount = kCountX * kCountY;
+  static constexpr int kClusterCount = kSliceClusterCount * kCountZ;
+
+  float near_plane = 0.1f;
+  float far_plane = 100.f;
+  // View space bounds of each cluster, see Index().
+  std::vector<glm::vec3> min{};
+  std::vector<glm::vec3> max{};
+  // Bounds of each whole slice, tested first to skip most of the lights.
+  std::array<glm::vec3, kCountZ> slice_min{};
+  std::array<glm::vec3, kCountZ> slice_max{};
+
+  // Only has to run again when the projection changes.
+  void Build(const glm::mat4& projection, float near, float far) noexcept;
+  // Distance to the camera where a slice starts.
+  [[nodiscard]] float SliceDistance(int slice) const noexcept;
+  // Scale and bias of log(-view z) giving the slice, for the shader.
+  [[nodiscard]] glm::vec2 SliceScaleBias() const noexcept;
+
+  [[nodiscard]] static constexpr int Index(const int x, const int y,
+                                           const int z) noexcept {
+    return x + y * kCountX + z * kSliceClusterCount;
+  }
+};
+
+// View space spheres in structure of arrays, padded to a multiple of
+// kLightBatchSize so that the last batch can be loaded in one go.
+struct ClusterLightSet {
+  std::vector<float> x{};
+  std::vector<float> y{};
+  std::vector<float> z{};
+  std::vector<float> radius{};
+
+  void Set(const std::vector<PointLight>& lights,
+           const glm::mat4& view) noexcept;
+  void Resize(std::size_t count) noexcept;
+
+  [[nodiscard]] std::size_t size() const noexcept { return size_; }
+
+ private:
+  std::size_t size_ = 0;
+};
+
+// Writes the index of the lights of [begin, end) touching the box after
+// `indices`, returns how many were written. Uses AVX when the compiler
+// targets it, SSE otherwise, and plain C++ on the other architectures.
+std::size_t GatherLightsInBox(const ClusterLightSet& lights,
+                              std::size_t begin, std::size_t end,
+                              glm::vec3 box_min, glm::vec3 box_max,
+                              std::uint32_t* indices) noexcept;
+
+// Assigns the lights to the clusters of a range of slices. The lists are
+// local to the job and merged once every job is done.
+class ClusterAssignJob final : public Job {
+ public:
+  ClusterAssignJob() noexcept : Job(JobType::kCompute) {}
+
+  void Setup(const ClusterGrid* grid, const ClusterLightSet* lights,
+             int begin_slice, int end_slice) noexcept;
+
+  [[nodiscard]] int begin_slice() const noexcept { return begin_slice_; }
+  [[nodiscard]] int end_slice() const noexcept { return end_slice_; }
+  // Light count of each cluster of the range.
+  [[nodiscard]] const std::vector<std::uint32_t>& counts() const noexcept {
+    return counts_;
+  }
+  [[nodiscard]] const std::vector<std::uint32_t>& indices() const noexcept {
+    return indices_;
+  }
+
+ private:
+  const ClusterGrid* grid_ = nullptr;
+  const ClusterLightSet* lights_ = nullptr;
+  int begin_slice_ = 0;
+  int end_slice_ = 0;
+  std::vector<std::uint32_t> counts_{};
+  std::vector<std::uint32_t> indices_{};
+  // Lights touching the current slice, tested again per cluster.
+  std::vector<std::uint32_t> slice_indices_{};
+  ClusterLightSet slice_lights_{};
+
+  void Work() noexcept override;
+};
+
+struct ClusterStats {
+  std::size_t light_count = 0;
+  std::size_t index_count = 0;
+  std::uint32_t max_cluster_light_count = 0;
+  float milliseconds = 0.f;
+};
+
+// Compact light lists: the lights of cluster i are
+// indices[offsets[2 * i], offsets[2 * i] + offsets[2 * i + 1]).
+class LightClusterer {
+ public:
+  // Each slice is a job, the slices near the camera are much more expensive
+  // and a finer split balances the workers better.
+  static constexpr int kSlicesPerJob = 1;
+  static constexpr std::size_t kMinLightsPerJob = 64;
+
+  ClusterStats Assign(JobSystem& job_system, const ClusterGrid& grid,
+                      const ClusterLightSet& lights) noexcept;
+
+  [[nodiscard]] const std::vector<std::uint32_t>& offsets() const noexcept {
+    return offsets_;
+  }
+  [[nodiscard]] const std::vector<std::uint32_t>& indices() const noexcept {
+    return indices_;
+  }
+
+ private:
+  std::vector<ClusterAssignJob> jobs_{};
+  std::vector<Job*> job_ptrs_{};
+  std::vector<std::uint32_t> offsets_{};
+  std::vector<std::uint32_t> indices_{};
+};
+
+// Scatters `count` lights in a room around the origin.
+[[nodiscard]] std::vector<PointLight> GeneratePointLights(
+    std::size_t count, glm::vec3 room_min, glm::vec3 room_max,
+    std::uint32_t seed = 7);
+
+// Assigns `light_count` random lights to the clusters of a camera frustum
+// `iterations` times and returns the fastest run.
+[[nodiscard]] ClusterStats RunClusterBenchmark(JobSystem& job_system,
+                                               std::size_t light_count,
+                                               int iterations) noexcept;
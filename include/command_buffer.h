@@ -0,0 +1,197 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "JobSystem.h"
+
+enum class CommandType : std::uint8_t {
+  kBindPipeline,
+  kBindUniforms,
+  kBindTextures,
+  kDrawIndexed,
+};
+
+// GL names and enums are plain integers, the buffers are recorded without
+// a context.
+struct DrawIndexedCommand {
+  std::uint32_t vertex_array = 0;
+  std::uint32_t mode = 0;
+  std::uint32_t index_count = 0;
+  // Byte offset of the first index in the element buffer.
+  std::uint32_t index_offset = 0;
+};
+
+// Std140 layout of the per draw uniform block of the geometry shaders.
+struct DrawUniforms {
+  glm::mat4 model{1.f};
+  glm::mat4 normal_matrix{1.f};
+};
+
+// Commands of a pass or of a range of objects, encoded in 32 bit words: a
+// header with the type and the argument count, then the arguments. Uniform
+// data is copied in an arena uploaded once per replay, at offsets aligned
+// for glBindBufferRange. Binding again what the buffer already bound is
+// dropped while recording, a buffer assumes nothing of the state before it.
+class CommandBuffer {
+ public:
+  static constexpr std::uint32_t kMaxTextures = 16;
+
+  void Reset(std::uint32_t uniform_alignment = 256) noexcept;
+
+  void BindPipeline(std::uint32_t program);
+  void SetUniforms(std::uint32_t binding, const void* data,
+                   std::uint32_t size);
+  template <typename T>
+  void SetUniforms(const std::uint32_t binding, const T& value) {
+    SetUniforms(binding, &value, static_cast<std::uint32_t>(sizeof(T)));
+  }
+  // Binds `count` 2D textures to the units from `first_unit`.
+  void BindTextures(std::uint32_t first_unit, const std::uint32_t* textures,
+                    std::uint32_t count);
+  void DrawIndexed(const DrawIndexedCommand& draw);
+
+  [[nodiscard]] const std::vector<std::uint32_t>& words() const noexcept {
+    return words_;
+  }
+  [[nodiscard]] const std::vector<std::byte>& uniforms() const noexcept {
+    return uniforms_;
+  }
+  [[nodiscard]] std::uint32_t uniform_alignment() const noexcept {
+    return uniform_alignment_;
+  }
+  [[nodiscard]] std::size_t command_count() const noexcept {
+    return command_count_;
+  }
+  [[nodiscard]] std::size_t draw_count() const noexcept {
+    return draw_count_;
+  }
+  [[nodiscard]] std::size_t ByteSize() const noexcept {
+    return words_.size() * sizeof(std::uint32_t) + uniforms_.size();
+  }
+
+ private:
+  static constexpr std::uint32_t kUnknown = ~0u;
+
+  std::vector<std::uint32_t> words_{};
+  std::vector<std::byte> uniforms_{};
+  std::uint32_t uniform_alignment_ = 256;
+  std::size_t command_count_ = 0;
+  std::size_t draw_count_ = 0;
+  // What the recorded commands left bound.
+  std::uint32_t program_ = kUnknown;
+  std::array<std::uint32_t, kMaxTextures> textures_{};
+
+  void PushHeader(CommandType type, std::uint32_t argument_count);
+};
+
+// Executes the decoded commands: GL on the render thread, or nothing to
+// measure the encoding and the replay alone.
+class CommandBackend {
+ public:
+  virtual ~CommandBackend() = default;
+
+  // Before the commands, with the uniform arenas of every buffer replayed.
+  virtual void BeginReplay(std::size_t uniform_byte_size) = 0;
+  virtual void UploadUniforms(std::size_t offset, const std::byte* data,
+                              std::size_t size) = 0;
+  virtual void BindPipeline(std::uint32_t program) = 0;
+  virtual void BindUniforms(std::uint32_t binding, std::size_t offset,
+                            std::size_t size) = 0;
+  virtual void BindTextures(std::uint32_t first_unit,
+                            const std::uint32_t* textures,
+                            std::uint32_t count) = 0;
+  virtual void DrawIndexed(const DrawIndexedCommand& draw) = 0;
+};
+
+// Counts the commands and folds their arguments in a checksum, the replay
+// can't be optimized away.
+class NullCommandBackend final : public CommandBackend {
+ public:
+  void BeginReplay(std::size_t uniform_byte_size) override;
+  void UploadUniforms(std::size_t offset, const std::byte* data,
+                      std::size_t size) override;
+  void BindPipeline(std::uint32_t program) override;
+  void BindUniforms(std::uint32_t binding, std::size_t offset,
+                    std::size_t size) override;
+  void BindTextures(std::uint32_t first_unit, const std::uint32_t* textures,
+                    std::uint32_t count) override;
+  void DrawIndexed(const DrawIndexedCommand& draw) override;
+
+  [[nodiscard]] std::size_t command_count() const noexcept {
+    return command_count_;
+  }
+  [[nodiscard]] std::uint64_t checksum() const noexcept { return checksum_; }
+
+ private:
+  std::size_t command_count_ = 0;
+  std::uint64_t checksum_ = 0;
+
+  void Fold(std::uint64_t value) noexcept;
+};
+
+// Replays the buffers one after the other on the calling thread.
+void ReplayCommandBuffers(const std::vector<CommandBuffer>& buffers,
+                          CommandBackend& backend);
+
+// Records the items [begin, end) of a pass.
+using CommandRecordFunction =
+    std::function<void(CommandBuffer& commands, std::size_t begin,
+                       std::size_t end)>;
+
+class RecordCommandsJob final : public Job {
+ public:
+  RecordCommandsJob() noexcept : Job(JobType::kCompute) {}
+
+  void Setup(const CommandRecordFunction* record, CommandBuffer* commands,
+             std::size_t begin, std::size_t end) noexcept;
+
+ private:
+  const CommandRecordFunction* record_ = nullptr;
+  CommandBuffer* commands_ = nullptr;
+  std::size_t begin_ = 0;
+  std::size_t end_ = 0;
+
+  void Work() noexcept override;
+};
+
+struct CommandBufferStats {
+  std::size_t buffer_count = 0;
+  std::size_t command_count = 0;
+  std::size_t draw_count = 0;
+  std::size_t byte_count = 0;
+  float record_milliseconds = 0.f;
+  float replay_milliseconds = 0.f;
+};
+
+// Splits the items in ranges recorded on the compute workers, one buffer per
+// range. Replaying the buffers in order keeps the order of the items. Small
+// passes are recorded on the calling thread, a job costs more than they do.
+class CommandRecorder {
+ public:
+  static constexpr std::size_t kMinItemsPerJob = 256;
+
+  // Only the record time is filled in the stats.
+  CommandBufferStats Record(JobSystem& job_system, std::size_t item_count,
+                            std::uint32_t uniform_alignment,
+                            const CommandRecordFunction& record) noexcept;
+
+  [[nodiscard]] const std::vector<CommandBuffer>& buffers() const noexcept {
+    return buffers_;
+  }
+
+ private:
+  std::vector<CommandBuffer> buffers_{};
+  std::vector<RecordCommandsJob> jobs_{};
+  std::vector<Job*> job_ptrs_{};
+};
+
+// Records `draw_count` draws of random objects, materials and meshes the
+// way the G-buffer pass does and replays them through the null backend,
+// `iterations` times. Returns the best times.
+[[nodiscard]] CommandBufferStats RunCommandBufferBenchmark(
+    JobSystem& job_system, std::size_t draw_count, int iterations) noexcept;
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define CPU_PROFILER_RDTSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CPU_PROFILER_RDTSC
+#endif
+
+#ifdef TRACY_ENABLE
+#include <Tracy.hpp>
+#endif
+
+enum class CpuEventKind : std::uint8_t {
+  kZone,
+  kJob,
+  kWait,
+};
+
+struct CpuEvent {
+  // Never copied, a literal or __func__.
+  const char* name = "";
+  std::uint64_t begin = 0;
+  std::uint64_t end = 0;
+  CpuEventKind kind = CpuEventKind::kZone;
+};
+
+// Time spent in the zones of one name, on every thread.
+struct CpuZoneSummary {
+  std::string name{};
+  double milliseconds = 0.0;
+  std::size_t count = 0;
+};
+
+struct CpuProfilerStats {
+  std::size_t thread_count = 0;
+  // Events still in the rings.
+  std::size_t event_count = 0;
+  // Events overwritten by newer ones before being written out.
+  std::uint64_t lost_event_count = 0;
+};
+
+// Scoped zones recorded without Tracy, written out as a Chrome trace. Each
+// thread writes its own ring of events, without lock, and only registering
+// a new thread takes a mutex. The timestamps are rdtsc ticks on x86 and
+// steady_clock nanoseconds elsewhere.
+class CpuProfiler {
+ public:
+  // Per thread, the oldest events are overwritten.
+  static constexpr std::size_t kRingCapacity = std::size_t{1} << 15;
+
+  [[nodiscard]] static std::uint64_t Now() noexcept {
+#ifdef CPU_PROFILER_RDTSC
+    return __rdtsc();
+#else
+    return static_cast<std::uint64_t>(
+        std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+  }
+
+  [[nodiscard]] static bool IsEnabled() noexcept {
+    return is_enabled_.load(std::memory_order_relaxed);
+  }
+  static void SetEnabled(bool is_enabled) noexcept {
+    is_enabled_.store(is_enabled, std::memory_order_relaxed);
+  }
+
+  static void Record(const char* name, std::uint64_t begin, std::uint64_t end,
+                     CpuEventKind kind) noexcept;
+  // Name of the calling thread in the traces.
+  static void SetThreadName(std::string name);
+
+  // Chrome trace event JSON of the events in the rings, opened by
+  // chrome://tracing and ui.perfetto.dev. Returns false when the file can't
+  // be written.
+  static bool WriteChromeTrace(std::string_view path);
+  [[nodiscard]] static CpuProfilerStats Stats();
+  // Zones that began and ended between the two Now() values still in the
+  // rings, sorted by name.
+  [[nodiscard]] static std::vector<CpuZoneSummary> Summarize(
+      std::uint64_t begin, std::uint64_t end);
+  // Nanoseconds an empty zone costs, measured over `iterations` zones.
+  [[nodiscard]] static float MeasureZoneOverhead(int iterations);
+
+ private:
+  inline static std::atomic<bool> is_enabled_{true};
+};
+
+class CpuZone {
+ public:
+  explicit CpuZone(const char* name,
+                   const CpuEventKind kind = CpuEventKind::kZone) noexcept
+      : name_(name), begin_(CpuProfiler::Now()), kind_(kind) {}
+  ~CpuZone() { CpuProfiler::Record(name_, begin_, CpuProfiler::Now(), kind_); }
+  CpuZone(const CpuZone&) = delete;
+  CpuZone& operator=(const CpuZone&) = delete;
+
+ private:
+  const char* name_;
+  std::uint64_t begin_;
+  CpuEventKind kind_;
+};
+
+// Zone named after the enclosing function, also sent to Tracy when enabled.
+#ifdef TRACY_ENABLE
+#define PROFILE_ZONE \
+  ZoneScoped;        \
+  const CpuZone cpu_profile_zone(__func__)
+#else
+#define PROFILE_ZONE const CpuZone cpu_profile_zone(__func__)
+#endif
+
+// Times the rest of the scope as the zone `zone` of a GpuProfiler, sent to
+// Tracy under the name of the zone when enabled. Needs gpu_profiler.h, and
+// TracyOpenGL.hpp with Tracy.
+#ifdef TRACY_ENABLE
+#define GPU_PROFILE_ZONE(profiler, zone)                                   \
+  TracyGpuZoneTransient(tracy_gpu_zone, (profiler).zone_name(zone), true); \
+  const GpuZoneScope gpu_profile_zone(profiler, zone)
+#else
+#define GPU_PROFILE_ZONE(profiler, zone) \
+  const GpuZoneScope gpu_profile_zone(profiler, zone)
+#endif
@@ -1,4 +1,15 @@
 #pragma once
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef HEADLESS_EGL
+#include <EGL/egl.h>
+#endif
+
+#include "benchmark.h"
+#include "camera_path.h"
+#include "frame_pacer.h"
 #include "scene.h"
 #include "scene_manager.h"
 
@@ -6,12 +17,54 @@ class Engine {
  public:
   Engine() = default;
   void Run();
+  // Writes the CPU profiler trace there when the engine stops.
+  void set_cpu_trace_path(std::string path) noexcept {
+    cpu_trace_path_ = std::move(path);
+  }
+  // Renders a fixed number of frames without window nor UI instead of the
+  // interactive loop, then writes a report.
+  void set_benchmark_options(BenchmarkOptions options) noexcept {
+    benchmark_options_ = std::move(options);
+  }
+  // Records the camera of the interactive session, saved under that name
+  // when the engine stops.
+  void set_camera_record_name(std::string name) noexcept {
+    camera_record_name_ = std::move(name);
+  }
 
  private:
   SceneManager sm_;
 
   void Begin();
   void End();
+  // SDL window and its OpenGL context.
+  void BeginWindow();
+  void BeginImGui();
+  // Sets the swap interval of the window from frame_pacing_.
+  void ApplyPresentMode();
+  void DrawFramePacing();
+  void RunBenchmark();
+  void SwapBuffers();
+  // Offscreen context without any window system, returns false when the
+  // platform doesn't offer one.
+  bool CreateHeadlessContext();
+  void DestroyHeadlessContext();
+
   SDL_Window* window_ = nullptr;
   SDL_GLContext glRenderContext_{};
+  std::string cpu_trace_path_{};
+  FramePacer frame_pacer_{};
+  FramePacingSettings frame_pacing_{};
+  BenchmarkOptions benchmark_options_{};
+  bool is_headless_ = false;
+  std::vector<BenchmarkTiming> startup_phases_{};
+  // Recorded in the interactive loop, replayed by the benchmark.
+  CameraPath camera_path_{};
+  std::string camera_record_name_{};
+  float camera_record_time_ = 0.f;
+#ifdef HEADLESS_EGL
+  EGLDisplay egl_display_ = EGL_NO_DISPLAY;
+  EGLContext egl_context_ = EGL_NO_CONTEXT;
+  EGLSurface egl_surface_ = EGL_NO_SURFACE;
+#endif
 };
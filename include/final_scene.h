@@ -5,13 +5,27 @@
 #include <random>
 #include <vector>
 
+#include "asset_archive.h"
+#include "clustered_lights.h"
+#include "command_buffer.h"
+#include "frustum_culling.h"
+#include "frame_data_ring.h"
+#include "g_buffer.h"
+#include "gl_command_backend.h"
+#include "gpu_profiler.h"
+#include "gpu_memory.h"
+#include "ibl_cache.h"
+#include "post_stack.h"
+#include "render_graph.h"
+#include "render_graph_textures.h"
 #include "scene.h"
+#include "scene_description.h"
+#include "shadow_atlas.h"
+#include "shadow_cache.h"
+#include "spherical_harmonics.h"
+#include "ssao.h"
 #include "texture_manager.h"
-
-struct BloomMip {
-  glm::vec2 size;
-  GLuint texture;
-};
+#include "transform_store.h"
 
 class FinalScene final : public Scene {
  private:
@@ -21,8 +35,11 @@ class FinalScene final : public Scene {
   JobSystem job_system_{};
 
   std::vector<ReadJob> read_jobs_{};
+  std::vector<UnpackAssetJob> unpack_jobs_{};
   std::vector<DecompressJob> decom_jobs_{};
   std::vector<UploadGpuJob> gpu_jobs_{};
+  std::vector<ImportModelJob> model_import_jobs_{};
+  std::vector<UploadModelJob> model_upload_jobs_{};
 
   std::queue<Job*> main_thread_jobs_{};
 
@@ -37,7 +54,6 @@ class FinalScene final : public Scene {
 
   Pipeline pbr_pipe_;
   Pipeline cubemap_pipe_;
-  Pipeline irradiance_pipe_;
   Pipeline background_pipe_;
   Pipeline prefilter_pipe_;
   Pipeline brdf_pipe_;
@@ -47,26 +63,132 @@ class FinalScene final : public Scene {
 
   Pipeline down_sample_pipe_;
   Pipeline up_sample_pipe_;
-  Pipeline hdr_pipe_;
+  // Bloom composite, tonemap and gamma fused in one generated shader, drawn
+  // with a triangle covering the screen.
+  Pipeline post_pipe_;
+  PostStack post_stack_;
+  std::uint32_t post_key_ = 0;
+  GLuint fullscreen_vao_ = 0;
 
   GLuint captureFBO = 0;
 
-  GLuint captureRBO = 0;
-
   GLuint hdr_cubemap_ = 0;
   GLuint env_cubemap_ = 0;
-  GLuint irradianceMap = 0;
   GLuint brdfLUTTexture = 0;
   GLuint prefilterMap = 0;
-
-  Model lamp_model_;
-  Model backpack_model_;
-  Model man_model_;
-
-  Material ground_mat_;
+  static constexpr unsigned int kPrefilterMipCount = 5;
+  static constexpr GLsizei kPrefilterSize = 128;
+  static constexpr GLsizei kBrdfLutSize = 512;
+  // The environment face size follows the source map and the viewport.
+  static constexpr std::uint32_t kMinEnvironmentSize = 128;
+  static constexpr std::uint32_t kMaxEnvironmentSize = 4096;
+  // Half the bytes of RGB16F, the radiance is clamped to 25 anyway.
+  static constexpr GLint kEnvironmentFormat = GL_R11F_G11F_B10F;
+  static constexpr std::uint32_t kEnvironmentTexelBytes = 4;
+  std::uint32_t environment_size_ = kMinEnvironmentSize;
+  // Full mip chain for a filtered skybox and cheaper prefilter samples.
+  bool is_environment_mipmapped_ = true;
+  // Deletes the source map and the capture programs once baked.
+  bool free_ibl_intermediates_ = true;
+  GpuMemoryReport ibl_memory_;
+
+  // The environment products are baked once then reloaded from disk while
+  // the map and the filtering shaders don't change.
+  static constexpr std::string_view kIblSourcePath =
+      "data/textures/final/peter.hdr";
+  static constexpr std::string_view kIblCachePath =
+      "data/textures/final/peter.ibl";
+  IblCacheReport ibl_report_{};
+
+  // Diffuse environment lighting, projected on the CPU and read by the
+  // lighting from a uniform block.
+  ShProjector sh_projector_;
+  ShIrradiance irradiance_sh_{};
+  GLuint irradiance_sh_ubo_ = 0;
+  static constexpr GLuint kIrradianceShBinding = 0;
+
+  // Models and materials of the scene file, in its order.
+  std::vector<Model> scene_models_;
+  std::vector<Material> scene_materials_;
+  // Untextured, for the objects the file gives no material.
+  Material default_material_;
   bool is_frist_frame_ = true;
-  Material steel_;
-  Material titanium_;
+
+  // Drawn objects of the scene file, each one owns a range of culling
+  // entries: one per mesh.
+  static constexpr std::uint32_t kNoSceneLight = ~0u;
+  struct SceneObject {
+    // A model of the file, or a built-in mesh when there is none.
+    Model* model = nullptr;
+    Mesh* mesh = nullptr;
+    bool is_sphere = false;
+    Material* material = nullptr;
+    Transform placement{};
+    // Index of the light it moves with.
+    std::uint32_t light = kNoSceneLight;
+    // Drawn in the dynamic layer of the shadows.
+    bool is_dynamic = false;
+    // Moved since the last shadow update.
+    bool is_moved = false;
+    std::uint32_t entity = 0;
+    std::uint32_t first_entry = 0;
+    std::uint32_t end_entry = 0;
+  };
+  std::vector<SceneObject> scene_objects_;
+  // Lights of the scene file. The first one casts the shadows, the others
+  // join the point lights.
+  struct SceneLight {
+    glm::vec3 rest_position{0.f};
+    glm::vec3 position{0.f};
+    glm::vec3 color{1.f};
+    float radius = 1.f;
+  };
+  std::vector<SceneLight> scene_lights_;
+  // Used when the file has no light.
+  static constexpr glm::vec3 kDefaultLightPos = glm::vec3(0, 5, 0);
+  static constexpr glm::vec3 kDefaultLightColor = glm::vec3(10);
+  // Local volumes of each culling entry, to update the moved objects.
+  std::vector<BoundingBox> entry_boxes_;
+  std::vector<BoundingSphere> entry_spheres_;
+  // Placement of the objects, with the nodes of their models under them.
+  // Each culling entry is placed by the entity of its mesh node.
+  TransformStore transforms_;
+  std::vector<std::uint32_t> entry_entities_;
+  TransformStats transform_stats_{};
+  TransformStats benchmark_transform_stats_{};
+  static constexpr std::size_t kTransformBenchmarkEntityCount = 1'000'000;
+
+  static constexpr float kDynamicOrbitRadius = 1.5f;
+  bool animate_dynamic_casters_ = false;
+  float animation_time_ = 0.f;
+
+  CullingSet culling_set_;
+  FrustumCuller culler_;
+  // Result of the last culled frustum, camera or shadow map face.
+  std::vector<std::uint8_t> visibility_;
+  CullingStats camera_culling_stats_{};
+  CullingStats benchmark_culling_stats_{};
+  static constexpr std::size_t kCullingBenchmarkObjectCount = 1'000'000;
+
+  // Per frame transforms and light lists, written in mapped memory.
+  FrameDataRing frame_ring_;
+  static constexpr GLuint kShadowObjectBinding = 2;
+
+  // Visible meshes of the G-buffer pass, recorded in ranges on the compute
+  // workers and replayed on this thread.
+  struct GBufferDraw {
+    const Mesh* mesh = nullptr;
+    const Material* material = nullptr;
+    std::uint32_t entity = 0;
+    bool is_sphere = false;
+  };
+  std::vector<GBufferDraw> g_buffer_draws_;
+  CommandRecorder g_buffer_recorder_;
+  GlCommandBackend command_backend_{frame_ring_};
+  CommandBufferStats g_buffer_command_stats_{};
+  CommandBufferStats benchmark_command_stats_{};
+  static constexpr std::size_t kCommandBenchmarkDrawCount = 100'000;
+  static constexpr GLuint kObjectBlockBinding = 1;
 
   glm::mat4 captureProjection = glm::mat4(1.0f);
   std::array<glm::mat4, 6> captureViews{};
@@ -75,26 +197,68 @@ class FinalScene final : public Scene {
   glm::mat4 projection = glm::mat4(1.0f);
   glm::mat4 model = glm::mat4(1.0f);
 
-  glm::vec3 lamp_pos_ = glm::vec3(0.077, 5.3, -10);
-  glm::vec3 light_color_ = glm::vec3(10);
-
   GLuint bloom_fbo_;
+  // Scene color with the g-buffer depth, for the lamp and the skybox. The
+  // lighting writes the color alone through lighting_fbo_ while it samples
+  // the depth.
   GLuint hdr_fbo_;
-  GLuint hdr_rbo_;
+  GLuint lighting_fbo_ = 0;
 
   GLuint g_buffer_;
-  GLuint pos_map_;
-  GLuint normal_map_;
-  GLuint albedo_map_;
-  GLuint depth_rbo_;
-
-  GLuint bright_tex_;
-  GLuint scene_tex_;
-
-  std::vector<BloomMip> bloom_mips_;
-
-  static constexpr GLuint kSsaoKernelSampleCount_ = 64;
-  std::array<glm::vec3, kSsaoKernelSampleCount_> ssao_kernel_{};
+  // Transient targets, views of the render graph slots.
+  GLuint normal_map_ = 0;
+  GLuint albedo_map_ = 0;
+  GLuint material_map_ = 0;
+  GLuint depth_map_ = 0;
+
+  GLuint scene_tex_ = 0;
+
+  // Passes of the frame with the targets they read and write. It is built
+  // again when the SSAO preset or the bloom changes what they use.
+  RenderGraph render_graph_;
+  RenderGraphTextures render_graph_textures_;
+  int render_graph_ssao_preset_ = -1;
+  bool render_graph_has_bloom_ = false;
+  std::uint32_t render_graph_bloom_pass_ = RenderGraph::kInvalid;
+
+  // Bloom chain from half resolution down in one texture. Every level also
+  // has a single level view, sampled or attached without the others being
+  // a feedback loop.
+  static constexpr GLsizei kBloomLevelCount = 5;
+  static constexpr float kBloomFilterRadius = 0.007f;
+  static constexpr float kBloomStrength = 0.04f;
+  // Luminance under which the bright pass drops a pixel.
+  static constexpr float kBloomThreshold = 1.f;
+  GLuint bloom_tex_ = 0;
+  std::array<GLuint, kBloomLevelCount> bloom_views_{};
+  std::array<glm::ivec2, kBloomLevelCount> bloom_sizes_{};
+  Pipeline bloom_down_pipe_;
+  Pipeline bloom_up_pipe_;
+  // The fragment chain is kept to compare the timings.
+  bool is_bloom_compute_ = true;
+
+  // Passes timed on the GPU every frame.
+  enum GpuZone : std::uint8_t {
+    kGpuZoneShadows,
+    kGpuZoneGBuffer,
+    kGpuZoneSsao,
+    kGpuZoneLighting,
+    kGpuZoneLamp,
+    kGpuZoneSkyBox,
+    kGpuZoneBloom,
+    kGpuZonePost,
+    kGpuZoneCount,
+  };
+  static constexpr std::array<const char*, kGpuZoneCount> kGpuZoneNames = {
+      "Shadows", "G-buffer", "SSAO",  "Lighting",
+      "Lamp",    "Skybox",   "Bloom", "Post composite"};
+  GpuProfiler gpu_profiler_;
+  bool show_gpu_overlay_ = true;
+
+  int ssao_preset_index_ = 4;
+  // Preset the kernel and the low resolution targets were made for.
+  int ssao_current_preset_index_ = -1;
+  glm::ivec2 ssao_size_ = glm::ivec2(0);
   static constexpr int kSsaoNoiseDimensionX_ = 4, kSsaoNoiseDimensionY_ = 4;
 
   static constexpr float kSsaoRadius = 0.5f;
@@ -104,78 +268,236 @@ class FinalScene final : public Scene {
   GLuint noise_texture_;
   GLuint ssao_fbo_;
   GLuint ssao_blur_fbo_;
-  GLuint ssao_tex_;
-  GLuint ssao_blur_tex_;
+  GLuint ssao_blurred_fbo_ = 0;
+  // Low resolution occlusion and depth, blurred in x then in y. The raw and
+  // the blurred targets are views of one slot of the render graph.
+  GLuint ssao_tex_ = 0;
+  GLuint ssao_blur_tex_ = 0;
+  GLuint ssao_blurred_tex_ = 0;
+  // Full resolution result read by the lighting.
+  GLuint ssao_upsample_fbo_ = 0;
+  GLuint ssao_result_tex_ = 0;
+  Pipeline ssao_upsample_pipe_;
+  // Temporal presets: occlusion, view space depth and octahedral world
+  // normal of the last two frames, written and read in turn.
+  std::array<GLuint, 2> ssao_history_fbo_{};
+  std::array<GLuint, 2> ssao_history_tex_{};
+  int ssao_history_index_ = 0;
+  bool is_ssao_history_valid_ = false;
+  std::uint32_t ssao_frame_index_ = 0;
+  glm::mat4 ssao_prev_view_ = glm::mat4(1.0f);
+  glm::mat4 ssao_prev_projection_ = glm::mat4(1.0f);
+  Pipeline ssao_temporal_pipe_;
 
   Pipeline shadow_map_pipe_;
   GLuint shadow_fbo_;
-  GLuint shadow_tex_;
+  // Atlases of 16 bit depth cube faces sharing the same tiles. The static
+  // casters only one is copied under the dynamic casters into shadow_tex_.
+  GLuint shadow_static_tex_ = 0;
+  GLuint shadow_tex_ = 0;
+  ShadowAtlas shadow_atlas_;
+  const ShadowAtlas::Light* shadow_light_ = nullptr;
+  static constexpr std::uint32_t kLampShadowId = 0;
+  static constexpr std::uint32_t kShadowTexelBytes = 2;
+  static constexpr std::uint32_t kMinShadowResolution = 256;
+  static constexpr std::uint32_t kMaxShadowResolution = 4096;
+  static constexpr std::array<std::size_t, 3> kShadowBudgets = {
+      32u << 20, 128u << 20, 512u << 20};
+  int shadow_budget_index_ = 1;
+  bool is_shadow_atlas_dirty_ = false;
+  ShadowFaceScheduler shadow_scheduler_;
+  ShadowCasterFaces shadow_caster_faces_;
+  ShadowCasterFaces::LightMatrices light_space_matrices_{};
+  glm::vec3 shadow_light_pos_ = glm::vec3(0.0f);
+  int shadow_face_budget_ = 2;
+
+  static constexpr float kCameraNearPlane = 0.1f;
+  static constexpr float kCameraFarPlane = 100.f;
+
+  // Unshadowed point lights, assigned to the clusters of the view frustum on
+  // the compute workers every frame.
+  static constexpr int kMaxPointLights = 1024;
+  static constexpr GLsizei kClusterIndexTextureWidth = 4096;
+  static constexpr glm::vec3 kPointLightRoomMin = glm::vec3(-20, 0.7, -25);
+  static constexpr glm::vec3 kPointLightRoomMax = glm::vec3(20, 4, 10);
+  static constexpr float kPointLightOrbitRadius = 1.5f;
+  int point_light_count_ = 512;
+  bool animate_point_lights_ = true;
+  float point_light_time_ = 0.f;
+  // Rest positions, the lights orbit around them.
+  std::vector<PointLight> point_lights_;
+  std::vector<PointLight> moved_point_lights_;
+  ClusterGrid cluster_grid_;
+  glm::mat4 cluster_projection_ = glm::mat4(0.0f);
+  ClusterLightSet cluster_light_set_;
+  LightClusterer light_clusterer_;
+  ClusterStats cluster_stats_{};
+  static constexpr std::array<std::size_t, 4> kClusterBenchmarkLightCounts = {
+      256, 1024, 4096, 16384};
+  std::array<ClusterStats, kClusterBenchmarkLightCounts.size()>
+      cluster_benchmark_stats_{};
+  // Row 0: world position and radius, row 1: color.
+  GLuint point_lights_tex_ = 0;
+  // Offset and count of each cluster in the index list.
+  GLuint cluster_lights_tex_ = 0;
+  GLuint cluster_indices_tex_ = 0;
+  GLsizei cluster_index_rows_ = 0;
 
   glm::mat4 lightSpaceMatrix;
-  constexpr static int nb_data = 30;
-  std::array<FileBuffer, nb_data> fbArray{};
-  std::array<TextureBuffer, nb_data> textures{};
+  // Assets and placements of the scene, parsed on a loading worker. Each
+  // texture it lists loads once, through a read, a decompress and an upload
+  // job.
+  static constexpr std::string_view kSceneFile = "data/scenes/final.json";
+  SceneDescription scene_description_;
+  LoadSceneDescriptionJob scene_description_job_;
+  bool are_scene_loads_queued_ = false;
+  std::vector<FileBuffer> scene_files_;
+  std::vector<TextureBuffer> scene_texture_buffers_;
+  std::vector<GLuint> scene_textures_;
+  // Packed data written by the asset packer. The textures it holds are
+  // unpacked on the compute workers instead of read, the others stay loose
+  // files.
+  static constexpr std::string_view kAssetArchiveFile = "data.pack";
+  AssetArchive asset_archive_;
+  std::size_t packed_texture_count_ = 0;
 
-  static constexpr int shadow_tex_res_ = 4096;
 
   static constexpr float kLightNearPlane = 4.5f;
   static constexpr float kLightFarPlane = 100.f;
 
-  static constexpr std::array<glm::vec3, 6> light_dirs = {
-      glm::vec3(1, 0, 0),  glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0),
-      glm::vec3(0, -1, 0), glm::vec3(0, 0, 1),  glm::vec3(0, 0, -1),
-  };
-  static constexpr std::array<glm::vec3, 6> light_ups = {
-      glm::vec3(0, -1, 0), glm::vec3(0, -1, 0), glm::vec3(0, 0, 1),
-      glm::vec3(0, 0, -1), glm::vec3(0, -1, 0), glm::vec3(0, -1, 0),
-  };
-
  public:
   void Begin() override;
   void End() override;
   void Update(float dt) override;
 
+  [[nodiscard]] bool IsReady() const noexcept override {
+    return is_initialized_;
+  }
+  [[nodiscard]] GpuTimingHistory* gpu_timings() noexcept override {
+    return &gpu_profiler_.history();
+  }
+  void AddStartupPhases(std::vector<BenchmarkTiming>& phases) const override;
+
  private:
   void BeginSkyBox();
   void UpdateSkyBox();
   void DeleteSkyBox();
 
-  void CreateIrradianceMap();
+  // Loads the IBL textures from the cache or bakes and saves them.
+  void BeginIbl();
+  void CreateEnvironmentMap(const HdrImage& image);
+  void ProjectIrradiance(const HdrImage& image);
+  void UploadIrradianceSh();
   void CreatePrefilterMap();
   void CreateBRDF();
+  void CreateIblTextures(const IblCache& cache);
+  void DeleteIblIntermediates();
+  [[nodiscard]] std::uint32_t EnvironmentLevelCount() const noexcept {
+    return is_environment_mipmapped_ ? MipCount(environment_size_) : 1;
+  }
+  void ReadBackIbl(IblCache& cache) const;
 
   void BeginLamp();
   void UpdateLamp();
   void DeleteLamp();
 
+  // Declares the passes in GPU zone order, a pass id is its zone.
+  void BuildRenderGraph();
+  void AttachRenderTargets();
+  void DeleteRenderGraph();
+  [[nodiscard]] bool IsRenderGraphStale() const noexcept {
+    return render_graph_ssao_preset_ != ssao_current_preset_index_ ||
+           render_graph_has_bloom_ != post_stack_.IsActive(PostEffect::kBloom);
+  }
+
   void BeginGBuffer();
   void UpdateGBuffer();
   void DeleteGBuffer();
 
   void BeginSSAO();
+  // Resizes the low resolution targets and the kernel to the preset.
+  void ApplySsaoPreset();
   void UpdateSSAO();
   void DeleteSSAO();
 
   void BeginShadowMap();
+  void CreateShadowAtlas();
+  // Gives the light tiles sized from its screen coverage.
+  void AcquireShadowTiles();
+  void UpdateLightMatrices();
+  // Redraws at most `face_budget` out of date faces.
+  void UpdateShadowMap(int face_budget);
+  void DrawShadowCasters(bool is_dynamic, std::uint8_t faces);
   void DeleteShadowMap();
 
   void BeginPBR();
   void UpdatePBR();
   void DeletePBR();
 
-  void LoadRessources();
-
-  void UpdateGround(Pipeline& pipeline);
-  void DeleteGround();
+  void BeginClusteredLights();
+  // Moves the lights, assigns them to the clusters and uploads the lists.
+  void UpdateClusteredLights(float dt);
+  void DeleteClusteredLights();
 
-  void UpdateModels(Pipeline& pipeline);
-  void DeleteModels();
-
-  void UpdateSpheres(Pipeline& pipeline);
+  // Starts parsing the scene file.
+  void LoadRessources();
+  // Once the file is parsed: queues the model and the texture jobs.
+  void QueueSceneLoads();
+  // Once everything is loaded: binds the textures to the materials and
+  // builds the objects and the lights of the file.
+  void ApplySceneDescription();
+  // The shadowed lamp, there is always one once the scene is applied.
+  [[nodiscard]] SceneLight& main_light() noexcept {
+    return scene_lights_.front();
+  }
+
+  // One transform entity per object, its model nodes under it.
+  void BeginCulling();
+  void CullObjects(const glm::mat4& view_projection, CullingStats& stats);
+  [[nodiscard]] bool IsObjectVisible(const SceneObject& object) const noexcept;
+  void MoveObject(const SceneObject& object, const glm::vec3& position);
+  // Moves the objects with their lights and the animated casters.
+  void UpdateDynamicObjects(float dt);
+  // Propagates the moves down the hierarchies and updates the culling
+  // entries of the moved meshes.
+  void UpdateTransforms();
+  // Model matrix and face mask of the culling entry, for the shadow pass.
+  void SetEntryUniforms(std::uint32_t entry);
+  [[nodiscard]] const std::uint8_t* ObjectVisibility(
+      const SceneObject& object) const noexcept;
+
+  // Draws the visible meshes of the objects, in the order of the file.
+  void DrawObjects(Pipeline& pipeline);
+  void DeleteObjects();
+
+  // Lists the visible meshes of the G-buffer pass and syncs their vertex
+  // arrays with the buffer pool, on the GL thread.
+  void CollectGBufferDraws();
+  void RecordGBufferDraws(CommandBuffer& commands, std::size_t begin,
+                          std::size_t end) const;
+
+  // Generates and builds the composite shader of the enabled effects.
+  void BuildPostPipeline();
+  void DrawFullscreenTriangle();
+  // Runs the passes of the enabled effects into the default framebuffer.
+  void UpdatePostStack();
 
   void BeginBloom();
   void UpdateBloom();
   void DeleteBloom();
+  // Two levels per compute dispatch, or one draw per level.
+  void DownsampleBloomCompute();
+  void UpsampleBloomCompute();
+  void DownsampleBloomFragment();
+  void UpsampleBloomFragment();
+  // Negative turns the bright pass off.
+  [[nodiscard]] float BloomThreshold() const noexcept {
+    return post_stack_.IsActive(PostEffect::kBrightPass) ? kBloomThreshold
+                                                         : -1.f;
+  }
+
+  // Rolling graphs of the GPU zones and the timing export.
+  void DrawGpuProfiler();
 
   void DrawImgui() override;
 };
\ No newline at end of file
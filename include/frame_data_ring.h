@@ -0,0 +1,78 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+#include "frame_ring.h"
+
+// Mapped range of the ring, valid until the end of the frame.
+struct FrameAllocation {
+  std::byte* data = nullptr;
+  // The ring may have grown since, the buffer is the one to bind.
+  GLuint buffer = 0;
+  GLintptr offset = 0;
+  GLsizeiptr size = 0;
+
+  [[nodiscard]] bool IsValid() const noexcept { return data != nullptr; }
+};
+
+// Per frame data written by the CPU straight into a persistent, coherent
+// mapping: transforms, light lists, instance data. Three partitions, each
+// fenced after the frame writing it, the CPU waits for the GPU only when it
+// gets three frames ahead. Bind the allocations as uniform or storage
+// ranges, or as the unpack buffer of texture uploads.
+class FrameDataRing {
+ public:
+  static constexpr std::size_t kDefaultPartitionSize = 2 << 20;
+
+  void Begin(std::size_t partition_size = kDefaultPartitionSize);
+  void End();
+
+  // Waits for the GPU to be done with the partition of the frame.
+  void BeginFrame();
+  // After the last command reading the frame data.
+  void EndFrame();
+
+  // Aligned for uniform and storage ranges by default. A full partition
+  // moves the ring to a larger buffer, the old one stays mapped until the
+  // GPU is done with it: the allocations of the frame stay valid. Empty if
+  // the ring couldn't be mapped.
+  [[nodiscard]] FrameAllocation Allocate(std::size_t size,
+                                         std::size_t alignment = 0);
+  void BindRange(GLenum target, GLuint index,
+                 const FrameAllocation& allocation) const;
+
+  [[nodiscard]] std::size_t alignment() const noexcept { return alignment_; }
+  [[nodiscard]] std::size_t partition_size() const noexcept {
+    return allocator_.partition_size();
+  }
+  [[nodiscard]] const FrameRingStats& stats() const noexcept {
+    return stats_;
+  }
+
+ private:
+  struct RetiredBuffer {
+    GLuint buffer = 0;
+    GLsync fence = nullptr;
+  };
+
+  GLuint buffer_ = 0;
+  std::byte* mapped_ = nullptr;
+  std::size_t alignment_ = 256;
+  FrameRingAllocator allocator_{};
+  std::array<GLsync, FrameRingAllocator::kPartitionCount> fences_{};
+  FrameRingStats stats_{};
+  // Buffers the ring grew out of, deleted once the fence of the last frame
+  // using them is signaled.
+  std::vector<RetiredBuffer> retired_{};
+  // Bytes the frame allocated in the buffers it grew out of.
+  std::size_t retired_frame_bytes_ = 0;
+
+  void CreateStorage(std::size_t partition_size);
+  void DeleteStorage();
+  void Retire();
+  void DeleteRetired(bool wait);
+};
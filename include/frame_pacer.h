@@ -0,0 +1,64 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "frame_pacing.h"
+#include "gpu_timings.h"
+
+// Paces the frames of the interactive loop: caps the frame rate, keeps the
+// CPU at most a few frames ahead of the GPU with fences and estimates the
+// input latency. The latency runs from the input poll of a frame to the GPU
+// finishing it, read with a timestamp query issued after the swap. Vsync
+// adds up to a refresh before the frame is scanned out.
+class FramePacer {
+ public:
+  static constexpr std::size_t kMaxFramesInFlight = 4;
+
+  void Begin();
+  void End();
+
+  // Before polling the input: waits for the limiter and the GPU.
+  void BeginFrame(const FramePacingSettings& settings);
+  // After the swap.
+  void EndFrame();
+
+  // The CPU values go through the GPU timing history, it has everything the
+  // overlay needs.
+  [[nodiscard]] const GpuTimingHistory& history() const noexcept {
+    return history_;
+  }
+  [[nodiscard]] const FrameLimiter& limiter() const noexcept {
+    return limiter_;
+  }
+
+ private:
+  // A frame waiting for the GPU.
+  struct FrameSlot {
+    GLsync fence = nullptr;
+    GLuint query = 0;
+    FrameClock::time_point input_time{};
+  };
+  // More slots than frames in flight, the driver may queue more frames than
+  // we allow when the throttle is off.
+  static constexpr std::size_t kSlotCount = 2 * kMaxFramesInFlight;
+
+  std::array<FrameSlot, kSlotCount> slots_{};
+  // Slots [oldest_, next_) wait for the GPU, counted without wrapping.
+  std::uint64_t oldest_ = 0;
+  std::uint64_t next_ = 0;
+  // CPU clock minus GPU clock, in nanoseconds.
+  std::int64_t gpu_clock_offset_ = 0;
+  FrameClock::time_point frame_start_{};
+  FrameLimiter limiter_{};
+  GpuTimingHistory history_{};
+  std::vector<float> milliseconds_{};
+
+  // Reads the finished frames, waiting for them down to `max_pending`.
+  void Collect(std::size_t max_pending);
+  void CalibrateGpuClock();
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+
+using FrameClock = std::chrono::steady_clock;
+
+enum class PresentMode {
+  kVsync,
+  // Waits for the vertical blank only when the frame is on time, a late
+  // frame tears instead of waiting a whole refresh.
+  kAdaptiveVsync,
+  kImmediate,
+  kCount
+};
+
+inline constexpr std::array<const char*,
+                            static_cast<std::size_t>(PresentMode::kCount)>
+    kPresentModeNames = {"Vsync", "Adaptive vsync", "Immediate"};
+
+// Value of SDL_GL_SetSwapInterval.
+[[nodiscard]] int PresentModeSwapInterval(PresentMode mode) noexcept;
+
+struct FramePacingSettings {
+  PresentMode present_mode = PresentMode::kVsync;
+  // 0 doesn't cap the frame rate.
+  float max_fps = 0.f;
+  // Frames the CPU may queue ahead of the GPU, 0 lets the driver decide.
+  int max_frames_in_flight = 2;
+};
+
+// Starts the frames at a fixed rate. The OS sleep wakes up late by a
+// varying amount, so it only covers the wait up to a margin learned from
+// the worst wake up seen, the rest is spent spinning.
+class FrameLimiter {
+ public:
+  // Returns how long it waited.
+  FrameClock::duration Wait(float max_fps);
+
+  [[nodiscard]] FrameClock::duration spin_margin() const noexcept {
+    return spin_margin_;
+  }
+
+ private:
+  static constexpr FrameClock::duration kMinSpinMargin =
+      std::chrono::microseconds(200);
+  // Windows sleeps by steps of 15.6 ms without timeBeginPeriod.
+  static constexpr FrameClock::duration kMaxSpinMargin =
+      std::chrono::milliseconds(20);
+  // Shrinks back when the system wakes up on time again.
+  static constexpr FrameClock::duration kSpinMarginDecay =
+      std::chrono::microseconds(10);
+
+  FrameClock::time_point next_frame_{};
+  FrameClock::duration spin_margin_ = std::chrono::milliseconds(1);
+};
+
+// Values pushed each frame to the pacing history.
+enum FramePacingZone {
+  kFramePacingCpu,
+  kFramePacingLimiter,
+  kFramePacingThrottle,
+  kFramePacingLatency,
+  kFramePacingZoneCount
+};
+
+inline constexpr std::array<const char*, kFramePacingZoneCount>
+    kFramePacingZoneNames = {"CPU frame", "Limiter wait", "Throttle wait",
+                             "Input to present"};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Counters of the frame data ring, shown in the GPU profiler overlay.
+struct FrameRingStats {
+  std::uint64_t frame_count = 0;
+  // Frames whose partition was still read by the GPU when they began.
+  std::uint64_t stall_count = 0;
+  // Time blocked on the fences, summed and for the last stall.
+  float wait_milliseconds = 0.f;
+  float last_wait_milliseconds = 0.f;
+  std::size_t frame_bytes = 0;
+  std::size_t peak_frame_bytes = 0;
+  // Partitions too small for a frame, the ring was made larger.
+  std::uint64_t grow_count = 0;
+};
+
+// Offsets in a ring split in partitions, one per frame in flight. A frame
+// allocates linearly in its partition while the GPU reads the partitions
+// of the frames before. GL free, the fences are the caller's.
+class FrameRingAllocator {
+ public:
+  static constexpr std::uint32_t kPartitionCount = 3;
+  static constexpr std::size_t kInvalid = ~std::size_t{0};
+
+  void Reset(std::size_t partition_size) noexcept;
+  // Moves to the partition of the next frame and returns it.
+  std::uint32_t NextFrame() noexcept;
+  // Offset from the start of the ring, kInvalid when the partition is full.
+  [[nodiscard]] std::size_t Allocate(std::size_t size,
+                                     std::size_t alignment) noexcept;
+
+  [[nodiscard]] std::uint32_t partition() const noexcept { return partition_; }
+  [[nodiscard]] std::size_t partition_size() const noexcept {
+    return partition_size_;
+  }
+  [[nodiscard]] std::size_t RingSize() const noexcept {
+    return partition_size_ * kPartitionCount;
+  }
+  // Bytes allocated by the current frame, padding included.
+  [[nodiscard]] std::size_t used() const noexcept { return used_; }
+
+ private:
+  std::size_t partition_size_ = 0;
+  std::uint32_t partition_ = 0;
+  std::size_t used_ = 0;
+};
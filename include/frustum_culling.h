@@ -0,0 +1,118 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "JobSystem.h"
+
+// Objects are tested by batches of kCullBatchSize, one SIMD lane per object.
+static constexpr std::size_t kCullBatchSize = 8;
+
+struct BoundingBox {
+  glm::vec3 min = glm::vec3(0.f);
+  glm::vec3 max = glm::vec3(0.f);
+};
+
+// Centered on the bounding box, so that a plane test can keep the tightest of
+// the two volumes.
+struct BoundingSphere {
+  glm::vec3 center = glm::vec3(0.f);
+  float radius = 0.f;
+};
+
+// Computes both volumes from tightly packed xyz positions.
+void ComputeBounds(const std::vector<float>& positions, BoundingBox& box,
+                   BoundingSphere& sphere) noexcept;
+
+struct Frustum {
+  // xyz is the normalized inward normal, w the distance: a point p is inside
+  // when dot(xyz, p) + w >= 0 for the 6 planes.
+  std::array<glm::vec4, 6> planes{};
+
+  [[nodiscard]] static Frustum FromMatrix(
+      const glm::mat4& view_projection) noexcept;
+};
+
+// World space volumes in structure of arrays, padded to a multiple of
+// kCullBatchSize so that the last batch can be loaded in one go.
+struct CullingSet {
+  std::vector<float> center_x;
+  std::vector<float> center_y;
+  std::vector<float> center_z;
+  std::vector<float> extent_x;
+  std::vector<float> extent_y;
+  std::vector<float> extent_z;
+  std::vector<float> radius;
+
+  // Transforms the local volumes by `model` and returns the entry index.
+  std::uint32_t Add(const BoundingBox& box, const BoundingSphere& sphere,
+                    const glm::mat4& model) noexcept;
+  void Set(std::uint32_t index, const BoundingBox& box,
+           const BoundingSphere& sphere, const glm::mat4& model) noexcept;
+  void Resize(std::size_t count) noexcept;
+  void Clear() noexcept;
+
+  [[nodiscard]] std::size_t size() const noexcept { return size_; }
+
+ private:
+  std::size_t size_ = 0;
+};
+
+// Writes 1 in `visibility` for the objects of [begin, end) touching the
+// frustum, 0 for the others. Uses AVX when the compiler targets it, SSE
+// otherwise, and plain C++ on the other architectures.
+void CullRange(const Frustum& frustum, const CullingSet& set,
+               std::size_t begin, std::size_t end,
+               std::uint8_t* visibility) noexcept;
+
+class CullJob final : public Job {
+ public:
+  CullJob() noexcept : Job(JobType::kCompute) {}
+
+  void Setup(const Frustum* frustum, const CullingSet* set, std::size_t begin,
+             std::size_t end, std::uint8_t* visibility) noexcept;
+
+ private:
+  const Frustum* frustum_ = nullptr;
+  const CullingSet* set_ = nullptr;
+  std::size_t begin_ = 0;
+  std::size_t end_ = 0;
+  std::uint8_t* visibility_ = nullptr;
+
+  void Work() noexcept override;
+};
+
+struct CullingStats {
+  std::size_t tested_count = 0;
+  std::size_t visible_count = 0;
+  float milliseconds = 0.f;
+
+  [[nodiscard]] double MillionObjectsPerSecond() const noexcept {
+    return milliseconds <= 0.f ? 0.0
+                               : static_cast<double>(tested_count) /
+                                     (static_cast<double>(milliseconds) * 1e3);
+  }
+};
+
+// Splits the set in ranges run on the compute workers of the job system. Small
+// sets are culled on the calling thread, a job costs more than the test.
+class FrustumCuller {
+ public:
+  static constexpr std::size_t kMinObjectsPerJob = 4096;
+
+  CullingStats Cull(JobSystem& job_system, const Frustum& frustum,
+                    const CullingSet& set,
+                    std::vector<std::uint8_t>& visibility) noexcept;
+
+ private:
+  std::vector<CullJob> jobs_{};
+  std::vector<Job*> job_ptrs_{};
+};
+
+// Culls `object_count` random boxes against a camera frustum `iterations`
+// times and returns the best throughput.
+[[nodiscard]] CullingStats RunCullingBenchmark(JobSystem& job_system,
+                                               std::size_t object_count,
+                                               int iterations) noexcept;
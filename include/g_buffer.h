@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "ssao.h"
+
+// Bytes per pixel the passes move to and from the G-buffer targets.
+struct GBufferLayout {
+  const char* name = "";
+  // Color targets and depth written by the geometry pass.
+  std::uint32_t write_bytes = 0;
+  // Everything the lighting reads.
+  std::uint32_t lighting_bytes = 0;
+  // What a screen pass reads to get the position and the normal.
+  std::uint32_t position_normal_bytes = 0;
+  std::uint32_t normal_bytes = 0;
+  // What an occlusion sample reads to get a depth.
+  std::uint32_t depth_tap_bytes = 0;
+};
+
+// View space position and normal in RGBA16F, albedo in RGBA8 and a 32 bit
+// depth buffer, metallic, roughness and AO in the alpha channels.
+static constexpr GBufferLayout kLegacyGBufferLayout = {
+    "RGBA16F position, RGBA16F normal, RGBA8 albedo", 24, 20, 16, 8, 8};
+// Position reconstructed from the depth, octahedral normal in RG16, albedo
+// and metallic, roughness, AO in two RGBA8 targets.
+static constexpr GBufferLayout kCompactGBufferLayout = {
+    "Depth, RG16 octahedral normal, RGBA8 albedo, RGBA8 material", 16, 16, 8,
+    4, 4};
+
+// Estimated G-buffer traffic of a frame. Overdraw, caches and compression
+// are ignored: the numbers compare layouts, they don't measure the GPU.
+struct GBufferTraffic {
+  std::size_t geometry_bytes = 0;
+  std::size_t lighting_bytes = 0;
+  // Occlusion, temporal accumulation, blur and upsample.
+  std::size_t ssao_bytes = 0;
+
+  [[nodiscard]] std::size_t Total() const noexcept {
+    return geometry_bytes + lighting_bytes + ssao_bytes;
+  }
+};
+
+[[nodiscard]] GBufferTraffic EstimateGBufferTraffic(
+    const GBufferLayout& layout, int width, int height,
+    const SsaoPreset& ssao) noexcept;
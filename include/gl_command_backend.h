@@ -0,0 +1,34 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include "command_buffer.h"
+#include "frame_data_ring.h"
+
+// Replays command buffers on the GL thread. The uniform arenas are copied
+// in the frame data ring, the draws bind ranges of it.
+class GlCommandBackend final : public CommandBackend {
+ public:
+  explicit GlCommandBackend(FrameDataRing& ring) noexcept : ring_(ring) {}
+
+  void BeginReplay(std::size_t uniform_byte_size) override;
+  void UploadUniforms(std::size_t offset, const std::byte* data,
+                      std::size_t size) override;
+  void BindPipeline(std::uint32_t program) override;
+  void BindUniforms(std::uint32_t binding, std::size_t offset,
+                    std::size_t size) override;
+  void BindTextures(std::uint32_t first_unit, const std::uint32_t* textures,
+                    std::uint32_t count) override;
+  void DrawIndexed(const DrawIndexedCommand& draw) override;
+
+  // Offset alignment of the bound uniform ranges, to record with.
+  [[nodiscard]] std::uint32_t uniform_alignment() const noexcept {
+    return static_cast<std::uint32_t>(ring_.alignment());
+  }
+
+ private:
+  FrameDataRing& ring_;
+  FrameAllocation uniforms_{};
+  // Bound by the replay, forgotten at the next one.
+  GLuint vertex_array_ = 0;
+};
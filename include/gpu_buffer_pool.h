@@ -0,0 +1,84 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "tlsf_allocator.h"
+
+struct GpuBufferHandle {
+  static constexpr std::uint32_t kInvalid = UINT32_MAX;
+  std::uint32_t index = kInvalid;
+
+  [[nodiscard]] bool IsValid() const noexcept { return index != kInvalid; }
+};
+
+struct GpuBufferPoolStats {
+  std::size_t arena_count = 0;
+  TlsfStats total{};
+  std::uint64_t moved_bytes = 0;  // Since the pool was created.
+};
+
+// Hands out ranges of a few big GL buffers instead of one buffer per vertex
+// attribute. Freed ranges go back to the arena they came from so that a new
+// scene reuses the memory of the previous one.
+// Ranges may move when the pool is compacted: owners must compare
+// Generation() with the one they bound their vertex arrays with and re-bind
+// when it changed.
+class GpuBufferPool {
+ public:
+  static constexpr std::uint32_t kDefaultArenaSize = 32u * 1024u * 1024u;
+  // Bytes copied per frame at most by the compaction.
+  static constexpr std::uint32_t kCompactionBudget = 1024u * 1024u;
+
+  explicit GpuBufferPool(
+      std::uint32_t arena_size = kDefaultArenaSize) noexcept;
+
+  [[nodiscard]] GpuBufferHandle Allocate(
+      std::uint32_t size,
+      std::uint32_t alignment = TlsfAllocator::kGranularity) noexcept;
+  void Upload(GpuBufferHandle handle, std::uint32_t offset, const void* data,
+              std::uint32_t size) const noexcept;
+  void Free(GpuBufferHandle& handle) noexcept;
+
+  [[nodiscard]] GLuint Buffer(GpuBufferHandle handle) const noexcept;
+  [[nodiscard]] std::uint32_t Offset(GpuBufferHandle handle) const noexcept;
+  [[nodiscard]] std::uint32_t Generation(
+      GpuBufferHandle handle) const noexcept;
+
+  // Moves ranges towards the start of their arena, copying at most
+  // `byte_budget` bytes. Meant to be called once per frame so that the
+  // defragmentation is spread in the background over many frames.
+  void Compact(std::uint32_t byte_budget = kCompactionBudget) noexcept;
+
+  [[nodiscard]] GpuBufferPoolStats Stats() const noexcept;
+
+  // Deletes the GL buffers, every handle becomes invalid.
+  void Release() noexcept;
+
+ private:
+  struct Arena {
+    GLuint buffer = 0;
+    TlsfAllocator allocator;
+    // Handle slot owning each allocator block.
+    std::vector<std::uint32_t> block_slots;
+  };
+
+  struct Slot {
+    std::uint32_t arena = 0;
+    std::uint32_t block = TlsfAllocator::kInvalidBlock;
+    std::uint32_t generation = 0;
+  };
+
+  std::uint32_t arena_size_ = kDefaultArenaSize;
+  std::vector<Arena> arenas_{};
+  std::vector<Slot> slots_{};
+  std::vector<std::uint32_t> free_slots_{};
+  std::uint64_t moved_bytes_ = 0;
+
+  std::uint32_t CreateArena(std::uint32_t min_size) noexcept;
+  std::uint32_t NewSlot() noexcept;
+  static void SetBlockSlot(Arena& arena, std::uint32_t block,
+                           std::uint32_t slot) noexcept;
+};
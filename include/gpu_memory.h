@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Number of mips of a full chain down to 1x1.
+[[nodiscard]] std::uint32_t MipCount(std::uint32_t size) noexcept;
+// Bytes of a texture, summed over its faces and its first `levels` mips.
+[[nodiscard]] std::size_t TextureByteSize(std::uint32_t width,
+                                          std::uint32_t height,
+                                          std::uint32_t bytes_per_texel,
+                                          std::uint32_t faces = 1,
+                                          std::uint32_t levels = 1) noexcept;
+
+// Video memory of a group of resources, computed from their sizes and
+// formats since GL can't be asked. Freed resources stay listed to show what
+// they cost.
+class GpuMemoryReport {
+ public:
+  struct Entry {
+    std::string name{};
+    std::size_t bytes = 0;
+    bool is_freed = false;
+  };
+
+  void Clear() noexcept { entries_.clear(); }
+  void Add(std::string name, std::size_t bytes);
+  void MarkFreed(std::string_view name) noexcept;
+
+  [[nodiscard]] std::size_t ResidentBytes() const noexcept;
+  [[nodiscard]] std::size_t FreedBytes() const noexcept;
+  [[nodiscard]] const std::vector<Entry>& entries() const noexcept {
+    return entries_;
+  }
+
+ private:
+  std::vector<Entry> entries_{};
+};
+
+[[nodiscard]] inline float ToMegabytes(const std::size_t bytes) noexcept {
+  return static_cast<float>(bytes) / (1024.f * 1024.f);
+}
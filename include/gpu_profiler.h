@@ -0,0 +1,77 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "gpu_timings.h"
+
+// GPU duration of named zones, measured with GL_TIMESTAMP queries so that
+// the zones can nest, unlike GL_TIME_ELAPSED ones. A frame is read back
+// kFrameLatency frames later and never waits for the GPU: a frame whose
+// results are still not there is dropped.
+class GpuProfiler {
+ public:
+  static constexpr std::size_t kFrameLatency = 4;
+
+  void Begin(std::vector<std::string> zone_names);
+  void End();
+
+  // Reads back the oldest frame of the ring then records a new one in its
+  // queries.
+  void BeginFrame();
+  void BeginZone(std::size_t zone);
+  void EndZone(std::size_t zone);
+
+  // Empty for the zones out of range.
+  [[nodiscard]] const char* zone_name(std::size_t zone) const noexcept {
+    const auto& names = history_.zone_names();
+    return zone < names.size() ? names[zone].c_str() : "";
+  }
+  [[nodiscard]] const GpuTimingHistory& history() const noexcept {
+    return history_;
+  }
+  [[nodiscard]] GpuTimingHistory& history() noexcept { return history_; }
+  [[nodiscard]] std::size_t dropped_frame_count() const noexcept {
+    return dropped_frame_count_;
+  }
+
+ private:
+  // Begin and end timestamps of each zone of each frame of the ring.
+  std::vector<GLuint> queries_{};
+  // Zones recorded by each frame of the ring.
+  std::array<std::vector<std::uint8_t>, kFrameLatency> recorded_zones_{};
+  std::array<bool, kFrameLatency> is_frame_issued_{};
+  std::size_t frame_ = 0;
+  std::size_t zone_count_ = 0;
+  std::size_t dropped_frame_count_ = 0;
+  std::vector<float> milliseconds_{};
+  GpuTimingHistory history_;
+
+  [[nodiscard]] GLuint Query(std::size_t frame, std::size_t zone,
+                             bool is_end) const noexcept {
+    return queries_[(frame * zone_count_ + zone) * 2 + (is_end ? 1 : 0)];
+  }
+  // Returns false when the GPU isn't done with the frame yet.
+  bool ReadFrame(std::size_t frame);
+};
+
+// Times the rest of the scope on the GPU.
+class GpuZoneScope {
+ public:
+  GpuZoneScope(GpuProfiler& profiler, const std::size_t zone)
+      : profiler_(profiler), zone_(zone) {
+    profiler_.BeginZone(zone_);
+  }
+  ~GpuZoneScope() { profiler_.EndZone(zone_); }
+  GpuZoneScope(const GpuZoneScope&) = delete;
+  GpuZoneScope& operator=(const GpuZoneScope&) = delete;
+
+ private:
+  GpuProfiler& profiler_;
+  std::size_t zone_;
+};
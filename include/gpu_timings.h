@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Duration of named GPU zones over the last frames, in milliseconds.
+class GpuTimingHistory {
+ public:
+  static constexpr std::size_t kFrameCount = 240;
+
+  void Reset(std::vector<std::string> zone_names);
+  // One value per zone, a zone that didn't run that frame costs 0.
+  void Push(const std::vector<float>& milliseconds);
+
+  [[nodiscard]] std::size_t zone_count() const noexcept {
+    return zone_names_.size();
+  }
+  [[nodiscard]] const std::vector<std::string>& zone_names() const noexcept {
+    return zone_names_;
+  }
+  // Frames recorded, at most kFrameCount are kept.
+  [[nodiscard]] std::size_t frame_count() const noexcept {
+    return frame_count_;
+  }
+  // kFrameCount values of a zone, the oldest one at offset(). The frames not
+  // recorded yet are 0.
+  [[nodiscard]] const float* Values(std::size_t zone) const noexcept {
+    return values_.data() + zone * kFrameCount;
+  }
+  [[nodiscard]] int offset() const noexcept {
+    return static_cast<int>(next_);
+  }
+
+  [[nodiscard]] float Latest(std::size_t zone) const noexcept;
+  // Over the kept frames.
+  [[nodiscard]] float Average(std::size_t zone) const noexcept;
+  [[nodiscard]] float Max(std::size_t zone) const noexcept;
+  // Over every frame pushed since ResetSums(), not only the kept ones.
+  [[nodiscard]] float Mean(std::size_t zone) const noexcept;
+  void ResetSums() noexcept;
+
+  // A row per kept frame, a column per zone and the total. Return false when
+  // the file can't be written.
+  bool WriteCsv(std::string_view path) const;
+  // The average, the max and the samples of each zone.
+  bool WriteJson(std::string_view path) const;
+
+ private:
+  std::vector<std::string> zone_names_{};
+  // Zone major rings of kFrameCount values.
+  std::vector<float> values_{};
+  std::size_t next_ = 0;
+  std::size_t frame_count_ = 0;
+  std::vector<double> sums_{};
+  std::size_t summed_frame_count_ = 0;
+
+  [[nodiscard]] std::size_t KeptFrameCount() const noexcept;
+  // Value of the i-th kept frame, oldest first.
+  [[nodiscard]] float KeptValue(std::size_t zone,
+                                std::size_t i) const noexcept;
+};
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 64 bit FNV-1a, `seed` chains several buffers in one hash.
+[[nodiscard]] std::uint64_t HashBytes(
+    const void* data, std::size_t size,
+    std::uint64_t seed = 0xcbf29ce484222325ull) noexcept;
+// Hash of the content of the files, a missing file hashes its path only so
+// that it still changes the key.
+[[nodiscard]] std::uint64_t HashFiles(
+    const std::vector<std::string_view>& paths) noexcept;
+
+// What the baked products depend on: the environment map, the shaders that
+// filter it and the capture settings.
+struct IblCacheKey {
+  std::uint64_t source_hash = 0;
+  std::uint64_t shader_hash = 0;
+  std::uint64_t settings_hash = 0;
+
+  bool operator==(const IblCacheKey& other) const noexcept {
+    return source_hash == other.source_hash &&
+           shader_hash == other.shader_hash &&
+           settings_hash == other.settings_hash;
+  }
+};
+
+// Face size of the environment cubemap, a power of two between the min and
+// max sizes. A face spans 90 degrees: more than a quarter of the
+// equirectangular source width adds no detail, and more than the texels a
+// viewport `viewport_height` high shows over 90 degrees with a vertical
+// field of view of `vertical_fov` radians is never seen at mip 0.
+[[nodiscard]] std::uint32_t EnvironmentCaptureSize(
+    std::uint32_t source_width, float viewport_height, float vertical_fov,
+    std::uint32_t min_size, std::uint32_t max_size) noexcept;
+
+// Half float texels of a 2D texture or a cubemap, with its mips. The images
+// are stored level by level, each level holding its faces in the GL cubemap
+// face order.
+struct IblTexture {
+  std::uint32_t width = 0;
+  std::uint32_t height = 0;
+  std::uint32_t channel_count = 0;
+  std::uint32_t face_count = 0;
+  std::uint32_t level_count = 0;
+  std::vector<std::uint16_t> texels{};
+
+  void Resize(std::uint32_t new_width, std::uint32_t new_height,
+              std::uint32_t channels, std::uint32_t faces,
+              std::uint32_t levels);
+  [[nodiscard]] std::uint32_t LevelWidth(std::uint32_t level) const noexcept;
+  [[nodiscard]] std::uint32_t LevelHeight(std::uint32_t level) const noexcept;
+  [[nodiscard]] std::size_t ImageTexelCount(
+      std::uint32_t level) const noexcept;
+  [[nodiscard]] std::uint16_t* Image(std::uint32_t level,
+                                     std::uint32_t face) noexcept;
+  [[nodiscard]] const std::uint16_t* Image(std::uint32_t level,
+                                           std::uint32_t face) const noexcept;
+  [[nodiscard]] std::size_t byte_size() const noexcept {
+    return texels.size() * sizeof(std::uint16_t);
+  }
+};
+
+// Everything the image based lighting bakes at startup.
+struct IblCache {
+  enum TextureId : std::uint8_t {
+    kEnvironment,
+    kPrefilter,
+    kBrdfLut,
+    kTextureCount,
+  };
+
+  IblCacheKey key{};
+  // Time the bake took on the GPU that wrote the file, to report what a
+  // cache hit saves.
+  float bake_milliseconds = 0.f;
+  std::array<IblTexture, kTextureCount> textures{};
+  // RGB of the 9 spherical harmonics coefficients of the irradiance.
+  std::array<float, 27> irradiance_sh{};
+
+  [[nodiscard]] std::size_t byte_size() const noexcept;
+};
+
+// Returns false when the file can't be written.
+bool SaveIblCache(std::string_view path, const IblCache& cache);
+// Returns false when the file is missing, truncated, from another version or
+// baked with another key, the cache must then be baked again.
+bool LoadIblCache(std::string_view path, const IblCacheKey& key,
+                  IblCache& cache);
+
+// Startup report of the image based lighting.
+struct IblCacheReport {
+  bool is_hit = false;
+  bool is_saved = false;
+  // Startup cost, hashing and loading on a hit, baking and saving otherwise.
+  float milliseconds = 0.f;
+  float bake_milliseconds = 0.f;
+  std::size_t byte_size = 0;
+
+  [[nodiscard]] float SavedMilliseconds() const noexcept {
+    return is_hit ? bake_milliseconds - milliseconds : 0.f;
+  }
+};
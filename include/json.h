@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Value of a parsed JSON document. The members of an object keep the order
+// of the file, a lookup is linear: scene files have small objects.
+class JsonValue {
+ public:
+  enum class Type : std::uint8_t {
+    kNull,
+    kBool,
+    kNumber,
+    kString,
+    kArray,
+    kObject,
+  };
+
+  using Member = std::pair<std::string, JsonValue>;
+
+  [[nodiscard]] Type type() const noexcept { return type_; }
+  [[nodiscard]] bool IsNull() const noexcept { return type_ == Type::kNull; }
+  [[nodiscard]] bool IsBool() const noexcept { return type_ == Type::kBool; }
+  [[nodiscard]] bool IsNumber() const noexcept {
+    return type_ == Type::kNumber;
+  }
+  [[nodiscard]] bool IsString() const noexcept {
+    return type_ == Type::kString;
+  }
+  [[nodiscard]] bool IsArray() const noexcept { return type_ == Type::kArray; }
+  [[nodiscard]] bool IsObject() const noexcept {
+    return type_ == Type::kObject;
+  }
+
+  // `fallback` when the value has another type.
+  [[nodiscard]] bool AsBool(bool fallback = false) const noexcept;
+  [[nodiscard]] double AsNumber(double fallback = 0.0) const noexcept;
+  [[nodiscard]] float AsFloat(float fallback = 0.f) const noexcept;
+  // Empty when the value isn't a string.
+  [[nodiscard]] const std::string& AsString() const noexcept;
+
+  // Empty unless the value is an array.
+  [[nodiscard]] const std::vector<JsonValue>& items() const noexcept {
+    return items_;
+  }
+  // Empty unless the value is an object.
+  [[nodiscard]] const std::vector<Member>& members() const noexcept {
+    return members_;
+  }
+  // Member of an object, nullptr when missing.
+  [[nodiscard]] const JsonValue* Find(std::string_view key) const noexcept;
+
+ private:
+  Type type_ = Type::kNull;
+  bool bool_ = false;
+  double number_ = 0.0;
+  std::string string_{};
+  std::vector<JsonValue> items_{};
+  std::vector<Member> members_{};
+
+  friend class JsonParser;
+};
+
+// Parses a whole document. Returns false with the line of the error in
+// `error` when the text isn't valid JSON.
+bool ParseJson(std::string_view text, JsonValue& value, std::string& error);
@@ -4,17 +4,32 @@
 #include <assimp/scene.h>
 #include <texture_manager.h>
 
+#include <array>
 #include <assimp/Importer.hpp>
+#include <glm/glm.hpp>
+#include <string>
 #include <string_view>
 #include <vector>
 
+#include "JobSystem.h"
+#include "command_buffer.h"
+#include "frustum_culling.h"
+#include "gpu_buffer_pool.h"
+#include "transform_store.h"
+
 class Mesh {
  public:
   Mesh() = default;
+  // Owns its range of the pool and its vertex array: moved, never copied.
+  Mesh(Mesh&& other) noexcept;
+  Mesh& operator=(Mesh&& other) noexcept;
+  Mesh(const Mesh&) = delete;
+  Mesh& operator=(const Mesh&) = delete;
   void SetTriangle();
-  void SetQuad(float scale = 1);
-  void SetCube(float scale = 1, glm::vec2 factor = glm::vec2(1, 1));
-  void SetSphere();
+  void SetQuad(GpuBufferPool& pool, float scale = 1);
+  void SetCube(GpuBufferPool& pool, float scale = 1,
+               glm::vec2 factor = glm::vec2(1, 1));
+  void SetSphere(GpuBufferPool& pool);
   std::vector<float> vertices_;
   std::vector<float> tex_coord_;
   std::vector<float> normals_;
@@ -23,13 +38,43 @@ class Mesh {
 
   std::vector<GLuint> indices_;
 
-  GLuint vao_;
-  std::vector<GLuint> vbo_;
-  GLuint ebo_ = 0;
+  GLuint vao_ = 0;
+
+  // Local space volumes, computed from the positions by Upload.
+  BoundingBox bounds_{};
+  BoundingSphere bounding_sphere_{};
 
+  // Packs every attribute and the indices in a single range of the pool,
+  // the previous range is given back.
+  void Upload(GpuBufferPool& pool);
   void Draw(bool is_sphere = false);
+  // Respecifies the vertex array if the pool moved the range. On the GL
+  // thread, before recording draws of the mesh.
+  void SyncAttributes();
+  // Empty if the mesh has no geometry.
+  [[nodiscard]] DrawIndexedCommand DrawCommand(
+      bool is_sphere = false) const noexcept;
   void clear();
-  void BindVBO(int index, std::vector<float> elements, int size);
+  // Gives the range back to the pool and deletes the vertex array.
+  void Delete();
+
+ private:
+  static constexpr int kAttributeCount = 5;
+  static constexpr std::array<int, kAttributeCount> kAttributeComponents = {
+      3, 2, 3, 3, 3};
+
+  GpuBufferPool* pool_ = nullptr;
+  GpuBufferHandle geometry_{};
+  std::uint32_t bound_generation_ = 0;
+
+  std::array<std::uint32_t, kAttributeCount> attribute_offsets_{};
+  std::uint32_t attribute_mask_ = 0;
+  std::uint32_t index_offset_ = 0;
+  GLsizei index_count_ = 0;
+
+  // (Re)specifies the vertex array, needed again each time the pool moved the
+  // range.
+  void BindAttributes();
 };
 
 struct Material {
@@ -42,6 +87,12 @@ struct Material {
 	void Set();
   void Clear();
 };
+// Node of the model hierarchy, the parents come before their children.
+struct ModelNode {
+  Transform local{};
+  std::uint32_t parent = TransformStore::kNoParent;
+};
+
 class Model {
  public:
   Material mat;
@@ -50,15 +101,59 @@ class Model {
   TextureManager tm_;
 
   std::vector<Mesh> meshes_;
+  std::vector<ModelNode> nodes_;
+  // Node of each mesh.
+  std::vector<std::uint32_t> mesh_nodes_;
   std::string dir_path_;
 
  public:
-  void Load(std::string_view path, bool flip = false);
+  // Reads the file and builds the nodes and the mesh geometry on the CPU,
+  // without GL: on a loading worker.
+  void Import(std::string_view path, bool flip = false);
+  // Gives the imported meshes their range of the pool, on the GL thread.
+  void Upload(GpuBufferPool& pool);
 
   void Draw();
+  void SyncAttributes();
+  void DrawMesh(std::size_t index);
   void Clear();
 
+  [[nodiscard]] const std::vector<Mesh>& meshes() const noexcept {
+    return meshes_;
+  }
+  [[nodiscard]] const std::vector<ModelNode>& nodes() const noexcept {
+    return nodes_;
+  }
+  [[nodiscard]] const std::vector<std::uint32_t>& mesh_nodes() const noexcept {
+    return mesh_nodes_;
+  }
+
  private:
-  void ProcessNode(aiNode* node, const aiScene* scene);
+  void ProcessNode(aiNode* node, const aiScene* scene, std::uint32_t parent);
   Mesh ProcessMesh(aiMesh* mesh, const aiScene* scene);
 };
+
+// Imports a model on the model loading worker.
+class ImportModelJob final : public Job {
+ public:
+  ImportModelJob(Model* model, std::string path, bool flip) noexcept;
+
+  void Work() noexcept override;
+
+ private:
+  Model* model_ = nullptr;
+  std::string path_{};
+  bool flip_ = false;
+};
+
+// Uploads an imported model, on the main thread once its import is done.
+class UploadModelJob final : public Job {
+ public:
+  UploadModelJob(Model* model, GpuBufferPool* pool) noexcept;
+
+  void Work() noexcept override;
+
+ private:
+  Model* model_ = nullptr;
+  GpuBufferPool* pool_ = nullptr;
+};
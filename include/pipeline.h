@@ -6,6 +6,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
+#include <string>
 #include <vector>
 
 #include "file_utility.h"
@@ -15,21 +16,42 @@ class Pipeline {
  public:
   void Bind();
   void Delete();
+  // Binds a program by name, for the command buffer replay.
+  static void Use(GLuint program);
+
+  [[nodiscard]] GLuint program() const noexcept { return program_; }
 
   void SetInt(std::string_view name, int value);
   void SetFloat(std::string_view name, float value);
   void SetMat4(std::string_view name, glm::mat4 matrix);
+  void SetMat4Array(std::string_view name, const glm::mat4* matrices,
+                    int count);
+  void SetVec4Array(std::string_view name, const glm::vec4* vectors,
+                    int count);
   void SetVec2(std::string_view name, glm::vec2 vec2);
+  void SetIVec2(std::string_view name, glm::ivec2 vec2);
   void SetVec3Color(std::string_view name, glm::vec3 vec3);
   void SetVec3Position(std::string_view name, glm::vec3 vec3);
+  // Points the uniform block at the buffer bound to `binding`.
+  void SetUniformBlockBinding(std::string_view name, GLuint binding);
 
   void LoadShader(std::string_view vert_path, std::string_view frag_path);
+  // Same with the fragment shader given as source, e.g. generated.
+  void LoadShaderSource(std::string_view vert_path,
+                        const std::string& frag_source);
+  // Same with a geometry shader between the vertex and fragment stages.
+  void LoadShader(std::string_view vert_path, std::string_view geom_path,
+                  std::string_view frag_path);
+  // Compute program, dispatched with glDispatchCompute once bound.
+  void LoadComputeShader(std::string_view comp_path);
 
   void LoadProgram();
 
  private:
   GLuint vertex_shader_ = 0;
   GLuint fragment_shader_ = 0;
+  GLuint geometry_shader_ = 0;
+  GLuint compute_shader_ = 0;
   GLuint program_ = 0;
 
   inline static GLuint current_program_ = 0;
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Effects after the lighting, in the order they apply.
+enum class PostEffect : std::uint8_t {
+  // Keeps the pixels brighter than the threshold in the bloom source.
+  kBrightPass,
+  kBloom,
+  kTonemap,
+  kGamma,
+  kCount,
+};
+
+struct PostEffectInfo {
+  const char* name = "";
+  // Defined in the generated shader when the effect is active.
+  const char* define = "";
+};
+
+static constexpr std::array<PostEffectInfo,
+                            static_cast<std::size_t>(PostEffect::kCount)>
+    kPostEffects = {{
+        {"Bright pass", "BRIGHT_PASS"},
+        {"Bloom", "BLOOM"},
+        {"Tonemap", "TONEMAP"},
+        {"Gamma", "GAMMA"},
+    }};
+
+// Passes a frame of post-processing runs.
+struct PostPassCount {
+  int fragment_passes = 0;
+  int compute_passes = 0;
+  // Full resolution targets read or written, the composite included.
+  int full_resolution_accesses = 0;
+};
+
+// The enabled effects, fused in one composite shader generated from a
+// template. A disabled effect is left out of the shader and its passes are
+// not run, instead of running with neutral parameters.
+class PostStack {
+ public:
+  void SetEnabled(PostEffect effect, bool is_enabled) noexcept;
+  [[nodiscard]] bool IsEnabled(PostEffect effect) const noexcept {
+    return (enabled_mask_ & Bit(effect)) != 0;
+  }
+  // Enabled and useful: the bright pass only feeds the bloom.
+  [[nodiscard]] bool IsActive(PostEffect effect) const noexcept;
+  // Changes when the generated shader has to be built again.
+  [[nodiscard]] std::uint32_t Key() const noexcept;
+
+  // The template with a define per active effect after its version line.
+  [[nodiscard]] std::string GenerateShader(
+      std::string_view template_source) const;
+  // One composite pass, plus the bloom chain of `bloom_level_count` levels
+  // whose last upsample is done by the composite.
+  [[nodiscard]] PostPassCount PassCount(int bloom_level_count,
+                                        bool is_bloom_compute) const noexcept;
+
+ private:
+  [[nodiscard]] static constexpr std::uint32_t Bit(
+      const PostEffect effect) noexcept {
+    return 1u << static_cast<std::uint32_t>(effect);
+  }
+
+  std::uint32_t enabled_mask_ = (1u << kPostEffects.size()) - 1;
+};
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Texture allocated by the graph for the frame only.
+struct RenderGraphTextureDesc {
+  std::string name{};
+  int width = 0;
+  int height = 0;
+  // GL internal format and sampling filter, only compared here.
+  std::uint32_t format = 0;
+  std::uint32_t filter = 0;
+  std::uint32_t bytes_per_texel = 0;
+  std::uint32_t levels = 1;
+  // A depth format can only be viewed as itself.
+  bool is_depth = false;
+};
+
+// Storage shared by transient textures whose lifetimes don't overlap. GL
+// can't alias memory between textures, so the textures of a slot are views
+// of one immutable storage: same size, same levels and same bits per texel,
+// the view compatibility class of the uncompressed color formats.
+struct RenderGraphSlot {
+  RenderGraphTextureDesc desc{};
+  std::size_t byte_size = 0;
+  // Last pass using the slot, while the graph is compiled.
+  std::uint32_t last_pass = 0;
+  std::uint32_t texture_count = 0;
+};
+
+struct RenderGraphStats {
+  std::size_t pass_count = 0;
+  std::size_t culled_pass_count = 0;
+  std::size_t texture_count = 0;
+  // Transient textures sharing the slot of an older one.
+  std::size_t aliased_texture_count = 0;
+  // Every used transient texture on its own, then the slots.
+  std::size_t transient_bytes = 0;
+  std::size_t slot_bytes = 0;
+};
+
+// Passes declare the textures they read and write, in execution order.
+// Compile() culls the passes nothing needs, computes the lifetime of the
+// textures and packs them into slots. GL free, the renderer creates the
+// slots and runs the passes that are still alive.
+class RenderGraph {
+ public:
+  static constexpr std::uint32_t kInvalid = ~0u;
+
+  struct Pass {
+    std::string name{};
+    std::vector<std::uint32_t> reads{};
+    std::vector<std::uint32_t> writes{};
+    bool is_alive = true;
+  };
+
+  struct Texture {
+    RenderGraphTextureDesc desc{};
+    // Owned outside the graph, never aliased.
+    bool is_imported = false;
+    // Read after the frame, by the screen or the next frames.
+    bool is_output = false;
+    std::size_t byte_size = 0;
+    std::uint32_t first_pass = kInvalid;
+    std::uint32_t last_pass = kInvalid;
+    std::uint32_t slot = kInvalid;
+  };
+
+  void Clear() noexcept;
+
+  std::uint32_t CreateTexture(RenderGraphTextureDesc desc);
+  std::uint32_t ImportTexture(std::string name, std::size_t byte_size = 0);
+  // The passes writing the texture are never culled.
+  void MarkOutput(std::uint32_t texture) noexcept;
+
+  std::uint32_t AddPass(std::string name);
+  void Read(std::uint32_t pass, std::uint32_t texture);
+  void Write(std::uint32_t pass, std::uint32_t texture);
+
+  void Compile();
+
+  [[nodiscard]] bool IsPassAlive(const std::uint32_t pass) const noexcept {
+    return pass < passes_.size() && passes_[pass].is_alive;
+  }
+  [[nodiscard]] const std::vector<Pass>& passes() const noexcept {
+    return passes_;
+  }
+  [[nodiscard]] const std::vector<Texture>& textures() const noexcept {
+    return textures_;
+  }
+  [[nodiscard]] const std::vector<RenderGraphSlot>& slots() const noexcept {
+    return slots_;
+  }
+  [[nodiscard]] const RenderGraphStats& stats() const noexcept {
+    return stats_;
+  }
+
+ private:
+  std::vector<Pass> passes_{};
+  std::vector<Texture> textures_{};
+  std::vector<RenderGraphSlot> slots_{};
+  RenderGraphStats stats_{};
+
+  void Cull();
+  void ComputeLifetimes() noexcept;
+  void AssignSlots();
+};
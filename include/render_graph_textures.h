@@ -0,0 +1,26 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <vector>
+
+#include "render_graph.h"
+
+// GL textures of a compiled render graph: one immutable storage per slot
+// and, for every transient texture, a view of its slot in its own format
+// and with its own filter.
+class RenderGraphTextures {
+ public:
+  // Deletes the textures of the previous graph first.
+  void Create(const RenderGraph& graph);
+  void Delete();
+
+  // 0 for an imported texture or one no living pass uses.
+  [[nodiscard]] GLuint Texture(std::uint32_t texture) const noexcept {
+    return texture < views_.size() ? views_[texture] : 0;
+  }
+
+ private:
+  std::vector<GLuint> storages_{};
+  std::vector<GLuint> views_{};
+};
@@ -2,7 +2,12 @@
 
 #include <SDL.h>
 
+#include <vector>
+
+#include "benchmark.h"
 #include "camera.h"
+#include "gpu_buffer_pool.h"
+#include "gpu_timings.h"
 #include "metrics.h"
 #include "pipeline.h"
 
@@ -17,4 +22,22 @@ class Scene {
   virtual void Update(float dt) = 0;
   virtual void End() = 0;
   virtual void DrawImgui() = 0;
+
+  // False while the scene still loads, the benchmark waits for it.
+  [[nodiscard]] virtual bool IsReady() const noexcept { return true; }
+  // Duration of the GPU passes, nullptr when the scene doesn't measure them.
+  [[nodiscard]] virtual GpuTimingHistory* gpu_timings() noexcept {
+    return nullptr;
+  }
+  // Loading steps the scene times itself.
+  virtual void AddStartupPhases(std::vector<BenchmarkTiming>& phases) const {}
+
+  // The pool outlives the scenes so that changing scene reuses the geometry
+  // memory of the previous one.
+  void SetBufferPool(GpuBufferPool* buffer_pool) noexcept {
+    buffer_pool_ = buffer_pool;
+  }
+
+ protected:
+  GpuBufferPool* buffer_pool_ = nullptr;
 };
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "JobSystem.h"
+#include "transform_store.h"
+
+// Image loaded once however many materials use it.
+struct SceneTextureDesc {
+  std::string path{};
+  bool is_srgb = false;
+  bool flip_y = true;
+};
+
+// Maps of a PBR material, in the order of kSceneMaterialMapNames.
+enum SceneMaterialMap : std::uint8_t {
+  kSceneMaterialAlbedo,
+  kSceneMaterialNormal,
+  kSceneMaterialAo,
+  kSceneMaterialMetallic,
+  kSceneMaterialRoughness,
+  kSceneMaterialMapCount,
+};
+
+inline constexpr std::array<const char*, kSceneMaterialMapCount>
+    kSceneMaterialMapNames = {"albedo", "normal", "ao", "metallic",
+                              "roughness"};
+
+struct SceneMaterialDesc {
+  static constexpr std::uint32_t kNoTexture = ~0u;
+
+  std::string name{};
+  // Indices in SceneDescription::textures.
+  std::array<std::uint32_t, kSceneMaterialMapCount> textures{
+      kNoTexture, kNoTexture, kNoTexture, kNoTexture, kNoTexture};
+};
+
+struct SceneModelDesc {
+  std::string name{};
+  std::string path{};
+  bool flip_uvs = false;
+  // Index of the model whose load this one shares: the first one with the
+  // same path and flags, itself otherwise.
+  std::uint32_t source = 0;
+};
+
+struct SceneObjectDesc {
+  std::string name{};
+  // Names of a model and a material of the file, or empty.
+  std::string model{};
+  std::string material{};
+  // Built-in mesh, "ground" or "sphere", drawn when there is no model.
+  std::string mesh{};
+  // Name of a light of the file the object moves with, or empty.
+  std::string light{};
+  // Animated, its shadow is drawn in the dynamic layer.
+  bool is_dynamic = false;
+  Transform transform{};
+};
+
+struct SceneLightDesc {
+  std::string name{};
+  glm::vec3 position{0.f};
+  glm::vec3 color{1.f};
+  // Range when drawn as a point light, which every light but the first one
+  // is.
+  float radius = 5.f;
+};
+
+// Assets and placements of a scene file. A texture is listed once, by path,
+// whatever the number of materials using it. Models are listed by name,
+// the ones sharing a path share one load. Names are unique per kind.
+// GL free: the scene turns it into load jobs.
+struct SceneDescription {
+  std::vector<SceneTextureDesc> textures{};
+  std::vector<SceneMaterialDesc> materials{};
+  std::vector<SceneModelDesc> models{};
+  std::vector<SceneObjectDesc> objects{};
+  std::vector<SceneLightDesc> lights{};
+
+  void Clear() noexcept;
+  // Index of the texture, added when no texture has the same path and
+  // flags.
+  std::uint32_t AddTexture(const SceneTextureDesc& texture);
+
+  // nullptr when the file has no entry of that name.
+  [[nodiscard]] const SceneMaterialDesc* FindMaterial(
+      std::string_view name) const noexcept;
+  [[nodiscard]] const SceneModelDesc* FindModel(
+      std::string_view name) const noexcept;
+  [[nodiscard]] const SceneObjectDesc* FindObject(
+      std::string_view name) const noexcept;
+  [[nodiscard]] const SceneLightDesc* FindLight(
+      std::string_view name) const noexcept;
+};
+
+// Returns false with the reason in `error` when the text isn't a valid
+// scene. Unknown keys are ignored.
+bool ParseSceneDescription(std::string_view text, SceneDescription& scene,
+                           std::string& error);
+bool LoadSceneDescription(std::string_view path, SceneDescription& scene,
+                          std::string& error);
+
+// Reads and parses the scene file on the model loading worker, before the
+// assets it lists are queued.
+class LoadSceneDescriptionJob final : public Job {
+ public:
+  LoadSceneDescriptionJob() noexcept : Job(JobType::kModelLoading) {}
+
+  void Setup(std::string path, SceneDescription* scene) noexcept;
+
+  [[nodiscard]] bool is_valid() const noexcept { return is_valid_; }
+  [[nodiscard]] const std::string& error() const noexcept { return error_; }
+
+ private:
+  std::string path_{};
+  SceneDescription* scene_ = nullptr;
+  bool is_valid_ = false;
+  std::string error_{};
+
+  void Work() noexcept override;
+};
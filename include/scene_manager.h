@@ -5,17 +5,19 @@
 #include <memory>
 #include <vector>
 
+#include "gpu_buffer_pool.h"
 #include "scene.h"
 
 class SceneManager {
  public:
   std::vector<std::unique_ptr<Scene>> scenes_;
+  GpuBufferPool buffer_pool_;
 
   std::size_t sceneIdx_ = 0;
 
   void Setup();
 
-  void UpdateScene(float deltaTime) const noexcept;
+  void UpdateScene(float deltaTime) noexcept;
 
   void ChangeScene(int index) noexcept;
 
@@ -29,7 +31,13 @@ class SceneManager {
 
   void EndScene() noexcept;
 
+  // Frees the GPU memory shared by the scenes, to call before the context is
+  // destroyed.
+  void ReleaseGpuMemory() noexcept;
+
   void DrawImGui() noexcept;
 
   Camera& GetCamera() noexcept;
+
+  Scene& GetScene() noexcept;
 };
\ No newline at end of file
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Square region of the atlas, in texels.
+struct AtlasTile {
+  std::uint32_t x = 0;
+  std::uint32_t y = 0;
+  std::uint32_t size = 0;
+};
+
+struct ShadowAtlasStats {
+  std::uint32_t size = 0;
+  std::uint32_t light_count = 0;
+  std::uint64_t used_texels = 0;
+  std::uint32_t eviction_count = 0;  // Since the atlas was created.
+};
+
+// Packs the 6 cube faces of point lights in one square depth texture. Tiles
+// are power of two squares handed out by a quadtree: a free tile is split in
+// 4 when a smaller one is needed and merged back once its 3 siblings are
+// free. GL free, the renderer only reads the tiles back.
+//
+// A new light takes the largest free resolution down to the min one. Only
+// when none fits are lights evicted, least recently used first, and only
+// the ones acquired neither this frame nor the previous one. A light that
+// grows never evicts: it keeps its tiles until bigger ones are free. A
+// fixed set of lights acquired every frame settles with no eviction.
+class ShadowAtlas {
+ public:
+  static constexpr int kFaceCount = 6;
+
+  struct Light {
+    std::array<AtlasTile, kFaceCount> tiles{};
+    std::uint32_t resolution = 0;
+    std::uint32_t last_used_frame = 0;
+  };
+
+  ShadowAtlas() noexcept = default;
+  ShadowAtlas(std::uint32_t size, std::uint32_t min_resolution,
+              std::uint32_t max_resolution) noexcept;
+
+  // Largest power of two atlas size whose texels fit in the budget, capped
+  // at `max_size`.
+  [[nodiscard]] static std::uint32_t SizeForBudget(
+      std::size_t byte_budget, std::uint32_t bytes_per_texel,
+      std::uint32_t max_size) noexcept;
+
+  // Face resolution for a light whose range covers `coverage` of the screen
+  // height, a power of two between the min and max resolutions.
+  [[nodiscard]] std::uint32_t ResolutionForCoverage(
+      float coverage) const noexcept;
+
+  // Returns the tiles of the light at `resolution` or lower, nullptr when
+  // not even the min resolution fits. `reallocated` is set when the tiles
+  // changed and the light shadow has to be redrawn.
+  const Light* Acquire(std::uint32_t light_id, std::uint32_t resolution,
+                       bool& reallocated) noexcept;
+  void Release(std::uint32_t light_id) noexcept;
+  // Starts a new frame for the least recently used eviction.
+  void NextFrame() noexcept { frame_++; }
+
+  [[nodiscard]] ShadowAtlasStats Stats() const noexcept;
+  [[nodiscard]] std::uint32_t size() const noexcept { return size_; }
+
+ private:
+  std::uint32_t size_ = 0;
+  std::uint32_t min_resolution_ = 0;
+  std::uint32_t max_resolution_ = 0;
+  std::uint32_t frame_ = 1;
+  std::uint32_t eviction_count_ = 0;
+
+  std::unordered_map<std::uint32_t, Light> lights_{};
+  // Free tiles of each level, level 0 is the whole atlas.
+  std::vector<std::vector<AtlasTile>> free_tiles_{};
+
+  [[nodiscard]] int LevelOf(std::uint32_t tile_size) const noexcept;
+  bool AllocateTile(int level, AtlasTile& tile) noexcept;
+  void FreeTile(const AtlasTile& tile) noexcept;
+  // All the faces or none.
+  bool AllocateLight(std::uint32_t resolution, Light& light) noexcept;
+  void FreeLight(const Light& light) noexcept;
+  // Evicts the least recently used light not acquired since the previous
+  // frame.
+  bool EvictLeastRecentlyUsed() noexcept;
+};
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "frustum_culling.h"
+
+// Keeps track of the faces of a cached point light shadow that are out of
+// date and picks the ones redrawn each frame. GL free, the renderer applies
+// the returned face masks (bit i is the cubemap face i).
+//
+// The shadow is made of two depth cubemaps: one with the static casters
+// only, redrawn when the light or a static caster moves, and the one
+// sampled by the lighting, made by copying the static faces and drawing
+// the dynamic casters on top of them.
+class ShadowFaceScheduler {
+ public:
+  static constexpr int kFaceCount = 6;
+  static constexpr std::uint8_t kAllFaces = (1u << kFaceCount) - 1;
+
+  struct FaceUpdate {
+    // Faces whose static cubemap is redrawn.
+    std::uint8_t static_faces = 0;
+    // Faces copied from the static cubemap then given the dynamic casters,
+    // always includes static_faces.
+    std::uint8_t composite_faces = 0;
+  };
+
+  // The light or a static caster of these faces moved.
+  void InvalidateStatic(std::uint8_t faces) noexcept;
+  // A dynamic caster of these faces moved.
+  void InvalidateDynamic(std::uint8_t faces) noexcept;
+
+  // Returns at most `face_budget` faces, the ones waiting for the longest
+  // first, and considers them up to date.
+  FaceUpdate Schedule(int face_budget) noexcept;
+
+  [[nodiscard]] std::uint8_t dirty_faces() const noexcept {
+    return static_cast<std::uint8_t>(static_dirty_ | dynamic_dirty_);
+  }
+  [[nodiscard]] const FaceUpdate& last_update() const noexcept {
+    return last_update_;
+  }
+
+ private:
+  std::uint8_t static_dirty_ = kAllFaces;
+  std::uint8_t dynamic_dirty_ = kAllFaces;
+  // Frame at which each face became dirty.
+  std::array<std::uint32_t, kFaceCount> dirty_since_{};
+  std::uint32_t frame_ = 0;
+  FaceUpdate last_update_{};
+
+  void MarkDirty(std::uint8_t faces) noexcept;
+};
+
+// View projection of each cubemap face of a point light at `position`, in
+// the face order of the scheduler masks.
+[[nodiscard]] std::array<glm::mat4, ShadowFaceScheduler::kFaceCount>
+PointLightMatrices(const glm::vec3& position, float near_plane,
+                   float far_plane) noexcept;
+
+// Faces of a point light each culling entry of the shadow casters is in.
+// Culls them again when the light or a caster moved and tells the
+// scheduler which faces the move dirtied. GL free.
+class ShadowCasterFaces {
+ public:
+  using LightMatrices =
+      std::array<glm::mat4, ShadowFaceScheduler::kFaceCount>;
+
+  // A moved light sees every caster from elsewhere: all the faces of both
+  // layers are dirtied. A moved caster dirties the faces it left and the
+  // ones it entered, in its layer. `Caster` has the range of culling
+  // entries of an object, `first_entry` to `end_entry`, its layer,
+  // `is_dynamic`, and `is_moved`, cleared here.
+  template <typename Caster>
+  void Update(JobSystem& job_system, const CullingSet& set,
+              const LightMatrices& matrices, bool is_light_moved,
+              std::vector<Caster>& casters, ShadowFaceScheduler& scheduler);
+
+  // Bit i of an entry set when it touches the frustum of the face i.
+  [[nodiscard]] const std::vector<std::uint8_t>& masks() const noexcept {
+    return masks_;
+  }
+  // Summed over the faces of the last cull.
+  [[nodiscard]] const CullingStats& stats() const noexcept { return stats_; }
+
+ private:
+  FrustumCuller culler_;
+  std::vector<std::uint8_t> visibility_;
+  std::vector<std::uint8_t> masks_;
+  // Per caster, before the last cull.
+  std::vector<std::uint8_t> old_masks_;
+  CullingStats stats_{};
+
+  void Cull(JobSystem& job_system, const CullingSet& set,
+            const LightMatrices& matrices);
+  // OR of the masks of [first, end), the entries not culled yet have none.
+  [[nodiscard]] std::uint8_t Mask(std::uint32_t first,
+                                  std::uint32_t end) const noexcept;
+};
+
+template <typename Caster>
+void ShadowCasterFaces::Update(JobSystem& job_system, const CullingSet& set,
+                               const LightMatrices& matrices,
+                               const bool is_light_moved,
+                               std::vector<Caster>& casters,
+                               ShadowFaceScheduler& scheduler) {
+  if (!is_light_moved &&
+      std::none_of(casters.begin(), casters.end(),
+                   [](const Caster& caster) { return caster.is_moved; })) {
+    return;
+  }
+  old_masks_.resize(casters.size());
+  for (std::size_t i = 0; i < casters.size(); i++) {
+    old_masks_[i] = Mask(casters[i].first_entry, casters[i].end_entry);
+  }
+  Cull(job_system, set, matrices);
+  if (is_light_moved) {
+    scheduler.InvalidateStatic(ShadowFaceScheduler::kAllFaces);
+    scheduler.InvalidateDynamic(ShadowFaceScheduler::kAllFaces);
+  }
+  for (std::size_t i = 0; i < casters.size(); i++) {
+    Caster& caster = casters[i];
+    if (caster.is_moved && !is_light_moved) {
+      const std::uint8_t faces = static_cast<std::uint8_t>(
+          old_masks_[i] | Mask(caster.first_entry, caster.end_entry));
+      if (caster.is_dynamic) {
+        scheduler.InvalidateDynamic(faces);
+      } else {
+        scheduler.InvalidateStatic(faces);
+      }
+    }
+    caster.is_moved = false;
+  }
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "JobSystem.h"
+
+// Diffuse irradiance of an environment as 9 RGB spherical harmonics
+// coefficients (bands 0 to 2). The coefficients already hold the basis
+// constants and the clamped cosine lobe divided by pi, like the irradiance
+// cubemap they replace: the lighting multiplies the result by the albedo.
+struct ShIrradiance {
+  static constexpr int kCoefficientCount = 9;
+
+  // RGB of each coefficient, in the order of the polynomials:
+  // 1, y, z, x, xy, yz, 3z^2 - 1, xz, x^2 - y^2.
+  std::array<glm::vec3, kCoefficientCount> coefficients{};
+
+  [[nodiscard]] glm::vec3 Evaluate(glm::vec3 normal) const noexcept;
+  // std140 array of 9 vec4, the layout of the shader uniform block.
+  [[nodiscard]] std::array<glm::vec4, kCoefficientCount> Std140()
+      const noexcept;
+};
+
+// Same clamp as the equirectangular to cubemap shader.
+static constexpr float kShMaxRadiance = 25.f;
+
+// Equirectangular RGB image, rows from the bottom (v = 0) to the top as
+// uploaded to GL, sampled like the cubemap shader: u follows atan(z, x) and
+// v asin(y).
+struct ShImage {
+  const float* texels = nullptr;
+  int width = 0;
+  int height = 0;
+};
+
+class ShProjectionJob final : public Job {
+ public:
+  ShProjectionJob() noexcept : Job(JobType::kCompute) {}
+
+  void Setup(const ShImage* image, const float* cos_phi, const float* sin_phi,
+             int begin_row, int end_row) noexcept;
+  // Solid angle weighted sums of the radiance times each polynomial.
+  [[nodiscard]] const std::array<double, ShIrradiance::kCoefficientCount * 3>&
+  sums() const noexcept {
+    return sums_;
+  }
+
+ private:
+  const ShImage* image_ = nullptr;
+  const float* cos_phi_ = nullptr;
+  const float* sin_phi_ = nullptr;
+  int begin_row_ = 0;
+  int end_row_ = 0;
+  std::array<double, ShIrradiance::kCoefficientCount * 3> sums_{};
+  // Deinterleaved and clamped RGB of the current row.
+  std::vector<float> row_{};
+
+  void Work() noexcept override;
+};
+
+struct ShProjectionStats {
+  std::size_t texel_count = 0;
+  float milliseconds = 0.f;
+};
+
+// Projects an environment on the SH basis, the rows are split between the
+// compute workers and each row is processed a SIMD batch of texels at a
+// time. Fast enough to run again when the environment changes.
+class ShProjector {
+ public:
+  static constexpr int kMinRowsPerJob = 16;
+
+  ShIrradiance Project(JobSystem& job_system, const ShImage& image) noexcept;
+
+  [[nodiscard]] const ShProjectionStats& stats() const noexcept {
+    return stats_;
+  }
+
+ private:
+  std::vector<ShProjectionJob> jobs_{};
+  std::vector<Job*> job_ptrs_{};
+  // Per column, padded to the SIMD batch size.
+  std::vector<float> cos_phi_{};
+  std::vector<float> sin_phi_{};
+  ShProjectionStats stats_{};
+};
+
+// Brute force convolution the irradiance cubemap used to be baked with,
+// sampling the image at the nearest texel. The reference the projection is
+// checked against.
+[[nodiscard]] glm::vec3 ConvolveIrradiance(const ShImage& image,
+                                           glm::vec3 normal,
+                                           float sample_delta = 0.025f);
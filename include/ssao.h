@@ -0,0 +1,52 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Size of the sample array of the ambient occlusion shader.
+static constexpr int kSsaoMaxSampleCount = 64;
+static constexpr int kSsaoMaxBlurRadius = 8;
+
+// The ambient occlusion is computed at a fraction of the screen resolution,
+// blurred and brought back to full resolution with depth and normal aware
+// filters so that it doesn't bleed over the silhouettes.
+struct SsaoPreset {
+  const char* name = "";
+  int resolution_divisor = 1;
+  int sample_count = kSsaoMaxSampleCount;
+  // Taps on each side of the separable blur.
+  int blur_radius = 2;
+  // Rotates the kernel every frame and accumulates the reprojected result
+  // of the previous frames, few samples per frame converge to many.
+  bool is_temporal = false;
+};
+
+// The last one is the reference the others are compared to.
+static constexpr std::array<SsaoPreset, 6> kSsaoPresets = {{
+    {"Low: quarter resolution, 8 samples", 4, 8, 2, false},
+    {"Medium: half resolution, 16 samples", 2, 16, 3, false},
+    {"High: half resolution, 32 samples", 2, 32, 4, false},
+    {"Temporal: half resolution, 4 samples", 2, 4, 2, true},
+    {"Temporal: full resolution, 8 samples", 1, 8, 2, true},
+    {"Reference: full resolution, 64 samples", 1, 64, 2, false},
+}};
+
+// Weight of the current frame in the exponential moving average, the
+// history then stands for about 1 / kSsaoTemporalBlend frames.
+static constexpr float kSsaoTemporalBlend = 0.125f;
+
+// Kernel rotation of a frame, the golden angle spreads the rotations of
+// consecutive frames evenly around the circle.
+[[nodiscard]] float SsaoFrameAngle(std::uint32_t frame_index) noexcept;
+
+// Hemisphere samples in tangent space (z up), denser near the origin where
+// the occlusion matters most.
+[[nodiscard]] std::vector<glm::vec3> GenerateSsaoKernel(
+    int sample_count, std::uint32_t seed = 0);
+
+// Occlusion samples taken per frame, to compare the cost of the presets.
+[[nodiscard]] std::size_t SsaoSampleTaps(const SsaoPreset& preset, int width,
+                                         int height) noexcept;
@@ -9,6 +9,13 @@
 #include "JobSystem.h"
 #include "file_utility.h"
 
+// Decoded RGB float image kept on the CPU.
+struct HdrImage {
+  int width = 0;
+  int height = 0;
+  std::vector<float> texels{};
+};
+
 struct FileData {
   int width, height, nr_channels;
   unsigned char* data;
@@ -21,6 +28,11 @@ class TextureManager {
   GLuint LoadCubeMap(std::string path, std::vector<std::string> faces,
                      bool flip = false);
   GLuint LoadHDR(std::string_view path, bool flip = true);
+  // Reads the header only, false when the file can't be read.
+  bool ReadImageSize(std::string_view path, int& width, int& height);
+  // Empty image when the file can't be decoded.
+  HdrImage LoadHDRImage(std::string_view path, bool flip = true);
+  GLuint UploadHDR(const HdrImage& image);
 };
 
 class ReadJob final : public Job {
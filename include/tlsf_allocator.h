@@ -0,0 +1,127 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// Two-level segregated fit allocator working on offsets only: it never touches
+// the memory it manages, so it can carve up a GL buffer (or anything else) and
+// be used without a GL context.
+// Block metadata lives out of band, which is what lets it sub-allocate GPU
+// memory the CPU cannot write headers into.
+
+struct TlsfStats {
+  std::uint32_t capacity = 0;
+  std::uint32_t used_bytes = 0;       // Sum of the allocated block sizes.
+  std::uint32_t requested_bytes = 0;  // Sum of the sizes asked by callers.
+  std::uint32_t free_bytes = 0;
+  std::uint32_t largest_free_block = 0;
+  std::uint32_t allocation_count = 0;
+  std::uint32_t free_block_count = 0;
+
+  // 0 when all the free memory is in one block, close to 1 when it is split
+  // in many small holes.
+  [[nodiscard]] float Fragmentation() const noexcept {
+    return free_bytes == 0 ? 0.f
+                           : 1.f - static_cast<float>(largest_free_block) /
+                                       static_cast<float>(free_bytes);
+  }
+  // Bytes lost to size rounding.
+  [[nodiscard]] std::uint32_t WastedBytes() const noexcept {
+    return used_bytes - requested_bytes;
+  }
+};
+
+struct TlsfMove {
+  std::uint32_t old_block = 0;
+  std::uint32_t new_block = 0;
+  std::uint32_t src_offset = 0;
+  std::uint32_t dst_offset = 0;
+  std::uint32_t size = 0;
+};
+
+class TlsfAllocator {
+ public:
+  static constexpr std::uint32_t kInvalidBlock = UINT32_MAX;
+  // Every offset and size is a multiple of the granularity.
+  static constexpr std::uint32_t kGranularity = 16;
+
+  TlsfAllocator() noexcept = default;
+  explicit TlsfAllocator(std::uint32_t capacity) noexcept;
+
+  // Returns the block index of the allocation or kInvalidBlock when there is
+  // no free range big enough. The alignment must be a power of two.
+  [[nodiscard]] std::uint32_t Allocate(std::uint32_t size,
+                                       std::uint32_t alignment) noexcept;
+  void Free(std::uint32_t block) noexcept;
+  void Reset() noexcept;
+
+  // Moves allocated blocks from the end of the range into free holes lower in
+  // the range, until `byte_budget` bytes have been moved. The old blocks are
+  // freed: callers must apply the returned copies in order before writing
+  // anything new into the range.
+  std::vector<TlsfMove> Compact(std::uint32_t byte_budget) noexcept;
+
+  [[nodiscard]] std::uint32_t Offset(std::uint32_t block) const noexcept {
+    return blocks_[block].offset;
+  }
+  [[nodiscard]] std::uint32_t Size(std::uint32_t block) const noexcept {
+    return blocks_[block].size;
+  }
+  [[nodiscard]] std::uint32_t capacity() const noexcept { return capacity_; }
+
+  [[nodiscard]] TlsfStats Stats() const noexcept;
+
+ private:
+  static constexpr std::uint32_t kSlCountLog2 = 4;
+  static constexpr std::uint32_t kSlCount = 1u << kSlCountLog2;
+  // Sizes under 2^kFlShift all go in the first level, split linearly.
+  static constexpr std::uint32_t kFlShift = kSlCountLog2 + 4;
+  static constexpr std::uint32_t kSmallBlockSize = 1u << kFlShift;
+  static constexpr std::uint32_t kFlCount = 32 - kFlShift + 1;
+
+  struct Block {
+    std::uint32_t offset = 0;
+    std::uint32_t size = 0;
+    std::uint32_t requested = 0;
+    std::uint32_t alignment = kGranularity;
+    std::uint32_t prev_phys = kInvalidBlock;
+    std::uint32_t next_phys = kInvalidBlock;
+    std::uint32_t prev_free = kInvalidBlock;
+    std::uint32_t next_free = kInvalidBlock;
+    bool is_free = false;
+  };
+
+  std::uint32_t capacity_ = 0;
+  std::uint32_t used_bytes_ = 0;
+  std::uint32_t requested_bytes_ = 0;
+  std::uint32_t allocation_count_ = 0;
+
+  std::vector<Block> blocks_{};
+  std::vector<std::uint32_t> unused_blocks_{};
+  std::uint32_t first_block_ = kInvalidBlock;
+
+  std::uint32_t fl_bitmap_ = 0;
+  std::array<std::uint32_t, kFlCount> sl_bitmaps_{};
+  std::array<std::array<std::uint32_t, kSlCount>, kFlCount> free_heads_{};
+
+  static void Mapping(std::uint32_t size, std::uint32_t& fl,
+                      std::uint32_t& sl) noexcept;
+  std::uint32_t FindFreeBlock(std::uint32_t size) const noexcept;
+
+  std::uint32_t NewBlock() noexcept;
+  void ReleaseBlock(std::uint32_t block) noexcept;
+
+  void InsertFree(std::uint32_t block) noexcept;
+  void RemoveFree(std::uint32_t block) noexcept;
+
+  // Splits `block` so that it starts at `offset` and holds `size` bytes, the
+  // leftovers on both sides go back to the free lists.
+  std::uint32_t Carve(std::uint32_t block, std::uint32_t offset,
+                      std::uint32_t size) noexcept;
+  std::uint32_t MergeWithNeighbours(std::uint32_t block) noexcept;
+
+  std::uint32_t Place(std::uint32_t free_block, std::uint32_t size,
+                      std::uint32_t requested,
+                      std::uint32_t alignment) noexcept;
+};
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <vector>
+
+#include "JobSystem.h"
+
+// Placement relative to the parent: translation, rotation then scale.
+struct Transform {
+  glm::vec3 position{0.f};
+  glm::quat rotation{1.f, 0.f, 0.f, 0.f};
+  glm::vec3 scale{1.f};
+};
+
+struct TransformStats {
+  std::size_t entity_count = 0;
+  // World matrices computed again, the moved entities and their children.
+  std::size_t updated_count = 0;
+  std::size_t level_count = 0;
+  float milliseconds = 0.f;
+};
+
+class TransformStore;
+
+class UpdateTransformsJob final : public Job {
+ public:
+  UpdateTransformsJob() noexcept : Job(JobType::kCompute) {}
+
+  void Setup(TransformStore* store, std::size_t begin,
+             std::size_t end) noexcept;
+
+  [[nodiscard]] std::size_t updated_count() const noexcept {
+    return updated_count_;
+  }
+
+ private:
+  TransformStore* store_ = nullptr;
+  std::size_t begin_ = 0;
+  std::size_t end_ = 0;
+  std::size_t updated_count_ = 0;
+
+  void Work() noexcept override;
+};
+
+// Entities of the scene in arrays, one per component. Moving an entity
+// marks it dirty, Update() computes the world matrices of the dirty
+// entities and of everything under them, one hierarchy level after the
+// other, each level split in ranges on the compute workers. The normal
+// matrices are computed there too, once per move, for every pass. GL free.
+class TransformStore {
+ public:
+  static constexpr std::uint32_t kNoParent = ~0u;
+  static constexpr std::size_t kMinEntitiesPerJob = 1024;
+
+  void Clear() noexcept;
+  // The parent must exist, children always come after their parent.
+  std::uint32_t Create(const Transform& local,
+                       std::uint32_t parent = kNoParent);
+
+  void SetPosition(std::uint32_t entity, const glm::vec3& position) noexcept;
+  void SetRotation(std::uint32_t entity, const glm::quat& rotation) noexcept;
+  void SetScale(std::uint32_t entity, const glm::vec3& scale) noexcept;
+  void SetLocal(std::uint32_t entity, const Transform& local) noexcept;
+
+  TransformStats Update(JobSystem& job_system) noexcept;
+  // Entities [begin, end) of the level order, their parents are up to date.
+  // Returns the number of world matrices computed.
+  std::size_t UpdateRange(std::size_t begin, std::size_t end) noexcept;
+
+  [[nodiscard]] std::size_t size() const noexcept { return parents_.size(); }
+  [[nodiscard]] const glm::vec3& position(
+      const std::uint32_t entity) const noexcept {
+    return positions_[entity];
+  }
+  [[nodiscard]] std::uint32_t parent(
+      const std::uint32_t entity) const noexcept {
+    return parents_[entity];
+  }
+  [[nodiscard]] const glm::mat4& world(
+      const std::uint32_t entity) const noexcept {
+    return worlds_[entity];
+  }
+  // Inverse transpose of the world matrix, in a mat4 for std140 blocks.
+  [[nodiscard]] const glm::mat4& normal_matrix(
+      const std::uint32_t entity) const noexcept {
+    return normal_matrices_[entity];
+  }
+  // True when the last Update() moved the entity.
+  [[nodiscard]] bool IsChanged(const std::uint32_t entity) const noexcept {
+    return changed_[entity] != 0;
+  }
+
+ private:
+  std::vector<glm::vec3> positions_{};
+  std::vector<glm::quat> rotations_{};
+  std::vector<glm::vec3> scales_{};
+  std::vector<std::uint32_t> parents_{};
+  std::vector<std::uint32_t> levels_{};
+  std::vector<std::uint8_t> dirty_{};
+  std::vector<std::uint8_t> changed_{};
+  std::vector<glm::mat4> worlds_{};
+  std::vector<glm::mat4> normal_matrices_{};
+
+  // Entities sorted by level, built again after a Create().
+  std::vector<std::uint32_t> order_{};
+  std::vector<std::size_t> level_offsets_{};
+  bool is_order_stale_ = true;
+  // Nothing to propagate without a dirty entity.
+  bool has_dirty_ = false;
+
+  std::vector<UpdateTransformsJob> jobs_{};
+  std::vector<Job*> job_ptrs_{};
+
+  void SortByLevel();
+};
+
+// Moves the root of a tree of `entity_count` entities, 8 children per
+// entity, and updates every world matrix, `iterations` times. Returns the
+// best time.
+[[nodiscard]] TransformStats RunTransformBenchmark(JobSystem& job_system,
+                                                   std::size_t entity_count,
+                                                   int iterations) noexcept;
@@ -1,7 +1,28 @@
+#include <iostream>
+#include <string_view>
+#include <utility>
+
+#include "benchmark.h"
 #include "engine.h"
 
 int main(int argc, char** argv) {
   Engine engine;
+  BenchmarkOptions benchmark_options;
+  for (int i = 1; i < argc; i++) {
+    if (std::string_view(argv[i]) == "--cpu-trace" && i + 1 < argc) {
+      engine.set_cpu_trace_path(argv[++i]);
+    } else if (std::string_view(argv[i]) == "--record-camera" &&
+               i + 1 < argc) {
+      engine.set_camera_record_name(argv[++i]);
+    } else if (!ParseBenchmarkArgument(argc, argv, i, benchmark_options)) {
+      std::cerr << "Unknown argument " << argv[i] << "\n"
+                << "Usage: main [--cpu-trace path] [--record-camera name] "
+                   "[--benchmark] [--camera-path name] [--frames count] "
+                   "[--warmup count] [--report path]\n";
+      return EXIT_FAILURE;
+    }
+  }
+  engine.set_benchmark_options(std::move(benchmark_options));
 
   engine.Run();
 
@@ -1,10 +1,34 @@
 #include "JobSystem.h"
 
-#ifdef TRACY_ENABLE
-#include <TracyC.h>
+#include <string>
 
-#include <Tracy.hpp>
-#endif
+#include "cpu_profiler.h"
+
+namespace {
+
+const char* JobTypeName(const JobType type) noexcept {
+  switch (type) {
+    case JobType::kImageFileLoading:
+      return "Image file loading job";
+    case JobType::kImageFileDecompressing:
+      return "Image decompressing job";
+    case JobType::kShaderFileLoading:
+      return "Shader file loading job";
+    case JobType::kMeshCreating:
+      return "Mesh creating job";
+    case JobType::kModelLoading:
+      return "Model loading job";
+    case JobType::kMainThread:
+      return "Main thread job";
+    case JobType::kCompute:
+      return "Compute job";
+    case JobType::kNone:
+      break;
+  }
+  return "Job";
+}
+
+}  // namespace
 
 void Job::Execute() noexcept {
   // Synchronization with all dependecies.
@@ -14,6 +38,7 @@ void Job::Execute() noexcept {
       dependecy->WaitUntilJobIsDone();
     }
   }
+  const CpuZone zone(JobTypeName(type_), CpuEventKind::kJob);
 
   // Do the work of the job.
   // -----------------------
@@ -26,12 +51,21 @@ void Job::Execute() noexcept {
   status_ = JobStatus::kDone;
 }
 
-void Job::WaitUntilJobIsDone() const noexcept { future_.get(); }
+void Job::WaitUntilJobIsDone() const noexcept {
+  const CpuZone zone("Wait for job", CpuEventKind::kWait);
+  future_.get();
+}
 
 void Job::AddDependency(const Job* dependency) noexcept {
   dependencies_.push_back(dependency);
 }
 
+void Job::Reset() noexcept {
+  promise_ = std::promise<void>();
+  future_ = promise_.get_future();
+  status_ = JobStatus::kNone;
+}
+
 bool Job::AreDependencyDone() const noexcept {
   for (const auto& dependency : dependencies_) {
     if (!dependency->IsDone()) {
@@ -40,6 +74,52 @@ bool Job::AreDependencyDone() const noexcept {
   }
   return true;
 }
+void JobQueue::Push(Job* job) noexcept {
+  {
+    std::scoped_lock lock(mutex_);
+    jobs_.push(job);
+  }
+  condition_.notify_one();
+}
+
+Job* JobQueue::Pop() noexcept {
+  std::unique_lock lock(mutex_);
+  // Only the actual waits are recorded, not every pop.
+  if (!is_closed_ && jobs_.empty()) {
+    const CpuZone zone("Wait for work", CpuEventKind::kWait);
+    condition_.wait(lock, [this]() { return is_closed_ || !jobs_.empty(); });
+  }
+  if (jobs_.empty()) {
+    return nullptr;
+  }
+  Job* job = jobs_.front();
+  jobs_.pop();
+  return job;
+}
+
+Job* JobQueue::TryPop() noexcept {
+  std::scoped_lock lock(mutex_);
+  if (jobs_.empty()) {
+    return nullptr;
+  }
+  Job* job = jobs_.front();
+  jobs_.pop();
+  return job;
+}
+
+void JobQueue::Open() noexcept {
+  std::scoped_lock lock(mutex_);
+  is_closed_ = false;
+}
+
+void JobQueue::Close() noexcept {
+  {
+    std::scoped_lock lock(mutex_);
+    is_closed_ = true;
+  }
+  condition_.notify_all();
+}
+
 Worker::Worker(std::queue<Job*>* jobs) noexcept : jobs_(jobs) {}
 
 void Worker::Start() noexcept {
@@ -49,6 +129,7 @@ void Worker::Start() noexcept {
 void Worker::Join() noexcept { thread_.join(); }
 
 void Worker::LoopOverJobs() noexcept {
+  CpuProfiler::SetThreadName("Loading worker");
   while (is_running_) {
     Job* job = nullptr;
 
@@ -67,18 +148,17 @@ void Worker::LoopOverJobs() noexcept {
 }
 
 void JobSystem::JoinWorkers() noexcept {
-#ifdef TRACY_ENABLE
-  ZoneScoped;
-#endif  // TRACY_ENABLE
+  PROFILE_ZONE;
   for (auto& worker : workers_) {
     worker.Join();
   }
+  // Workers are single use, the next launch (after a scene change) creates new
+  // ones.
+  workers_.clear();
 }
 
 void JobSystem::LaunchWorkers(const int worker_count) noexcept {
-#ifdef TRACY_ENABLE
-  ZoneScoped;
-#endif  // TRACY_ENABLE
+  PROFILE_ZONE;
 
   workers_.reserve(worker_count);
 
@@ -106,6 +186,7 @@ void JobSystem::LaunchWorkers(const int worker_count) noexcept {
         break;
       case JobType::kNone:
       case JobType::kMainThread:
+      case JobType::kCompute:
         break;
     }
   }
@@ -113,10 +194,48 @@ void JobSystem::LaunchWorkers(const int worker_count) noexcept {
   RunMainThreadWorkLoop(main_thread_jobs_);
 }
 
+void JobSystem::LaunchComputeWorkers(const int worker_count) noexcept {
+  PROFILE_ZONE;
+  compute_jobs_.Open();
+  compute_workers_.reserve(worker_count);
+
+  for (int i = 0; i < worker_count; i++) {
+    compute_workers_.emplace_back([this, i]() {
+      CpuProfiler::SetThreadName("Compute worker " + std::to_string(i));
+      while (Job* job = compute_jobs_.Pop()) {
+        job->Execute();
+      }
+    });
+  }
+}
+
+void JobSystem::StopComputeWorkers() noexcept {
+  compute_jobs_.Close();
+  for (auto& worker : compute_workers_) {
+    worker.join();
+  }
+  compute_workers_.clear();
+}
+
+void JobSystem::RunComputeJobs(Job* const* jobs,
+                               const std::size_t count) noexcept {
+  PROFILE_ZONE;
+  for (std::size_t i = 0; i < count; i++) {
+    compute_jobs_.Push(jobs[i]);
+  }
+
+  // Help the workers instead of sleeping, with no worker this runs every job.
+  while (Job* job = compute_jobs_.TryPop()) {
+    job->Execute();
+  }
+
+  for (std::size_t i = 0; i < count; i++) {
+    jobs[i]->WaitUntilJobIsDone();
+  }
+}
+
 void JobSystem::AddJob(Job* job) noexcept {
-#ifdef TRACY_ENABLE
-  ZoneScoped;
-#endif  // TRACY_ENABLE
+  PROFILE_ZONE;
   switch (job->type()) {
     case JobType::kImageFileLoading:
       img_file_loading_jobs_.push(job);
@@ -136,6 +255,9 @@ void JobSystem::AddJob(Job* job) noexcept {
     case JobType::kMainThread:
       main_thread_jobs_.push_back(job);
       break;
+    case JobType::kCompute:
+      compute_jobs_.Push(job);
+      break;
     case JobType::kNone:
       break;
   }
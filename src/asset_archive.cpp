@@ -0,0 +1,219 @@
+#include "asset_archive.h"
+
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "cpu_profiler.h"
+#include "tracy_lz4.hpp"
+
+AssetArchive::~AssetArchive() noexcept { Close(); }
+
+bool AssetArchive::Open(const std::string_view path) noexcept {
+  PROFILE_ZONE;
+  Close();
+  const std::string file_path(path);
+#ifdef _WIN32
+  HANDLE file = CreateFileA(file_path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                            nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  LARGE_INTEGER file_size{};
+  HANDLE mapping = nullptr;
+  if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0) {
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  }
+  if (mapping == nullptr) {
+    CloseHandle(file);
+    return false;
+  }
+  const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (view == nullptr) {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+  }
+  file_ = file;
+  mapping_ = mapping;
+  size_ = static_cast<std::uint64_t>(file_size.QuadPart);
+#else
+  const int file = open(file_path.c_str(), O_RDONLY);
+  if (file < 0) {
+    return false;
+  }
+  struct stat file_stat {};
+  void* view = MAP_FAILED;
+  if (fstat(file, &file_stat) == 0 && file_stat.st_size > 0) {
+    view = mmap(nullptr, static_cast<std::size_t>(file_stat.st_size),
+                PROT_READ, MAP_PRIVATE, file, 0);
+  }
+  // The mapping keeps the file alive.
+  close(file);
+  if (view == MAP_FAILED) {
+    return false;
+  }
+  size_ = static_cast<std::uint64_t>(file_stat.st_size);
+#endif
+  data_ = static_cast<const unsigned char*>(view);
+
+  if (size_ < sizeof(AssetArchiveHeader)) {
+    std::cerr << file_path << " isn't an asset archive\n";
+    Close();
+    return false;
+  }
+  header_ = reinterpret_cast<const AssetArchiveHeader*>(data_);
+  entries_ = reinterpret_cast<const AssetArchiveEntry*>(
+      data_ + header_->entries_offset);
+  buckets_ =
+      reinterpret_cast<const std::uint32_t*>(data_ + header_->buckets_offset);
+  names_ = reinterpret_cast<const char*>(data_ + header_->names_offset);
+  if (!IsValid()) {
+    std::cerr << file_path << " is a corrupted or outdated asset archive\n";
+    Close();
+    return false;
+  }
+  return true;
+}
+
+void AssetArchive::Close() noexcept {
+  if (data_ != nullptr) {
+#ifdef _WIN32
+    UnmapViewOfFile(data_);
+    CloseHandle(mapping_);
+    CloseHandle(file_);
+    mapping_ = nullptr;
+    file_ = nullptr;
+#else
+    munmap(const_cast<unsigned char*>(data_), static_cast<std::size_t>(size_));
+#endif
+  }
+  data_ = nullptr;
+  size_ = 0;
+  header_ = nullptr;
+  entries_ = nullptr;
+  buckets_ = nullptr;
+  names_ = nullptr;
+}
+
+bool AssetArchive::IsValid() const noexcept {
+  const AssetArchiveHeader& header = *header_;
+  if (header.magic != kAssetArchiveMagic ||
+      header.version != kAssetArchiveVersion) {
+    return false;
+  }
+  const auto is_in_file = [this](const std::uint64_t offset,
+                                 const std::uint64_t size) {
+    return offset <= size_ && size <= size_ - offset;
+  };
+  // The index is read in place, its arrays must be aligned and in the file.
+  if (header.entries_offset % alignof(AssetArchiveEntry) != 0 ||
+      header.buckets_offset % alignof(std::uint32_t) != 0 ||
+      !is_in_file(header.entries_offset,
+                  static_cast<std::uint64_t>(header.entry_count) *
+                      sizeof(AssetArchiveEntry)) ||
+      !is_in_file(header.buckets_offset,
+                  static_cast<std::uint64_t>(header.bucket_count) *
+                      sizeof(std::uint32_t)) ||
+      !is_in_file(header.names_offset, header.names_size)) {
+    return false;
+  }
+  if (header.bucket_count < header.entry_count || header.bucket_count == 0 ||
+      (header.bucket_count & (header.bucket_count - 1)) != 0) {
+    return false;
+  }
+  for (std::uint32_t i = 0; i < header.entry_count; i++) {
+    const AssetArchiveEntry& entry = entries_[i];
+    // FileBuffer sizes are ints, LZ4 blocks stay below that.
+    if (!is_in_file(entry.offset, entry.packed_size) ||
+        entry.size > LZ4_MAX_INPUT_SIZE ||
+        static_cast<std::uint64_t>(entry.name_offset) + entry.name_size >
+            header.names_size) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::uint32_t AssetArchive::Find(const std::string_view path) const noexcept {
+  if (header_ == nullptr) {
+    return kAssetArchiveNoEntry;
+  }
+  const std::uint64_t hash = HashAssetPath(path);
+  const std::uint32_t mask = header_->bucket_count - 1;
+  // At most as many probes as buckets, a damaged table can't loop forever.
+  for (std::uint32_t probe = 0; probe < header_->bucket_count; probe++) {
+    const std::uint32_t index =
+        buckets_[(static_cast<std::uint32_t>(hash) + probe) & mask];
+    if (index >= header_->entry_count) {
+      return kAssetArchiveNoEntry;
+    }
+    const AssetArchiveEntry& entry = entries_[index];
+    if (entry.hash == hash && name(entry) == path) {
+      return index;
+    }
+  }
+  return kAssetArchiveNoEntry;
+}
+
+bool AssetArchive::Unpack(const std::uint32_t index,
+                          unsigned char* out) const noexcept {
+  if (index >= entry_count()) {
+    return false;
+  }
+  const AssetArchiveEntry& entry = entries_[index];
+  const unsigned char* packed = data_ + entry.offset;
+  if ((entry.flags & kAssetArchiveCompressed) == 0) {
+    if (entry.packed_size != entry.size) {
+      return false;
+    }
+    std::memcpy(out, packed, entry.size);
+    return true;
+  }
+  // The safe decoder never reads or writes out of the given sizes.
+  const int size = tracy::LZ4_decompress_safe(
+      reinterpret_cast<const char*>(packed), reinterpret_cast<char*>(out),
+      static_cast<int>(entry.packed_size), static_cast<int>(entry.size));
+  return size >= 0 && static_cast<std::uint32_t>(size) == entry.size;
+}
+
+bool AssetArchive::Unpack(const std::uint32_t index,
+                          FileBuffer* file_buffer) const {
+  *file_buffer = FileBuffer();
+  if (index >= entry_count()) {
+    return false;
+  }
+  FileBuffer unpacked;
+  unpacked.size = static_cast<int>(entries_[index].size);
+  unpacked.data = new unsigned char[entries_[index].size];
+  if (!Unpack(index, unpacked.data)) {
+    std::cerr << "Can't unpack " << name(entries_[index]) << '\n';
+    return false;
+  }
+  *file_buffer = std::move(unpacked);
+  return true;
+}
+
+UnpackAssetJob::UnpackAssetJob(const AssetArchive* archive,
+                               const std::uint32_t index,
+                               FileBuffer* file_buffer) noexcept
+    : Job(JobType::kCompute),
+      archive_(archive),
+      index_(index),
+      file_buffer_(file_buffer) {}
+
+void UnpackAssetJob::Work() noexcept {
+  PROFILE_ZONE;
+  archive_->Unpack(index_, file_buffer_);
+}
@@ -0,0 +1,140 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <numeric>
+
+namespace {
+
+bool ParseFrameCount(const std::string_view text, int& count) noexcept {
+  int value = 0;
+  const auto [end, error] =
+      std::from_chars(text.data(), text.data() + text.size(), value);
+  if (error != std::errc() || end != text.data() + text.size() || value < 0) {
+    return false;
+  }
+  count = value;
+  return true;
+}
+
+float NearestRank(const std::vector<float>& sorted,
+                  const float percentile) noexcept {
+  const auto rank = static_cast<std::size_t>(
+      std::ceil(percentile / 100.f * static_cast<float>(sorted.size())));
+  return sorted[std::clamp<std::size_t>(rank, 1, sorted.size()) - 1];
+}
+
+// The renderer name comes from the driver.
+std::string JsonEscape(const std::string_view text) {
+  std::string escaped;
+  escaped.reserve(text.size());
+  for (const char c : text) {
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+      escaped += c;
+    } else if (static_cast<unsigned char>(c) >= 0x20) {
+      escaped += c;
+    }
+  }
+  return escaped;
+}
+
+void WriteBenchmarkTimings(std::ofstream& file, const std::string_view key,
+                           const std::vector<BenchmarkTiming>& timings) {
+  file << "  \"" << key << "\": [";
+  for (std::size_t i = 0; i < timings.size(); i++) {
+    file << (i == 0 ? "\n" : ",\n") << "    {\"name\": \""
+         << JsonEscape(timings[i].name)
+         << "\", \"ms\": " << timings[i].milliseconds << '}';
+  }
+  file << (timings.empty() ? "]" : "\n  ]");
+}
+
+}  // namespace
+
+bool ParseBenchmarkArgument(const int argc, char** argv, int& index,
+                            BenchmarkOptions& options) {
+  const std::string_view argument = argv[index];
+  if (argument == "--benchmark") {
+    options.is_enabled = true;
+    return true;
+  }
+  if (index + 1 >= argc) {
+    return false;
+  }
+  const std::string_view value = argv[index + 1];
+  bool is_valid = false;
+  if (argument == "--frames") {
+    is_valid = ParseFrameCount(value, options.frame_count) &&
+               options.frame_count > 0;
+  } else if (argument == "--warmup") {
+    is_valid = ParseFrameCount(value, options.warmup_frames);
+  } else if (argument == "--report") {
+    options.report_path = value;
+    is_valid = !value.empty();
+  } else if (argument == "--camera-path") {
+    options.camera_path = value;
+    is_valid = !value.empty();
+  }
+  if (is_valid) {
+    index++;
+  }
+  return is_valid;
+}
+
+FrameTimeStats ComputeFrameTimeStats(std::vector<float> milliseconds) {
+  FrameTimeStats stats;
+  stats.frame_count = milliseconds.size();
+  if (milliseconds.empty()) {
+    return stats;
+  }
+  std::sort(milliseconds.begin(), milliseconds.end());
+  // Summed in double, thousands of frames lose precision in float.
+  const double sum =
+      std::accumulate(milliseconds.begin(), milliseconds.end(), 0.0);
+  stats.min = milliseconds.front();
+  stats.max = milliseconds.back();
+  stats.mean = static_cast<float>(sum / milliseconds.size());
+  stats.p50 = NearestRank(milliseconds, 50.f);
+  stats.p90 = NearestRank(milliseconds, 90.f);
+  stats.p95 = NearestRank(milliseconds, 95.f);
+  stats.p99 = NearestRank(milliseconds, 99.f);
+  return stats;
+}
+
+bool WriteBenchmarkReport(const std::string_view path,
+                          const BenchmarkReport& report) {
+  std::ofstream file{std::string(path)};
+  if (!file) {
+    return false;
+  }
+  const FrameTimeStats stats = ComputeFrameTimeStats(report.frame_milliseconds);
+  file << std::fixed << std::setprecision(4) << "{\n"
+       << "  \"renderer\": \"" << JsonEscape(report.renderer) << "\",\n"
+       << "  \"context\": \"" << JsonEscape(report.context) << "\",\n"
+       << "  \"camera_path\": \"" << JsonEscape(report.camera_path)
+       << "\",\n"
+       << "  \"width\": " << report.width << ",\n"
+       << "  \"height\": " << report.height << ",\n"
+       << "  \"warmup_frames\": " << report.warmup_frames << ",\n"
+       << "  \"unit\": \"ms\",\n"
+       << "  \"frame_time\": {\"frame_count\": " << stats.frame_count
+       << ", \"min\": " << stats.min << ", \"mean\": " << stats.mean
+       << ", \"p50\": " << stats.p50 << ", \"p90\": " << stats.p90
+       << ", \"p95\": " << stats.p95 << ", \"p99\": " << stats.p99
+       << ", \"max\": " << stats.max << "},\n";
+  WriteBenchmarkTimings(file, "startup_phases", report.startup_phases);
+  file << ",\n";
+  WriteBenchmarkTimings(file, "cpu_passes", report.cpu_passes);
+  file << ",\n";
+  WriteBenchmarkTimings(file, "gpu_passes", report.gpu_passes);
+  file << ",\n  \"frames\": [";
+  for (std::size_t i = 0; i < report.frame_milliseconds.size(); i++) {
+    file << (i == 0 ? "" : ", ") << report.frame_milliseconds[i];
+  }
+  file << "]\n}\n";
+  return static_cast<bool>(file);
+}
@@ -63,6 +63,12 @@ void Camera::ProcessMouseScroll(float yoffset) {
   if (zoom_ > 45.0f) zoom_ = 45.0f;
 }
 
+void Camera::SetOrientation(float yaw, float pitch) {
+  yaw_ = yaw;
+  pitch_ = pitch;
+  updateCameraVectors();
+}
+
 void Camera::updateCameraVectors() {
   // calculate the new Front vector
   glm::vec3 front;
@@ -0,0 +1,156 @@
+#include "camera_path.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <utility>
+
+namespace {
+
+constexpr std::uint32_t kCameraPathMagic = 0x504d4143;  // "CAMP"
+constexpr std::uint32_t kCameraPathVersion = 1;
+// A corrupted header must not make us allocate gigabytes.
+constexpr std::uint32_t kMaxCameraKeyCount = 1u << 20;
+
+struct CameraPathHeader {
+  std::uint32_t magic = kCameraPathMagic;
+  std::uint32_t version = kCameraPathVersion;
+  std::uint32_t key_count = 0;
+};
+
+// Cubic Hermite between p0 and p1 with the Catmull-Rom tangents of keys
+// spaced unevenly in time.
+template <typename T>
+T CameraPathHermite(const T& p0, const T& p1, const T& m0, const T& m1,
+                    const float span, const float s) noexcept {
+  const float s2 = s * s;
+  const float s3 = s2 * s;
+  return (2.f * s3 - 3.f * s2 + 1.f) * p0 + (s3 - 2.f * s2 + s) * span * m0 +
+         (-2.f * s3 + 3.f * s2) * p1 + (s3 - s2) * span * m1;
+}
+
+template <typename T>
+T CameraPathTangent(const std::vector<CameraKey>& keys, const std::size_t i,
+                    T CameraKey::*value) noexcept {
+  const std::size_t previous = i == 0 ? 0 : i - 1;
+  const std::size_t next = std::min(i + 1, keys.size() - 1);
+  const float span = keys[next].time - keys[previous].time;
+  if (span <= 0.f) {
+    return T(0.f);
+  }
+  return (keys[next].*value - keys[previous].*value) / span;
+}
+
+}  // namespace
+
+void CameraPath::Clear() noexcept { keys_.clear(); }
+
+void CameraPath::Record(const float time, const Camera& camera) {
+  if (!keys_.empty() && time - keys_.back().time < kRecordInterval) {
+    return;
+  }
+  keys_.push_back({time, camera.position_, camera.yaw_, camera.pitch_,
+                   camera.zoom_});
+}
+
+void CameraPath::Finish(const float time, const Camera& camera) {
+  if (!keys_.empty() && time <= keys_.back().time) {
+    keys_.pop_back();
+  }
+  keys_.push_back({time, camera.position_, camera.yaw_, camera.pitch_,
+                   camera.zoom_});
+}
+
+CameraKey CameraPath::Sample(const float time) const noexcept {
+  if (keys_.empty()) {
+    return {};
+  }
+  if (time <= keys_.front().time) {
+    return keys_.front();
+  }
+  if (time >= keys_.back().time) {
+    return keys_.back();
+  }
+  const auto next = std::upper_bound(
+      keys_.begin(), keys_.end(), time,
+      [](const float t, const CameraKey& key) { return t < key.time; });
+  const std::size_t i1 = static_cast<std::size_t>(next - keys_.begin());
+  const std::size_t i0 = i1 - 1;
+  const CameraKey& k0 = keys_[i0];
+  const CameraKey& k1 = keys_[i1];
+  const float span = k1.time - k0.time;
+  const float s = (time - k0.time) / span;
+
+  const auto interpolate = [&](auto CameraKey::*value) {
+    return CameraPathHermite(k0.*value, k1.*value,
+                             CameraPathTangent(keys_, i0, value),
+                             CameraPathTangent(keys_, i1, value), span, s);
+  };
+  CameraKey key;
+  key.time = time;
+  key.position = interpolate(&CameraKey::position);
+  // The yaw isn't wrapped while recording, the spline never turns the long
+  // way around.
+  key.yaw = interpolate(&CameraKey::yaw);
+  key.pitch = std::clamp(interpolate(&CameraKey::pitch), -89.f, 89.f);
+  key.zoom = std::clamp(interpolate(&CameraKey::zoom), 1.f, 45.f);
+  return key;
+}
+
+void CameraPath::Apply(const float time, Camera& camera) const noexcept {
+  if (keys_.empty()) {
+    return;
+  }
+  const CameraKey key = Sample(time);
+  camera.position_ = key.position;
+  camera.zoom_ = key.zoom;
+  camera.SetOrientation(key.yaw, key.pitch);
+}
+
+bool CameraPath::Save(const std::string_view path) const {
+  std::ofstream file(std::string(path), std::ios::binary | std::ios::trunc);
+  if (!file) {
+    return false;
+  }
+  CameraPathHeader header;
+  header.key_count = static_cast<std::uint32_t>(keys_.size());
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char*>(keys_.data()),
+             static_cast<std::streamsize>(keys_.size() * sizeof(CameraKey)));
+  return static_cast<bool>(file);
+}
+
+bool CameraPath::Load(const std::string_view path) {
+  std::ifstream file(std::string(path), std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  CameraPathHeader header;
+  file.read(reinterpret_cast<char*>(&header), sizeof(header));
+  if (!file || header.magic != kCameraPathMagic ||
+      header.version != kCameraPathVersion ||
+      header.key_count > kMaxCameraKeyCount) {
+    return false;
+  }
+  std::vector<CameraKey> keys(header.key_count);
+  file.read(reinterpret_cast<char*>(keys.data()),
+            static_cast<std::streamsize>(keys.size() * sizeof(CameraKey)));
+  if (!file) {
+    return false;
+  }
+  // Sample() searches the keys by time.
+  for (std::size_t i = 1; i < keys.size(); i++) {
+    if (!(keys[i].time > keys[i - 1].time)) {
+      return false;
+    }
+  }
+  keys_ = std::move(keys);
+  return true;
+}
+
+std::string CameraPathFile(const std::string_view name) {
+  if (name.find_first_of("/\\.") != std::string_view::npos) {
+    return std::string(name);
+  }
+  return "data/camera_paths/" + std::string(name) + ".campath";
+}
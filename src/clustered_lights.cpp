@@ -0,0 +1,384 @@
+#include "clustered_lights.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <random>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define CLUSTER_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define CLUSTER_SSE
+#endif
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "cpu_profiler.h"
+
+void ClusterGrid::Build(const glm::mat4& projection, const float near,
+                        const float far) noexcept {
+  near_plane = near;
+  far_plane = far;
+  min.resize(kClusterCount);
+  max.resize(kClusterCount);
+
+  // View space direction through each tile corner, scaled to a depth of 1.
+  const glm::mat4 inverse_projection = glm::inverse(projection);
+  std::array<glm::vec3, (kCountX + 1) * (kCountY + 1)> rays{};
+  for (int y = 0; y <= kCountY; y++) {
+    for (int x = 0; x <= kCountX; x++) {
+      const glm::vec4 ndc(2.f * static_cast<float>(x) / kCountX - 1.f,
+                          2.f * static_cast<float>(y) / kCountY - 1.f, -1.f,
+                          1.f);
+      const glm::vec4 point = inverse_projection * ndc;
+      const glm::vec3 direction = glm::vec3(point) / point.w;
+      rays[x + y * (kCountX + 1)] = direction / -direction.z;
+    }
+  }
+
+  for (int z = 0; z < kCountZ; z++) {
+    const float slice_near = SliceDistance(z);
+    const float slice_far = SliceDistance(z + 1);
+    slice_min[z] = glm::vec3(std::numeric_limits<float>::max());
+    slice_max[z] = glm::vec3(std::numeric_limits<float>::lowest());
+    for (int y = 0; y < kCountY; y++) {
+      for (int x = 0; x < kCountX; x++) {
+        glm::vec3 box_min(std::numeric_limits<float>::max());
+        glm::vec3 box_max(std::numeric_limits<float>::lowest());
+        for (int corner = 0; corner < 4; corner++) {
+          const glm::vec3& ray =
+              rays[(x + (corner & 1)) + (y + (corner >> 1)) * (kCountX + 1)];
+          for (const float distance : {slice_near, slice_far}) {
+            box_min = glm::min(box_min, ray * distance);
+            box_max = glm::max(box_max, ray * distance);
+          }
+        }
+        const int index = Index(x, y, z);
+        min[index] = box_min;
+        max[index] = box_max;
+        slice_min[z] = glm::min(slice_min[z], box_min);
+        slice_max[z] = glm::max(slice_max[z], box_max);
+      }
+    }
+  }
+}
+
+float ClusterGrid::SliceDistance(const int slice) const noexcept {
+  return near_plane * std::pow(far_plane / near_plane,
+                               static_cast<float>(slice) / kCountZ);
+}
+
+glm::vec2 ClusterGrid::SliceScaleBias() const noexcept {
+  const float log_ratio = std::log(far_plane / near_plane);
+  return glm::vec2(kCountZ / log_ratio,
+                   -kCountZ * std::log(near_plane) / log_ratio);
+}
+
+void ClusterLightSet::Set(const std::vector<PointLight>& lights,
+                          const glm::mat4& view) noexcept {
+  Resize(lights.size());
+  for (std::size_t i = 0; i < lights.size(); i++) {
+    const glm::vec3 center =
+        glm::vec3(view * glm::vec4(lights[i].position, 1.f));
+    x[i] = center.x;
+    y[i] = center.y;
+    z[i] = center.z;
+    radius[i] = lights[i].radius;
+  }
+}
+
+void ClusterLightSet::Resize(const std::size_t count) noexcept {
+  size_ = count;
+  const std::size_t padded =
+      (count + kLightBatchSize - 1) / kLightBatchSize * kLightBatchSize;
+  for (auto* array : {&x, &y, &z, &radius}) {
+    array->resize(padded, 0.f);
+  }
+}
+
+#if defined(CLUSTER_AVX) || defined(CLUSTER_SSE)
+
+namespace {
+
+// The padding lanes past `end` are never written.
+std::size_t ClusterWriteMask(const int mask, const std::size_t i,
+                             const std::size_t end,
+                             std::uint32_t* indices) noexcept {
+  const std::size_t count = std::min(kLightBatchSize, end - i);
+  std::size_t written = 0;
+  for (std::size_t lane = 0; lane < count; lane++) {
+    indices[written] = static_cast<std::uint32_t>(i + lane);
+    written += static_cast<std::size_t>((mask >> lane) & 1);
+  }
+  return written;
+}
+
+}  // namespace
+
+#endif
+
+#if defined(CLUSTER_AVX)
+
+std::size_t GatherLightsInBox(const ClusterLightSet& lights,
+                              const std::size_t begin, const std::size_t end,
+                              const glm::vec3 box_min, const glm::vec3 box_max,
+                              std::uint32_t* indices) noexcept {
+  const __m256 min_x = _mm256_set1_ps(box_min.x);
+  const __m256 min_y = _mm256_set1_ps(box_min.y);
+  const __m256 min_z = _mm256_set1_ps(box_min.z);
+  const __m256 max_x = _mm256_set1_ps(box_max.x);
+  const __m256 max_y = _mm256_set1_ps(box_max.y);
+  const __m256 max_z = _mm256_set1_ps(box_max.z);
+  const __m256 zero = _mm256_setzero_ps();
+
+  std::size_t written = 0;
+  for (std::size_t i = begin; i < end; i += kLightBatchSize) {
+    const __m256 cx = _mm256_loadu_ps(lights.x.data() + i);
+    const __m256 cy = _mm256_loadu_ps(lights.y.data() + i);
+    const __m256 cz = _mm256_loadu_ps(lights.z.data() + i);
+    const __m256 r = _mm256_loadu_ps(lights.radius.data() + i);
+    // Distance from the center to the box on each axis, 0 inside.
+    const __m256 dx = _mm256_max_ps(
+        _mm256_max_ps(_mm256_sub_ps(min_x, cx), _mm256_sub_ps(cx, max_x)),
+        zero);
+    const __m256 dy = _mm256_max_ps(
+        _mm256_max_ps(_mm256_sub_ps(min_y, cy), _mm256_sub_ps(cy, max_y)),
+        zero);
+    const __m256 dz = _mm256_max_ps(
+        _mm256_max_ps(_mm256_sub_ps(min_z, cz), _mm256_sub_ps(cz, max_z)),
+        zero);
+    __m256 distance_sqr = _mm256_mul_ps(dx, dx);
+    distance_sqr = _mm256_add_ps(distance_sqr, _mm256_mul_ps(dy, dy));
+    distance_sqr = _mm256_add_ps(distance_sqr, _mm256_mul_ps(dz, dz));
+    const __m256 touches =
+        _mm256_cmp_ps(distance_sqr, _mm256_mul_ps(r, r), _CMP_LE_OQ);
+    written += ClusterWriteMask(_mm256_movemask_ps(touches), i, end,
+                                indices + written);
+  }
+  return written;
+}
+
+#elif defined(CLUSTER_SSE)
+
+// SSE only has 4 lanes: two halves are tested to still fill a batch of 8
+// lights per iteration.
+std::size_t GatherLightsInBox(const ClusterLightSet& lights,
+                              const std::size_t begin, const std::size_t end,
+                              const glm::vec3 box_min, const glm::vec3 box_max,
+                              std::uint32_t* indices) noexcept {
+  const __m128 min_x = _mm_set1_ps(box_min.x);
+  const __m128 min_y = _mm_set1_ps(box_min.y);
+  const __m128 min_z = _mm_set1_ps(box_min.z);
+  const __m128 max_x = _mm_set1_ps(box_max.x);
+  const __m128 max_y = _mm_set1_ps(box_max.y);
+  const __m128 max_z = _mm_set1_ps(box_max.z);
+  const __m128 zero = _mm_setzero_ps();
+
+  std::size_t written = 0;
+  for (std::size_t i = begin; i < end; i += kLightBatchSize) {
+    int mask = 0;
+    for (std::size_t half = 0; half < 2; half++) {
+      const std::size_t j = i + half * 4;
+      const __m128 cx = _mm_loadu_ps(lights.x.data() + j);
+      const __m128 cy = _mm_loadu_ps(lights.y.data() + j);
+      const __m128 cz = _mm_loadu_ps(lights.z.data() + j);
+      const __m128 r = _mm_loadu_ps(lights.radius.data() + j);
+      const __m128 dx = _mm_max_ps(
+          _mm_max_ps(_mm_sub_ps(min_x, cx), _mm_sub_ps(cx, max_x)), zero);
+      const __m128 dy = _mm_max_ps(
+          _mm_max_ps(_mm_sub_ps(min_y, cy), _mm_sub_ps(cy, max_y)), zero);
+      const __m128 dz = _mm_max_ps(
+          _mm_max_ps(_mm_sub_ps(min_z, cz), _mm_sub_ps(cz, max_z)), zero);
+      __m128 distance_sqr = _mm_mul_ps(dx, dx);
+      distance_sqr = _mm_add_ps(distance_sqr, _mm_mul_ps(dy, dy));
+      distance_sqr = _mm_add_ps(distance_sqr, _mm_mul_ps(dz, dz));
+      const __m128 touches = _mm_cmple_ps(distance_sqr, _mm_mul_ps(r, r));
+      mask |= _mm_movemask_ps(touches) << (half * 4);
+    }
+    written += ClusterWriteMask(mask, i, end, indices + written);
+  }
+  return written;
+}
+
+#else
+
+std::size_t GatherLightsInBox(const ClusterLightSet& lights,
+                              const std::size_t begin, const std::size_t end,
+                              const glm::vec3 box_min, const glm::vec3 box_max,
+                              std::uint32_t* indices) noexcept {
+  std::size_t written = 0;
+  for (std::size_t i = begin; i < end; i++) {
+    const glm::vec3 center(lights.x[i], lights.y[i], lights.z[i]);
+    const glm::vec3 d = glm::max(glm::max(box_min - center, center - box_max),
+                                 glm::vec3(0.f));
+    if (glm::dot(d, d) <= lights.radius[i] * lights.radius[i]) {
+      indices[written++] = static_cast<std::uint32_t>(i);
+    }
+  }
+  return written;
+}
+
+#endif
+
+void ClusterAssignJob::Setup(const ClusterGrid* grid,
+                             const ClusterLightSet* lights,
+                             const int begin_slice,
+                             const int end_slice) noexcept {
+  grid_ = grid;
+  lights_ = lights;
+  begin_slice_ = begin_slice;
+  end_slice_ = end_slice;
+}
+
+void ClusterAssignJob::Work() noexcept {
+  PROFILE_ZONE;
+  const ClusterGrid& grid = *grid_;
+  const ClusterLightSet& lights = *lights_;
+  counts_.assign(static_cast<std::size_t>(end_slice_ - begin_slice_) *
+                     ClusterGrid::kSliceClusterCount,
+                 0);
+  indices_.clear();
+
+  for (int z = begin_slice_; z < end_slice_; z++) {
+    // Lights of the slice, copied in their own set to test them against
+    // every cluster of the slice.
+    slice_indices_.resize(lights.size());
+    const std::size_t slice_count =
+        GatherLightsInBox(lights, 0, lights.size(), grid.slice_min[z],
+                          grid.slice_max[z], slice_indices_.data());
+    if (slice_count == 0) {
+      continue;
+    }
+    slice_lights_.Resize(slice_count);
+    for (std::size_t i = 0; i < slice_count; i++) {
+      const std::uint32_t light = slice_indices_[i];
+      slice_lights_.x[i] = lights.x[light];
+      slice_lights_.y[i] = lights.y[light];
+      slice_lights_.z[i] = lights.z[light];
+      slice_lights_.radius[i] = lights.radius[light];
+    }
+
+    for (int cluster = 0; cluster < ClusterGrid::kSliceClusterCount;
+         cluster++) {
+      const int index = z * ClusterGrid::kSliceClusterCount + cluster;
+      const std::size_t first = indices_.size();
+      indices_.resize(first + slice_count);
+      const std::size_t count =
+          GatherLightsInBox(slice_lights_, 0, slice_count, grid.min[index],
+                            grid.max[index], indices_.data() + first);
+      indices_.resize(first + count);
+      for (std::size_t i = first; i < first + count; i++) {
+        indices_[i] = slice_indices_[indices_[i]];
+      }
+      counts_[static_cast<std::size_t>(z - begin_slice_) *
+                  ClusterGrid::kSliceClusterCount +
+              cluster] = static_cast<std::uint32_t>(count);
+    }
+  }
+}
+
+ClusterStats LightClusterer::Assign(JobSystem& job_system,
+                                    const ClusterGrid& grid,
+                                    const ClusterLightSet& lights) noexcept {
+  PROFILE_ZONE;
+  const auto start = std::chrono::steady_clock::now();
+
+  // Few lights are assigned on one job, splitting costs more than it saves.
+  const int job_count =
+      lights.size() < kMinLightsPerJob
+          ? 1
+          : (ClusterGrid::kCountZ + kSlicesPerJob - 1) / kSlicesPerJob;
+  const int slices_per_job =
+      (ClusterGrid::kCountZ + job_count - 1) / job_count;
+  jobs_.resize(static_cast<std::size_t>(job_count));
+  job_ptrs_.clear();
+  for (int i = 0; i < job_count; i++) {
+    const int begin = i * slices_per_job;
+    const int end = std::min(ClusterGrid::kCountZ, begin + slices_per_job);
+    jobs_[i].Reset();
+    jobs_[i].Setup(&grid, &lights, begin, end);
+    job_ptrs_.push_back(&jobs_[i]);
+  }
+  job_system.RunComputeJobs(job_ptrs_.data(), job_ptrs_.size());
+
+  // The jobs cover consecutive clusters, their lists are appended in order.
+  ClusterStats stats;
+  offsets_.resize(2 * ClusterGrid::kClusterCount);
+  indices_.clear();
+  for (const auto& job : jobs_) {
+    std::size_t cluster = static_cast<std::size_t>(job.begin_slice()) *
+                          ClusterGrid::kSliceClusterCount;
+    auto offset = static_cast<std::uint32_t>(indices_.size());
+    for (const std::uint32_t count : job.counts()) {
+      offsets_[2 * cluster] = offset;
+      offsets_[2 * cluster + 1] = count;
+      offset += count;
+      stats.max_cluster_light_count =
+          std::max(stats.max_cluster_light_count, count);
+      cluster++;
+    }
+    indices_.insert(indices_.end(), job.indices().begin(),
+                    job.indices().end());
+  }
+
+  stats.light_count = lights.size();
+  stats.index_count = indices_.size();
+  stats.milliseconds = std::chrono::duration<float, std::milli>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+  return stats;
+}
+
+std::vector<PointLight> GeneratePointLights(const std::size_t count,
+                                            const glm::vec3 room_min,
+                                            const glm::vec3 room_max,
+                                            const std::uint32_t seed) {
+  std::mt19937 generator(seed);
+  std::uniform_real_distribution unit(0.f, 1.f);
+  std::uniform_real_distribution radius(1.5f, 4.f);
+
+  std::vector<PointLight> lights(count);
+  for (auto& light : lights) {
+    light.position =
+        room_min + (room_max - room_min) * glm::vec3(unit(generator),
+                                                     unit(generator),
+                                                     unit(generator));
+    light.radius = radius(generator);
+    // Saturated colors, one channel is always full.
+    glm::vec3 color(unit(generator), unit(generator), unit(generator));
+    color /= std::max({color.r, color.g, color.b, 1e-3f});
+    light.color = color * 2.f;
+  }
+  return lights;
+}
+
+ClusterStats RunClusterBenchmark(JobSystem& job_system,
+                                 const std::size_t light_count,
+                                 const int iterations) noexcept {
+  PROFILE_ZONE;
+  const glm::mat4 projection =
+      glm::perspective(glm::radians(45.f), 16.f / 9.f, 0.1f, 100.f);
+  const glm::mat4 view = glm::lookAt(glm::vec3(0.f, 2.f, 0.f),
+                                     glm::vec3(0.f, 2.f, -1.f),
+                                     glm::vec3(0.f, 1.f, 0.f));
+  ClusterGrid grid;
+  grid.Build(projection, 0.1f, 100.f);
+
+  const std::vector<PointLight> lights = GeneratePointLights(
+      light_count, glm::vec3(-40.f, 0.f, -90.f), glm::vec3(40.f, 8.f, 10.f));
+  ClusterLightSet set;
+  set.Set(lights, view);
+
+  LightClusterer clusterer;
+  ClusterStats best{};
+  for (int i = 0; i < iterations; i++) {
+    const ClusterStats stats = clusterer.Assign(job_system, grid, set);
+    if (i == 0 || stats.milliseconds < best.milliseconds) {
+      best = stats;
+    }
+  }
+  return best;
+}
@@ -0,0 +1,314 @@
+#include "command_buffer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <glm/gtc/matrix_transform.hpp>
+#include <random>
+
+#include "cpu_profiler.h"
+
+namespace {
+
+constexpr std::uint32_t kCommandTypeBits = 8;
+constexpr std::uint32_t kCommandTypeMask = (1u << kCommandTypeBits) - 1;
+
+std::size_t AlignCommandOffset(const std::size_t offset,
+                               const std::size_t alignment) noexcept {
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+}  // namespace
+
+void CommandBuffer::Reset(const std::uint32_t uniform_alignment) noexcept {
+  words_.clear();
+  uniforms_.clear();
+  uniform_alignment_ = std::max(uniform_alignment, 1u);
+  command_count_ = 0;
+  draw_count_ = 0;
+  program_ = kUnknown;
+  textures_.fill(kUnknown);
+}
+
+void CommandBuffer::BindPipeline(const std::uint32_t program) {
+  if (program == program_) {
+    return;
+  }
+  program_ = program;
+  PushHeader(CommandType::kBindPipeline, 1);
+  words_.push_back(program);
+}
+
+void CommandBuffer::SetUniforms(const std::uint32_t binding, const void* data,
+                                const std::uint32_t size) {
+  const std::size_t offset =
+      AlignCommandOffset(uniforms_.size(), uniform_alignment_);
+  uniforms_.resize(offset + size);
+  std::memcpy(uniforms_.data() + offset, data, size);
+  PushHeader(CommandType::kBindUniforms, 3);
+  words_.insert(words_.end(),
+                {binding, static_cast<std::uint32_t>(offset), size});
+}
+
+void CommandBuffer::BindTextures(const std::uint32_t first_unit,
+                                 const std::uint32_t* textures,
+                                 std::uint32_t count) {
+  if (first_unit >= kMaxTextures) {
+    return;
+  }
+  count = std::min(count, kMaxTextures - first_unit);
+  if (std::equal(textures, textures + count,
+                 textures_.begin() + first_unit)) {
+    return;
+  }
+  std::copy(textures, textures + count, textures_.begin() + first_unit);
+  PushHeader(CommandType::kBindTextures, 2 + count);
+  words_.push_back(first_unit);
+  words_.push_back(count);
+  words_.insert(words_.end(), textures, textures + count);
+}
+
+void CommandBuffer::DrawIndexed(const DrawIndexedCommand& draw) {
+  if (draw.index_count == 0) {
+    return;
+  }
+  PushHeader(CommandType::kDrawIndexed, 4);
+  words_.insert(words_.end(), {draw.vertex_array, draw.mode, draw.index_count,
+                               draw.index_offset});
+  draw_count_++;
+}
+
+void CommandBuffer::PushHeader(const CommandType type,
+                               const std::uint32_t argument_count) {
+  words_.push_back(static_cast<std::uint32_t>(type) |
+                   argument_count << kCommandTypeBits);
+  command_count_++;
+}
+
+void NullCommandBackend::BeginReplay(const std::size_t uniform_byte_size) {
+  Fold(uniform_byte_size);
+}
+
+void NullCommandBackend::UploadUniforms(const std::size_t offset,
+                                        const std::byte* data,
+                                        const std::size_t size) {
+  Fold(offset + size + static_cast<std::uint64_t>(data[0]));
+}
+
+void NullCommandBackend::BindPipeline(const std::uint32_t program) {
+  Fold(program);
+}
+
+void NullCommandBackend::BindUniforms(const std::uint32_t binding,
+                                      const std::size_t offset,
+                                      const std::size_t size) {
+  Fold(binding + offset + size);
+}
+
+void NullCommandBackend::BindTextures(const std::uint32_t first_unit,
+                                      const std::uint32_t* textures,
+                                      const std::uint32_t count) {
+  Fold(first_unit);
+  for (std::uint32_t i = 0; i < count; i++) {
+    Fold(textures[i]);
+  }
+}
+
+void NullCommandBackend::DrawIndexed(const DrawIndexedCommand& draw) {
+  Fold(draw.vertex_array + draw.mode + draw.index_count + draw.index_offset);
+}
+
+void NullCommandBackend::Fold(const std::uint64_t value) noexcept {
+  command_count_++;
+  checksum_ = (checksum_ ^ value) * 0x100000001b3ull;
+}
+
+void ReplayCommandBuffers(const std::vector<CommandBuffer>& buffers,
+                          CommandBackend& backend) {
+  PROFILE_ZONE;
+  // The arenas are uploaded back to back, each at its own alignment.
+  std::size_t uniform_byte_size = 0;
+  for (const auto& buffer : buffers) {
+    uniform_byte_size =
+        AlignCommandOffset(uniform_byte_size, buffer.uniform_alignment()) +
+        buffer.uniforms().size();
+  }
+  backend.BeginReplay(uniform_byte_size);
+
+  std::size_t base = 0;
+  for (const auto& buffer : buffers) {
+    base = AlignCommandOffset(base, buffer.uniform_alignment());
+    if (!buffer.uniforms().empty()) {
+      backend.UploadUniforms(base, buffer.uniforms().data(),
+                             buffer.uniforms().size());
+    }
+    const std::vector<std::uint32_t>& words = buffer.words();
+    for (std::size_t i = 0; i < words.size();) {
+      const std::uint32_t header = words[i];
+      const std::uint32_t* arguments = words.data() + i + 1;
+      switch (static_cast<CommandType>(header & kCommandTypeMask)) {
+        case CommandType::kBindPipeline:
+          backend.BindPipeline(arguments[0]);
+          break;
+        case CommandType::kBindUniforms:
+          backend.BindUniforms(arguments[0], base + arguments[1],
+                               arguments[2]);
+          break;
+        case CommandType::kBindTextures:
+          backend.BindTextures(arguments[0], arguments + 2, arguments[1]);
+          break;
+        case CommandType::kDrawIndexed:
+          backend.DrawIndexed(
+              {arguments[0], arguments[1], arguments[2], arguments[3]});
+          break;
+      }
+      i += 1 + (header >> kCommandTypeBits);
+    }
+    base += buffer.uniforms().size();
+  }
+}
+
+void RecordCommandsJob::Setup(const CommandRecordFunction* record,
+                              CommandBuffer* commands, const std::size_t begin,
+                              const std::size_t end) noexcept {
+  record_ = record;
+  commands_ = commands;
+  begin_ = begin;
+  end_ = end;
+}
+
+void RecordCommandsJob::Work() noexcept {
+  PROFILE_ZONE;
+  (*record_)(*commands_, begin_, end_);
+}
+
+CommandBufferStats CommandRecorder::Record(
+    JobSystem& job_system, const std::size_t item_count,
+    const std::uint32_t uniform_alignment,
+    const CommandRecordFunction& record) noexcept {
+  PROFILE_ZONE;
+  const auto start = std::chrono::steady_clock::now();
+  const std::size_t max_jobs =
+      static_cast<std::size_t>(job_system.compute_worker_count()) + 1;
+  const std::size_t job_count =
+      std::clamp<std::size_t>(item_count / kMinItemsPerJob, 1, max_jobs);
+
+  buffers_.resize(job_count);
+  for (auto& buffer : buffers_) {
+    buffer.Reset(uniform_alignment);
+  }
+  if (job_count == 1) {
+    record(buffers_[0], 0, item_count);
+  } else {
+    const std::size_t items_per_job = (item_count + job_count - 1) / job_count;
+    jobs_.resize(job_count);
+    job_ptrs_.clear();
+    for (std::size_t i = 0; i < job_count; i++) {
+      const std::size_t begin = i * items_per_job;
+      const std::size_t end = std::min(item_count, begin + items_per_job);
+      if (begin >= end) {
+        break;
+      }
+      jobs_[i].Reset();
+      jobs_[i].Setup(&record, &buffers_[i], begin, end);
+      job_ptrs_.push_back(&jobs_[i]);
+    }
+    job_system.RunComputeJobs(job_ptrs_.data(), job_ptrs_.size());
+  }
+
+  CommandBufferStats stats;
+  stats.buffer_count = buffers_.size();
+  for (const auto& buffer : buffers_) {
+    stats.command_count += buffer.command_count();
+    stats.draw_count += buffer.draw_count();
+    stats.byte_count += buffer.ByteSize();
+  }
+  stats.record_milliseconds = std::chrono::duration<float, std::milli>(
+                                  std::chrono::steady_clock::now() - start)
+                                  .count();
+  return stats;
+}
+
+CommandBufferStats RunCommandBufferBenchmark(JobSystem& job_system,
+                                             const std::size_t draw_count,
+                                             const int iterations) noexcept {
+  PROFILE_ZONE;
+  // GL_TRIANGLES, the null backend never draws.
+  static constexpr std::uint32_t kTriangles = 0x0004;
+  static constexpr std::uint32_t kPipelineCount = 4;
+  static constexpr std::uint32_t kMaterialCount = 32;
+  static constexpr std::uint32_t kMeshCount = 64;
+  // Consecutive draws share a material, like the meshes of a model.
+  static constexpr std::size_t kDrawsPerMaterial = 16;
+  static constexpr std::uint32_t kUniformBinding = 1;
+
+  struct BenchmarkDraw {
+    glm::mat4 model{1.f};
+    std::uint32_t material = 0;
+    DrawIndexedCommand mesh{};
+  };
+  std::mt19937 generator(42);
+  std::uniform_real_distribution position(-200.f, 200.f);
+  std::uniform_real_distribution size(0.1f, 4.f);
+  std::vector<BenchmarkDraw> draws(draw_count);
+  for (std::size_t i = 0; i < draw_count; i++) {
+    BenchmarkDraw& draw = draws[i];
+    draw.model = glm::translate(
+        glm::mat4(1.f), glm::vec3(position(generator), position(generator),
+                                  position(generator)));
+    draw.model = glm::scale(draw.model, glm::vec3(size(generator)));
+    draw.material =
+        static_cast<std::uint32_t>(i / kDrawsPerMaterial % kMaterialCount);
+    const auto mesh = static_cast<std::uint32_t>(i % kMeshCount);
+    draw.mesh = {1 + mesh, kTriangles, 36 * (1 + mesh % 8), 0};
+  }
+  const glm::mat4 view = glm::lookAt(glm::vec3(0.f, 0.f, 50.f),
+                                     glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f));
+
+  const CommandRecordFunction record = [&draws, &view](
+                                           CommandBuffer& commands,
+                                           const std::size_t begin,
+                                           const std::size_t end) {
+    for (std::size_t i = begin; i < end; i++) {
+      const BenchmarkDraw& draw = draws[i];
+      // Draws sorted by pipeline.
+      commands.BindPipeline(
+          1 + static_cast<std::uint32_t>(i * kPipelineCount / draws.size()));
+      std::array<std::uint32_t, 5> textures{};
+      for (std::uint32_t t = 0; t < textures.size(); t++) {
+        textures[t] = 1 + draw.material * 5 + t;
+      }
+      commands.BindTextures(0, textures.data(),
+                            static_cast<std::uint32_t>(textures.size()));
+      commands.SetUniforms(
+          kUniformBinding,
+          DrawUniforms{draw.model,
+                       glm::transpose(glm::inverse(view * draw.model))});
+      commands.DrawIndexed(draw.mesh);
+    }
+  };
+
+  CommandRecorder recorder;
+  CommandBufferStats best{};
+  for (int i = 0; i < iterations; i++) {
+    CommandBufferStats stats = recorder.Record(job_system, draw_count, 256,
+                                               record);
+    NullCommandBackend backend;
+    const auto replay_start = std::chrono::steady_clock::now();
+    ReplayCommandBuffers(recorder.buffers(), backend);
+    stats.replay_milliseconds =
+        std::chrono::duration<float, std::milli>(
+            std::chrono::steady_clock::now() - replay_start)
+            .count();
+    // Keeps the replay from being optimized away.
+    [[maybe_unused]] volatile std::uint64_t checksum = backend.checksum();
+    if (i == 0) {
+      best = stats;
+    }
+    best.record_milliseconds =
+        std::min(best.record_milliseconds, stats.record_milliseconds);
+    best.replay_milliseconds =
+        std::min(best.replay_milliseconds, stats.replay_milliseconds);
+  }
+  return best;
+}
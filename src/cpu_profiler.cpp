@@ -0,0 +1,231 @@
+#include "cpu_profiler.h"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct CpuThreadRing {
+  std::array<CpuEvent, CpuProfiler::kRingCapacity> events{};
+  // Only written by the owner thread, which keeps a plain copy to skip the
+  // atomic load.
+  std::atomic<std::uint64_t> write_count{0};
+  std::uint64_t next_index = 0;
+  std::string name{};
+  std::uint32_t id = 0;
+};
+
+// Rings are never freed, the events of a finished thread can still be
+// written out.
+struct CpuProfilerRegistry {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<CpuThreadRing>> rings;
+  // Reference point of the trace and of the tick calibration.
+  std::uint64_t start_ticks = CpuProfiler::Now();
+  std::chrono::steady_clock::time_point start_time =
+      std::chrono::steady_clock::now();
+};
+
+CpuProfilerRegistry& Registry() {
+  static CpuProfilerRegistry registry;
+  return registry;
+}
+
+thread_local CpuThreadRing* cpu_thread_ring = nullptr;
+
+CpuThreadRing& ThreadRing() {
+  if (cpu_thread_ring == nullptr) {
+    auto& registry = Registry();
+    std::scoped_lock lock(registry.mutex);
+    auto& ring = registry.rings.emplace_back(std::make_unique<CpuThreadRing>());
+    ring->id = static_cast<std::uint32_t>(registry.rings.size() - 1);
+    ring->name = "Thread " + std::to_string(ring->id);
+    cpu_thread_ring = ring.get();
+  }
+  return *cpu_thread_ring;
+}
+
+// Copies the events of a ring that are not being overwritten.
+std::vector<CpuEvent> SnapshotRing(const CpuThreadRing& ring) {
+  constexpr std::uint64_t kCapacity = CpuProfiler::kRingCapacity;
+  const std::uint64_t count = ring.write_count.load(std::memory_order_acquire);
+  std::uint64_t first = count > kCapacity ? count - kCapacity : 0;
+  std::vector<CpuEvent> events;
+  events.reserve(static_cast<std::size_t>(count - first));
+  for (std::uint64_t i = first; i < count; i++) {
+    events.push_back(ring.events[i % kCapacity]);
+  }
+  // The owner may have lapped the copy, drop what it wrote over. It may
+  // also be writing the slot of event new_count - kCapacity, not counted
+  // yet: that one goes too.
+  const std::uint64_t new_count =
+      ring.write_count.load(std::memory_order_acquire);
+  if (new_count + 1 > first + kCapacity) {
+    const auto overwritten = std::min<std::uint64_t>(
+        new_count + 1 - kCapacity - first, events.size());
+    events.erase(events.begin(),
+                 events.begin() + static_cast<std::ptrdiff_t>(overwritten));
+  }
+  return events;
+}
+
+// Ticks per microsecond of CpuProfiler::Now().
+double CpuTicksPerMicrosecond(const CpuProfilerRegistry& registry) {
+#ifdef CPU_PROFILER_RDTSC
+  // Long enough for the steady clock resolution not to matter.
+  constexpr auto kMinCalibration = std::chrono::milliseconds(10);
+  auto now = std::chrono::steady_clock::now();
+  if (now - registry.start_time < kMinCalibration) {
+    std::this_thread::sleep_for(kMinCalibration);
+    now = std::chrono::steady_clock::now();
+  }
+  const std::uint64_t ticks = CpuProfiler::Now() - registry.start_ticks;
+  const double microseconds =
+      std::chrono::duration<double, std::micro>(now - registry.start_time)
+          .count();
+  return static_cast<double>(ticks) / microseconds;
+#else
+  static_cast<void>(registry);
+  using Period = std::chrono::steady_clock::period;
+  return static_cast<double>(Period::den) /
+         (static_cast<double>(Period::num) * 1e6);
+#endif
+}
+
+const char* CpuEventCategory(const CpuEventKind kind) noexcept {
+  switch (kind) {
+    case CpuEventKind::kJob:
+      return "job";
+    case CpuEventKind::kWait:
+      return "wait";
+    case CpuEventKind::kZone:
+      break;
+  }
+  return "zone";
+}
+
+}  // namespace
+
+void CpuProfiler::Record(const char* name, const std::uint64_t begin,
+                         const std::uint64_t end,
+                         const CpuEventKind kind) noexcept {
+  if (!IsEnabled()) {
+    return;
+  }
+  CpuThreadRing& ring = ThreadRing();
+  ring.events[ring.next_index % kRingCapacity] = {name, begin, end, kind};
+  ring.next_index++;
+  ring.write_count.store(ring.next_index, std::memory_order_release);
+}
+
+void CpuProfiler::SetThreadName(std::string name) {
+  CpuThreadRing& ring = ThreadRing();
+  std::scoped_lock lock(Registry().mutex);
+  ring.name = std::move(name);
+}
+
+bool CpuProfiler::WriteChromeTrace(const std::string_view path) {
+  auto& registry = Registry();
+  std::ofstream file{std::string(path)};
+  if (!file) {
+    return false;
+  }
+  const double ticks_per_microsecond = CpuTicksPerMicrosecond(registry);
+  const auto microseconds = [&](const std::uint64_t ticks) {
+    return static_cast<double>(ticks) / ticks_per_microsecond;
+  };
+
+  std::scoped_lock lock(registry.mutex);
+  std::vector<std::vector<CpuEvent>> thread_events;
+  thread_events.reserve(registry.rings.size());
+  // The trace starts with the oldest event still recorded.
+  std::uint64_t origin = CpuProfiler::Now();
+  for (const auto& ring : registry.rings) {
+    thread_events.push_back(SnapshotRing(*ring));
+    for (const auto& event : thread_events.back()) {
+      origin = std::min(origin, event.begin);
+    }
+  }
+
+  // The names are literals and function names of ours, they don't need
+  // escaping.
+  file << std::fixed << std::setprecision(3) << "{\"traceEvents\": [";
+  for (std::size_t i = 0; i < registry.rings.size(); i++) {
+    const CpuThreadRing& ring = *registry.rings[i];
+    file << (i == 0 ? "\n" : ",\n")
+         << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": "
+         << ring.id << ", \"args\": {\"name\": \"" << ring.name << "\"}}";
+    for (const auto& event : thread_events[i]) {
+      // Read on two cores whose counters slightly differ.
+      if (event.end < event.begin) {
+        continue;
+      }
+      file << ",\n{\"name\": \"" << event.name << "\", \"cat\": \""
+           << CpuEventCategory(event.kind) << "\", \"ph\": \"X\", \"ts\": "
+           << microseconds(event.begin - origin)
+           << ", \"dur\": " << microseconds(event.end - event.begin)
+           << ", \"pid\": 1, \"tid\": " << ring.id << '}';
+    }
+  }
+  file << "\n], \"displayTimeUnit\": \"ms\"}\n";
+  return static_cast<bool>(file);
+}
+
+std::vector<CpuZoneSummary> CpuProfiler::Summarize(const std::uint64_t begin,
+                                                   const std::uint64_t end) {
+  auto& registry = Registry();
+  const double ticks_per_millisecond =
+      CpuTicksPerMicrosecond(registry) * 1000.0;
+  std::map<std::string_view, CpuZoneSummary> summaries;
+  std::scoped_lock lock(registry.mutex);
+  for (const auto& ring : registry.rings) {
+    for (const auto& event : SnapshotRing(*ring)) {
+      if (event.begin < begin || event.end > end || event.end < event.begin) {
+        continue;
+      }
+      CpuZoneSummary& summary = summaries[event.name];
+      summary.milliseconds +=
+          static_cast<double>(event.end - event.begin) / ticks_per_millisecond;
+      summary.count++;
+    }
+  }
+  std::vector<CpuZoneSummary> result;
+  result.reserve(summaries.size());
+  for (auto& [name, summary] : summaries) {
+    summary.name = name;
+    result.push_back(std::move(summary));
+  }
+  return result;
+}
+
+CpuProfilerStats CpuProfiler::Stats() {
+  auto& registry = Registry();
+  std::scoped_lock lock(registry.mutex);
+  CpuProfilerStats stats;
+  stats.thread_count = registry.rings.size();
+  for (const auto& ring : registry.rings) {
+    const std::uint64_t count =
+        ring->write_count.load(std::memory_order_acquire);
+    stats.event_count +=
+        static_cast<std::size_t>(std::min<std::uint64_t>(count, kRingCapacity));
+    stats.lost_event_count += count > kRingCapacity ? count - kRingCapacity : 0;
+  }
+  return stats;
+}
+
+float CpuProfiler::MeasureZoneOverhead(const int iterations) {
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    const CpuZone zone("Zone overhead");
+  }
+  const auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<float, std::nano>(end - start).count() /
+         static_cast<float>(std::max(iterations, 1));
+}
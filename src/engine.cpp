@@ -5,23 +5,62 @@
 #include <imgui_impl_opengl3.h>
 #include <imgui_impl_sdl2.h>
 
+#include <array>
 #include <cassert>
 #include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
 #include <glm/vec2.hpp>
+#include <iostream>
+#include <map>
+
+#include "cpu_profiler.h"
+
+#ifdef HEADLESS_EGL
+#include <EGL/eglext.h>
+#endif
 
 #ifdef TRACY_ENABLE
 #include "Tracy.hpp"
 #include "TracyC.h"
+#include "TracyOpenGL.hpp"
 #endif 
 
+namespace {
+
+using BenchmarkClock = std::chrono::steady_clock;
+
+float MillisecondsSince(const BenchmarkClock::time_point start) noexcept {
+  using milliseconds = std::chrono::duration<float, std::milli>;
+  return std::chrono::duration_cast<milliseconds>(BenchmarkClock::now() -
+                                                  start)
+      .count();
+}
+
+void AddCpuZones(std::map<std::string, double>& totals,
+                 const std::uint64_t begin, const std::uint64_t end) {
+  for (const auto& summary : CpuProfiler::Summarize(begin, end)) {
+    totals[summary.name] += summary.milliseconds;
+  }
+}
+
+}  // namespace
+
 void Engine::Run() {
   Begin();
+  if (benchmark_options_.is_enabled) {
+    RunBenchmark();
+    End();
+    return;
+  }
   bool isOpen = true;
 
-  std::chrono::time_point<std::chrono::system_clock> clock =
-      std::chrono::system_clock::now();
+  FrameClock::time_point clock = FrameClock::now();
   while (isOpen) {
-    const auto start = std::chrono::system_clock::now();
+    frame_pacer_.BeginFrame(frame_pacing_);
+    const CpuZone frame_zone("Frame");
+    const auto start = FrameClock::now();
     using seconds = std::chrono::duration<float, std::ratio<1, 1>>;
     const auto dt = std::chrono::duration_cast<seconds>(start - clock);
     clock = start;
@@ -123,6 +162,12 @@ void Engine::Run() {
       sm_.GetCamera().ProcessKeyboard(Direction::DOWN, dt.count());
     }
 
+    // The scene places the camera once loaded, the path starts after.
+    if (!camera_record_name_.empty() && sm_.GetScene().IsReady()) {
+      camera_path_.Record(camera_record_time_, sm_.GetCamera());
+      camera_record_time_ += dt.count();
+    }
+
     glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
@@ -134,19 +179,266 @@ void Engine::Run() {
     ImGui::NewFrame();
 
     sm_.DrawImGui();
-    
+    DrawFramePacing();
+
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
     SDL_GL_SwapWindow(window_);
+    frame_pacer_.EndFrame();
 #ifdef TRACY_ENABLE
     FrameMark;
+    TracyGpuCollect;
 #endif 
   }
   End();
 }
 
+void Engine::RunBenchmark() {
+  constexpr float kFrameDt = 1.f / 60.f;
+  // Flushes the CPU zones often enough that the rings never wrap.
+  constexpr int kCpuSummaryFrames = 16;
+  if (!benchmark_options_.camera_path.empty()) {
+    const std::string file = CameraPathFile(benchmark_options_.camera_path);
+    if (!camera_path_.Load(file)) {
+      std::cerr << "Can't load the camera path " << file << '\n';
+      return;
+    }
+  }
+  int frame_count = benchmark_options_.frame_count;
+  if (frame_count == 0) {
+    frame_count = camera_path_.empty()
+                      ? BenchmarkOptions::kDefaultFrameCount
+                      : static_cast<int>(std::ceil(camera_path_.duration() /
+                                                   kFrameDt)) +
+                            1;
+  }
+  // The camera of timed frame i is always the path at i * kFrameDt, two runs
+  // render the same frames whatever their speed.
+  const auto render_frame = [this](const float camera_time) {
+    const CpuZone frame_zone("Frame");
+    camera_path_.Apply(camera_time, sm_.GetCamera());
+    glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+    // A fixed step, the same frames are rendered whatever the speed.
+    sm_.UpdateScene(kFrameDt);
+    SwapBuffers();
+#ifdef TRACY_ENABLE
+    FrameMark;
+    TracyGpuCollect;
+#endif
+  };
+
+  // The scene loads its data over the first frames.
+  auto start = BenchmarkClock::now();
+  while (!sm_.GetScene().IsReady()) {
+    render_frame(0.f);
+  }
+  glFinish();
+  startup_phases_.push_back({"Scene loading", MillisecondsSince(start)});
+  sm_.GetScene().AddStartupPhases(startup_phases_);
+
+  start = BenchmarkClock::now();
+  for (int i = 0; i < benchmark_options_.warmup_frames; i++) {
+    render_frame(0.f);
+  }
+  glFinish();
+  startup_phases_.push_back({"Warmup", MillisecondsSince(start)});
+
+  GpuTimingHistory* gpu_timings = sm_.GetScene().gpu_timings();
+  if (gpu_timings != nullptr) {
+    gpu_timings->ResetSums();
+  }
+  BenchmarkReport report;
+  report.frame_milliseconds.reserve(frame_count);
+  std::map<std::string, double> cpu_totals;
+  std::uint64_t cpu_begin = CpuProfiler::Now();
+  for (int i = 0; i < frame_count; i++) {
+    start = BenchmarkClock::now();
+    render_frame(static_cast<float>(i) * kFrameDt);
+    // The last frame waits for the GPU, the frames before were throttled by
+    // the driver queue anyway.
+    if (i + 1 == frame_count) {
+      glFinish();
+    }
+    report.frame_milliseconds.push_back(MillisecondsSince(start));
+    if ((i + 1) % kCpuSummaryFrames == 0 || i + 1 == frame_count) {
+      const std::uint64_t cpu_end = CpuProfiler::Now();
+      AddCpuZones(cpu_totals, cpu_begin, cpu_end);
+      cpu_begin = cpu_end;
+    }
+  }
+
+  const auto* renderer =
+      reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+  report.renderer = renderer != nullptr ? renderer : "";
+  report.context = is_headless_ ? "EGL surfaceless" : "SDL hidden window";
+  report.camera_path = benchmark_options_.camera_path;
+  report.width = static_cast<int>(Metrics::width_);
+  report.height = static_cast<int>(Metrics::height_);
+  report.warmup_frames = benchmark_options_.warmup_frames;
+  report.startup_phases = startup_phases_;
+  for (const auto& [name, milliseconds] : cpu_totals) {
+    report.cpu_passes.push_back(
+        {name, static_cast<float>(milliseconds / frame_count)});
+  }
+  if (gpu_timings != nullptr) {
+    for (std::size_t zone = 0; zone < gpu_timings->zone_count(); zone++) {
+      report.gpu_passes.push_back(
+          {gpu_timings->zone_names()[zone], gpu_timings->Mean(zone)});
+    }
+  }
+
+  const FrameTimeStats stats = ComputeFrameTimeStats(report.frame_milliseconds);
+  std::cout << "Benchmark of " << stats.frame_count << " frames on "
+            << report.renderer << ": mean " << stats.mean << " ms, p99 "
+            << stats.p99 << " ms.\n";
+  if (WriteBenchmarkReport(benchmark_options_.report_path, report)) {
+    std::cout << "Benchmark report written to "
+              << benchmark_options_.report_path << '\n';
+  } else {
+    std::cerr << "Can't write the benchmark report "
+              << benchmark_options_.report_path << '\n';
+  }
+}
+
+void Engine::SwapBuffers() {
+#ifdef HEADLESS_EGL
+  if (is_headless_) {
+    eglSwapBuffers(egl_display_, egl_surface_);
+    return;
+  }
+#endif
+  SDL_GL_SwapWindow(window_);
+}
+
+bool Engine::CreateHeadlessContext() {
+#ifdef HEADLESS_EGL
+  // Mesa's surfaceless platform needs neither X nor a GPU, llvmpipe renders
+  // on it. The default display is the fallback of the other drivers.
+  const auto get_platform_display =
+      reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+          eglGetProcAddress("eglGetPlatformDisplayEXT"));
+  if (get_platform_display != nullptr) {
+    egl_display_ = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA,
+                                        EGL_DEFAULT_DISPLAY, nullptr);
+  }
+  if (egl_display_ == EGL_NO_DISPLAY) {
+    egl_display_ = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  }
+  EGLint major = 0;
+  EGLint minor = 0;
+  if (egl_display_ == EGL_NO_DISPLAY ||
+      !eglInitialize(egl_display_, &major, &minor)) {
+    std::cerr << "Can't initialize EGL\n";
+    egl_display_ = EGL_NO_DISPLAY;
+    return false;
+  }
+
+  constexpr EGLint kConfigAttributes[] = {
+      EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+      EGL_RED_SIZE,     8,               EGL_GREEN_SIZE,      8,
+      EGL_BLUE_SIZE,    8,               EGL_DEPTH_SIZE,      24,
+      EGL_STENCIL_SIZE, 8,               EGL_NONE};
+  EGLConfig config = nullptr;
+  EGLint config_count = 0;
+  if (!eglChooseConfig(egl_display_, kConfigAttributes, &config, 1,
+                       &config_count) ||
+      config_count == 0) {
+    std::cerr << "No EGL config with a pbuffer\n";
+    DestroyHeadlessContext();
+    return false;
+  }
+  // The scenes render to their own framebuffers, the pbuffer only stands in
+  // for the window framebuffer.
+  const EGLint surface_attributes[] = {
+      EGL_WIDTH, static_cast<EGLint>(Metrics::width_), EGL_HEIGHT,
+      static_cast<EGLint>(Metrics::height_), EGL_NONE};
+  egl_surface_ =
+      eglCreatePbufferSurface(egl_display_, config, surface_attributes);
+
+  constexpr EGLint kContextAttributes[] = {
+      EGL_CONTEXT_MAJOR_VERSION,       4,
+      EGL_CONTEXT_MINOR_VERSION,       5,
+      EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+      EGL_NONE};
+  if (egl_surface_ != EGL_NO_SURFACE && eglBindAPI(EGL_OPENGL_API)) {
+    egl_context_ = eglCreateContext(egl_display_, config, EGL_NO_CONTEXT,
+                                    kContextAttributes);
+  }
+  if (egl_context_ == EGL_NO_CONTEXT ||
+      !eglMakeCurrent(egl_display_, egl_surface_, egl_surface_,
+                      egl_context_)) {
+    std::cerr << "Can't create an OpenGL 4.5 EGL context\n";
+    DestroyHeadlessContext();
+    return false;
+  }
+  eglSwapInterval(egl_display_, 0);
+  return true;
+#else
+  return false;
+#endif
+}
+
+void Engine::DestroyHeadlessContext() {
+#ifdef HEADLESS_EGL
+  if (egl_display_ == EGL_NO_DISPLAY) {
+    return;
+  }
+  eglMakeCurrent(egl_display_, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                 EGL_NO_CONTEXT);
+  if (egl_context_ != EGL_NO_CONTEXT) {
+    eglDestroyContext(egl_display_, egl_context_);
+  }
+  if (egl_surface_ != EGL_NO_SURFACE) {
+    eglDestroySurface(egl_display_, egl_surface_);
+  }
+  eglTerminate(egl_display_);
+  egl_display_ = EGL_NO_DISPLAY;
+  egl_context_ = EGL_NO_CONTEXT;
+  egl_surface_ = EGL_NO_SURFACE;
+#endif
+}
+
 void Engine::Begin() {
+  const auto begin_start = BenchmarkClock::now();
+  CpuProfiler::SetThreadName("Main");
+  if (benchmark_options_.is_enabled) {
+    is_headless_ = CreateHeadlessContext();
+    if (!is_headless_) {
+      std::cout << "No headless context, the benchmark uses a hidden window\n";
+    }
+  }
+  if (!is_headless_) {
+    BeginWindow();
+  }
+  const GLenum glew_status = glewInit();
+  // GLEW built for GLX fails to find an X display under EGL, the GL
+  // functions are loaded nonetheless.
+  if (glew_status != GLEW_OK &&
+      !(is_headless_ && glew_status == GLEW_ERROR_NO_GLX_DISPLAY)) {
+    assert(false && "Failed to initialize OpenGL context");
+  }
+#ifdef TRACY_ENABLE
+  // The GPU zones of the scenes are sent to Tracy too.
+  TracyGpuContext;
+#endif
+  startup_phases_.push_back(
+      {"Context creation", MillisecondsSince(begin_start)});
+
+  // The benchmark measures the scene alone.
+  if (!benchmark_options_.is_enabled) {
+    BeginImGui();
+    frame_pacer_.Begin();
+  }
+
+  const auto scene_start = BenchmarkClock::now();
+  sm_.Setup();
+  sm_.BeginScene();
+  startup_phases_.push_back({"Scene begin", MillisecondsSince(scene_start)});
+}
+
+void Engine::BeginWindow() {
   SDL_Init(SDL_INIT_VIDEO | SDL_INIT_GAMECONTROLLER);
   // Set our OpenGL version.
 #if true
@@ -161,17 +453,71 @@ void Engine::Begin() {
 
   SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
   SDL_GL_SetAttribute(SDL_GL_STENCIL_SIZE, 8);
+  const Uint32 window_flags =
+      SDL_WINDOW_OPENGL |
+      (benchmark_options_.is_enabled ? SDL_WINDOW_HIDDEN : 0u);
   window_ = SDL_CreateWindow("Scenes", SDL_WINDOWPOS_UNDEFINED,
                              SDL_WINDOWPOS_UNDEFINED, Metrics::width_,
-                             Metrics::height_, SDL_WINDOW_OPENGL);
+                             Metrics::height_, window_flags);
   glRenderContext_ = SDL_GL_CreateContext(window_);
-  // setting vsync
-  SDL_GL_SetSwapInterval(1);
+  if (benchmark_options_.is_enabled) {
+    SDL_GL_SetSwapInterval(0);
+  } else {
+    ApplyPresentMode();
+  }
+}
 
-  if (GLEW_OK != glewInit()) {
-    assert(false && "Failed to initialize OpenGL context");
+void Engine::ApplyPresentMode() {
+  const int interval = PresentModeSwapInterval(frame_pacing_.present_mode);
+  // Adaptive vsync needs EXT_swap_control_tear, plain vsync is the closest.
+  if (SDL_GL_SetSwapInterval(interval) != 0 &&
+      frame_pacing_.present_mode == PresentMode::kAdaptiveVsync) {
+    std::cout << "Adaptive vsync isn't supported, using vsync instead\n";
+    frame_pacing_.present_mode = PresentMode::kVsync;
+    SDL_GL_SetSwapInterval(1);
+  }
+}
+
+void Engine::DrawFramePacing() {
+  const ImGuiIO& io = ImGui::GetIO();
+  ImGui::SetNextWindowPos(ImVec2(10.f, io.DisplaySize.y - 10.f),
+                          ImGuiCond_FirstUseEver, ImVec2(0.f, 1.f));
+  ImGui::SetNextWindowBgAlpha(0.6f);
+  if (!ImGui::Begin("Frame pacing", nullptr,
+                    ImGuiWindowFlags_AlwaysAutoResize)) {
+    ImGui::End();
+    return;
+  }
+  int present_mode = static_cast<int>(frame_pacing_.present_mode);
+  if (ImGui::Combo("Present mode", &present_mode, kPresentModeNames.data(),
+                   static_cast<int>(kPresentModeNames.size()))) {
+    frame_pacing_.present_mode = static_cast<PresentMode>(present_mode);
+    ApplyPresentMode();
+  }
+  ImGui::SliderFloat("Max FPS", &frame_pacing_.max_fps, 0.f, 240.f,
+                     frame_pacing_.max_fps > 0.f ? "%.0f" : "Uncapped");
+  ImGui::SliderInt("Frames in flight", &frame_pacing_.max_frames_in_flight,
+                   0, static_cast<int>(FramePacer::kMaxFramesInFlight),
+                   frame_pacing_.max_frames_in_flight > 0 ? "%d" : "Driver");
+  ImGui::Text("Limiter spin margin: %.2f ms",
+              std::chrono::duration<float, std::milli>(
+                  frame_pacer_.limiter().spin_margin())
+                  .count());
+
+  const GpuTimingHistory& history = frame_pacer_.history();
+  for (std::size_t zone = 0; zone < history.zone_count(); zone++) {
+    std::array<char, 48> overlay{};
+    std::snprintf(overlay.data(), overlay.size(), "%.2f ms, max %.2f ms",
+                  history.Average(zone), history.Max(zone));
+    ImGui::PlotLines(history.zone_names()[zone].c_str(), history.Values(zone),
+                     static_cast<int>(GpuTimingHistory::kFrameCount),
+                     history.offset(), overlay.data(), 0.f, history.Max(zone),
+                     ImVec2(240.f, 32.f));
   }
+  ImGui::End();
+}
 
+void Engine::BeginImGui() {
   // Setup Dear ImGui context
   IMGUI_CHECKVERSION();
   ImGui::CreateContext();
@@ -188,18 +534,44 @@ void Engine::Begin() {
   ImGui::StyleColorsDark();
   ImGui_ImplSDL2_InitForOpenGL(window_, glRenderContext_);
   ImGui_ImplOpenGL3_Init("#version 300 es");
-
-  sm_.Setup();
-  sm_.BeginScene();
 }
 
 void Engine::End() {
   sm_.EndScene();
+  sm_.ReleaseGpuMemory();
+
+  if (!benchmark_options_.is_enabled) {
+    frame_pacer_.End();
+    ImGui_ImplOpenGL3_Shutdown();
+    ImGui_ImplSDL2_Shutdown();
+    ImGui::DestroyContext();
+  }
+  if (is_headless_) {
+    DestroyHeadlessContext();
+  } else {
+    SDL_GL_DeleteContext(glRenderContext_);
+    SDL_DestroyWindow(window_);
+    SDL_Quit();
+  }
+
+  if (!benchmark_options_.is_enabled && !camera_path_.empty()) {
+    camera_path_.Finish(camera_record_time_, sm_.GetCamera());
+    const std::filesystem::path file = CameraPathFile(camera_record_name_);
+    std::error_code error;
+    std::filesystem::create_directories(file.parent_path(), error);
+    if (camera_path_.Save(file.string())) {
+      std::cout << "Camera path of " << camera_path_.duration()
+                << " s written to " << file.string() << '\n';
+    } else {
+      std::cerr << "Can't write the camera path " << file.string() << '\n';
+    }
+  }
 
-  ImGui_ImplOpenGL3_Shutdown();
-  ImGui_ImplSDL2_Shutdown();
-  ImGui::DestroyContext();
-  SDL_GL_DeleteContext(glRenderContext_);
-  SDL_DestroyWindow(window_);
-  SDL_Quit();
+  if (!cpu_trace_path_.empty()) {
+    if (CpuProfiler::WriteChromeTrace(cpu_trace_path_)) {
+      std::cout << "CPU trace written to " << cpu_trace_path_ << '\n';
+    } else {
+      std::cerr << "Can't write the CPU trace " << cpu_trace_path_ << '\n';
+    }
+  }
 }
@@ -1,27 +1,36 @@
 #include "final_scene.h"
 
+#include <algorithm>
+#include <bitset>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
 #include <thread>
+#include <utility>
 
-#ifdef TRACY_ENABLE
-#include <TracyC.h>
+#include "cpu_profiler.h"
 
-#include <Tracy.hpp>
+#ifdef TRACY_ENABLE
+#include <TracyOpenGL.hpp>
 #endif
 
 void FinalScene::Begin() {
-#ifdef TRACY_ENABLE
-  ZoneScoped;
-#endif
+  PROFILE_ZONE;
   glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
 
   LoadRessources();
 }
 
 void FinalScene::Update(float dt) {
-#ifdef TRACY_ENABLE
-  ZoneScoped;
-#endif
+  PROFILE_ZONE;
   is_frist_frame_ = false;
+  if (!are_scene_loads_queued_) {
+    if (!scene_description_job_.IsDone()) {
+      return;
+    }
+    QueueSceneLoads();
+  }
   while (!are_all_data_loaded_) {
     Job* job = nullptr;
 
@@ -41,22 +50,30 @@ void FinalScene::Update(float dt) {
 
   if (!is_initialized_) {
     job_system_.JoinWorkers();
-    cube_.SetCube();
-    cube_ground_.SetCube(30, {1, 0.1});
-    quad_screen_.SetQuad(2);
-    sphere_.SetSphere();
+    cube_.SetCube(*buffer_pool_);
+    cube_ground_.SetCube(*buffer_pool_, 30, {1, 0.1});
+    quad_screen_.SetQuad(*buffer_pool_, 2);
+    sphere_.SetSphere(*buffer_pool_);
+
+    ApplySceneDescription();
+    BeginCulling();
+    gpu_profiler_.Begin({kGpuZoneNames.begin(), kGpuZoneNames.end()});
+    // The shadow bake draws with frame data too.
+    frame_ring_.Begin();
+    frame_ring_.BeginFrame();
 
     BeginBloom();
     BeginSkyBox();
-    CreateIrradianceMap();
-    CreatePrefilterMap();
-    CreateBRDF();
+    BeginIbl();
     BeginLamp();
 
     BeginGBuffer();
     BeginSSAO();
     BeginPBR();
+    BeginClusteredLights();
     BeginShadowMap();
+    BuildRenderGraph();
+    frame_ring_.EndFrame();
 
     glViewport(0, 0, Metrics::width_, Metrics::height_);
     camera_ = (glm::vec3(0.0f, 2.0f, 0.0f));
@@ -65,48 +82,88 @@ void FinalScene::Update(float dt) {
     return;
   }
 
+  gpu_profiler_.BeginFrame();
+  frame_ring_.BeginFrame();
   view = camera_.GetViewMatrix();
-  projection =
-      glm::perspective(glm::radians(camera_.zoom_),
-                       Metrics::width_ / Metrics::height_, 0.1f, 100.0f);
+  projection = glm::perspective(glm::radians(camera_.zoom_),
+                                Metrics::width_ / Metrics::height_,
+                                kCameraNearPlane, kCameraFarPlane);
   glEnable(GL_DEPTH_TEST);
   glDepthFunc(GL_LESS);
   glEnable(GL_CULL_FACE);
   glCullFace(GL_BACK);
 
-  glBindFramebuffer(GL_FRAMEBUFFER, hdr_fbo_);
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  UpdateDynamicObjects(dt);
+  UpdateClusteredLights(dt);
+  UpdateShadowMap(shadow_face_budget_);
+
+  if (ssao_preset_index_ != ssao_current_preset_index_) {
+    ApplySsaoPreset();
+  }
+  if (IsRenderGraphStale()) {
+    BuildRenderGraph();
+  }
 
   UpdateGBuffer();
   UpdateSSAO();
   UpdatePBR();
-  glBindFramebuffer(GL_READ_FRAMEBUFFER, g_buffer_);
-  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, hdr_fbo_);
-  glBlitFramebuffer(0, 0, Metrics::width_, Metrics::height_, 0, 0,
-                    Metrics::width_, Metrics::height_, GL_DEPTH_BUFFER_BIT,
-                    GL_NEAREST);
+  // The lamp and the skybox test against the g-buffer depth, no copy.
+  glBindFramebuffer(GL_FRAMEBUFFER, hdr_fbo_);
   UpdateLamp();
   UpdateSkyBox();
   UpdateBloom();
+  UpdatePostStack();
+  frame_ring_.EndFrame();
 }
+void FinalScene::AddStartupPhases(
+    std::vector<BenchmarkTiming>& phases) const {
+  phases.push_back({ibl_report_.is_hit ? "IBL cache load" : "IBL bake",
+                    ibl_report_.milliseconds});
+}
+
 void FinalScene::End() {
   glDisable(GL_DEPTH_TEST);
   glDisable(GL_CULL_FACE);
   DeleteLamp();
-  DeleteGround();
-  DeleteModels();
+  DeleteObjects();
   DeleteSkyBox();
   DeleteBloom();
   DeletePBR();
+  DeleteClusteredLights();
   DeleteGBuffer();
   DeleteSSAO();
+  DeleteRenderGraph();
   DeleteShadowMap();
+  frame_ring_.End();
+  gpu_profiler_.End();
+
+  cube_.Delete();
+  cube_ground_.Delete();
+  quad_screen_.Delete();
+  sphere_.Delete();
+
+  job_system_.StopComputeWorkers();
+  culling_set_.Clear();
+
+  read_jobs_.clear();
+  unpack_jobs_.clear();
+  decom_jobs_.clear();
+  gpu_jobs_.clear();
+  model_import_jobs_.clear();
+  model_upload_jobs_.clear();
+  asset_archive_.Close();
+  glDeleteTextures(static_cast<GLsizei>(scene_textures_.size()),
+                   scene_textures_.data());
+  scene_textures_.clear();
+  scene_texture_buffers_.clear();
+  scene_files_.clear();
+  are_scene_loads_queued_ = false;
+  are_all_data_loaded_ = false;
+  is_initialized_ = false;
 }
 
 void FinalScene::BeginSkyBox() {
-#ifdef TRACY_ENABLE
-  ZoneScoped;
-#endif
+  PROFILE_ZONE;
   background_pipe_.LoadShader("data/shaders/final/skybox.vert",
                               "data/shaders/final/skybox.frag");
   background_pipe_.LoadProgram();
@@ -114,33 +171,6 @@ void FinalScene::BeginSkyBox() {
   background_pipe_.Bind();
   background_pipe_.SetInt("environmentMap", 0);
 
-  // buffers
-  glGenFramebuffers(1, &captureFBO);
-  glGenRenderbuffers(1, &captureRBO);
-
-  glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-  glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 4096, 4096);
-  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
-                            GL_RENDERBUFFER, captureRBO);
-
-  hdr_cubemap_ = tm_.LoadHDR("data/textures/final/peter.hdr");
-
-  // pbr: setup cubemap to render to and attach to framebuffer
-  // ---------------------------------------------------------
-
-  glGenTextures(1, &env_cubemap_);
-  glBindTexture(GL_TEXTURE_CUBE_MAP, env_cubemap_);
-  for (unsigned int i = 0; i < 6; ++i) {
-    glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 4096, 4096,
-                 0, GL_RGB, GL_FLOAT, nullptr);
-  }
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
   // pbr: set up projection and view matrices for capturing data onto the 6
   // cubemap face directions
   // ----------------------------------------------------------------------------------------------
@@ -158,39 +188,11 @@ void FinalScene::BeginSkyBox() {
                   glm::vec3(0.0f, -1.0f, 0.0f)),
       glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f),
                   glm::vec3(0.0f, -1.0f, 0.0f))};
-
-  // pbr: convert HDR equirectangular environment map to cubemap equivalent
-  // ----------------------------------------------------------------------
-  cubemap_pipe_.LoadShader("data/shaders/pbr/cubemap.vert",
-                           "data/shaders/pbr/cubemap.frag");
-  cubemap_pipe_.LoadProgram();
-
-  cubemap_pipe_.Bind();
-
-  cubemap_pipe_.SetInt("equirectangularMap", 0);
-  cubemap_pipe_.SetMat4("projection", captureProjection);
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, hdr_cubemap_);
-
-  glViewport(0, 0, 4096, 4096);  // don't forget to configure the viewport to
-                                 // the
-                                 // capture dimensions.
-  glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-  for (unsigned int i = 0; i < 6; ++i) {
-    cubemap_pipe_.SetMat4("view", captureViews[i]);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-                           GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, env_cubemap_, 0);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    cube_.Draw();
-  }
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 void FinalScene::UpdateSkyBox() {
-#ifdef TRACY_ENABLE
-  ZoneScoped;
-#endif
+  PROFILE_ZONE;
+  GPU_PROFILE_ZONE(gpu_profiler_, kGpuZoneSkyBox);
   glDepthFunc(GL_LEQUAL);  // set depth function to less than AND equal for
                            // skybox depth trick.
   glEnable(GL_CULL_FACE);
@@ -207,74 +209,110 @@ void FinalScene::UpdateSkyBox() {
 
 void FinalScene::DeleteSkyBox() { cubemap_pipe_.Delete(); }
 
-void FinalScene::CreateIrradianceMap() {
-#ifdef TRACY_ENABLE
-  ZoneScoped;
-#endif
-  // pbr: create an irradiance cubemap, and re-scale capture FBO to irradiance
-  // scale.
-  // --------------------------------------------------------------------------------
-  irradianceMap;
-  glGenTextures(1, &irradianceMap);
-  glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
-  for (unsigned int i = 0; i < 6; ++i) {
-    glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 32, 32, 0,
-                 GL_RGB, GL_FLOAT, nullptr);
+void FinalScene::CreateEnvironmentMap(const HdrImage& image) {
+  PROFILE_ZONE;
+  // buffers
+  // The cube is seen from its center, no face hides another: the captures
+  // need no depth buffer.
+  glGenFramebuffers(1, &captureFBO);
+
+  hdr_cubemap_ = tm_.UploadHDR(image);
+
+  // pbr: setup cubemap to render to and attach to framebuffer
+  // ---------------------------------------------------------
+
+  glGenTextures(1, &env_cubemap_);
+  glBindTexture(GL_TEXTURE_CUBE_MAP, env_cubemap_);
+  const auto size = static_cast<GLsizei>(environment_size_);
+  const std::uint32_t level_count = EnvironmentLevelCount();
+  for (std::uint32_t level = 0; level < level_count; ++level) {
+    for (unsigned int i = 0; i < 6; ++i) {
+      glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
+                   static_cast<GLint>(level), kEnvironmentFormat,
+                   std::max(size >> level, 1), std::max(size >> level, 1), 0,
+                   GL_RGB, GL_FLOAT, nullptr);
+    }
   }
   glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
   glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
   glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER,
+                  level_count > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
   glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL,
+                  static_cast<GLint>(level_count) - 1);
 
-  glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-  glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 32, 32);
-
-  // pbr: solve diffuse integral by convolution to create an irradiance
-  // (cube)map.
-  // -----------------------------------------------------------------------------
-
-  irradiance_pipe_.LoadShader("data/shaders/pbr/cubemap.vert",
-                              "data/shaders/pbr/irradiance.frag");
+  // pbr: convert HDR equirectangular environment map to cubemap equivalent
+  // ----------------------------------------------------------------------
+  cubemap_pipe_.LoadShader("data/shaders/pbr/cubemap.vert",
+                           "data/shaders/pbr/cubemap.frag");
+  cubemap_pipe_.LoadProgram();
 
-  irradiance_pipe_.LoadProgram();
+  cubemap_pipe_.Bind();
 
-  irradiance_pipe_.Bind();
-  irradiance_pipe_.SetInt("environmentMap", 0);
-  irradiance_pipe_.SetMat4("projection", captureProjection);
+  cubemap_pipe_.SetInt("equirectangularMap", 0);
+  cubemap_pipe_.SetMat4("projection", captureProjection);
   glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_CUBE_MAP, env_cubemap_);
+  glBindTexture(GL_TEXTURE_2D, hdr_cubemap_);
 
-  glViewport(
-      0, 0, 32,
-      32);  // don't forget to configure the viewport to the capture dimensions.
+  glViewport(0, 0, size, size);  // don't forget to configure the viewport to
+                                 // the
+                                 // capture dimensions.
   glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
   for (unsigned int i = 0; i < 6; ++i) {
-    irradiance_pipe_.SetMat4("view", captureViews[i]);
+    cubemap_pipe_.SetMat4("view", captureViews[i]);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-                           GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, irradianceMap,
-                           0);
+                           GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, env_cubemap_, 0);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     cube_.Draw();
   }
   glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  if (level_count > 1) {
+    // Filtered skybox minification and cheaper prefilter samples.
+    glBindTexture(GL_TEXTURE_CUBE_MAP, env_cubemap_);
+    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+  }
+}
+
+void FinalScene::ProjectIrradiance(const HdrImage& image) {
+  PROFILE_ZONE;
+  irradiance_sh_ = sh_projector_.Project(
+      job_system_, ShImage{image.texels.data(), image.width, image.height});
+}
+
+void FinalScene::UploadIrradianceSh() {
+  const auto packed = irradiance_sh_.Std140();
+  if (irradiance_sh_ubo_ == 0) {
+    glGenBuffers(1, &irradiance_sh_ubo_);
+    glBindBuffer(GL_UNIFORM_BUFFER, irradiance_sh_ubo_);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(packed), packed.data(),
+                 GL_DYNAMIC_DRAW);
+  } else {
+    glBindBuffer(GL_UNIFORM_BUFFER, irradiance_sh_ubo_);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(packed), packed.data());
+  }
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  glBindBufferBase(GL_UNIFORM_BUFFER, kIrradianceShBinding,
+                   irradiance_sh_ubo_);
 }
 
 void FinalScene::CreatePrefilterMap() {
-#ifdef TRACY_ENABLE
-  ZoneScoped;
-#endif
+  PROFILE_ZONE;
   // pbr: create a pre-filter cubemap, and re-scale capture FBO to
   // pre-filter scale.
   // --------------------------------------------------------------------------------
 
   glGenTextures(1, &prefilterMap);
   glBindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap);
-  for (unsigned int i = 0; i < 6; ++i) {
-    glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 128, 128, 0,
-                 GL_RGB, GL_FLOAT, nullptr);
+  // Only the sampled mips are allocated.
+  for (unsigned int mip = 0; mip < kPrefilterMipCount; ++mip) {
+    for (unsigned int i = 0; i < 6; ++i) {
+      glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, static_cast<GLint>(mip),
+                   kEnvironmentFormat, kPrefilterSize >> mip,
+                   kPrefilterSize >> mip, 0, GL_RGB, GL_FLOAT, nullptr);
+    }
   }
   glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
   glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
@@ -283,9 +321,8 @@ void FinalScene::CreatePrefilterMap() {
                   GL_LINEAR_MIPMAP_LINEAR);  // be sure to set minification
                                              // filter to mip_linear
   glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  // generate mipmaps for the cubemap so OpenGL automatically allocates the
-  // required memory.
-  glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL,
+                  kPrefilterMipCount - 1);
 
   // pbr: run a quasi monte-carlo simulation on the environment lighting to
   // create a prefilter (cube)map.
@@ -299,19 +336,19 @@ void FinalScene::CreatePrefilterMap() {
   prefilter_pipe_.Bind();
   prefilter_pipe_.SetInt("environmentMap", 0);
   prefilter_pipe_.SetMat4("projection", captureProjection);
+  prefilter_pipe_.SetFloat("environmentResolution",
+                           static_cast<float>(environment_size_));
+  prefilter_pipe_.SetFloat("environmentMaxLevel",
+                           static_cast<float>(EnvironmentLevelCount() - 1));
   glActiveTexture(GL_TEXTURE0);
   glBindTexture(GL_TEXTURE_CUBE_MAP, env_cubemap_);
 
   glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-  unsigned int maxMipLevels = 5;
+  unsigned int maxMipLevels = kPrefilterMipCount;
   for (unsigned int mip = 0; mip < maxMipLevels; ++mip) {
     // reisze framebuffer according to mip-level size.
-    unsigned int mipWidth = static_cast<unsigned int>(128 * std::pow(0.5, mip));
-    unsigned int mipHeight =
-        static_cast<unsigned int>(128 * std::pow(0.5, mip));
-    glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, mipWidth,
-                          mipHeight);
+    unsigned int mipWidth = kPrefilterSize >> mip;
+    unsigned int mipHeight = kPrefilterSize >> mip;
     glViewport(0, 0, mipWidth, mipHeight);
 
     float roughness = (float)mip / (float)(maxMipLevels - 1);
@@ -330,9 +367,7 @@ void FinalScene::CreatePrefilterMap() {
 }
 
 void FinalScene::CreateBRDF() {
-#ifdef TRACY_ENABLE
-  ZoneScoped;
-#endif
+  PROFILE_ZONE;
   // pbr: generate a 2D LUT from the BRDF equations used.
   // ----------------------------------------------------
 
@@ -340,7 +375,8 @@ void FinalScene::CreateBRDF() {
 
   // pre-allocate enough memory for the LUT texture.
   glBindTexture(GL_TEXTURE_2D, brdfLUTTexture);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, 1024, 1024, 0, GL_RG, GL_FLOAT, 0);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, kBrdfLutSize, kBrdfLutSize, 0,
+               GL_RG, GL_FLOAT, 0);
   // be sure to set wrapping mode to GL_CLAMP_TO_EDGE
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
@@ -350,12 +386,10 @@ void FinalScene::CreateBRDF() {
   // then re-configure capture framebuffer object and render screen-space quad
   // with BRDF shader.
   glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-  glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 1024, 1024);
   glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
                          brdfLUTTexture, 0);
 
-  glViewport(0, 0, 1024, 1024);
+  glViewport(0, 0, kBrdfLutSize, kBrdfLutSize);
 
   brdf_pipe_.LoadShader("data/shaders/pbr/brdf.vert",
                         "data/shaders/pbr/brdf.frag");
@@ -371,24 +405,201 @@ void FinalScene::CreateBRDF() {
   glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
+void FinalScene::BeginIbl() {
+  PROFILE_ZONE;
+  const auto start = std::chrono::steady_clock::now();
+  const auto elapsed_milliseconds = [&start]() {
+    return std::chrono::duration<float, std::milli>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+  };
+
+  int source_width = 0, source_height = 0;
+  tm_.ReadImageSize(kIblSourcePath, source_width, source_height);
+  environment_size_ = EnvironmentCaptureSize(
+      static_cast<std::uint32_t>(source_width), Metrics::height_,
+      glm::radians(camera_.zoom_), kMinEnvironmentSize, kMaxEnvironmentSize);
+  const std::array<std::uint32_t, 2> settings = {environment_size_,
+                                                 EnvironmentLevelCount()};
+
+  const IblCacheKey key{
+      HashFiles({kIblSourcePath}),
+      HashFiles({"data/shaders/pbr/cubemap.vert",
+                 "data/shaders/pbr/cubemap.frag",
+                 "data/shaders/pbr/prefilter.frag",
+                 "data/shaders/pbr/brdf.vert", "data/shaders/pbr/brdf.frag"}),
+      HashBytes(settings.data(), sizeof(settings))};
+  IblCache cache;
+  ibl_report_ = IblCacheReport{};
+  ibl_report_.is_hit = LoadIblCache(kIblCachePath, key, cache);
+  if (ibl_report_.is_hit) {
+    CreateIblTextures(cache);
+    for (int i = 0; i < ShIrradiance::kCoefficientCount; i++) {
+      irradiance_sh_.coefficients[i] =
+          glm::vec3(cache.irradiance_sh[i * 3], cache.irradiance_sh[i * 3 + 1],
+                    cache.irradiance_sh[i * 3 + 2]);
+    }
+  } else {
+    const HdrImage image = tm_.LoadHDRImage(kIblSourcePath);
+    CreateEnvironmentMap(image);
+    ProjectIrradiance(image);
+    CreatePrefilterMap();
+    CreateBRDF();
+    // The draws are only queued, wait for them to time the bake.
+    glFinish();
+    cache.key = key;
+    cache.bake_milliseconds = elapsed_milliseconds();
+    for (int i = 0; i < ShIrradiance::kCoefficientCount; i++) {
+      cache.irradiance_sh[i * 3] = irradiance_sh_.coefficients[i].x;
+      cache.irradiance_sh[i * 3 + 1] = irradiance_sh_.coefficients[i].y;
+      cache.irradiance_sh[i * 3 + 2] = irradiance_sh_.coefficients[i].z;
+    }
+    ReadBackIbl(cache);
+    ibl_report_.is_saved = SaveIblCache(kIblCachePath, cache);
+  }
+  UploadIrradianceSh();
+  ibl_report_.milliseconds = elapsed_milliseconds();
+  ibl_report_.bake_milliseconds = cache.bake_milliseconds;
+  ibl_report_.byte_size = cache.byte_size();
+
+  // What the GPU holds, the bake intermediates only exist on a cache miss.
+  ibl_memory_.Clear();
+  ibl_memory_.Add("Environment cubemap",
+                  TextureByteSize(environment_size_, environment_size_,
+                                  kEnvironmentTexelBytes, 6,
+                                  EnvironmentLevelCount()));
+  ibl_memory_.Add("Prefilter cubemap",
+                  TextureByteSize(kPrefilterSize, kPrefilterSize,
+                                  kEnvironmentTexelBytes, 6,
+                                  kPrefilterMipCount));
+  ibl_memory_.Add("BRDF LUT", TextureByteSize(kBrdfLutSize, kBrdfLutSize, 4));
+  ibl_memory_.Add("Irradiance SH buffer", sizeof(glm::vec4) * 9);
+  if (!ibl_report_.is_hit) {
+    ibl_memory_.Add("HDR source",
+                    TextureByteSize(static_cast<std::uint32_t>(source_width),
+                                    static_cast<std::uint32_t>(source_height),
+                                    6));
+    if (free_ibl_intermediates_) {
+      DeleteIblIntermediates();
+      ibl_memory_.MarkFreed("HDR source");
+    }
+  }
+
+  if (ibl_report_.is_hit) {
+    std::cout << "IBL loaded from " << kIblCachePath << " in "
+              << ibl_report_.milliseconds << " ms instead of "
+              << ibl_report_.bake_milliseconds << " ms, saved "
+              << ibl_report_.SavedMilliseconds() << " ms.\n";
+  } else {
+    std::cout << "IBL baked in " << ibl_report_.bake_milliseconds << " ms, "
+              << (ibl_report_.is_saved ? "cached" : "failed to cache")
+              << " in " << kIblCachePath << ".\n";
+  }
+  std::cout << "IBL environment " << environment_size_ << "x"
+            << environment_size_ << ", "
+            << ToMegabytes(ibl_memory_.ResidentBytes()) << " MB resident, "
+            << ToMegabytes(ibl_memory_.FreedBytes()) << " MB freed.\n";
+}
+
+void FinalScene::DeleteIblIntermediates() {
+  glDeleteTextures(1, &hdr_cubemap_);
+  hdr_cubemap_ = 0;
+  glDeleteFramebuffers(1, &captureFBO);
+  captureFBO = 0;
+  cubemap_pipe_.Delete();
+  prefilter_pipe_.Delete();
+  brdf_pipe_.Delete();
+}
+
+namespace {
+
+GLuint IblUploadTexture(const IblTexture& texture) {
+  const bool is_cubemap = texture.face_count == 6;
+  const GLenum target = is_cubemap ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+  const GLenum format = texture.channel_count == 2 ? GL_RG : GL_RGB;
+  const GLint internal_format =
+      texture.channel_count == 2 ? GL_RG16F : GL_R11F_G11F_B10F;
+
+  GLuint id;
+  glGenTextures(1, &id);
+  glBindTexture(target, id);
+  for (std::uint32_t level = 0; level < texture.level_count; level++) {
+    for (std::uint32_t face = 0; face < texture.face_count; face++) {
+      glTexImage2D(is_cubemap ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : target,
+                   static_cast<GLint>(level), internal_format,
+                   static_cast<GLsizei>(texture.LevelWidth(level)),
+                   static_cast<GLsizei>(texture.LevelHeight(level)), 0, format,
+                   GL_HALF_FLOAT, texture.Image(level, face));
+    }
+  }
+  glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+  glTexParameteri(target, GL_TEXTURE_MIN_FILTER,
+                  texture.level_count > 1 ? GL_LINEAR_MIPMAP_LINEAR
+                                          : GL_LINEAR);
+  glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(target, GL_TEXTURE_MAX_LEVEL,
+                  static_cast<GLint>(texture.level_count) - 1);
+  return id;
+}
+
+void IblReadBackTexture(const GLuint id, const GLenum target,
+                        IblTexture& texture) {
+  const bool is_cubemap = target == GL_TEXTURE_CUBE_MAP;
+  const GLenum format = texture.channel_count == 2 ? GL_RG : GL_RGB;
+  glBindTexture(target, id);
+  for (std::uint32_t level = 0; level < texture.level_count; level++) {
+    for (std::uint32_t face = 0; face < texture.face_count; face++) {
+      glGetTexImage(is_cubemap ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : target,
+                    static_cast<GLint>(level), format, GL_HALF_FLOAT,
+                    texture.Image(level, face));
+    }
+  }
+}
+
+}  // namespace
+
+void FinalScene::CreateIblTextures(const IblCache& cache) {
+  PROFILE_ZONE;
+  env_cubemap_ = IblUploadTexture(cache.textures[IblCache::kEnvironment]);
+  prefilterMap = IblUploadTexture(cache.textures[IblCache::kPrefilter]);
+  brdfLUTTexture = IblUploadTexture(cache.textures[IblCache::kBrdfLut]);
+}
+
+void FinalScene::ReadBackIbl(IblCache& cache) const {
+  PROFILE_ZONE;
+  // Same sizes as the Create functions, the prefilter mips past the
+  // sampled ones are not kept.
+  auto& textures = cache.textures;
+  textures[IblCache::kEnvironment].Resize(environment_size_, environment_size_,
+                                          3, 6, EnvironmentLevelCount());
+  textures[IblCache::kPrefilter].Resize(kPrefilterSize, kPrefilterSize, 3, 6,
+                                        kPrefilterMipCount);
+  textures[IblCache::kBrdfLut].Resize(kBrdfLutSize, kBrdfLutSize, 2, 1, 1);
+  IblReadBackTexture(env_cubemap_, GL_TEXTURE_CUBE_MAP,
+                     textures[IblCache::kEnvironment]);
+  IblReadBackTexture(prefilterMap, GL_TEXTURE_CUBE_MAP,
+                     textures[IblCache::kPrefilter]);
+  IblReadBackTexture(brdfLUTTexture, GL_TEXTURE_2D,
+                     textures[IblCache::kBrdfLut]);
+}
+
 void FinalScene::BeginLamp() {
-#ifdef TRACY_ENABLE
-  ZoneScoped;
-#endif
+  PROFILE_ZONE;
   light_cube_.LoadShader("data/shaders/final/lamp.vert",
                          "data/shaders/final/lamp.frag");
   light_cube_.LoadProgram();
 }
 
 void FinalScene::UpdateLamp() {
-#ifdef TRACY_ENABLE
-  ZoneScoped;
-#endif
+  PROFILE_ZONE;
+  GPU_PROFILE_ZONE(gpu_profiler_, kGpuZoneLamp);
   light_cube_.Bind();
   light_cube_.SetMat4("projection", projection);
   light_cube_.SetMat4("view", view);
   model = glm::mat4(1.0f);
-  model = glm::translate(model, lamp_pos_);
+  model = glm::translate(model, main_light().position);
   model = glm::scale(model, glm::vec3(0.3f));  // a smaller cube
   light_cube_.SetMat4("model", model);
 
@@ -397,28 +608,8 @@ void FinalScene::UpdateLamp() {
 
 void FinalScene::DeleteLamp() { light_cube_.Delete(); }
 
-void FinalScene::UpdateGround(Pipeline& pipeline) {
-#ifdef TRACY_ENABLE
-  ZoneScoped;
-#endif
-  ground_mat_.Set();
-
-  model = glm::mat4(1.0f);
-  model = glm::translate(model, glm::vec3(0, -2.45, 0));
-  model = glm::scale(model, glm::vec3(1, 0.1, 1));
-  pipeline.SetMat4("model", model);
-  pipeline.SetMat4("normalMatrix",
-                   glm::transpose(glm::inverse(glm::mat4(view * model))));
-
-  cube_ground_.Draw();
-}
-
-void FinalScene::DeleteGround() { ground_mat_.Clear(); }
-
 void FinalScene::BeginGBuffer() {
-#ifdef TRACY_ENABLE
-  ZoneScoped;
-#endif
+  PROFILE_ZONE;
   geom_pipe_.LoadShader("data/shaders/Final/g_buffer.vert",
                         "data/shaders/Final/g_buffer.frag");
 
@@ -430,66 +621,28 @@ void FinalScene::BeginGBuffer() {
   geom_pipe_.SetInt("metallicMap", 2);
   geom_pipe_.SetInt("roughnessMap", 3);
   geom_pipe_.SetInt("aoMap", 4);
+  geom_pipe_.SetUniformBlockBinding("ObjectBlock", kObjectBlockBinding);
 
   // configure g-buffer framebuffer
   // ------------------------------
+  // The position is reconstructed from the depth, the normal is octahedral
+  // encoded and metallic, roughness and AO share a target: 16 bytes per
+  // pixel instead of 24.
+  // The targets come from the render graph.
   glGenFramebuffers(1, &g_buffer_);
   glBindFramebuffer(GL_FRAMEBUFFER, g_buffer_);
 
-  // position color buffer
-  glGenTextures(1, &pos_map_);
-  glBindTexture(GL_TEXTURE_2D, pos_map_);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, Metrics::width_, Metrics::height_,
-               0, GL_RGBA, GL_FLOAT, NULL);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
-                         pos_map_, 0);
-
-  // normal color buffer
-  glGenTextures(1, &normal_map_);
-  glBindTexture(GL_TEXTURE_2D, normal_map_);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, Metrics::width_, Metrics::height_,
-               0, GL_RGBA, GL_FLOAT, NULL);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D,
-                         normal_map_, 0);
-
-  // color + specular color buffer
-  glGenTextures(1, &albedo_map_);
-  glBindTexture(GL_TEXTURE_2D, albedo_map_);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, Metrics::width_, Metrics::height_, 0,
-               GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D,
-                         albedo_map_, 0);
-
   // tell OpenGL which color attachments we'll use (of this framebuffer) for
   // rendering
   static constexpr std::array<GLuint, 3> attachments = {
       GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2};
   glDrawBuffers(3, attachments.data());
-
-  // create and attach depth buffer (renderbuffer)
-  glGenRenderbuffers(1, &depth_rbo_);
-  glBindRenderbuffer(GL_RENDERBUFFER, depth_rbo_);
-  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, Metrics::width_,
-                        Metrics::height_);
-  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
-                            GL_RENDERBUFFER, depth_rbo_);
-
-  // finally check if framebuffer is complete
-  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-    std::cout << "Framebuffer not complete!" << std::endl;
   glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 void FinalScene::UpdateGBuffer() {
-#ifdef TRACY_ENABLE
-  ZoneScoped;
-#endif
+  PROFILE_ZONE;
+  GPU_PROFILE_ZONE(gpu_profiler_, kGpuZoneGBuffer);
   geom_pipe_.Bind();
   geom_pipe_.SetMat4("view", view);
   geom_pipe_.SetMat4("projection", projection);
@@ -497,46 +650,94 @@ void FinalScene::UpdateGBuffer() {
   glBindFramebuffer(GL_FRAMEBUFFER, g_buffer_);
   glClearColor(0, 0, 0, 1);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  UpdateGround(geom_pipe_);
-  UpdateModels(geom_pipe_);
-  UpdateSpheres(geom_pipe_);
+  // (0.5, 0.5) decodes to a normal facing the camera.
+  static constexpr std::array<GLfloat, 4> kClearNormal = {0.5f, 0.5f, 0.f,
+                                                          0.f};
+  glClearBufferfv(GL_COLOR, 0, kClearNormal.data());
+  CullObjects(projection * view, camera_culling_stats_);
+  CollectGBufferDraws();
+  g_buffer_command_stats_ = g_buffer_recorder_.Record(
+      job_system_, g_buffer_draws_.size(), command_backend_.uniform_alignment(),
+      [this](CommandBuffer& commands, const std::size_t begin,
+             const std::size_t end) {
+        RecordGBufferDraws(commands, begin, end);
+      });
+  const auto replay_start = std::chrono::steady_clock::now();
+  ReplayCommandBuffers(g_buffer_recorder_.buffers(), command_backend_);
+  g_buffer_command_stats_.replay_milliseconds =
+      std::chrono::duration<float, std::milli>(
+          std::chrono::steady_clock::now() - replay_start)
+          .count();
+}
+
+void FinalScene::CollectGBufferDraws() {
+  PROFILE_ZONE;
+  g_buffer_draws_.clear();
+  // Same order as the immediate draws of the shadow pass.
+  for (const auto& object : scene_objects_) {
+    if (!IsObjectVisible(object)) {
+      continue;
+    }
+    if (object.model == nullptr) {
+      object.mesh->SyncAttributes();
+      g_buffer_draws_.push_back(
+          {object.mesh, object.material, object.entity, object.is_sphere});
+      continue;
+    }
+    Model& model = *object.model;
+    model.SyncAttributes();
+    const std::uint8_t* visibility = ObjectVisibility(object);
+    const std::uint32_t* entities =
+        entry_entities_.data() + object.first_entry;
+    for (std::size_t i = 0; i < model.meshes().size(); i++) {
+      if (visibility[i]) {
+        g_buffer_draws_.push_back(
+            {&model.meshes()[i], object.material, entities[i], false});
+      }
+    }
+  }
+}
+
+void FinalScene::RecordGBufferDraws(CommandBuffer& commands,
+                                    const std::size_t begin,
+                                    const std::size_t end) const {
+  PROFILE_ZONE;
+  // The meshes of a node share its uniforms.
+  auto uniforms_entity = TransformStore::kNoParent;
+  for (std::size_t i = begin; i < end; i++) {
+    const GBufferDraw& draw = g_buffer_draws_[i];
+    commands.BindPipeline(geom_pipe_.program());
+    const Material& material = *draw.material;
+    // Units of the samplers set in BeginGBuffer.
+    const std::array<std::uint32_t, 5> textures = {
+        material.albedo, material.normal, material.metallic,
+        material.roughness, material.ao};
+    commands.BindTextures(0, textures.data(),
+                          static_cast<std::uint32_t>(textures.size()));
+    if (draw.entity != uniforms_entity) {
+      uniforms_entity = draw.entity;
+      commands.SetUniforms(
+          kObjectBlockBinding,
+          DrawUniforms{transforms_.world(draw.entity),
+                       transforms_.normal_matrix(draw.entity)});
+    }
+    commands.DrawIndexed(draw.mesh->DrawCommand(draw.is_sphere));
+  }
 }
 
 void FinalScene::DeleteGBuffer() {
   geom_pipe_.Delete();
-  glDeleteRenderbuffers(1, &depth_rbo_);
+  g_buffer_draws_.clear();
+  glDeleteFramebuffers(1, &g_buffer_);
   g_buffer_ = 0;
-  pos_map_ = 0;
-  normal_map_ = 0;
-  albedo_map_ = 0;
-  depth_rbo_ = 0;
 }
 
 void FinalScene::BeginSSAO() {
-#ifdef TRACY_ENABLE
-  ZoneScoped;
-#endif
-  // generate sample kernel
-  // ----------------------
+  PROFILE_ZONE;
   std::uniform_real_distribution<GLfloat> random_floats(0.0, 1.0);
   // generates random floats between 0.0 and 1.0
   std::default_random_engine generator;
 
-  for (GLuint i = 0; i < kSsaoKernelSampleCount_; i++) {
-    glm::vec3 sample(random_floats(generator) * 2.0 - 1.0,
-                     random_floats(generator) * 2.0 - 1.0,
-                     random_floats(generator));
-    sample = glm::normalize(sample);
-    sample *= random_floats(generator);
-    float scale = float(i) / kSsaoKernelSampleCount_;
-
-    // scale samples s.t. they're more aligned to center of kernel
-    // scale = lerp(0.1f, 1.0f, scale * scale);
-    scale = 0.1f + (scale * scale) * (1.0f - 0.1f);
-    sample *= scale;
-    ssao_kernel_[i] = sample;
-  }
-
   static constexpr auto kSsaoNoiseDimensionXY =
       kSsaoNoiseDimensionX_ * kSsaoNoiseDimensionY_;
 
@@ -564,11 +765,11 @@ void FinalScene::BeginSSAO() {
   ssao_pipe_.LoadProgram();
   ssao_pipe_.Bind();
 
-  ssao_pipe_.SetInt("g_position_metallic", 0);
-  ssao_pipe_.SetInt("g_normal_roughness", 1);
+  ssao_pipe_.SetInt("g_depth", 0);
+  ssao_pipe_.SetInt("g_normal", 1);
   ssao_pipe_.SetInt("texNoise", 2);
   ssao_pipe_.SetFloat("radius", kSsaoRadius);
-  ssao_pipe_.SetFloat("biais", kSsaoBiais);
+  ssao_pipe_.SetFloat("bias", kSsaoBiais);
 
   ssao_blur_pipe_.LoadShader("data/shaders/Final/screen_tex.vert",
                              "data/shaders/Final/ssao_blur.frag");
@@ -576,59 +777,100 @@ void FinalScene::BeginSSAO() {
   ssao_blur_pipe_.Bind();
 
   ssao_blur_pipe_.SetInt("ssao_tex", 0);
+  ssao_blur_pipe_.SetInt("g_normal", 1);
 
-  glGenFramebuffers(1, &ssao_fbo_);
-  glBindFramebuffer(GL_FRAMEBUFFER, ssao_fbo_);
+  ssao_upsample_pipe_.LoadShader("data/shaders/Final/screen_tex.vert",
+                                 "data/shaders/Final/ssao_upsample.frag");
+  ssao_upsample_pipe_.LoadProgram();
+  ssao_upsample_pipe_.Bind();
 
-  glGenTextures(1, &ssao_tex_);
-  glBindTexture(GL_TEXTURE_2D, ssao_tex_);
-  // As the ambient occlusion result is a single grayscale value we'll only need
-  // a texture's red component, so we set the color buffer's internal format to
-  // GL_RED.
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, Metrics::width_, Metrics::height_, 0,
-               GL_RED, GL_FLOAT, NULL);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  ssao_upsample_pipe_.SetInt("ssao_tex", 0);
+  ssao_upsample_pipe_.SetInt("g_depth", 1);
+  ssao_upsample_pipe_.SetInt("g_normal", 2);
 
-  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
-                         ssao_tex_, 0);
+  ssao_temporal_pipe_.LoadShader("data/shaders/Final/screen_tex.vert",
+                                 "data/shaders/Final/ssao_temporal.frag");
+  ssao_temporal_pipe_.LoadProgram();
+  ssao_temporal_pipe_.Bind();
 
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  ssao_temporal_pipe_.SetInt("ssao_tex", 0);
+  ssao_temporal_pipe_.SetInt("history_tex", 1);
+  ssao_temporal_pipe_.SetInt("g_depth", 2);
+  ssao_temporal_pipe_.SetInt("g_normal", 3);
 
+  glGenFramebuffers(1, &ssao_fbo_);
   glGenFramebuffers(1, &ssao_blur_fbo_);
-  glBindFramebuffer(GL_FRAMEBUFFER, ssao_blur_fbo_);
-  glGenTextures(1, &ssao_blur_tex_);
-  glBindTexture(GL_TEXTURE_2D, ssao_blur_tex_);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, Metrics::width_, Metrics::height_, 0,
-               GL_RED, GL_FLOAT, NULL);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
-                         ssao_blur_tex_, 0);
+  glGenFramebuffers(1, &ssao_blurred_fbo_);
 
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glGenFramebuffers(1, &ssao_upsample_fbo_);
+  glGenFramebuffers(2, ssao_history_fbo_.data());
+
+  ApplySsaoPreset();
 }
 
-void FinalScene::UpdateSSAO() {
-#ifdef TRACY_ENABLE
-  ZoneScoped;
-#endif
-  glBindFramebuffer(GL_FRAMEBUFFER, ssao_fbo_);
-  glClearColor(0, 0, 0, 1);
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+void FinalScene::ApplySsaoPreset() {
+  PROFILE_ZONE;
+  const SsaoPreset& preset = kSsaoPresets[ssao_preset_index_];
+  ssao_current_preset_index_ = ssao_preset_index_;
 
+  const auto kernel = GenerateSsaoKernel(preset.sample_count);
   ssao_pipe_.Bind();
-  // Send kernel + rotation
-  for (unsigned int i = 0; i < 64; ++i) {
+  ssao_pipe_.SetInt("sampleCount", preset.sample_count);
+  for (int i = 0; i < preset.sample_count; ++i) {
     ssao_pipe_.SetVec3Position("samples[" + std::to_string(i) + "]",
-                               ssao_kernel_[i]);
+                               kernel[i]);
+  }
+  ssao_blur_pipe_.Bind();
+  ssao_blur_pipe_.SetInt("radius",
+                         std::min(preset.blur_radius, kSsaoMaxBlurRadius));
+
+  // The low resolution targets are made by the render graph at this size.
+  const int divisor = preset.resolution_divisor;
+  ssao_size_ = glm::ivec2(
+      (static_cast<int>(Metrics::width_) + divisor - 1) / divisor,
+      (static_cast<int>(Metrics::height_) + divisor - 1) / divisor);
+
+  // The history of another resolution or sample count can't be reused.
+  glDeleteTextures(2, ssao_history_tex_.data());
+  ssao_history_tex_ = {};
+  is_ssao_history_valid_ = false;
+  if (preset.is_temporal) {
+    glGenTextures(2, ssao_history_tex_.data());
+    for (std::size_t i = 0; i < ssao_history_tex_.size(); i++) {
+      glBindFramebuffer(GL_FRAMEBUFFER, ssao_history_fbo_[i]);
+      glBindTexture(GL_TEXTURE_2D, ssao_history_tex_[i]);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, ssao_size_.x, ssao_size_.y,
+                   0, GL_RGBA, GL_FLOAT, NULL);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+      glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                             GL_TEXTURE_2D, ssao_history_tex_[i], 0);
+    }
   }
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void FinalScene::UpdateSSAO() {
+  PROFILE_ZONE;
+  GPU_PROFILE_ZONE(gpu_profiler_, kGpuZoneSsao);
+
+  // The occlusion and the blur run at the preset resolution, they read the
+  // g-buffer at the center of each low resolution texel.
+  glViewport(0, 0, ssao_size_.x, ssao_size_.y);
+  glBindFramebuffer(GL_FRAMEBUFFER, ssao_fbo_);
 
+  ssao_pipe_.Bind();
   ssao_pipe_.SetMat4("projection", projection);
-  ssao_pipe_.SetVec2("noiseScale",
-                     glm::vec2(Metrics::width_ / 4.f, Metrics::height_ / 4.f));
+  ssao_pipe_.SetMat4("inverse_projection", glm::inverse(projection));
+  ssao_pipe_.SetVec2("noiseScale", glm::vec2(ssao_size_.x / 4.f,
+                                             ssao_size_.y / 4.f));
+  const bool is_temporal = kSsaoPresets[ssao_preset_index_].is_temporal;
+  ssao_pipe_.SetFloat("frameAngle",
+                      is_temporal ? SsaoFrameAngle(ssao_frame_index_) : 0.f);
   glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, pos_map_);
+  glBindTexture(GL_TEXTURE_2D, depth_map_);
   glActiveTexture(GL_TEXTURE1);
   glBindTexture(GL_TEXTURE_2D, normal_map_);
   glActiveTexture(GL_TEXTURE2);
@@ -636,15 +878,70 @@ void FinalScene::UpdateSSAO() {
 
   quad_screen_.Draw();
 
+  // SSAO temporal accumulation.
+  // ---------------------------
+  // Blends in the previous frames before the blur, the blur then only has
+  // to smooth what the history could not cover.
+  GLuint blur_source = ssao_tex_;
+  if (is_temporal) {
+    const int current = ssao_history_index_;
+    const int previous = 1 - current;
+    glBindFramebuffer(GL_FRAMEBUFFER, ssao_history_fbo_[current]);
+    ssao_temporal_pipe_.Bind();
+    ssao_temporal_pipe_.SetMat4("inverse_projection",
+                                glm::inverse(projection));
+    ssao_temporal_pipe_.SetMat4("inverse_view", glm::inverse(view));
+    ssao_temporal_pipe_.SetMat4("prevView", ssao_prev_view_);
+    ssao_temporal_pipe_.SetMat4("prevProjection", ssao_prev_projection_);
+    ssao_temporal_pipe_.SetFloat(
+        "blendFactor", is_ssao_history_valid_ ? kSsaoTemporalBlend : 1.f);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, ssao_tex_);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, ssao_history_tex_[previous]);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, depth_map_);
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_2D, normal_map_);
+    quad_screen_.Draw();
+
+    blur_source = ssao_history_tex_[current];
+    ssao_history_index_ = previous;
+    ssao_prev_view_ = view;
+    ssao_prev_projection_ = projection;
+    is_ssao_history_valid_ = true;
+  }
+  ssao_frame_index_++;
+
   // SSAO blur.
   // ----------
-  glBindFramebuffer(GL_FRAMEBUFFER, ssao_blur_fbo_);
-  glClearColor(0, 0, 0, 1);
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
   ssao_blur_pipe_.Bind();
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, normal_map_);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, ssao_blur_fbo_);
+  ssao_blur_pipe_.SetIVec2("direction", glm::ivec2(1, 0));
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, blur_source);
+  quad_screen_.Draw();
+
+  glBindFramebuffer(GL_FRAMEBUFFER, ssao_blurred_fbo_);
+  ssao_blur_pipe_.SetIVec2("direction", glm::ivec2(0, 1));
+  glBindTexture(GL_TEXTURE_2D, ssao_blur_tex_);
+  quad_screen_.Draw();
 
+  // SSAO upsample.
+  // --------------
+  glViewport(0, 0, Metrics::width_, Metrics::height_);
+  glBindFramebuffer(GL_FRAMEBUFFER, ssao_upsample_fbo_);
+  ssao_upsample_pipe_.Bind();
+  ssao_upsample_pipe_.SetMat4("inverse_projection", glm::inverse(projection));
   glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, ssao_tex_);
+  glBindTexture(GL_TEXTURE_2D, ssao_blurred_tex_);
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, depth_map_);
+  glActiveTexture(GL_TEXTURE2);
+  glBindTexture(GL_TEXTURE_2D, normal_map_);
 
   quad_screen_.Draw();
 }
@@ -652,423 +949,1000 @@ void FinalScene::UpdateSSAO() {
 void FinalScene::DeleteSSAO() {
   ssao_pipe_.Delete();
   ssao_blur_pipe_.Delete();
+  ssao_upsample_pipe_.Delete();
+  ssao_temporal_pipe_.Delete();
+  glDeleteTextures(1, &noise_texture_);
   noise_texture_ = 0;
   glDeleteFramebuffers(1, &ssao_fbo_);
   glDeleteFramebuffers(1, &ssao_blur_fbo_);
+  glDeleteFramebuffers(1, &ssao_blurred_fbo_);
+  glDeleteFramebuffers(1, &ssao_upsample_fbo_);
   ssao_fbo_ = 0;
   ssao_blur_fbo_ = 0;
-  ssao_tex_ = 0;
-  ssao_blur_tex_ = 0;
+  ssao_blurred_fbo_ = 0;
+  ssao_upsample_fbo_ = 0;
+  glDeleteFramebuffers(2, ssao_history_fbo_.data());
+  glDeleteTextures(2, ssao_history_tex_.data());
+  ssao_history_fbo_ = {};
+  ssao_history_tex_ = {};
+  is_ssao_history_valid_ = false;
+  ssao_current_preset_index_ = -1;
 }
 
-void FinalScene::BeginShadowMap() {
-#ifdef TRACY_ENABLE
-  ZoneScoped;
-#endif
-  glEnable(GL_DEPTH_TEST);
-  glDepthFunc(GL_LESS);
-  glEnable(GL_CULL_FACE);
-  glCullFace(GL_FRONT);
-  shadow_map_pipe_.LoadShader("data/shaders/Final/depth.vert",
-                              "data/shaders/Final/depth.frag");
+void FinalScene::BuildRenderGraph() {
+  PROFILE_ZONE;
+  const auto width = static_cast<int>(Metrics::width_);
+  const auto height = static_cast<int>(Metrics::height_);
+  const bool is_temporal = kSsaoPresets[ssao_current_preset_index_].is_temporal;
+  const bool has_bloom = post_stack_.IsActive(PostEffect::kBloom);
+
+  RenderGraph& graph = render_graph_;
+  graph.Clear();
+  // In execution order. The SSAO zone is split in its draws, the graph sees
+  // when each of its targets dies.
+  const auto shadows_pass = graph.AddPass(kGpuZoneNames[kGpuZoneShadows]);
+  const auto g_buffer_pass = graph.AddPass(kGpuZoneNames[kGpuZoneGBuffer]);
+  const auto ssao_pass = graph.AddPass(kGpuZoneNames[kGpuZoneSsao]);
+  const auto ssao_temporal_pass =
+      is_temporal ? graph.AddPass("SSAO temporal") : RenderGraph::kInvalid;
+  const auto ssao_blur_x_pass = graph.AddPass("SSAO horizontal blur");
+  const auto ssao_blur_y_pass = graph.AddPass("SSAO vertical blur");
+  const auto ssao_upsample_pass = graph.AddPass("SSAO upsample");
+  const auto lighting_pass = graph.AddPass(kGpuZoneNames[kGpuZoneLighting]);
+  const auto lamp_pass = graph.AddPass(kGpuZoneNames[kGpuZoneLamp]);
+  const auto sky_box_pass = graph.AddPass(kGpuZoneNames[kGpuZoneSkyBox]);
+  const auto bloom_pass = graph.AddPass(kGpuZoneNames[kGpuZoneBloom]);
+  const auto post_pass = graph.AddPass(kGpuZoneNames[kGpuZonePost]);
+  const auto normal =
+      graph.CreateTexture({"Normal", width, height, GL_RG16, GL_NEAREST, 4});
+  const auto albedo =
+      graph.CreateTexture({"Albedo", width, height, GL_RGBA8, GL_NEAREST, 4});
+  const auto material = graph.CreateTexture(
+      {"Material", width, height, GL_RGBA8, GL_NEAREST, 4});
+  const auto depth = graph.CreateTexture({"Depth", width, height,
+                                          GL_DEPTH_COMPONENT24, GL_NEAREST, 4,
+                                          1, true});
+  // Occlusion in r and view space depth in g, for the depth aware filters.
+  const auto ssao = graph.CreateTexture(
+      {"SSAO", ssao_size_.x, ssao_size_.y, GL_RG16F, GL_NEAREST, 4});
+  const auto ssao_blur = graph.CreateTexture(
+      {"SSAO blur", ssao_size_.x, ssao_size_.y, GL_RG16F, GL_NEAREST, 4});
+  // Born after the raw occlusion dies, the graph puts them in one slot.
+  const auto ssao_blurred = graph.CreateTexture(
+      {"SSAO blurred", ssao_size_.x, ssao_size_.y, GL_RG16F, GL_NEAREST, 4});
+  const auto ssao_result = graph.CreateTexture(
+      {"SSAO result", width, height, GL_R8, GL_NEAREST, 1});
+  const auto scene = graph.CreateTexture(
+      {"Scene color", width, height, GL_RGBA16F, GL_LINEAR, 8});
+  const auto shadows = graph.ImportTexture("Shadow atlas");
+  const auto ssao_history = graph.ImportTexture("SSAO history");
+  const auto bloom = graph.ImportTexture("Bloom chain");
+  const auto backbuffer = graph.ImportTexture("Backbuffer");
+  graph.MarkOutput(backbuffer);
+
+  graph.Write(shadows_pass, shadows);
+  for (const auto target : {normal, albedo, material, depth}) {
+    graph.Write(g_buffer_pass, target);
+  }
+  graph.Read(ssao_pass, depth);
+  graph.Read(ssao_pass, normal);
+  graph.Write(ssao_pass, ssao);
+  auto blur_source = ssao;
+  if (is_temporal) {
+    for (const auto source : {ssao, ssao_history, depth, normal}) {
+      graph.Read(ssao_temporal_pass, source);
+    }
+    // Read by the next frame.
+    graph.Write(ssao_temporal_pass, ssao_history);
+    graph.MarkOutput(ssao_history);
+    blur_source = ssao_history;
+  }
+  graph.Read(ssao_blur_x_pass, blur_source);
+  graph.Read(ssao_blur_x_pass, normal);
+  graph.Write(ssao_blur_x_pass, ssao_blur);
+  graph.Read(ssao_blur_y_pass, ssao_blur);
+  graph.Read(ssao_blur_y_pass, normal);
+  graph.Write(ssao_blur_y_pass, ssao_blurred);
+  for (const auto source : {ssao_blurred, depth, normal}) {
+    graph.Read(ssao_upsample_pass, source);
+  }
+  graph.Write(ssao_upsample_pass, ssao_result);
+  for (const auto source :
+       {shadows, depth, normal, albedo, material, ssao_result}) {
+    graph.Read(lighting_pass, source);
+  }
+  graph.Write(lighting_pass, scene);
+  graph.Read(lamp_pass, depth);
+  graph.Write(lamp_pass, depth);
+  graph.Write(lamp_pass, scene);
+  graph.Read(sky_box_pass, depth);
+  graph.Write(sky_box_pass, scene);
+  graph.Read(bloom_pass, scene);
+  graph.Write(bloom_pass, bloom);
+  graph.Read(post_pass, scene);
+  if (has_bloom) {
+    graph.Read(post_pass, bloom);
+  }
+  graph.Write(post_pass, backbuffer);
+  graph.Compile();
+  render_graph_bloom_pass_ = bloom_pass;
+
+  render_graph_textures_.Create(graph);
+  normal_map_ = render_graph_textures_.Texture(normal);
+  albedo_map_ = render_graph_textures_.Texture(albedo);
+  material_map_ = render_graph_textures_.Texture(material);
+  depth_map_ = render_graph_textures_.Texture(depth);
+  ssao_tex_ = render_graph_textures_.Texture(ssao);
+  ssao_blur_tex_ = render_graph_textures_.Texture(ssao_blur);
+  ssao_blurred_tex_ = render_graph_textures_.Texture(ssao_blurred);
+  ssao_result_tex_ = render_graph_textures_.Texture(ssao_result);
+  scene_tex_ = render_graph_textures_.Texture(scene);
+  render_graph_ssao_preset_ = ssao_current_preset_index_;
+  render_graph_has_bloom_ = has_bloom;
+  AttachRenderTargets();
+}
+
+void FinalScene::AttachRenderTargets() {
+  struct Attachment {
+    GLuint fbo;
+    GLenum attachment;
+    GLuint texture;
+  };
+  // The HDR target shares the g-buffer depth instead of a copy of it.
+  const std::array<Attachment, 11> attachments = {{
+      {g_buffer_, GL_COLOR_ATTACHMENT0, normal_map_},
+      {g_buffer_, GL_COLOR_ATTACHMENT1, albedo_map_},
+      {g_buffer_, GL_COLOR_ATTACHMENT2, material_map_},
+      {g_buffer_, GL_DEPTH_ATTACHMENT, depth_map_},
+      {ssao_fbo_, GL_COLOR_ATTACHMENT0, ssao_tex_},
+      {ssao_blur_fbo_, GL_COLOR_ATTACHMENT0, ssao_blur_tex_},
+      {ssao_blurred_fbo_, GL_COLOR_ATTACHMENT0, ssao_blurred_tex_},
+      {ssao_upsample_fbo_, GL_COLOR_ATTACHMENT0, ssao_result_tex_},
+      {lighting_fbo_, GL_COLOR_ATTACHMENT0, scene_tex_},
+      {hdr_fbo_, GL_COLOR_ATTACHMENT0, scene_tex_},
+      {hdr_fbo_, GL_DEPTH_ATTACHMENT, depth_map_},
+  }};
+  for (const auto& attachment : attachments) {
+    glBindFramebuffer(GL_FRAMEBUFFER, attachment.fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, attachment.attachment,
+                           GL_TEXTURE_2D, attachment.texture, 0);
+  }
+  for (const GLuint fbo :
+       {g_buffer_, ssao_fbo_, ssao_blur_fbo_, ssao_blurred_fbo_,
+        ssao_upsample_fbo_, lighting_fbo_, hdr_fbo_}) {
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+      std::cout << "Framebuffer " << fbo << " not complete!" << std::endl;
+    }
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void FinalScene::DeleteRenderGraph() {
+  render_graph_textures_.Delete();
+  render_graph_.Clear();
+  normal_map_ = 0;
+  albedo_map_ = 0;
+  material_map_ = 0;
+  depth_map_ = 0;
+  ssao_tex_ = 0;
+  ssao_blur_tex_ = 0;
+  ssao_blurred_tex_ = 0;
+  ssao_result_tex_ = 0;
+  scene_tex_ = 0;
+  render_graph_ssao_preset_ = -1;
+  render_graph_bloom_pass_ = RenderGraph::kInvalid;
+}
+
+void FinalScene::BeginShadowMap() {
+  PROFILE_ZONE;
+  shadow_map_pipe_.LoadShader("data/shaders/Final/depth.vert",
+                              "data/shaders/Final/depth.geom",
+                              "data/shaders/Final/depth.frag");
   shadow_map_pipe_.LoadProgram();
   shadow_map_pipe_.Bind();
-
-  shadow_map_pipe_.SetVec3Position("lightPos", lamp_pos_);
   shadow_map_pipe_.SetFloat("lightFarPlane", kLightFarPlane);
+  shadow_map_pipe_.SetUniformBlockBinding("ShadowObjectBlock",
+                                          kShadowObjectBinding);
 
-  // Point Shadow Cubemap Framebuffer.
-  // ---------------------------------
+  // Point Shadow Atlas Framebuffer.
+  // --------------------------------
   glGenFramebuffers(1, &shadow_fbo_);
-  // create depth cubemap texture
-  glGenTextures(1, &shadow_tex_);
-  glBindTexture(GL_TEXTURE_CUBE_MAP, shadow_tex_);
-  for (unsigned int i = 0; i < 6; ++i) {
-    glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT24,
-                 shadow_tex_res_, shadow_tex_res_, 0, GL_DEPTH_COMPONENT,
-                 GL_FLOAT, nullptr);
-  }
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-  glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
-  // attach depth texture as FBO's depth buffer
   glBindFramebuffer(GL_FRAMEBUFFER, shadow_fbo_);
   GLenum drawBuffers[] = {GL_NONE};
   glDrawBuffers(1, drawBuffers);
   glReadBuffer(GL_NONE);
-  glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
-                         GL_TEXTURE_CUBE_MAP_POSITIVE_X, shadow_tex_, 0);
-
   glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-  /////////
+  // Every face is dirty at first, bake them all now.
+  CreateShadowAtlas();
+  UpdateLightMatrices();
+  UpdateShadowMap(ShadowFaceScheduler::kFaceCount);
+}
 
-  glBindFramebuffer(GL_FRAMEBUFFER, shadow_fbo_);
-  glClearColor(0, 0, 0, 1);
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  glViewport(0, 0, shadow_tex_res_, shadow_tex_res_);
+void FinalScene::CreateShadowAtlas() {
+  PROFILE_ZONE;
+  glDeleteTextures(1, &shadow_tex_);
+  glDeleteTextures(1, &shadow_static_tex_);
+
+  GLint max_size = 0;
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+  const std::uint32_t size = ShadowAtlas::SizeForBudget(
+      kShadowBudgets[shadow_budget_index_] / 2, kShadowTexelBytes,
+      static_cast<std::uint32_t>(max_size));
+  shadow_atlas_ =
+      ShadowAtlas(size, kMinShadowResolution, kMaxShadowResolution);
+
+  // The static casters copy uses the same tiles, so half the budget each.
+  for (GLuint* texture : {&shadow_static_tex_, &shadow_tex_}) {
+    glGenTextures(1, texture);
+    glBindTexture(GL_TEXTURE_2D, *texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT16, size, size, 0,
+                 GL_DEPTH_COMPONENT, GL_UNSIGNED_SHORT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  shadow_light_ = nullptr;
+  shadow_scheduler_ = ShadowFaceScheduler{};
+  is_shadow_atlas_dirty_ = false;
+}
+
+void FinalScene::AcquireShadowTiles() {
+  // Screen height covered by the light range.
+  const float distance =
+      glm::length(camera_.position_ - main_light().position);
+  const float coverage =
+      distance <= kLightFarPlane
+          ? 1.f
+          : kLightFarPlane /
+                (distance * std::tan(glm::radians(camera_.zoom_) * 0.5f));
+
+  bool reallocated = false;
+  shadow_atlas_.NextFrame();
+  shadow_light_ = shadow_atlas_.Acquire(
+      kLampShadowId, shadow_atlas_.ResolutionForCoverage(coverage),
+      reallocated);
+  if (shadow_light_ == nullptr || !reallocated) {
+    return;
+  }
+
+  const float atlas_size = static_cast<float>(shadow_atlas_.size());
+  std::array<glm::vec4, ShadowAtlas::kFaceCount> tiles{};
+  for (int face = 0; face < ShadowAtlas::kFaceCount; face++) {
+    const AtlasTile& tile = shadow_light_->tiles[face];
+    tiles[face] = glm::vec4(tile.x, tile.y, tile.size, 0) / atlas_size;
+  }
+  pbr_pipe_.Bind();
+  pbr_pipe_.SetVec4Array("shadowTiles", tiles.data(),
+                         ShadowAtlas::kFaceCount);
+  pbr_pipe_.SetFloat("shadowAtlasSize", atlas_size);
+  shadow_scheduler_.InvalidateStatic(ShadowFaceScheduler::kAllFaces);
+}
+
+void FinalScene::UpdateLightMatrices() {
+  const glm::vec3 light_pos = main_light().position;
+  light_space_matrices_ =
+      PointLightMatrices(light_pos, kLightNearPlane, kLightFarPlane);
+  lightSpaceMatrix = light_space_matrices_.back();
+  shadow_light_pos_ = light_pos;
 
   shadow_map_pipe_.Bind();
+  shadow_map_pipe_.SetVec3Position("lightPos", light_pos);
+  shadow_map_pipe_.SetMat4Array("lightSpaceMatrices",
+                                light_space_matrices_.data(), 6);
+  pbr_pipe_.Bind();
+  pbr_pipe_.SetVec3Position("lightPos", light_pos);
+  pbr_pipe_.SetMat4("lightSpaceMatrix", lightSpaceMatrix);
+  pbr_pipe_.SetMat4Array("lightSpaceMatrices", light_space_matrices_.data(),
+                         6);
+  shadow_scheduler_.InvalidateStatic(ShadowFaceScheduler::kAllFaces);
+}
 
-  glm::mat4 lightProjection, lightView;
+void FinalScene::UpdateShadowMap(const int face_budget) {
+  PROFILE_ZONE;
+  GPU_PROFILE_ZONE(gpu_profiler_, kGpuZoneShadows);
+  if (is_shadow_atlas_dirty_) {
+    CreateShadowAtlas();
+  }
+  AcquireShadowTiles();
+  if (shadow_light_ == nullptr) {
+    return;
+  }
+  const bool is_light_moved = main_light().position != shadow_light_pos_;
+  if (is_light_moved) {
+    UpdateLightMatrices();
+  }
+  shadow_caster_faces_.Update(job_system_, culling_set_, light_space_matrices_,
+                              is_light_moved, scene_objects_,
+                              shadow_scheduler_);
 
-  for (int i = 0; i < 6; ++i) {
-    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
-                           GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, shadow_tex_, 0);
-    glClear(GL_DEPTH_BUFFER_BIT);
-    lightView = glm::lookAt(lamp_pos_, lamp_pos_ + light_dirs[i], light_ups[i]);
-    lightProjection = glm::perspective(glm::radians(90.f), 1.0f,
-                                       kLightNearPlane, kLightFarPlane);
-    lightSpaceMatrix = lightProjection * lightView;
-    shadow_map_pipe_.SetMat4("lightSpaceMatrix", lightSpaceMatrix);
-    UpdateGround(shadow_map_pipe_);
-    UpdateModels(shadow_map_pipe_);
-    UpdateSpheres(shadow_map_pipe_);
+  const auto update = shadow_scheduler_.Schedule(face_budget);
+  if (update.composite_faces == 0) {
+    return;
   }
 
+  glBindFramebuffer(GL_FRAMEBUFFER, shadow_fbo_);
+  glEnable(GL_DEPTH_TEST);
+  glDepthFunc(GL_LESS);
+  glEnable(GL_CULL_FACE);
+  glCullFace(GL_FRONT);
+
+  // One viewport per face, the geometry shader picks it with
+  // gl_ViewportIndex. The scissors keep wide triangles in their tile.
+  glEnable(GL_SCISSOR_TEST);
+  for (int face = 0; face < ShadowAtlas::kFaceCount; face++) {
+    const AtlasTile& tile = shadow_light_->tiles[face];
+    glViewportIndexedf(face, static_cast<float>(tile.x),
+                       static_cast<float>(tile.y),
+                       static_cast<float>(tile.size),
+                       static_cast<float>(tile.size));
+    glScissorIndexed(face, tile.x, tile.y, tile.size, tile.size);
+  }
+
+  // Static casters, only when the light or one of them moved.
+  // ----------------------------------------------------------
+  if (update.static_faces != 0) {
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D,
+                           shadow_static_tex_, 0);
+    static constexpr float kClearDepth = 1.f;
+    for (int face = 0; face < ShadowAtlas::kFaceCount; face++) {
+      if (update.static_faces & (1u << face)) {
+        const AtlasTile& tile = shadow_light_->tiles[face];
+        glClearTexSubImage(shadow_static_tex_, 0, tile.x, tile.y, 0,
+                           tile.size, tile.size, 1, GL_DEPTH_COMPONENT,
+                           GL_FLOAT, &kClearDepth);
+      }
+    }
+    DrawShadowCasters(false, update.static_faces);
+  }
+
+  // Static depth copied under the dynamic casters.
+  // ----------------------------------------------
+  for (int face = 0; face < ShadowAtlas::kFaceCount; face++) {
+    if (update.composite_faces & (1u << face)) {
+      const AtlasTile& tile = shadow_light_->tiles[face];
+      glCopyImageSubData(shadow_static_tex_, GL_TEXTURE_2D, 0, tile.x, tile.y,
+                         0, shadow_tex_, GL_TEXTURE_2D, 0, tile.x, tile.y, 0,
+                         tile.size, tile.size, 1);
+    }
+  }
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D,
+                         shadow_tex_, 0);
+  DrawShadowCasters(true, update.composite_faces);
+
+  glDisable(GL_SCISSOR_TEST);
+  glCullFace(GL_BACK);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
   glViewport(0, 0, Metrics::width_, Metrics::height_);
 }
 
+void FinalScene::DrawShadowCasters(const bool is_dynamic,
+                                   const std::uint8_t faces) {
+  // The draw functions read visibility_: the face masks of the casters of
+  // the wanted kind, limited to the updated faces.
+  const std::vector<std::uint8_t>& masks = shadow_caster_faces_.masks();
+  for (const auto& object : scene_objects_) {
+    const bool is_wanted = object.is_dynamic == is_dynamic;
+    for (std::uint32_t entry = object.first_entry; entry < object.end_entry;
+         entry++) {
+      visibility_[entry] = is_wanted ? masks[entry] & faces : 0;
+    }
+  }
+
+  DrawObjects(shadow_map_pipe_);
+}
+
+void FinalScene::UpdateDynamicObjects(const float dt) {
+  if (animate_dynamic_casters_) {
+    animation_time_ += dt;
+  }
+  // The animated casters orbit their placement, every other one the other
+  // way round.
+  const glm::vec3 orbit = glm::vec3(std::cos(animation_time_), 0,
+                                    std::sin(animation_time_)) *
+                          kDynamicOrbitRadius;
+  float orbit_sign = 1.f;
+  for (const auto& object : scene_objects_) {
+    // The lamp post follows its bulb.
+    if (object.light != kNoSceneLight) {
+      const SceneLight& light = scene_lights_[object.light];
+      const glm::vec3 position =
+          object.placement.position + light.position - light.rest_position;
+      if (transforms_.position(object.entity) != position) {
+        MoveObject(object, position);
+      }
+    } else if (object.is_dynamic && animate_dynamic_casters_) {
+      MoveObject(object, object.placement.position + orbit_sign * orbit);
+      orbit_sign = -orbit_sign;
+    }
+  }
+  UpdateTransforms();
+}
+
+void FinalScene::UpdateTransforms() {
+  transform_stats_ = transforms_.Update(job_system_);
+  if (transform_stats_.updated_count == 0) {
+    return;
+  }
+  for (auto& object : scene_objects_) {
+    for (std::uint32_t entry = object.first_entry; entry < object.end_entry;
+         entry++) {
+      const std::uint32_t entity = entry_entities_[entry];
+      if (!transforms_.IsChanged(entity)) {
+        continue;
+      }
+      culling_set_.Set(entry, entry_boxes_[entry], entry_spheres_[entry],
+                       transforms_.world(entity));
+      object.is_moved = true;
+    }
+  }
+}
+
 void FinalScene::DeleteShadowMap() {
   shadow_map_pipe_.Delete();
   glDeleteFramebuffers(1, &shadow_fbo_);
+  glDeleteTextures(1, &shadow_tex_);
+  glDeleteTextures(1, &shadow_static_tex_);
   shadow_fbo_ = 0;
   shadow_tex_ = 0;
+  shadow_static_tex_ = 0;
+  shadow_light_ = nullptr;
+  shadow_atlas_ = ShadowAtlas{};
 }
 
 void FinalScene::BeginPBR() {
-#ifdef TRACY_ENABLE
-  ZoneScoped;
-#endif
+  PROFILE_ZONE;
   pbr_pipe_.LoadShader("data/shaders/Final/screen_tex.vert",
                        "data/shaders/Final/pbr.frag");
 
   pbr_pipe_.LoadProgram();
 
   pbr_pipe_.Bind();
-  pbr_pipe_.SetInt("irradianceMap", 0);
+  pbr_pipe_.SetUniformBlockBinding("IrradianceSh", kIrradianceShBinding);
   pbr_pipe_.SetInt("prefilterMap", 1);
   pbr_pipe_.SetInt("brdfLUT", 2);
 
-  pbr_pipe_.SetInt("g_position_metallic", 3);
-  pbr_pipe_.SetInt("g_normal_roughness", 4);
-  pbr_pipe_.SetInt("g_albedo_ao", 5);
+  pbr_pipe_.SetInt("g_depth", 3);
+  pbr_pipe_.SetInt("g_normal", 4);
+  pbr_pipe_.SetInt("g_albedo", 5);
+  pbr_pipe_.SetInt("g_metallic_roughness_ao", 8);
 
   pbr_pipe_.SetInt("ssao_tex", 6);
 
   pbr_pipe_.SetInt("depth_tex", 7);
 
-  pbr_pipe_.SetVec3Position("lightPos", lamp_pos_);
-  pbr_pipe_.SetVec3Color("lightColor", light_color_);
+  pbr_pipe_.SetInt("pointLights", 9);
+  pbr_pipe_.SetInt("clusterLights", 10);
+  pbr_pipe_.SetInt("clusterLightIndices", 11);
+
+  pbr_pipe_.SetVec3Position("lightPos", main_light().position);
+  pbr_pipe_.SetVec3Color("lightColor", main_light().color);
 
   pbr_pipe_.SetMat4("lightSpaceMatrix", lightSpaceMatrix);
+  pbr_pipe_.SetMat4Array("lightSpaceMatrices", light_space_matrices_.data(),
+                         6);
   pbr_pipe_.SetFloat("lightFarPlane", kLightFarPlane);
 }
 
 void FinalScene::UpdatePBR() {
-#ifdef TRACY_ENABLE
-  ZoneScoped;
-#endif
-  glBindFramebuffer(GL_FRAMEBUFFER, hdr_fbo_);
+  PROFILE_ZONE;
+  GPU_PROFILE_ZONE(gpu_profiler_, kGpuZoneLighting);
+  // The depth is sampled, it can't be attached.
+  glBindFramebuffer(GL_FRAMEBUFFER, lighting_fbo_);
   glClearColor(0, 0, 0, 1);
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  glClear(GL_COLOR_BUFFER_BIT);
 
   pbr_pipe_.Bind();
   pbr_pipe_.SetVec3Position("camPos", camera_.position_);
   pbr_pipe_.SetMat4("inverse_view", glm::inverse(view));
+  pbr_pipe_.SetMat4("inverse_projection", glm::inverse(projection));
   // set light pos and color todo in futur
 
   // bind pre-computed IBL data
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
   glActiveTexture(GL_TEXTURE1);
   glBindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap);
   glActiveTexture(GL_TEXTURE2);
   glBindTexture(GL_TEXTURE_2D, brdfLUTTexture);
 
   glActiveTexture(GL_TEXTURE3);
-  glBindTexture(GL_TEXTURE_2D, pos_map_);
+  glBindTexture(GL_TEXTURE_2D, depth_map_);
   glActiveTexture(GL_TEXTURE4);
   glBindTexture(GL_TEXTURE_2D, normal_map_);
   glActiveTexture(GL_TEXTURE5);
   glBindTexture(GL_TEXTURE_2D, albedo_map_);
   glActiveTexture(GL_TEXTURE6);
-  glBindTexture(GL_TEXTURE_2D, ssao_blur_tex_);
+  glBindTexture(GL_TEXTURE_2D, ssao_result_tex_);
   glActiveTexture(GL_TEXTURE7);
-  glBindTexture(GL_TEXTURE_CUBE_MAP, shadow_tex_);
+  glBindTexture(GL_TEXTURE_2D, shadow_tex_);
+  glActiveTexture(GL_TEXTURE8);
+  glBindTexture(GL_TEXTURE_2D, material_map_);
+  glActiveTexture(GL_TEXTURE9);
+  glBindTexture(GL_TEXTURE_2D, point_lights_tex_);
+  glActiveTexture(GL_TEXTURE10);
+  glBindTexture(GL_TEXTURE_2D, cluster_lights_tex_);
+  glActiveTexture(GL_TEXTURE11);
+  glBindTexture(GL_TEXTURE_2D, cluster_indices_tex_);
 
   quad_screen_.Draw();
 }
 
 void FinalScene::DeletePBR() {
-  irradiance_pipe_.Delete();
+  glDeleteBuffers(1, &irradiance_sh_ubo_);
+  irradiance_sh_ubo_ = 0;
   prefilter_pipe_.Delete();
   brdf_pipe_.Delete();
   pbr_pipe_.Delete();
 }
 
-void FinalScene::LoadRessources() {
-#ifdef TRACY_ENABLE
-  ZoneScoped;
-#endif
-  lamp_model_.Load("data/models/final/lamp/msh_lampadaire_01.obj");
-  backpack_model_.Load("data/models/final/backpack/backpack.obj");
-  man_model_.Load("data/models/final/man/man1.obj");
-
-  std::array<GLuint*, nb_data> tex_id{
-      &lamp_model_.mat.albedo,
-      &lamp_model_.mat.normal,
-      &lamp_model_.mat.ao,
-      &lamp_model_.mat.metallic,
-      &lamp_model_.mat.roughness,
-
-      &man_model_.mat.albedo,
-      &man_model_.mat.normal,
-      &man_model_.mat.ao,
-      &man_model_.mat.metallic,
-      &man_model_.mat.roughness,
-
-      &steel_.albedo,
-      &steel_.normal,
-      &steel_.ao,
-      &steel_.metallic,
-      &steel_.roughness,
-
-      &titanium_.albedo,
-      &titanium_.normal,
-      &titanium_.ao,
-      &titanium_.metallic,
-      &titanium_.roughness,
-
-      &ground_mat_.albedo,
-      &ground_mat_.normal,
-      &ground_mat_.ao,
-      &ground_mat_.metallic,
-      &ground_mat_.roughness,
-
-      &backpack_model_.mat.albedo,
-      &backpack_model_.mat.normal,
-      &backpack_model_.mat.ao,
-      &backpack_model_.mat.metallic,
-      &backpack_model_.mat.roughness,
-  };
-
-  std::array<TextureParameters, nb_data> tex_params{
-      TextureParameters("data/models/final/lamp/lampBaseColor.png", GL_REPEAT,
-                        GL_LINEAR, true, true),
-      TextureParameters("data/models/final/lamp/lampNormal.png", GL_REPEAT,
-                        GL_LINEAR, false, true),
-      TextureParameters("data/models/final/lamp/lampAO.png", GL_REPEAT,
-                        GL_LINEAR, false, true),
-      TextureParameters("data/models/final/lamp/lampMetallic.png", GL_REPEAT,
-                        GL_LINEAR, false, true),
-      TextureParameters("data/models/final/lamp/lampRoughness.png", GL_REPEAT,
-                        GL_LINEAR, false, true),
-
-      TextureParameters("data/models/final/man/albedo.jpg", GL_REPEAT,
-                        GL_LINEAR, true, true),
-      TextureParameters("data/models/final/man/normal.png", GL_REPEAT,
-                        GL_LINEAR, false, true),
-      TextureParameters("data/models/final/man/ao.png", GL_REPEAT, GL_LINEAR,
-                        false, true),
-      TextureParameters("data/models/final/man/metallic.png", GL_REPEAT,
-                        GL_LINEAR, false, true),
-      TextureParameters("data/models/final/man/roughness.jpg", GL_REPEAT,
-                        GL_LINEAR, false, true),
-
-      TextureParameters("data/textures/pbr/steel/albedo.png", GL_REPEAT,
-                        GL_LINEAR, true, true),
-      TextureParameters("data/textures/pbr/steel/normal.png", GL_REPEAT,
-                        GL_LINEAR, false, true),
-      TextureParameters("data/textures/pbr/steel/ao.png", GL_REPEAT, GL_LINEAR,
-                        false, true),
-      TextureParameters("data/textures/pbr/steel/metallic.png", GL_REPEAT,
-                        GL_LINEAR, false, true),
-      TextureParameters("data/textures/pbr/steel/roughness.png", GL_REPEAT,
-                        GL_LINEAR, false, true),
-
-      TextureParameters("data/textures/pbr/titanium/albedo.png", GL_REPEAT,
-                        GL_LINEAR, true, true),
-      TextureParameters("data/textures/pbr/titanium/normal.png", GL_REPEAT,
-                        GL_LINEAR, false, true),
-      TextureParameters("data/textures/pbr/titanium/ao.png", GL_REPEAT,
-                        GL_LINEAR, false, true),
-      TextureParameters("data/textures/pbr/titanium/metallic.png", GL_REPEAT,
-                        GL_LINEAR, false, true),
-      TextureParameters("data/textures/pbr/titanium/roughness.png", GL_REPEAT,
-                        GL_LINEAR, false, true),
-
-      TextureParameters("data/textures/pbr/stonework/albedo.png", GL_REPEAT,
-                        GL_LINEAR, false, true),
-      TextureParameters("data/textures/pbr/stonework/normal.png", GL_REPEAT,
-                        GL_LINEAR, false, true),
-      TextureParameters("data/textures/pbr/stonework/ao.png", GL_REPEAT,
-                        GL_LINEAR, false, true),
-      TextureParameters("data/textures/pbr/stonework/metallic.png", GL_REPEAT,
-                        GL_LINEAR, false, true),
-      TextureParameters("data/textures/pbr/stonework/roughness.png", GL_REPEAT,
-                        GL_LINEAR, false, true),
-
-      TextureParameters("data/models/final/backpack/diffuse.jpg", GL_REPEAT,
-                        GL_LINEAR, true, false),
-      TextureParameters("data/models/final/backpack/normal.png", GL_REPEAT,
-                        GL_LINEAR, false, false),
-      TextureParameters("data/models/final/backpack/ao.jpg", GL_REPEAT,
-                        GL_LINEAR, false, false),
-      TextureParameters("data/models/final/backpack/specular.jpg", GL_REPEAT,
-                        GL_LINEAR, false, false),
-      TextureParameters("data/models/final/backpack/roughness.jpg", GL_REPEAT,
-                        GL_LINEAR, false, false),
+void FinalScene::BeginClusteredLights() {
+  PROFILE_ZONE;
+  point_lights_ = GeneratePointLights(kMaxPointLights, kPointLightRoomMin,
+                                      kPointLightRoomMax);
+
+  // Integer textures can only be fetched, the filters must be nearest.
+  struct Texture {
+    GLuint* name;
+    GLenum internal_format;
+    GLsizei width;
+    GLsizei height;
+    GLenum format;
+    GLenum type;
   };
+  cluster_index_rows_ = 1;
+  const std::array<Texture, 3> textures = {{
+      {&point_lights_tex_, GL_RGBA32F, kMaxPointLights, 2, GL_RGBA, GL_FLOAT},
+      {&cluster_lights_tex_, GL_RG32UI, ClusterGrid::kSliceClusterCount,
+       ClusterGrid::kCountZ, GL_RG_INTEGER, GL_UNSIGNED_INT},
+      {&cluster_indices_tex_, GL_R32UI, kClusterIndexTextureWidth,
+       cluster_index_rows_, GL_RED_INTEGER, GL_UNSIGNED_INT},
+  }};
+  for (const auto& texture : textures) {
+    glGenTextures(1, texture.name);
+    glBindTexture(GL_TEXTURE_2D, *texture.name);
+    glTexImage2D(GL_TEXTURE_2D, 0, texture.internal_format, texture.width,
+                 texture.height, 0, texture.format, texture.type, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  }
+}
 
-  read_jobs_.reserve(nb_data);
-  decom_jobs_.reserve(nb_data);
-  gpu_jobs_.reserve(nb_data);
-
-  for (int i = 0; i < nb_data; ++i) {
-    const auto& tex_param = tex_params[i];
+void FinalScene::UpdateClusteredLights(const float dt) {
+  PROFILE_ZONE;
+  if (projection != cluster_projection_) {
+    cluster_grid_.Build(projection, kCameraNearPlane, kCameraFarPlane);
+    cluster_projection_ = projection;
+  }
 
-    read_jobs_.emplace_back(tex_param.image_file_path, &fbArray[i]);
+  if (animate_point_lights_) {
+    point_light_time_ += dt;
+  }
+  // The lights of the scene file after the lamp, then the generated ones.
+  const std::size_t scene_count =
+      std::min(scene_lights_.size() - 1, std::size_t{kMaxPointLights});
+  const std::size_t generated_count =
+      std::min(static_cast<std::size_t>(
+                   std::clamp(point_light_count_, 0, kMaxPointLights)),
+               std::size_t{kMaxPointLights} - scene_count);
+  const std::size_t count = scene_count + generated_count;
+  moved_point_lights_.resize(count);
+  for (std::size_t i = 0; i < scene_count; i++) {
+    const SceneLight& light = scene_lights_[i + 1];
+    moved_point_lights_[i] = {light.position, light.radius, light.color};
+  }
+  for (std::size_t i = 0; i < generated_count; i++) {
+    // Each light orbits at its own speed and phase.
+    const float angle =
+        point_light_time_ * (0.3f + 0.1f * static_cast<float>(i % 7)) +
+        static_cast<float>(i);
+    PointLight& light = moved_point_lights_[scene_count + i];
+    light = point_lights_[i];
+    light.position += glm::vec3(std::cos(angle), 0.f, std::sin(angle)) *
+                      kPointLightOrbitRadius;
+  }
 
-    decom_jobs_.emplace_back(&fbArray[i], &textures[i], tex_param.flipped_y);
-    decom_jobs_[i].AddDependency(&read_jobs_[i]);
+  cluster_light_set_.Set(moved_point_lights_, view);
+  cluster_stats_ =
+      light_clusterer_.Assign(job_system_, cluster_grid_, cluster_light_set_);
 
-    gpu_jobs_.emplace_back(&textures[i], tex_id[i], tex_param);
-    gpu_jobs_[i].AddDependency(&decom_jobs_[i]);
+  const glm::vec2 slice_scale_bias = cluster_grid_.SliceScaleBias();
+  pbr_pipe_.Bind();
+  pbr_pipe_.SetIVec2("clusterCount",
+                     glm::ivec2(ClusterGrid::kCountX, ClusterGrid::kCountY));
+  pbr_pipe_.SetInt("clusterSliceCount", ClusterGrid::kCountZ);
+  pbr_pipe_.SetVec2("clusterSliceScaleBias", slice_scale_bias);
+
+  // Upload.
+  // -------
+  // The index list wraps over rows, the texture only grows. Resized before
+  // the unpack buffer is bound, the null data would be an offset in it.
+  const auto& offsets = light_clusterer_.offsets();
+  const auto& indices = light_clusterer_.indices();
+  const auto index_count = static_cast<GLsizei>(indices.size());
+  const GLsizei rows =
+      (index_count + kClusterIndexTextureWidth - 1) / kClusterIndexTextureWidth;
+  if (rows > cluster_index_rows_) {
+    cluster_index_rows_ = rows;
+    glBindTexture(GL_TEXTURE_2D, cluster_indices_tex_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, kClusterIndexTextureWidth,
+                 cluster_index_rows_, 0, GL_RED_INTEGER, GL_UNSIGNED_INT,
+                 nullptr);
+  }
 
-    job_system_.AddJob(&read_jobs_[i]);
-    job_system_.AddJob(&decom_jobs_[i]);
-    main_thread_jobs_.push(&gpu_jobs_[i]);
+  // The texels are written in the frame data ring, the textures copy them
+  // from there as their unpack buffer: lights, cluster ranges then indices.
+  const std::size_t lights_size = 2 * count * sizeof(glm::vec4);
+  const std::size_t offsets_size = offsets.size() * sizeof(offsets[0]);
+  const FrameAllocation upload = frame_ring_.Allocate(
+      lights_size + offsets_size + indices.size() * sizeof(indices[0]),
+      sizeof(glm::vec4));
+  if (!upload.IsValid()) {
+    return;
+  }
+  auto* texels = reinterpret_cast<glm::vec4*>(upload.data);
+  for (std::size_t i = 0; i < count; i++) {
+    const PointLight& light = moved_point_lights_[i];
+    texels[i] = glm::vec4(light.position, light.radius);
+    texels[count + i] = glm::vec4(light.color, 0.f);
+  }
+  std::memcpy(upload.data + lights_size, offsets.data(), offsets_size);
+  std::memcpy(upload.data + lights_size + offsets_size, indices.data(),
+              indices.size() * sizeof(indices[0]));
 
-    // do not push back jobs otherwise it will explode
+  const auto unpack_offset = [&upload](const std::size_t offset) {
+    return reinterpret_cast<const void*>(
+        static_cast<std::uintptr_t>(upload.offset) + offset);
+  };
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload.buffer);
+  if (count > 0) {
+    glBindTexture(GL_TEXTURE_2D, point_lights_tex_);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, static_cast<GLsizei>(count), 1,
+                    GL_RGBA, GL_FLOAT, unpack_offset(0));
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 1, static_cast<GLsizei>(count), 1,
+                    GL_RGBA, GL_FLOAT,
+                    unpack_offset(count * sizeof(glm::vec4)));
   }
 
-  job_system_.LaunchWorkers(2);
+  glBindTexture(GL_TEXTURE_2D, cluster_lights_tex_);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, ClusterGrid::kSliceClusterCount,
+                  ClusterGrid::kCountZ, GL_RG_INTEGER, GL_UNSIGNED_INT,
+                  unpack_offset(lights_size));
+
+  glBindTexture(GL_TEXTURE_2D, cluster_indices_tex_);
+  const std::size_t indices_offset = lights_size + offsets_size;
+  const GLsizei full_rows = index_count / kClusterIndexTextureWidth;
+  if (full_rows > 0) {
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, kClusterIndexTextureWidth,
+                    full_rows, GL_RED_INTEGER, GL_UNSIGNED_INT,
+                    unpack_offset(indices_offset));
+  }
+  const GLsizei last_row_count = index_count % kClusterIndexTextureWidth;
+  if (last_row_count > 0) {
+    glTexSubImage2D(
+        GL_TEXTURE_2D, 0, 0, full_rows, last_row_count, 1, GL_RED_INTEGER,
+        GL_UNSIGNED_INT,
+        unpack_offset(indices_offset +
+                      static_cast<std::size_t>(full_rows) *
+                          kClusterIndexTextureWidth * sizeof(indices[0])));
+  }
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
 }
 
-void FinalScene::UpdateModels(Pipeline& pipeline) {
-#ifdef TRACY_ENABLE
-  ZoneScoped;
-#endif
-  lamp_model_.mat.Set();
-
-  model = glm::mat4(1.0f);
-  model = glm::translate(model, glm::vec3(0, 0, -10));
-  model = glm::scale(model, glm::vec3(0.05));
-  model = glm::translate(model, glm::vec3(0, 10, 0));
-  pipeline.Bind();
-  pipeline.SetMat4("model", model);
+void FinalScene::DeleteClusteredLights() {
+  const std::array<GLuint, 3> textures = {
+      point_lights_tex_, cluster_lights_tex_, cluster_indices_tex_};
+  glDeleteTextures(static_cast<GLsizei>(textures.size()), textures.data());
+  point_lights_tex_ = 0;
+  cluster_lights_tex_ = 0;
+  cluster_indices_tex_ = 0;
+  cluster_index_rows_ = 0;
+  cluster_projection_ = glm::mat4(0.0f);
+}
 
-  pipeline.SetMat4("normalMatrix",
-                   glm::mat4(glm::transpose(glm::inverse(view * model))));
+void FinalScene::LoadRessources() {
+  PROFILE_ZONE;
+  are_scene_loads_queued_ = false;
+  // Launched before the loads, they unpack the archive entries.
+  job_system_.LaunchComputeWorkers(static_cast<int>(
+      std::max(1u, std::thread::hardware_concurrency()) - 1));
+  if (!asset_archive_.Open(kAssetArchiveFile)) {
+    std::cout << "No " << kAssetArchiveFile << ", loading loose files\n";
+  }
+  scene_description_job_.Reset();
+  scene_description_job_.Setup(std::string(kSceneFile), &scene_description_);
+  job_system_.AddJob(&scene_description_job_);
+  // Workers are launched by job type, up to the model loading one. The
+  // others find their queue empty and stop.
+  job_system_.LaunchWorkers(static_cast<int>(JobType::kModelLoading) + 1);
+}
 
-  lamp_model_.Draw();
+void FinalScene::QueueSceneLoads() {
+  PROFILE_ZONE;
+  job_system_.JoinWorkers();
+  are_scene_loads_queued_ = true;
+  if (!scene_description_job_.is_valid()) {
+    std::cerr << "Can't load the scene: " << scene_description_job_.error()
+              << '\n';
+    scene_description_.Clear();
+  }
 
-  backpack_model_.mat.Set();
+  // The objects and the jobs point in the models, sized once.
+  const std::size_t model_count = scene_description_.models.size();
+  scene_models_.clear();
+  scene_models_.resize(model_count);
+  model_import_jobs_.clear();
+  model_upload_jobs_.clear();
+  model_import_jobs_.reserve(model_count);
+  model_upload_jobs_.reserve(model_count);
+  for (std::size_t i = 0; i < model_count; i++) {
+    const SceneModelDesc& model = scene_description_.models[i];
+    // Models sharing a path use the first one.
+    if (model.source != i) {
+      continue;
+    }
+    // Imported by the model loading worker, uploaded on the main thread.
+    auto& import_job = model_import_jobs_.emplace_back(
+        &scene_models_[i], model.path, model.flip_uvs);
+    auto& upload_job =
+        model_upload_jobs_.emplace_back(&scene_models_[i], buffer_pool_);
+    upload_job.AddDependency(&import_job);
+    job_system_.AddJob(&import_job);
+  }
 
-  model = glm::mat4(1.0f);
-  model = glm::translate(model, glm::vec3(0, 2.2, 0));
-  model = glm::rotate(model, glm::radians(180.f), glm::vec3(0, 1, 0));
-  pipeline.Bind();
-  pipeline.SetMat4("model", model);
-  pipeline.SetMat4("normalMatrix",
-                   glm::mat4(glm::transpose(glm::inverse(view * model))));
+  // The jobs keep pointers in the buffers, sized before the first job.
+  const std::size_t texture_count = scene_description_.textures.size();
+  scene_files_.clear();
+  scene_files_.resize(texture_count);
+  scene_texture_buffers_.assign(texture_count, TextureBuffer{});
+  scene_textures_.assign(texture_count, 0);
+  read_jobs_.clear();
+  unpack_jobs_.clear();
+  decom_jobs_.clear();
+  gpu_jobs_.clear();
+  read_jobs_.reserve(texture_count);
+  unpack_jobs_.reserve(texture_count);
+  decom_jobs_.reserve(texture_count);
+  gpu_jobs_.reserve(texture_count);
+  packed_texture_count_ = 0;
+
+  for (std::size_t i = 0; i < texture_count; ++i) {
+    const SceneTextureDesc& texture = scene_description_.textures[i];
+    const TextureParameters tex_param(texture.path, GL_REPEAT, GL_LINEAR,
+                                      texture.is_srgb, texture.flip_y);
+
+    // Packed textures are unpacked in parallel on the compute workers, the
+    // others are read by the loading worker.
+    Job* file_job = nullptr;
+    const std::uint32_t entry = asset_archive_.Find(texture.path);
+    if (entry != kAssetArchiveNoEntry) {
+      file_job = &unpack_jobs_.emplace_back(&asset_archive_, entry,
+                                            &scene_files_[i]);
+      packed_texture_count_++;
+    } else {
+      file_job = &read_jobs_.emplace_back(tex_param.image_file_path,
+                                          &scene_files_[i]);
+    }
 
-  backpack_model_.Draw();
+    decom_jobs_.emplace_back(&scene_files_[i], &scene_texture_buffers_[i],
+                             tex_param.flipped_y);
+    decom_jobs_[i].AddDependency(file_job);
 
-  man_model_.mat.Set();
+    gpu_jobs_.emplace_back(&scene_texture_buffers_[i], &scene_textures_[i],
+                           tex_param);
+    gpu_jobs_[i].AddDependency(&decom_jobs_[i]);
 
-  model = glm::mat4(1.0f);
-  model = glm::translate(model, glm::vec3(3, 0.5, -2));
-  model = glm::scale(model, glm::vec3(0.025f));
-  model = glm::rotate(model, glm::radians(180.f), glm::vec3(0, 1, 0));
-  pipeline.Bind();
-  pipeline.SetMat4("model", model);
-  pipeline.SetMat4("normalMatrix",
-                   glm::mat4(glm::transpose(glm::inverse(view * model))));
+    job_system_.AddJob(file_job);
+    job_system_.AddJob(&decom_jobs_[i]);
+    main_thread_jobs_.push(&gpu_jobs_[i]);
 
-  man_model_.Draw();
+    // do not push back jobs otherwise it will explode
+  }
+  // The main thread uploads the models once the textures are done.
+  for (auto& upload_job : model_upload_jobs_) {
+    main_thread_jobs_.push(&upload_job);
+  }
 
-  steel_.Set();
+  job_system_.LaunchWorkers(static_cast<int>(JobType::kModelLoading) + 1);
+}
 
-  model = glm::mat4(1.0f);
-  model = glm::translate(model, glm::vec3(6, 0.5, -8));
-  model = glm::scale(model, glm::vec3(0.025f));
-  model = glm::rotate(model, glm::radians(-110.f), glm::vec3(0, 1, 0));
-  pipeline.Bind();
-  pipeline.SetMat4("model", model);
-  pipeline.SetMat4("normalMatrix",
-                   glm::mat4(glm::transpose(glm::inverse(view * model))));
+void FinalScene::ApplySceneDescription() {
+  PROFILE_ZONE;
+  const SceneDescription& scene = scene_description_;
+  scene_materials_.assign(scene.materials.size(), Material{});
+  for (std::size_t i = 0; i < scene.materials.size(); i++) {
+    Material& scene_material = scene_materials_[i];
+    const std::array<GLuint*, kSceneMaterialMapCount> maps = {
+        &scene_material.albedo, &scene_material.normal, &scene_material.ao,
+        &scene_material.metallic, &scene_material.roughness};
+    for (std::size_t map = 0; map < maps.size(); map++) {
+      const std::uint32_t texture = scene.materials[i].textures[map];
+      *maps[map] = texture == SceneMaterialDesc::kNoTexture
+                       ? 0
+                       : scene_textures_[texture];
+    }
+  }
 
-  man_model_.Draw();
+  scene_lights_.clear();
+  for (const auto& light : scene.lights) {
+    scene_lights_.push_back(
+        {light.position, light.position, light.color, light.radius});
+  }
+  if (scene_lights_.empty()) {
+    std::cerr << "The scene has no light, adding one\n";
+    scene_lights_.push_back(
+        {kDefaultLightPos, kDefaultLightPos, kDefaultLightColor, 1.f});
+  }
 
-  titanium_.Set();
+  // The description validated the names, they index its vectors.
+  scene_objects_.clear();
+  scene_objects_.reserve(scene.objects.size());
+  for (const auto& desc : scene.objects) {
+    SceneObject object;
+    if (!desc.model.empty()) {
+      object.model = &scene_models_[scene.FindModel(desc.model)->source];
+    } else if (desc.mesh == "ground") {
+      object.mesh = &cube_ground_;
+    } else if (desc.mesh == "sphere") {
+      object.mesh = &sphere_;
+      object.is_sphere = true;
+    } else {
+      std::cerr << "The scene has no mesh named " << desc.mesh << '\n';
+      continue;
+    }
+    object.material =
+        desc.material.empty()
+            ? &default_material_
+            : &scene_materials_[scene.FindMaterial(desc.material) -
+                                scene.materials.data()];
+    if (!desc.light.empty()) {
+      object.light = static_cast<std::uint32_t>(scene.FindLight(desc.light) -
+                                                scene.lights.data());
+    }
+    object.placement = desc.transform;
+    object.is_dynamic = desc.is_dynamic;
+    scene_objects_.push_back(object);
+  }
+}
 
-  model = glm::mat4(1.0f);
-  model = glm::translate(model, glm::vec3(-6, 0.5, -5));
-  model = glm::scale(model, glm::vec3(0.025f));
-  model = glm::rotate(model, glm::radians(110.f), glm::vec3(0, 1, 0));
+void FinalScene::DrawObjects(Pipeline& pipeline) {
+  PROFILE_ZONE;
   pipeline.Bind();
-  pipeline.SetMat4("model", model);
-  pipeline.SetMat4("normalMatrix",
-                   glm::mat4(glm::transpose(glm::inverse(view * model))));
-
-  man_model_.Draw();
+  for (const auto& object : scene_objects_) {
+    if (!IsObjectVisible(object)) {
+      continue;
+    }
+    object.material->Set();
+    if (object.model == nullptr) {
+      SetEntryUniforms(object.first_entry);
+      object.mesh->Draw(object.is_sphere);
+      continue;
+    }
+    // Each mesh is placed by its node.
+    const std::uint8_t* visibility = ObjectVisibility(object);
+    for (std::size_t i = 0; i < object.model->meshes().size(); i++) {
+      if (visibility[i]) {
+        SetEntryUniforms(object.first_entry + static_cast<std::uint32_t>(i));
+        object.model->DrawMesh(i);
+      }
+    }
+  }
 }
 
-void FinalScene::DeleteModels() {
-  lamp_model_.Clear();
-  man_model_.Clear();
-  backpack_model_.Clear();
-
-  steel_.Clear();
-  titanium_.Clear();
+void FinalScene::DeleteObjects() {
+  // The textures of the materials are deleted with the scene textures.
+  for (auto& scene_model : scene_models_) {
+    scene_model.Clear();
+  }
+  scene_models_.clear();
+  scene_materials_.clear();
+  scene_objects_.clear();
+  scene_lights_.clear();
 }
 
-void FinalScene::UpdateSpheres(Pipeline& pipeline) {
-#ifdef TRACY_ENABLE
-  ZoneScoped;
-#endif
-  steel_.Set();
-
-  model = glm::mat4(1.0f);
-  model = glm::translate(model, glm::vec3(5.2, 1.8, -6));
-  pipeline.Bind();
-  pipeline.SetMat4("model", model);
-  pipeline.SetMat4("normalMatrix",
-                   glm::mat4(glm::transpose(glm::inverse(view * model))));
+void FinalScene::BeginCulling() {
+  PROFILE_ZONE;
+  culling_set_.Clear();
+  entry_boxes_.clear();
+  entry_spheres_.clear();
+  entry_entities_.clear();
+  transforms_.Clear();
+  // One culling entry per mesh.
+  // ---------------------------
+  std::vector<std::uint32_t> node_entities;
+  for (auto& object : scene_objects_) {
+    // The objects moving with a light start where it is.
+    Transform placement = object.placement;
+    if (object.light != kNoSceneLight) {
+      const SceneLight& light = scene_lights_[object.light];
+      placement.position += light.position - light.rest_position;
+    }
+    object.entity = transforms_.Create(placement);
+    object.first_entry = static_cast<std::uint32_t>(entry_boxes_.size());
+    object.is_moved = true;
+    if (object.model == nullptr) {
+      entry_boxes_.push_back(object.mesh->bounds_);
+      entry_spheres_.push_back(object.mesh->bounding_sphere_);
+      entry_entities_.push_back(object.entity);
+      object.end_entry = object.first_entry + 1;
+      continue;
+    }
+    // The model hierarchy goes under the object.
+    const Model& model = *object.model;
+    node_entities.clear();
+    for (const auto& node : model.nodes()) {
+      node_entities.push_back(transforms_.Create(
+          node.local, node.parent == TransformStore::kNoParent
+                          ? object.entity
+                          : node_entities[node.parent]));
+    }
+    for (std::size_t mesh = 0; mesh < model.meshes().size(); mesh++) {
+      entry_boxes_.push_back(model.meshes()[mesh].bounds_);
+      entry_spheres_.push_back(model.meshes()[mesh].bounding_sphere_);
+      entry_entities_.push_back(node_entities[model.mesh_nodes()[mesh]]);
+    }
+    object.end_entry = static_cast<std::uint32_t>(entry_boxes_.size());
+  }
+  transform_stats_ = transforms_.Update(job_system_);
+  for (std::size_t entry = 0; entry < entry_boxes_.size(); entry++) {
+    culling_set_.Add(entry_boxes_[entry], entry_spheres_[entry],
+                     transforms_.world(entry_entities_[entry]));
+  }
+  visibility_.assign(culling_set_.size(), 1);
+}
 
-  sphere_.Draw(true);
+void FinalScene::MoveObject(const SceneObject& object,
+                            const glm::vec3& position) {
+  // The culling entries follow in UpdateTransforms.
+  transforms_.SetPosition(object.entity, position);
+}
 
-  titanium_.Set();
+void FinalScene::CullObjects(const glm::mat4& view_projection,
+                             CullingStats& stats) {
+  stats = culler_.Cull(job_system_, Frustum::FromMatrix(view_projection),
+                       culling_set_, visibility_);
+}
 
-  model = glm::mat4(1.0f);
-  model = glm::translate(model, glm::vec3(-5, 1.8, -9));
+bool FinalScene::IsObjectVisible(const SceneObject& object) const noexcept {
+  for (std::uint32_t i = object.first_entry; i < object.end_entry; i++) {
+    if (visibility_[i]) {
+      return true;
+    }
+  }
+  return false;
+}
 
-  pipeline.Bind();
-  pipeline.SetMat4("model", model);
-  pipeline.SetMat4("normalMatrix",
-                   glm::mat4(glm::transpose(glm::inverse(view * model))));
+void FinalScene::SetEntryUniforms(const std::uint32_t entry) {
+  // Only the shadow pass draws immediately, the G-buffer pass records its
+  // uniforms in command buffers. Std140 layout of ShadowObjectBlock.
+  struct ShadowObject {
+    glm::mat4 model;
+    glm::ivec4 face_mask;
+  };
+  const FrameAllocation allocation = frame_ring_.Allocate(sizeof(ShadowObject));
+  if (!allocation.IsValid()) {
+    return;
+  }
+  const ShadowObject data{transforms_.world(entry_entities_[entry]),
+                          glm::ivec4(visibility_[entry], 0, 0, 0)};
+  std::memcpy(allocation.data, &data, sizeof(data));
+  frame_ring_.BindRange(GL_UNIFORM_BUFFER, kShadowObjectBinding, allocation);
+}
 
-  sphere_.Draw(true);
+const std::uint8_t* FinalScene::ObjectVisibility(
+    const SceneObject& object) const noexcept {
+  return visibility_.data() + object.first_entry;
 }
 
 void FinalScene::BeginBloom() {
-#ifdef TRACY_ENABLE
-  ZoneScoped;
-#endif
-  hdr_pipe_.LoadShader("data/shaders/final/screen_tex.vert",
-                       "data/shaders/final/hdr.frag");
-  hdr_pipe_.LoadProgram();
-
-  hdr_pipe_.Bind();
-  hdr_pipe_.SetInt("hdrBuffer", 0);
-  hdr_pipe_.SetInt("bloomBlur", 1);
+  PROFILE_ZONE;
+  // Core profile draws need a vertex array, even without attribute.
+  glGenVertexArrays(1, &fullscreen_vao_);
+  BuildPostPipeline();
 
-  down_sample_pipe_.LoadShader("data/shaders/final/screen_tex.vert",
+  down_sample_pipe_.LoadShader("data/shaders/final/fullscreen_triangle.vert",
                                "data/shaders/final/down_sample.frag");
 
   down_sample_pipe_.LoadProgram();
@@ -1076,7 +1950,7 @@ void FinalScene::BeginBloom() {
   down_sample_pipe_.Bind();
   down_sample_pipe_.SetInt("srcTexture", 0);
 
-  up_sample_pipe_.LoadShader("data/shaders/final/screen_tex.vert",
+  up_sample_pipe_.LoadShader("data/shaders/final/fullscreen_triangle.vert",
                              "data/shaders/final/up_sample.frag");
 
   up_sample_pipe_.LoadProgram();
@@ -1084,37 +1958,46 @@ void FinalScene::BeginBloom() {
   up_sample_pipe_.Bind();
   up_sample_pipe_.SetInt("srcTexture", 0);
 
-  constexpr auto mip_chain_length = 5;
-  glGenFramebuffers(1, &bloom_fbo_);
-  glBindFramebuffer(GL_FRAMEBUFFER, bloom_fbo_);
-
-  glm::vec2 mip_size(Metrics::width_, Metrics::height_);
-  glm::ivec2 mip_int_size(Metrics::width_, Metrics::height_);
-
-  bloom_mips_.reserve(mip_chain_length);
-
-  for (unsigned int i = 0; i < mip_chain_length; i++) {
-    BloomMip mip;
-
-    mip_size *= 0.5f;
-    mip_int_size /= 2;
-    mip.size = mip_size;
-
-    glGenTextures(1, &mip.texture);
-    glBindTexture(GL_TEXTURE_2D, mip.texture);
-    // we are downscaling an HDR color buffer, so we need a float texture
-    // format
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, mip_size.x, mip_size.y, 0, GL_RGB,
-                 GL_FLOAT, nullptr);
+  bloom_down_pipe_.LoadComputeShader("data/shaders/final/bloom_down.comp");
+  bloom_down_pipe_.LoadProgram();
+  bloom_down_pipe_.Bind();
+  bloom_down_pipe_.SetInt("srcTexture", 0);
+
+  bloom_up_pipe_.LoadComputeShader("data/shaders/final/bloom_up.comp");
+  bloom_up_pipe_.LoadProgram();
+  bloom_up_pipe_.Bind();
+  bloom_up_pipe_.SetInt("srcTexture", 0);
+  bloom_up_pipe_.SetFloat("filterRadius", kBloomFilterRadius);
+
+  // Immutable storage, required by the views and the image stores. We are
+  // downscaling an HDR color buffer, the bloom is never negative and
+  // R11F_G11F_B10F halves the bytes of RGBA16F.
+  glm::ivec2 level_size(Metrics::width_, Metrics::height_);
+  for (auto& size : bloom_sizes_) {
+    level_size = glm::max(level_size / 2, glm::ivec2(1));
+    size = level_size;
+  }
+  glGenTextures(1, &bloom_tex_);
+  glBindTexture(GL_TEXTURE_2D, bloom_tex_);
+  glTexStorage2D(GL_TEXTURE_2D, kBloomLevelCount, GL_R11F_G11F_B10F,
+                 bloom_sizes_[0].x, bloom_sizes_[0].y);
+
+  glGenTextures(kBloomLevelCount, bloom_views_.data());
+  for (GLuint level = 0; level < kBloomLevelCount; level++) {
+    glTextureView(bloom_views_[level], GL_TEXTURE_2D, bloom_tex_,
+                  GL_R11F_G11F_B10F, level, 1, 0, 1);
+    glBindTexture(GL_TEXTURE_2D, bloom_views_[level]);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    bloom_mips_.push_back(mip);
   }
+
+  // Only the fragment chain renders to the levels.
+  glGenFramebuffers(1, &bloom_fbo_);
+  glBindFramebuffer(GL_FRAMEBUFFER, bloom_fbo_);
   glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
-                         bloom_mips_[0].texture, 0);
+                         bloom_views_[0], 0);
 
   // setup attachments
   constexpr std::array<GLuint, 1> attachments = {GL_COLOR_ATTACHMENT0};
@@ -1124,164 +2007,287 @@ void FinalScene::BeginBloom() {
   int status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
 
   if (status != GL_FRAMEBUFFER_COMPLETE) {
-    std::cerr << "G-buffer FBO error, status : " << status << '\n';
+    std::cerr << "Bloom FBO error, status : " << status << '\n';
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
   }
 
   glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
+  // The scene color and the depth come from the render graph.
   glGenFramebuffers(1, &hdr_fbo_);
-  glBindFramebuffer(GL_FRAMEBUFFER, hdr_fbo_);
-
-  glGenTextures(1, &scene_tex_);
-  glBindTexture(GL_TEXTURE_2D, scene_tex_);
-
-  // Specify texture storage and parameters
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, Metrics::width_, Metrics::height_,
-               0, GL_RGBA, GL_FLOAT, NULL);
-
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
-                         scene_tex_, 0);
-
-  glGenTextures(1, &bright_tex_);
-
-  glBindTexture(GL_TEXTURE_2D, bright_tex_);
+  glGenFramebuffers(1, &lighting_fbo_);
+}
 
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, Metrics::width_, Metrics::height_,
-               0, GL_RGBA, GL_FLOAT, NULL);
+void FinalScene::BuildPostPipeline() {
+  post_pipe_.Delete();
+  post_pipe_.LoadShaderSource(
+      "data/shaders/final/fullscreen_triangle.vert",
+      post_stack_.GenerateShader(
+          LoadFile("data/shaders/final/post_stack.frag")));
+  post_pipe_.LoadProgram();
+  post_key_ = post_stack_.Key();
+
+  post_pipe_.Bind();
+  post_pipe_.SetInt("hdrBuffer", 0);
+  if (post_stack_.IsActive(PostEffect::kBloom)) {
+    post_pipe_.SetInt("bloomBlur", 1);
+    post_pipe_.SetInt("bloomBlurLow", 2);
+    post_pipe_.SetFloat("filterRadius", kBloomFilterRadius);
+    post_pipe_.SetFloat("bloomStrength", kBloomStrength);
+  }
+}
 
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+void FinalScene::DrawFullscreenTriangle() {
+  glBindVertexArray(fullscreen_vao_);
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+}
 
-  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D,
-                         bright_tex_, 0);
+void FinalScene::UpdatePostStack() {
+  PROFILE_ZONE;
+  if (post_key_ != post_stack_.Key()) {
+    BuildPostPipeline();
+  }
+  GPU_PROFILE_ZONE(gpu_profiler_, kGpuZonePost);
 
-  glGenRenderbuffers(1, &hdr_rbo_);
-  glBindRenderbuffer(GL_RENDERBUFFER, hdr_rbo_);
+  // Every pixel is written, no clear needed.
+  glViewport(0, 0, Metrics::width_, Metrics::height_);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glDisable(GL_DEPTH_TEST);
+  glDisable(GL_CULL_FACE);
+  post_pipe_.Bind();
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, scene_tex_);
+  if (post_stack_.IsActive(PostEffect::kBloom)) {
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, bloom_views_[0]);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, bloom_views_[1]);
+  }
 
-  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, Metrics::width_,
-                        Metrics::height_);
+  DrawFullscreenTriangle();
+}
 
-  // Attach renderbuffer to framebuffer
-  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
-                            GL_RENDERBUFFER, hdr_rbo_);
+void FinalScene::UpdateBloom() {
+  PROFILE_ZONE;
+  // Culled when the composite doesn't read the chain.
+  if (!render_graph_.IsPassAlive(render_graph_bloom_pass_)) {
+    return;
+  }
+  GPU_PROFILE_ZONE(gpu_profiler_, kGpuZoneBloom);
+  glDisable(GL_DEPTH_TEST);
+  glDisable(GL_CULL_FACE);
 
-  // Specify the color attachments to be drawn
-  constexpr std::array<GLuint, 2> hdr_attachments = {GL_COLOR_ATTACHMENT0,
-                                                     GL_COLOR_ATTACHMENT1};
-  glDrawBuffers(2, hdr_attachments.data());
+  if (is_bloom_compute_) {
+    DownsampleBloomCompute();
+    UpsampleBloomCompute();
+  } else {
+    DownsampleBloomFragment();
+    UpsampleBloomFragment();
+  }
+}
 
-  // Check framebuffer completeness
-  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-    std::cout << "Framebuffer not complete!" << std::endl;
+void FinalScene::DownsampleBloomCompute() {
+  PROFILE_ZONE;
+  static constexpr GLuint kGroupSize = 8;
+  bloom_down_pipe_.Bind();
+  glActiveTexture(GL_TEXTURE0);
+  glm::ivec2 source_size(Metrics::width_, Metrics::height_);
+  GLuint source = scene_tex_;
+  // The first dispatch reads the scene and does the bright pass.
+  bloom_down_pipe_.SetFloat("threshold", BloomThreshold());
+  for (GLsizei level = 0; level < kBloomLevelCount; level += 2) {
+    const bool has_second = level + 1 < kBloomLevelCount;
+    const glm::ivec2 first_size = bloom_sizes_[level];
+    const glm::ivec2 second_size =
+        has_second ? bloom_sizes_[level + 1] : glm::ivec2(0);
+    bloom_down_pipe_.SetVec2("srcResolution", glm::vec2(source_size));
+    bloom_down_pipe_.SetIVec2("firstSize", first_size);
+    bloom_down_pipe_.SetIVec2("secondSize", second_size);
+    bloom_down_pipe_.SetInt("writeSecond", has_second ? 1 : 0);
+    glBindTexture(GL_TEXTURE_2D, source);
+    glBindImageTexture(0, bloom_tex_, level, GL_FALSE, 0, GL_WRITE_ONLY,
+                       GL_R11F_G11F_B10F);
+    glBindImageTexture(1, bloom_tex_, has_second ? level + 1 : level,
+                       GL_FALSE, 0, GL_WRITE_ONLY, GL_R11F_G11F_B10F);
+
+    // A group writes 16 x 16 texels of the first level and 8 x 8 of the
+    // second one.
+    const auto groups = [](const int size, const int texels_per_group) {
+      return static_cast<GLuint>((size + texels_per_group - 1) /
+                                 texels_per_group);
+    };
+    glDispatchCompute(std::max(groups(first_size.x, 2 * kGroupSize),
+                               groups(second_size.x, kGroupSize)),
+                      std::max(groups(first_size.y, 2 * kGroupSize),
+                               groups(second_size.y, kGroupSize)),
+                      1);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT |
+                    GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+    const GLsizei last = has_second ? level + 1 : level;
+    source = bloom_views_[last];
+    source_size = bloom_sizes_[last];
+    bloom_down_pipe_.SetFloat("threshold", -1.f);
   }
+}
 
-  // Unbind the framebuffer
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+void FinalScene::UpsampleBloomCompute() {
+  PROFILE_ZONE;
+  static constexpr GLuint kGroupSize = 8;
+  bloom_up_pipe_.Bind();
+  glActiveTexture(GL_TEXTURE0);
+  // Level 0 is upsampled into by the composite pass.
+  for (GLsizei level = kBloomLevelCount - 2; level > 0; level--) {
+    const glm::ivec2 size = bloom_sizes_[level];
+    bloom_up_pipe_.SetIVec2("dstSize", size);
+    glBindTexture(GL_TEXTURE_2D, bloom_views_[level + 1]);
+    glBindImageTexture(0, bloom_tex_, level, GL_FALSE, 0, GL_READ_WRITE,
+                       GL_R11F_G11F_B10F);
+    glDispatchCompute((size.x + kGroupSize - 1) / kGroupSize,
+                      (size.y + kGroupSize - 1) / kGroupSize, 1);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT |
+                    GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+  }
 }
 
-void FinalScene::UpdateBloom() {
-#ifdef TRACY_ENABLE
-  ZoneScoped;
-#endif
+void FinalScene::DownsampleBloomFragment() {
+  PROFILE_ZONE;
   glBindFramebuffer(GL_FRAMEBUFFER, bloom_fbo_);
-  glDisable(GL_DEPTH_TEST);
-  glDisable(GL_CULL_FACE);
-
   down_sample_pipe_.Bind();
 
   down_sample_pipe_.SetVec2("srcResolution",
                             glm::vec2(Metrics::width_, Metrics::height_));
+  down_sample_pipe_.SetFloat("threshold", BloomThreshold());
 
   // Bind srcTexture (HDR color buffer) as initial texture input
-  glBindTexture(GL_TEXTURE_2D, bright_tex_);
   glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, scene_tex_);
 
   // Progressively downsample through the mip chain.
-  for (int i = 0; i < bloom_mips_.size(); i++) {
-    const BloomMip& mip = bloom_mips_[i];
+  for (GLsizei level = 0; level < kBloomLevelCount; level++) {
+    const glm::ivec2 size = bloom_sizes_[level];
 
-    glViewport(0, 0, mip.size.x, mip.size.y);
+    glViewport(0, 0, size.x, size.y);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
-                           mip.texture, 0);
+                           bloom_views_[level], 0);
 
-    // Render screen-filled quad of resolution of current mip
-    quad_screen_.Draw();
+    // Render screen-filled triangle of resolution of current mip
+    DrawFullscreenTriangle();
 
     // Set current mip resolution as srcResolution for next iteration
-    down_sample_pipe_.SetVec2("srcResolution", mip.size);
+    down_sample_pipe_.SetVec2("srcResolution", glm::vec2(size));
+    down_sample_pipe_.SetFloat("threshold", -1.f);
     // Set current mip as texture input for next iteration
-    glBindTexture(GL_TEXTURE_2D, mip.texture);
+    glBindTexture(GL_TEXTURE_2D, bloom_views_[level]);
   }
+}
 
+void FinalScene::UpsampleBloomFragment() {
+  PROFILE_ZONE;
   up_sample_pipe_.Bind();
-  up_sample_pipe_.SetFloat("filterRadius", 0.007);
+  up_sample_pipe_.SetFloat("filterRadius", kBloomFilterRadius);
 
   // Enable additive blending
   glEnable(GL_BLEND);
   glBlendFunc(GL_ONE, GL_ONE);
   glBlendEquation(GL_FUNC_ADD);
 
-  for (int i = bloom_mips_.size() - 1; i > 0; i--) {
-    const BloomMip& mip = bloom_mips_[i];
-    const BloomMip& nextMip = bloom_mips_[i - 1];
+  // Level 0 is upsampled into by the composite pass.
+  for (GLsizei level = kBloomLevelCount - 2; level > 0; level--) {
+    const glm::ivec2 size = bloom_sizes_[level];
 
     // Bind viewport and texture from where to read
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, mip.texture);
+    glBindTexture(GL_TEXTURE_2D, bloom_views_[level + 1]);
 
     // Set framebuffer render target (we write to this texture)
-    glViewport(0, 0, nextMip.size.x, nextMip.size.y);
+    glViewport(0, 0, size.x, size.y);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
-                           nextMip.texture, 0);
+                           bloom_views_[level], 0);
 
-    // Render screen-filled quad of resolution of current mip
-    quad_screen_.Draw();
+    // Render screen-filled triangle of resolution of current mip
+    DrawFullscreenTriangle();
   }
 
   // Disable additive blending
-  // glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA); // Restore if this was default
   glDisable(GL_BLEND);
-
-  glViewport(0, 0, Metrics::width_, Metrics::height_);
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
-  glDisable(GL_DEPTH_TEST);
-  glDisable(GL_CULL_FACE);
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER);
-  hdr_pipe_.Bind();
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, scene_tex_);
-  glActiveTexture(GL_TEXTURE1);
-  glBindTexture(GL_TEXTURE_2D, bloom_mips_[0].texture);
-  hdr_pipe_.SetFloat("bloomStrength", 0.04f);
-
-  quad_screen_.Draw();
 }
 
 void FinalScene::DeleteBloom() {
-  for (int i = 0; i < bloom_mips_.size(); i++) {
-    glDeleteTextures(1, &bloom_mips_[i].texture);
-    bloom_mips_[i].texture = 0;
-  }
+  glDeleteTextures(kBloomLevelCount, bloom_views_.data());
+  glDeleteTextures(1, &bloom_tex_);
+  bloom_views_ = {};
+  bloom_tex_ = 0;
   glDeleteFramebuffers(1, &bloom_fbo_);
   bloom_fbo_ = 0;
-  bloom_mips_.clear();
-  hdr_pipe_.Delete();
+  glDeleteFramebuffers(1, &hdr_fbo_);
+  glDeleteFramebuffers(1, &lighting_fbo_);
+  hdr_fbo_ = 0;
+  lighting_fbo_ = 0;
+  post_pipe_.Delete();
+  glDeleteVertexArrays(1, &fullscreen_vao_);
+  fullscreen_vao_ = 0;
   up_sample_pipe_.Delete();
   down_sample_pipe_.Delete();
+  bloom_down_pipe_.Delete();
+  bloom_up_pipe_.Delete();
+}
+
+void FinalScene::DrawGpuProfiler() {
+  const GpuTimingHistory& history = gpu_profiler_.history();
+  const ImGuiIO& io = ImGui::GetIO();
+  ImGui::SetNextWindowPos(ImVec2(io.DisplaySize.x - 10.f, 10.f),
+                          ImGuiCond_FirstUseEver, ImVec2(1.f, 0.f));
+  ImGui::SetNextWindowBgAlpha(0.6f);
+  if (!ImGui::Begin("GPU profiler", &show_gpu_overlay_,
+                    ImGuiWindowFlags_AlwaysAutoResize)) {
+    ImGui::End();
+    return;
+  }
+  float total = 0.f;
+  float max = 0.f;
+  for (std::size_t zone = 0; zone < history.zone_count(); zone++) {
+    total += history.Average(zone);
+    max = std::max(max, history.Max(zone));
+  }
+  ImGui::Text("%.3f ms per frame, %zu frames, %zu dropped", total,
+              history.frame_count(), gpu_profiler_.dropped_frame_count());
+  const FrameRingStats& ring = frame_ring_.stats();
+  ImGui::Text("Frame ring: %.1f KB, peak %.1f / %.1f KB, %zu grown",
+              static_cast<float>(ring.frame_bytes) / 1024.f,
+              static_cast<float>(ring.peak_frame_bytes) / 1024.f,
+              static_cast<float>(frame_ring_.partition_size()) / 1024.f,
+              static_cast<std::size_t>(ring.grow_count));
+  ImGui::Text("Frame ring stalls: %zu, %.3f ms, last %.3f ms",
+              static_cast<std::size_t>(ring.stall_count),
+              ring.wait_milliseconds,
+              ring.last_wait_milliseconds);
+  // Same scale for every graph, the passes can be compared by eye.
+  for (std::size_t zone = 0; zone < history.zone_count(); zone++) {
+    std::array<char, 32> overlay{};
+    std::snprintf(overlay.data(), overlay.size(), "%.3f ms",
+                  history.Average(zone));
+    ImGui::PlotLines(history.zone_names()[zone].c_str(), history.Values(zone),
+                     static_cast<int>(GpuTimingHistory::kFrameCount),
+                     history.offset(), overlay.data(), 0.f, max,
+                     ImVec2(240.f, 32.f));
+  }
+  if (ImGui::Button("Export CSV")) {
+    std::cout << (history.WriteCsv("gpu_timings.csv")
+                      ? "GPU timings written to gpu_timings.csv\n"
+                      : "Can't write gpu_timings.csv\n");
+  }
+  ImGui::SameLine();
+  if (ImGui::Button("Export JSON")) {
+    std::cout << (history.WriteJson("gpu_timings.json")
+                      ? "GPU timings written to gpu_timings.json\n"
+                      : "Can't write gpu_timings.json\n");
+  }
+  ImGui::End();
 }
 
 void FinalScene::DrawImgui() {
-#ifdef TRACY_ENABLE
-  ZoneScoped;
-#endif
+  PROFILE_ZONE;
   if (is_initialized_) {
     ImGui::TextWrapped("CONTROLS:");
     ImGui::TextWrapped("W - move forward");
@@ -1293,6 +2299,319 @@ void FinalScene::DrawImgui() {
     ImGui::TextWrapped("SPACE - move up");
     ImGui::Spacing();
     ImGui::TextWrapped("LEFT MOUSE CLICK AND MOVE MOUSE - move camera");
+
+    if (ImGui::CollapsingHeader("Image based lighting")) {
+      if (ibl_report_.is_hit) {
+        ImGui::Text("Loaded from cache in %.1f ms", ibl_report_.milliseconds);
+        ImGui::Text("Bake took %.1f ms, saved %.1f ms",
+                    ibl_report_.bake_milliseconds,
+                    ibl_report_.SavedMilliseconds());
+      } else {
+        ImGui::Text("Baked in %.1f ms, %s", ibl_report_.bake_milliseconds,
+                    ibl_report_.is_saved ? "cached for the next launch"
+                                         : "failed to write the cache");
+      }
+      ImGui::Text("Cache: %.1f MB", ToMegabytes(ibl_report_.byte_size));
+      ImGui::Text("Environment: %ux%u, %u mips", environment_size_,
+                  environment_size_, EnvironmentLevelCount());
+      for (const auto& entry : ibl_memory_.entries()) {
+        ImGui::BulletText("%s: %.2f MB%s", entry.name.c_str(),
+                          ToMegabytes(entry.bytes),
+                          entry.is_freed ? " (freed)" : "");
+      }
+      // The fixed 4096 RGB16F capture with its depth buffer, the irradiance
+      // cubemap and the full prefilter chain this replaced.
+      const std::size_t fixed_capture_bytes =
+          TextureByteSize(4096, 4096, 6, 6) + TextureByteSize(4096, 4096, 4) +
+          TextureByteSize(32, 32, 6, 6) + TextureByteSize(128, 128, 6, 6, 8) +
+          TextureByteSize(1024, 1024, 4);
+      ImGui::Text("Resident: %.1f MB, fixed size capture: %.1f MB",
+                  ToMegabytes(ibl_memory_.ResidentBytes()),
+                  ToMegabytes(fixed_capture_bytes));
+      if (ImGui::Button("Project irradiance again")) {
+        ProjectIrradiance(tm_.LoadHDRImage(kIblSourcePath));
+        UploadIrradianceSh();
+      }
+      const ShProjectionStats& sh_stats = sh_projector_.stats();
+      if (sh_stats.texel_count > 0) {
+        ImGui::Text("SH projection: %zu texels in %.2f ms",
+                    sh_stats.texel_count, sh_stats.milliseconds);
+      }
+    }
+
+    if (ImGui::CollapsingHeader("G-buffer")) {
+      const auto width = static_cast<int>(Metrics::width_);
+      const auto height = static_cast<int>(Metrics::height_);
+      const SsaoPreset& ssao = kSsaoPresets[ssao_preset_index_];
+      const GBufferTraffic traffic =
+          EstimateGBufferTraffic(kCompactGBufferLayout, width, height, ssao);
+      const GBufferTraffic legacy_traffic =
+          EstimateGBufferTraffic(kLegacyGBufferLayout, width, height, ssao);
+      ImGui::TextWrapped("%s", kCompactGBufferLayout.name);
+      ImGui::Text("Geometry pass: %u bytes per pixel, was %u",
+                  kCompactGBufferLayout.write_bytes,
+                  kLegacyGBufferLayout.write_bytes);
+      ImGui::Text("Estimated traffic per frame:");
+      ImGui::Text("  Geometry %.1f MB, lighting %.1f MB, SSAO %.1f MB",
+                  ToMegabytes(traffic.geometry_bytes),
+                  ToMegabytes(traffic.lighting_bytes),
+                  ToMegabytes(traffic.ssao_bytes));
+      ImGui::Text("  Total %.1f MB, was %.1f MB (%.0f%%)",
+                  ToMegabytes(traffic.Total()),
+                  ToMegabytes(legacy_traffic.Total()),
+                  100.f * static_cast<float>(traffic.Total()) /
+                      static_cast<float>(legacy_traffic.Total()));
+      ImGui::Text("  %.1f GB/s at 60 frames per second",
+                  static_cast<float>(traffic.Total()) * 60.f / 1e9f);
+    }
+
+    if (ImGui::CollapsingHeader("Command buffers")) {
+      const CommandBufferStats& stats = g_buffer_command_stats_;
+      ImGui::Text("G-buffer: %zu draws, %zu commands in %zu buffers, %.1f KB",
+                  stats.draw_count, stats.command_count, stats.buffer_count,
+                  static_cast<float>(stats.byte_count) / 1024.f);
+      ImGui::Text("Record %.3f ms, replay %.3f ms", stats.record_milliseconds,
+                  stats.replay_milliseconds);
+      if (ImGui::Button("Run null backend benchmark")) {
+        benchmark_command_stats_ = RunCommandBufferBenchmark(
+            job_system_, kCommandBenchmarkDrawCount, 10);
+      }
+      const CommandBufferStats& benchmark = benchmark_command_stats_;
+      if (benchmark.draw_count > 0) {
+        ImGui::Text("%zu draws, %zu commands in %zu buffers, %.1f MB",
+                    benchmark.draw_count, benchmark.command_count,
+                    benchmark.buffer_count, ToMegabytes(benchmark.byte_count));
+        ImGui::Text("Record %.2f ms, replay %.2f ms",
+                    benchmark.record_milliseconds,
+                    benchmark.replay_milliseconds);
+      }
+    }
+
+    if (ImGui::CollapsingHeader("Ambient occlusion")) {
+      std::array<const char*, kSsaoPresets.size()> preset_names{};
+      for (std::size_t i = 0; i < kSsaoPresets.size(); i++) {
+        preset_names[i] = kSsaoPresets[i].name;
+      }
+      ImGui::Combo("Quality", &ssao_preset_index_, preset_names.data(),
+                   static_cast<int>(preset_names.size()));
+      const SsaoPreset& preset = kSsaoPresets[ssao_preset_index_];
+      const auto width = static_cast<int>(Metrics::width_);
+      const auto height = static_cast<int>(Metrics::height_);
+      // Against the former full resolution 64 samples pass.
+      const std::size_t taps = SsaoSampleTaps(preset, width, height);
+      const std::size_t reference_taps =
+          SsaoSampleTaps(kSsaoPresets.back(), width, height);
+      ImGui::Text("%d x %d, %d samples, blur radius %d", ssao_size_.x,
+                  ssao_size_.y, preset.sample_count, preset.blur_radius);
+      ImGui::Text("%.1f M samples per frame, %.1fx fewer than full resolution",
+                  static_cast<float>(taps) / 1e6f,
+                  static_cast<float>(reference_taps) /
+                      static_cast<float>(taps));
+      if (preset.is_temporal) {
+        ImGui::Text("Temporal: %.0f%% of this frame, about %.0f frames "
+                    "accumulated",
+                    kSsaoTemporalBlend * 100.f, 1.f / kSsaoTemporalBlend);
+      }
+    }
+
+    if (ImGui::CollapsingHeader("Clustered lights")) {
+      ImGui::SliderInt("Point lights", &point_light_count_, 0,
+                       kMaxPointLights);
+      ImGui::Checkbox("Animate point lights", &animate_point_lights_);
+      ImGui::Text("%d x %d x %d clusters", ClusterGrid::kCountX,
+                  ClusterGrid::kCountY, ClusterGrid::kCountZ);
+      ImGui::Text("Assignment: %zu lights in %.3f ms",
+                  cluster_stats_.light_count, cluster_stats_.milliseconds);
+      ImGui::Text("%zu indices, %.1f lights per cluster, at most %u",
+                  cluster_stats_.index_count,
+                  static_cast<float>(cluster_stats_.index_count) /
+                      ClusterGrid::kClusterCount,
+                  cluster_stats_.max_cluster_light_count);
+      if (ImGui::Button("Run assignment benchmark")) {
+        for (std::size_t i = 0; i < kClusterBenchmarkLightCounts.size(); i++) {
+          cluster_benchmark_stats_[i] = RunClusterBenchmark(
+              job_system_, kClusterBenchmarkLightCounts[i], 20);
+        }
+      }
+      for (const auto& stats : cluster_benchmark_stats_) {
+        if (stats.light_count > 0) {
+          ImGui::Text("%5zu lights: %.3f ms, %zu indices", stats.light_count,
+                      stats.milliseconds, stats.index_count);
+        }
+      }
+    }
+
+    ImGui::Checkbox("GPU profiler", &show_gpu_overlay_);
+    if (show_gpu_overlay_) {
+      DrawGpuProfiler();
+    }
+
+    if (ImGui::CollapsingHeader("Post-processing")) {
+      for (std::size_t i = 0; i < kPostEffects.size(); i++) {
+        const auto effect = static_cast<PostEffect>(i);
+        bool is_enabled = post_stack_.IsEnabled(effect);
+        if (ImGui::Checkbox(kPostEffects[i].name, &is_enabled)) {
+          post_stack_.SetEnabled(effect, is_enabled);
+        }
+      }
+      const PostPassCount count =
+          post_stack_.PassCount(kBloomLevelCount, is_bloom_compute_);
+      ImGui::Text("%d fragment + %d compute passes, %d full resolution "
+                  "accesses",
+                  count.fragment_passes, count.compute_passes,
+                  count.full_resolution_accesses);
+      // The lighting used to write an RGBA16F bright target.
+      ImGui::Text("No bright target: %.1f MB saved",
+                  ToMegabytes(static_cast<std::size_t>(Metrics::width_) *
+                              static_cast<std::size_t>(Metrics::height_) * 8));
+    }
+
+    if (ImGui::CollapsingHeader("Bloom")) {
+      ImGui::Checkbox("Compute downsampling", &is_bloom_compute_);
+      ImGui::Text("GPU time: %.3f ms",
+                  gpu_profiler_.history().Average(kGpuZoneBloom));
+      // The last upsample is done by the composite pass in both paths.
+      if (is_bloom_compute_) {
+        ImGui::Text("3 down + 3 up dispatches, no attachment change");
+      } else {
+        ImGui::Text("%d down + %d up draws, %d attachment changes",
+                    kBloomLevelCount, kBloomLevelCount - 2,
+                    2 * kBloomLevelCount - 2);
+      }
+      std::size_t texel_count = 0;
+      for (const auto& size : bloom_sizes_) {
+        texel_count += static_cast<std::size_t>(size.x) * size.y;
+      }
+      // R11F_G11F_B10F instead of one RGB16F texture per level.
+      ImGui::Text("Chain: %.1f MB, was %.1f MB", ToMegabytes(texel_count * 4),
+                  ToMegabytes(texel_count * 6));
+    }
+
+    if (ImGui::CollapsingHeader("Render graph")) {
+      const RenderGraphStats& stats = render_graph_.stats();
+      ImGui::Text("%zu / %zu passes alive",
+                  stats.pass_count - stats.culled_pass_count,
+                  stats.pass_count);
+      for (const auto& pass : render_graph_.passes()) {
+        ImGui::BulletText("%s%s", pass.name.c_str(),
+                          pass.is_alive ? "" : " (culled)");
+      }
+      ImGui::Text("%zu transient textures in %zu slots, %zu aliased",
+                  stats.texture_count, render_graph_.slots().size(),
+                  stats.aliased_texture_count);
+      for (const auto& texture : render_graph_.textures()) {
+        if (texture.is_imported || texture.slot == RenderGraph::kInvalid) {
+          continue;
+        }
+        ImGui::BulletText("%s: passes %u-%u, slot %u, %.2f MB",
+                          texture.desc.name.c_str(), texture.first_pass,
+                          texture.last_pass, texture.slot,
+                          ToMegabytes(texture.byte_size));
+      }
+      ImGui::Text("Targets: %.1f MB, %.1f MB without aliasing",
+                  ToMegabytes(stats.slot_bytes),
+                  ToMegabytes(stats.transient_bytes));
+      // Not the graph: the HDR target used to have its own depth
+      // renderbuffer, blitted from the g-buffer every frame.
+      const std::size_t hdr_depth_bytes = TextureByteSize(
+          static_cast<std::uint32_t>(Metrics::width_),
+          static_cast<std::uint32_t>(Metrics::height_), 4);
+      ImGui::Text("Shared HDR depth: %.1f MB saved",
+                  ToMegabytes(hdr_depth_bytes));
+    }
+
+    if (ImGui::CollapsingHeader("Frustum culling")) {
+      ImGui::Text("Camera: %zu / %zu meshes visible in %.3f ms",
+                  camera_culling_stats_.visible_count,
+                  camera_culling_stats_.tested_count,
+                  camera_culling_stats_.milliseconds);
+      // Each visible mesh costs one face draw, the 6 pass version drew every
+      // mesh 6 times.
+      ImGui::Text("Shadow pass: %zu face draws instead of %zu (%.2fx scene)",
+                  shadow_caster_faces_.stats().visible_count,
+                  shadow_caster_faces_.stats().tested_count,
+                  culling_set_.size() == 0
+                      ? 0.f
+                      : static_cast<float>(
+                            shadow_caster_faces_.stats().visible_count) /
+                            static_cast<float>(culling_set_.size()));
+      ImGui::Text("Compute workers: %d", job_system_.compute_worker_count());
+      if (ImGui::Button("Run benchmark")) {
+        benchmark_culling_stats_ =
+            RunCullingBenchmark(job_system_, kCullingBenchmarkObjectCount, 10);
+      }
+      if (benchmark_culling_stats_.tested_count > 0) {
+        ImGui::Text("%zu objects in %.3f ms: %.1f M objects/s",
+                    benchmark_culling_stats_.tested_count,
+                    benchmark_culling_stats_.milliseconds,
+                    benchmark_culling_stats_.MillionObjectsPerSecond());
+      }
+    }
+
+    if (ImGui::CollapsingHeader("Transforms")) {
+      ImGui::Text("%zu entities on %zu levels",
+                  transform_stats_.entity_count,
+                  transform_stats_.level_count);
+      ImGui::Text("Last frame: %zu world matrices in %.3f ms",
+                  transform_stats_.updated_count,
+                  transform_stats_.milliseconds);
+      if (ImGui::Button("Run transform benchmark")) {
+        benchmark_transform_stats_ = RunTransformBenchmark(
+            job_system_, kTransformBenchmarkEntityCount, 10);
+      }
+      if (benchmark_transform_stats_.updated_count > 0) {
+        ImGui::Text("%zu world matrices on %zu levels in %.3f ms",
+                    benchmark_transform_stats_.updated_count,
+                    benchmark_transform_stats_.level_count,
+                    benchmark_transform_stats_.milliseconds);
+      }
+    }
+
+    if (ImGui::CollapsingHeader("Asset archive")) {
+      if (asset_archive_.is_open()) {
+        ImGui::Text("%s: %u entries, %.1f MiB mapped",
+                    kAssetArchiveFile.data(), asset_archive_.entry_count(),
+                    static_cast<double>(asset_archive_.file_size()) /
+                        (1024.0 * 1024.0));
+      } else {
+        ImGui::Text("No archive, the assets are loose files");
+      }
+      ImGui::Text("%zu of %zu textures unpacked from the archive",
+                  packed_texture_count_, scene_textures_.size());
+    }
+
+    if (ImGui::CollapsingHeader("Shadows")) {
+      ImGui::DragFloat3("Light position", &main_light().position.x, 0.05f);
+      ImGui::Checkbox("Animate dynamic casters", &animate_dynamic_casters_);
+      ImGui::SliderInt("Faces updated per frame", &shadow_face_budget_, 1,
+                       ShadowFaceScheduler::kFaceCount);
+      const auto& update = shadow_scheduler_.last_update();
+      ImGui::Text("Last frame: %d static, %d composited faces",
+                  static_cast<int>(std::bitset<6>(update.static_faces).count()),
+                  static_cast<int>(
+                      std::bitset<6>(update.composite_faces).count()));
+      ImGui::Text("Faces waiting: %d",
+                  static_cast<int>(
+                      std::bitset<6>(shadow_scheduler_.dirty_faces()).count()));
+
+      static constexpr std::array<const char*, 3> budget_names = {
+          "32 MB", "128 MB", "512 MB"};
+      if (ImGui::Combo("Memory budget", &shadow_budget_index_,
+                       budget_names.data(),
+                       static_cast<int>(budget_names.size()))) {
+        is_shadow_atlas_dirty_ = true;
+      }
+      const ShadowAtlasStats atlas = shadow_atlas_.Stats();
+      ImGui::Text("Atlas: %u x %u, 16 bit depth, %.1f MB with the static copy",
+                  atlas.size, atlas.size,
+                  2.f * atlas.size * atlas.size * kShadowTexelBytes /
+                      (1024.f * 1024.f));
+      ImGui::Text("Light face resolution: %u, atlas used %.0f%%",
+                  shadow_light_ != nullptr ? shadow_light_->resolution : 0u,
+                  100.f * static_cast<float>(atlas.used_texels) /
+                      (static_cast<float>(atlas.size) * atlas.size));
+      ImGui::Text("Evictions: %u", atlas.eviction_count);
+    }
   } else {
     ImGui::TextWrapped("Loading...");
   }
@@ -0,0 +1,174 @@
+#include "frame_data_ring.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#include "cpu_profiler.h"
+
+namespace {
+
+// A fence still not signaled after that long is a lost GPU, not a slow one.
+constexpr GLuint64 kRingFenceTimeoutNanoseconds = 1'000'000'000;
+
+}  // namespace
+
+void FrameDataRing::Begin(const std::size_t partition_size) {
+  GLint uniform_alignment = 0;
+  GLint storage_alignment = 0;
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniform_alignment);
+  glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT,
+                &storage_alignment);
+  alignment_ = static_cast<std::size_t>(
+      std::max({uniform_alignment, storage_alignment, 16}));
+  stats_ = {};
+  CreateStorage(partition_size);
+}
+
+void FrameDataRing::End() {
+  DeleteRetired(true);
+  DeleteStorage();
+}
+
+void FrameDataRing::BeginFrame() {
+  PROFILE_ZONE;
+  GLsync& fence = fences_[allocator_.NextFrame()];
+  if (fence != nullptr) {
+    if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+      stats_.stall_count++;
+      const auto start = std::chrono::steady_clock::now();
+      glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                       kRingFenceTimeoutNanoseconds);
+      stats_.last_wait_milliseconds =
+          std::chrono::duration<float, std::milli>(
+              std::chrono::steady_clock::now() - start)
+              .count();
+      stats_.wait_milliseconds += stats_.last_wait_milliseconds;
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+  }
+  DeleteRetired(false);
+  retired_frame_bytes_ = 0;
+  stats_.frame_count++;
+}
+
+void FrameDataRing::EndFrame() {
+  fences_[allocator_.partition()] =
+      glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  // Buffers retired this frame are done with once this frame is.
+  for (auto& retired : retired_) {
+    if (retired.fence == nullptr) {
+      retired.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+  }
+  stats_.frame_bytes = retired_frame_bytes_ + allocator_.used();
+  stats_.peak_frame_bytes =
+      std::max(stats_.peak_frame_bytes, stats_.frame_bytes);
+}
+
+FrameAllocation FrameDataRing::Allocate(const std::size_t size,
+                                        std::size_t alignment) {
+  if (mapped_ == nullptr) {
+    return {};
+  }
+  if (alignment == 0) {
+    alignment = alignment_;
+  }
+  std::size_t offset = allocator_.Allocate(size, alignment);
+  if (offset == FrameRingAllocator::kInvalid) {
+    // The frame's earlier allocations point in the old mapping, it is kept
+    // until the GPU is done with it.
+    stats_.grow_count++;
+    const std::size_t used = allocator_.used();
+    retired_frame_bytes_ += used;
+    Retire();
+    CreateStorage(std::max(2 * allocator_.partition_size(),
+                           used + size + alignment));
+    if (mapped_ == nullptr) {
+      return {};
+    }
+    offset = allocator_.Allocate(size, alignment);
+  }
+  return {mapped_ + offset, buffer_, static_cast<GLintptr>(offset),
+          static_cast<GLsizeiptr>(size)};
+}
+
+void FrameDataRing::BindRange(const GLenum target, const GLuint index,
+                              const FrameAllocation& allocation) const {
+  glBindBufferRange(target, index, allocation.buffer, allocation.offset,
+                    allocation.size);
+}
+
+void FrameDataRing::CreateStorage(const std::size_t partition_size) {
+  // A whole number of alignments, every partition starts aligned.
+  const std::size_t aligned_size =
+      (partition_size + alignment_ - 1) / alignment_ * alignment_;
+  allocator_.Reset(aligned_size);
+  constexpr GLbitfield kFlags =
+      GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+  glGenBuffers(1, &buffer_);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, buffer_);
+  glBufferStorage(GL_COPY_WRITE_BUFFER,
+                  static_cast<GLsizeiptr>(allocator_.RingSize()), nullptr,
+                  kFlags);
+  mapped_ = static_cast<std::byte*>(glMapBufferRange(
+      GL_COPY_WRITE_BUFFER, 0,
+      static_cast<GLsizeiptr>(allocator_.RingSize()), kFlags));
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  if (mapped_ == nullptr) {
+    std::cerr << "Can't map the frame data ring\n";
+  }
+}
+
+void FrameDataRing::DeleteStorage() {
+  for (auto& fence : fences_) {
+    glDeleteSync(fence);
+    fence = nullptr;
+  }
+  if (buffer_ != 0) {
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer_);
+    glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glDeleteBuffers(1, &buffer_);
+  }
+  buffer_ = 0;
+  mapped_ = nullptr;
+}
+
+void FrameDataRing::Retire() {
+  // The fences of the frames before only guard the old buffer, the one of
+  // this frame will cover them: fences are signaled in order.
+  for (auto& fence : fences_) {
+    glDeleteSync(fence);
+    fence = nullptr;
+  }
+  retired_.push_back({buffer_, nullptr});
+  buffer_ = 0;
+  mapped_ = nullptr;
+}
+
+void FrameDataRing::DeleteRetired(const bool wait) {
+  const auto done = [wait](const RetiredBuffer& retired) {
+    if (retired.fence == nullptr) {
+      return wait;
+    }
+    const GLenum status = glClientWaitSync(
+        retired.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+        wait ? kRingFenceTimeoutNanoseconds : 0);
+    return status != GL_TIMEOUT_EXPIRED;
+  };
+  auto kept = retired_.begin();
+  for (auto& retired : retired_) {
+    if (!done(retired)) {
+      *kept++ = retired;
+      continue;
+    }
+    glDeleteSync(retired.fence);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, retired.buffer);
+    glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glDeleteBuffers(1, &retired.buffer);
+  }
+  retired_.erase(kept, retired_.end());
+}
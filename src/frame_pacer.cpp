@@ -0,0 +1,117 @@
+#include "frame_pacer.h"
+
+#include <algorithm>
+
+namespace {
+
+using PacingMilliseconds = std::chrono::duration<float, std::milli>;
+
+// A fence still not signaled after that long is a lost GPU, not a slow one.
+constexpr GLuint64 kFenceTimeoutNanoseconds = 1'000'000'000;
+// The GPU and CPU clocks drift apart slowly, asking the GPU time is a round
+// trip to the driver.
+constexpr std::uint64_t kGpuClockCalibrationPeriod = 60;
+
+}  // namespace
+
+void FramePacer::Begin() {
+  for (auto& slot : slots_) {
+    glGenQueries(1, &slot.query);
+  }
+  oldest_ = 0;
+  next_ = 0;
+  milliseconds_.assign(kFramePacingZoneCount, 0.f);
+  history_.Reset({kFramePacingZoneNames.begin(), kFramePacingZoneNames.end()});
+  CalibrateGpuClock();
+}
+
+void FramePacer::End() {
+  for (; oldest_ < next_; oldest_++) {
+    FrameSlot& slot = slots_[oldest_ % kSlotCount];
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+  }
+  for (auto& slot : slots_) {
+    glDeleteQueries(1, &slot.query);
+    slot.query = 0;
+  }
+}
+
+void FramePacer::BeginFrame(const FramePacingSettings& settings) {
+  milliseconds_[kFramePacingLimiter] =
+      std::chrono::duration_cast<PacingMilliseconds>(
+          limiter_.Wait(settings.max_fps))
+          .count();
+
+  const auto throttle_start = FrameClock::now();
+  // Leaves room for the frame about to start.
+  const std::size_t max_pending =
+      settings.max_frames_in_flight > 0
+          ? std::min<std::size_t>(settings.max_frames_in_flight,
+                                  kMaxFramesInFlight) -
+                1
+          : kSlotCount - 1;
+  Collect(max_pending);
+  frame_start_ = FrameClock::now();
+  milliseconds_[kFramePacingThrottle] =
+      std::chrono::duration_cast<PacingMilliseconds>(frame_start_ -
+                                                     throttle_start)
+          .count();
+}
+
+void FramePacer::EndFrame() {
+  if (next_ % kGpuClockCalibrationPeriod == 0) {
+    CalibrateGpuClock();
+  }
+  FrameSlot& slot = slots_[next_ % kSlotCount];
+  glQueryCounter(slot.query, GL_TIMESTAMP);
+  slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  slot.input_time = frame_start_;
+  next_++;
+
+  milliseconds_[kFramePacingCpu] =
+      std::chrono::duration_cast<PacingMilliseconds>(FrameClock::now() -
+                                                     frame_start_)
+          .count();
+  history_.Push(milliseconds_);
+}
+
+void FramePacer::Collect(const std::size_t max_pending) {
+  while (oldest_ < next_) {
+    FrameSlot& slot = slots_[oldest_ % kSlotCount];
+    const bool must_wait = next_ - oldest_ > max_pending;
+    const GLenum status = glClientWaitSync(
+        slot.fence, must_wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+        must_wait ? kFenceTimeoutNanoseconds : 0);
+    if (status == GL_TIMEOUT_EXPIRED && !must_wait) {
+      break;
+    }
+    if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+      // The query was issued before the fence, its result is there.
+      GLuint64 gpu_time = 0;
+      glGetQueryObjectui64v(slot.query, GL_QUERY_RESULT, &gpu_time);
+      const std::int64_t input_time =
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+              slot.input_time.time_since_epoch())
+              .count();
+      const std::int64_t latency =
+          static_cast<std::int64_t>(gpu_time) + gpu_clock_offset_ -
+          input_time;
+      milliseconds_[kFramePacingLatency] =
+          static_cast<float>(std::max<std::int64_t>(latency, 0)) * 1e-6f;
+    }
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+    oldest_++;
+  }
+}
+
+void FramePacer::CalibrateGpuClock() {
+  GLint64 gpu_now = 0;
+  glGetInteger64v(GL_TIMESTAMP, &gpu_now);
+  const std::int64_t cpu_now =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          FrameClock::now().time_since_epoch())
+          .count();
+  gpu_clock_offset_ = cpu_now - gpu_now;
+}
@@ -0,0 +1,49 @@
+#include "frame_pacing.h"
+
+#include <algorithm>
+#include <thread>
+
+int PresentModeSwapInterval(const PresentMode mode) noexcept {
+  switch (mode) {
+    case PresentMode::kAdaptiveVsync:
+      return -1;
+    case PresentMode::kImmediate:
+      return 0;
+    default:
+      return 1;
+  }
+}
+
+FrameClock::duration FrameLimiter::Wait(const float max_fps) {
+  const auto start = FrameClock::now();
+  if (max_fps <= 0.f) {
+    next_frame_ = {};
+    return {};
+  }
+  const auto period = std::chrono::duration_cast<FrameClock::duration>(
+      std::chrono::duration<double>(1.0 / max_fps));
+  // A frame later than a whole period restarts the schedule rather than
+  // rushing the next ones to catch up.
+  if (next_frame_ == FrameClock::time_point{} ||
+      start > next_frame_ + period) {
+    next_frame_ = start;
+  }
+
+  auto now = start;
+  while (next_frame_ - now > spin_margin_) {
+    const auto sleep = next_frame_ - now - spin_margin_;
+    std::this_thread::sleep_for(sleep);
+    const auto woken = FrameClock::now();
+    const auto overshoot = woken - now - sleep;
+    spin_margin_ = std::clamp(std::max(overshoot + overshoot / 4,
+                                       spin_margin_ - kSpinMarginDecay),
+                              kMinSpinMargin, kMaxSpinMargin);
+    now = woken;
+  }
+  while (now < next_frame_) {
+    std::this_thread::yield();
+    now = FrameClock::now();
+  }
+  next_frame_ += period;
+  return now - start;
+}
@@ -0,0 +1,29 @@
+#include "frame_ring.h"
+
+#include <algorithm>
+
+void FrameRingAllocator::Reset(const std::size_t partition_size) noexcept {
+  partition_size_ = partition_size;
+  partition_ = 0;
+  used_ = 0;
+}
+
+std::uint32_t FrameRingAllocator::NextFrame() noexcept {
+  partition_ = (partition_ + 1) % kPartitionCount;
+  used_ = 0;
+  return partition_;
+}
+
+std::size_t FrameRingAllocator::Allocate(const std::size_t size,
+                                         std::size_t alignment) noexcept {
+  alignment = std::max<std::size_t>(alignment, 1);
+  // Aligned from the start of the ring, the partitions may not be.
+  const std::size_t base = partition_ * partition_size_;
+  const std::size_t begin =
+      (base + used_ + alignment - 1) / alignment * alignment - base;
+  if (begin + size > partition_size_) {
+    return kInvalid;
+  }
+  used_ = begin + size;
+  return base + begin;
+}
@@ -0,0 +1,364 @@
+#include "frustum_culling.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <random>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define CULLING_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define CULLING_SSE
+#endif
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "cpu_profiler.h"
+
+void ComputeBounds(const std::vector<float>& positions, BoundingBox& box,
+                   BoundingSphere& sphere) noexcept {
+  if (positions.size() < 3) {
+    box = BoundingBox{};
+    sphere = BoundingSphere{};
+    return;
+  }
+
+  box.min = glm::vec3(std::numeric_limits<float>::max());
+  box.max = glm::vec3(std::numeric_limits<float>::lowest());
+  for (std::size_t i = 0; i + 2 < positions.size(); i += 3) {
+    const glm::vec3 p(positions[i], positions[i + 1], positions[i + 2]);
+    box.min = glm::min(box.min, p);
+    box.max = glm::max(box.max, p);
+  }
+
+  // The farthest vertex from the box center is tighter than the half
+  // diagonal for anything rounder than a box.
+  sphere.center = (box.min + box.max) * 0.5f;
+  float radius_sqr = 0.f;
+  for (std::size_t i = 0; i + 2 < positions.size(); i += 3) {
+    const glm::vec3 d =
+        glm::vec3(positions[i], positions[i + 1], positions[i + 2]) -
+        sphere.center;
+    radius_sqr = std::max(radius_sqr, glm::dot(d, d));
+  }
+  sphere.radius = std::sqrt(radius_sqr);
+}
+
+Frustum Frustum::FromMatrix(const glm::mat4& view_projection) noexcept {
+  // Gribb & Hartmann: the planes are sums of the rows of the matrix.
+  const auto row = [&view_projection](const int i) {
+    return glm::vec4(view_projection[0][i], view_projection[1][i],
+                     view_projection[2][i], view_projection[3][i]);
+  };
+  const glm::vec4 x = row(0), y = row(1), z = row(2), w = row(3);
+
+  Frustum frustum;
+  frustum.planes = {w + x, w - x, w + y, w - y, w + z, w - z};
+  for (auto& plane : frustum.planes) {
+    plane /= glm::length(glm::vec3(plane));
+  }
+  return frustum;
+}
+
+std::uint32_t CullingSet::Add(const BoundingBox& box,
+                              const BoundingSphere& sphere,
+                              const glm::mat4& model) noexcept {
+  const auto index = static_cast<std::uint32_t>(size_);
+  Resize(size_ + 1);
+  Set(index, box, sphere, model);
+  return index;
+}
+
+void CullingSet::Set(const std::uint32_t index, const BoundingBox& box,
+                     const BoundingSphere& sphere,
+                     const glm::mat4& model) noexcept {
+  // Arvo: the world extent on each axis is the local extents projected on
+  // the absolute values of the matrix rows.
+  const glm::vec3 center = glm::vec3(model * glm::vec4(sphere.center, 1.f));
+  const glm::vec3 extent = (box.max - box.min) * 0.5f;
+  glm::vec3 world_extent(0.f);
+  for (int axis = 0; axis < 3; axis++) {
+    for (int col = 0; col < 3; col++) {
+      world_extent[axis] += std::abs(model[col][axis]) * extent[col];
+    }
+  }
+  const float scale = std::sqrt(std::max(
+      {glm::dot(glm::vec3(model[0]), glm::vec3(model[0])),
+       glm::dot(glm::vec3(model[1]), glm::vec3(model[1])),
+       glm::dot(glm::vec3(model[2]), glm::vec3(model[2]))}));
+
+  center_x[index] = center.x;
+  center_y[index] = center.y;
+  center_z[index] = center.z;
+  extent_x[index] = world_extent.x;
+  extent_y[index] = world_extent.y;
+  extent_z[index] = world_extent.z;
+  radius[index] = sphere.radius * scale;
+}
+
+void CullingSet::Resize(const std::size_t count) noexcept {
+  size_ = count;
+  const std::size_t padded =
+      (count + kCullBatchSize - 1) / kCullBatchSize * kCullBatchSize;
+  for (auto* array : {&center_x, &center_y, &center_z, &extent_x, &extent_y,
+                      &extent_z, &radius}) {
+    array->resize(padded, 0.f);
+  }
+}
+
+void CullingSet::Clear() noexcept { Resize(0); }
+
+namespace {
+
+#if !defined(CULLING_AVX) && !defined(CULLING_SSE)
+
+// A volume is outside when its center is farther behind one plane than its
+// projected radius. Both volumes share the center, so the smallest of the
+// two radii is still conservative.
+void CullBatchScalar(const Frustum& frustum, const CullingSet& set,
+                     const std::size_t begin, const std::size_t end,
+                     std::uint8_t* visibility) noexcept {
+  for (std::size_t i = begin; i < end; i++) {
+    bool is_visible = true;
+    for (const auto& plane : frustum.planes) {
+      const float distance = plane.x * set.center_x[i] +
+                             plane.y * set.center_y[i] +
+                             plane.z * set.center_z[i] + plane.w;
+      const float box_radius = std::abs(plane.x) * set.extent_x[i] +
+                               std::abs(plane.y) * set.extent_y[i] +
+                               std::abs(plane.z) * set.extent_z[i];
+      if (distance + std::min(box_radius, set.radius[i]) < 0.f) {
+        is_visible = false;
+        break;
+      }
+    }
+    visibility[i] = is_visible ? 1 : 0;
+  }
+}
+
+#else
+
+void WriteCullMask(const int mask, const std::size_t i, const std::size_t end,
+                   std::uint8_t* visibility) noexcept {
+  const std::size_t count = std::min(kCullBatchSize, end - i);
+  for (std::size_t lane = 0; lane < count; lane++) {
+    visibility[i + lane] = static_cast<std::uint8_t>((mask >> lane) & 1);
+  }
+}
+
+#endif
+
+#if defined(CULLING_AVX)
+
+void CullBatchSimd(const Frustum& frustum, const CullingSet& set,
+                   const std::size_t begin, const std::size_t end,
+                   std::uint8_t* visibility) noexcept {
+  // Broadcast plane: normal, distance then absolute normal.
+  __m256 planes[6][7];
+  for (std::size_t p = 0; p < frustum.planes.size(); p++) {
+    const glm::vec4& plane = frustum.planes[p];
+    planes[p][0] = _mm256_set1_ps(plane.x);
+    planes[p][1] = _mm256_set1_ps(plane.y);
+    planes[p][2] = _mm256_set1_ps(plane.z);
+    planes[p][3] = _mm256_set1_ps(plane.w);
+    planes[p][4] = _mm256_set1_ps(std::abs(plane.x));
+    planes[p][5] = _mm256_set1_ps(std::abs(plane.y));
+    planes[p][6] = _mm256_set1_ps(std::abs(plane.z));
+  }
+  const __m256 zero = _mm256_setzero_ps();
+
+  for (std::size_t i = begin; i < end; i += kCullBatchSize) {
+    const __m256 cx = _mm256_loadu_ps(set.center_x.data() + i);
+    const __m256 cy = _mm256_loadu_ps(set.center_y.data() + i);
+    const __m256 cz = _mm256_loadu_ps(set.center_z.data() + i);
+    const __m256 ex = _mm256_loadu_ps(set.extent_x.data() + i);
+    const __m256 ey = _mm256_loadu_ps(set.extent_y.data() + i);
+    const __m256 ez = _mm256_loadu_ps(set.extent_z.data() + i);
+    const __m256 rad = _mm256_loadu_ps(set.radius.data() + i);
+
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (const auto& p : planes) {
+      __m256 distance = _mm256_add_ps(_mm256_mul_ps(p[0], cx), p[3]);
+      distance = _mm256_add_ps(distance, _mm256_mul_ps(p[1], cy));
+      distance = _mm256_add_ps(distance, _mm256_mul_ps(p[2], cz));
+      __m256 box_radius = _mm256_mul_ps(p[4], ex);
+      box_radius = _mm256_add_ps(box_radius, _mm256_mul_ps(p[5], ey));
+      box_radius = _mm256_add_ps(box_radius, _mm256_mul_ps(p[6], ez));
+      const __m256 reach =
+          _mm256_add_ps(distance, _mm256_min_ps(box_radius, rad));
+      inside = _mm256_and_ps(inside, _mm256_cmp_ps(reach, zero, _CMP_GE_OQ));
+    }
+    WriteCullMask(_mm256_movemask_ps(inside), i, end, visibility);
+  }
+}
+
+#elif defined(CULLING_SSE)
+
+// SSE only has 4 lanes: two halves are interleaved to still test a batch of
+// 8 objects per iteration.
+void CullBatchSimd(const Frustum& frustum, const CullingSet& set,
+                   const std::size_t begin, const std::size_t end,
+                   std::uint8_t* visibility) noexcept {
+  // Broadcast plane: normal, distance then absolute normal.
+  __m128 planes[6][7];
+  for (std::size_t p = 0; p < frustum.planes.size(); p++) {
+    const glm::vec4& plane = frustum.planes[p];
+    planes[p][0] = _mm_set1_ps(plane.x);
+    planes[p][1] = _mm_set1_ps(plane.y);
+    planes[p][2] = _mm_set1_ps(plane.z);
+    planes[p][3] = _mm_set1_ps(plane.w);
+    planes[p][4] = _mm_set1_ps(std::abs(plane.x));
+    planes[p][5] = _mm_set1_ps(std::abs(plane.y));
+    planes[p][6] = _mm_set1_ps(std::abs(plane.z));
+  }
+  const __m128 zero = _mm_setzero_ps();
+
+  for (std::size_t i = begin; i < end; i += kCullBatchSize) {
+    int mask = 0;
+    for (std::size_t half = 0; half < 2; half++) {
+      const std::size_t j = i + half * 4;
+      const __m128 cx = _mm_loadu_ps(set.center_x.data() + j);
+      const __m128 cy = _mm_loadu_ps(set.center_y.data() + j);
+      const __m128 cz = _mm_loadu_ps(set.center_z.data() + j);
+      const __m128 ex = _mm_loadu_ps(set.extent_x.data() + j);
+      const __m128 ey = _mm_loadu_ps(set.extent_y.data() + j);
+      const __m128 ez = _mm_loadu_ps(set.extent_z.data() + j);
+      const __m128 rad = _mm_loadu_ps(set.radius.data() + j);
+
+      __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+      for (const auto& p : planes) {
+        __m128 distance = _mm_add_ps(_mm_mul_ps(p[0], cx), p[3]);
+        distance = _mm_add_ps(distance, _mm_mul_ps(p[1], cy));
+        distance = _mm_add_ps(distance, _mm_mul_ps(p[2], cz));
+        __m128 box_radius = _mm_mul_ps(p[4], ex);
+        box_radius = _mm_add_ps(box_radius, _mm_mul_ps(p[5], ey));
+        box_radius = _mm_add_ps(box_radius, _mm_mul_ps(p[6], ez));
+        const __m128 reach = _mm_add_ps(distance, _mm_min_ps(box_radius, rad));
+        inside = _mm_and_ps(inside, _mm_cmpge_ps(reach, zero));
+      }
+      mask |= _mm_movemask_ps(inside) << (half * 4);
+    }
+    WriteCullMask(mask, i, end, visibility);
+  }
+}
+
+#endif
+
+}  // namespace
+
+void CullRange(const Frustum& frustum, const CullingSet& set,
+               const std::size_t begin, const std::size_t end,
+               std::uint8_t* visibility) noexcept {
+#if defined(CULLING_AVX) || defined(CULLING_SSE)
+  // The arrays are padded, a batch can always be loaded entirely.
+  CullBatchSimd(frustum, set, begin, end, visibility);
+#else
+  CullBatchScalar(frustum, set, begin, end, visibility);
+#endif
+}
+
+void CullJob::Setup(const Frustum* frustum, const CullingSet* set,
+                    const std::size_t begin, const std::size_t end,
+                    std::uint8_t* visibility) noexcept {
+  frustum_ = frustum;
+  set_ = set;
+  begin_ = begin;
+  end_ = end;
+  visibility_ = visibility;
+}
+
+void CullJob::Work() noexcept {
+  PROFILE_ZONE;
+  CullRange(*frustum_, *set_, begin_, end_, visibility_);
+}
+
+CullingStats FrustumCuller::Cull(
+    JobSystem& job_system, const Frustum& frustum, const CullingSet& set,
+    std::vector<std::uint8_t>& visibility) noexcept {
+  PROFILE_ZONE;
+  const auto start = std::chrono::steady_clock::now();
+  const std::size_t count = set.size();
+  visibility.resize(count);
+
+  const std::size_t max_jobs =
+      static_cast<std::size_t>(job_system.compute_worker_count()) + 1;
+  const std::size_t job_count =
+      std::clamp<std::size_t>(count / kMinObjectsPerJob, 1, max_jobs);
+
+  if (job_count == 1) {
+    CullRange(frustum, set, 0, count, visibility.data());
+  } else {
+    // Ranges start on a batch boundary so that no batch is split between two
+    // jobs writing the same bytes.
+    const std::size_t batch_count =
+        (count + kCullBatchSize - 1) / kCullBatchSize;
+    const std::size_t batches_per_job =
+        (batch_count + job_count - 1) / job_count;
+
+    jobs_.resize(job_count);
+    job_ptrs_.clear();
+    for (std::size_t i = 0; i < job_count; i++) {
+      const std::size_t begin = i * batches_per_job * kCullBatchSize;
+      const std::size_t end =
+          std::min(count, (i + 1) * batches_per_job * kCullBatchSize);
+      if (begin >= end) {
+        break;
+      }
+      jobs_[i].Reset();
+      jobs_[i].Setup(&frustum, &set, begin, end, visibility.data());
+      job_ptrs_.push_back(&jobs_[i]);
+    }
+    job_system.RunComputeJobs(job_ptrs_.data(), job_ptrs_.size());
+  }
+
+  CullingStats stats;
+  stats.tested_count = count;
+  stats.visible_count = static_cast<std::size_t>(
+      std::count(visibility.begin(), visibility.end(), std::uint8_t{1}));
+  stats.milliseconds = std::chrono::duration<float, std::milli>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+  return stats;
+}
+
+CullingStats RunCullingBenchmark(JobSystem& job_system,
+                                 const std::size_t object_count,
+                                 const int iterations) noexcept {
+  PROFILE_ZONE;
+  std::mt19937 generator(42);
+  std::uniform_real_distribution position(-200.f, 200.f);
+  std::uniform_real_distribution size(0.1f, 4.f);
+
+  CullingSet set;
+  const BoundingBox unit_box{glm::vec3(-1.f), glm::vec3(1.f)};
+  const BoundingSphere unit_sphere{glm::vec3(0.f), std::sqrt(3.f)};
+  set.Resize(object_count);
+  for (std::size_t i = 0; i < object_count; i++) {
+    glm::mat4 model = glm::translate(
+        glm::mat4(1.f), glm::vec3(position(generator), position(generator),
+                                  position(generator)));
+    model = glm::scale(model, glm::vec3(size(generator)));
+    set.Set(static_cast<std::uint32_t>(i), unit_box, unit_sphere, model);
+  }
+
+  const glm::mat4 projection =
+      glm::perspective(glm::radians(45.f), 1.5f, 0.1f, 300.f);
+  const glm::mat4 view = glm::lookAt(glm::vec3(0.f, 0.f, 50.f),
+                                     glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f));
+  const Frustum frustum = Frustum::FromMatrix(projection * view);
+
+  FrustumCuller culler;
+  std::vector<std::uint8_t> visibility;
+  CullingStats best{};
+  for (int i = 0; i < iterations; i++) {
+    const CullingStats stats =
+        culler.Cull(job_system, frustum, set, visibility);
+    if (i == 0 || stats.milliseconds < best.milliseconds) {
+      best = stats;
+    }
+  }
+  return best;
+}
@@ -0,0 +1,32 @@
+#include "g_buffer.h"
+
+GBufferTraffic EstimateGBufferTraffic(const GBufferLayout& layout,
+                                      const int width, const int height,
+                                      const SsaoPreset& ssao) noexcept {
+  const auto pixels = static_cast<std::size_t>(width) * height;
+  const auto divisor = static_cast<std::size_t>(ssao.resolution_divisor);
+  const std::size_t ssao_pixels = ((width + divisor - 1) / divisor) *
+                                  ((height + divisor - 1) / divisor);
+
+  GBufferTraffic traffic;
+  traffic.geometry_bytes = pixels * layout.write_bytes;
+  traffic.lighting_bytes = pixels * layout.lighting_bytes;
+
+  // The occlusion reads the center then a depth per sample.
+  std::size_t ssao_texel_bytes =
+      layout.position_normal_bytes +
+      static_cast<std::size_t>(ssao.sample_count) * layout.depth_tap_bytes;
+  if (ssao.is_temporal) {
+    ssao_texel_bytes += layout.position_normal_bytes;
+  }
+  // Two blur passes, a normal per tap.
+  ssao_texel_bytes += 2 * static_cast<std::size_t>(2 * ssao.blur_radius + 1) *
+                      layout.normal_bytes;
+  // The upsample reads the pixel and the normals of the 4 low resolution
+  // texels around it.
+  const std::size_t upsample_bytes =
+      layout.position_normal_bytes + 4 * layout.normal_bytes;
+  traffic.ssao_bytes =
+      ssao_pixels * ssao_texel_bytes + pixels * upsample_bytes;
+  return traffic;
+}
@@ -0,0 +1,51 @@
+#include "gl_command_backend.h"
+
+#include <cstring>
+
+#include "pipeline.h"
+
+void GlCommandBackend::BeginReplay(const std::size_t uniform_byte_size) {
+  vertex_array_ = 0;
+  uniforms_ = uniform_byte_size > 0 ? ring_.Allocate(uniform_byte_size)
+                                    : FrameAllocation{};
+}
+
+void GlCommandBackend::UploadUniforms(const std::size_t offset,
+                                      const std::byte* data,
+                                      const std::size_t size) {
+  if (uniforms_.IsValid()) {
+    std::memcpy(uniforms_.data + offset, data, size);
+  }
+}
+
+void GlCommandBackend::BindPipeline(const std::uint32_t program) {
+  Pipeline::Use(program);
+}
+
+void GlCommandBackend::BindUniforms(const std::uint32_t binding,
+                                    const std::size_t offset,
+                                    const std::size_t size) {
+  glBindBufferRange(GL_UNIFORM_BUFFER, binding, uniforms_.buffer,
+                    uniforms_.offset + static_cast<GLintptr>(offset),
+                    static_cast<GLsizeiptr>(size));
+}
+
+void GlCommandBackend::BindTextures(const std::uint32_t first_unit,
+                                    const std::uint32_t* textures,
+                                    const std::uint32_t count) {
+  for (std::uint32_t i = 0; i < count; i++) {
+    glActiveTexture(GL_TEXTURE0 + first_unit + i);
+    glBindTexture(GL_TEXTURE_2D, textures[i]);
+  }
+}
+
+void GlCommandBackend::DrawIndexed(const DrawIndexedCommand& draw) {
+  if (draw.vertex_array != vertex_array_) {
+    vertex_array_ = draw.vertex_array;
+    glBindVertexArray(vertex_array_);
+  }
+  glDrawElements(draw.mode, static_cast<GLsizei>(draw.index_count),
+                 GL_UNSIGNED_INT,
+                 reinterpret_cast<void*>(
+                     static_cast<std::uintptr_t>(draw.index_offset)));
+}
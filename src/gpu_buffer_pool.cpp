@@ -0,0 +1,183 @@
+#include "gpu_buffer_pool.h"
+
+#include <algorithm>
+
+#include "cpu_profiler.h"
+
+GpuBufferPool::GpuBufferPool(const std::uint32_t arena_size) noexcept
+    : arena_size_(arena_size) {}
+
+GpuBufferHandle GpuBufferPool::Allocate(
+    const std::uint32_t size, const std::uint32_t alignment) noexcept {
+  std::uint32_t arena_index = 0;
+  std::uint32_t block = TlsfAllocator::kInvalidBlock;
+
+  for (; arena_index < arenas_.size(); arena_index++) {
+    block = arenas_[arena_index].allocator.Allocate(size, alignment);
+    if (block != TlsfAllocator::kInvalidBlock) {
+      break;
+    }
+  }
+
+  if (block == TlsfAllocator::kInvalidBlock) {
+    // Room for the rounded size and the worst alignment padding, the sum
+    // must not wrap around.
+    const std::uint64_t min_size =
+        static_cast<std::uint64_t>(size) +
+        std::max(alignment, TlsfAllocator::kGranularity) +
+        TlsfAllocator::kGranularity;
+    if (min_size > UINT32_MAX) {
+      return {};
+    }
+    arena_index = CreateArena(static_cast<std::uint32_t>(min_size));
+    block = arenas_[arena_index].allocator.Allocate(size, alignment);
+    if (block == TlsfAllocator::kInvalidBlock) {
+      return {};
+    }
+  }
+
+  const std::uint32_t slot = NewSlot();
+  slots_[slot].arena = arena_index;
+  slots_[slot].block = block;
+  SetBlockSlot(arenas_[arena_index], block, slot);
+
+  return GpuBufferHandle{slot};
+}
+
+void GpuBufferPool::Upload(const GpuBufferHandle handle,
+                           const std::uint32_t offset, const void* data,
+                           const std::uint32_t size) const noexcept {
+  if (!handle.IsValid() || size == 0) {
+    return;
+  }
+  // The copy target is used so that the element buffer of the bound vertex
+  // array is left untouched.
+  glBindBuffer(GL_COPY_WRITE_BUFFER, Buffer(handle));
+  glBufferSubData(GL_COPY_WRITE_BUFFER, Offset(handle) + offset, size, data);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void GpuBufferPool::Free(GpuBufferHandle& handle) noexcept {
+  if (!handle.IsValid()) {
+    return;
+  }
+  Slot& slot = slots_[handle.index];
+  Arena& arena = arenas_[slot.arena];
+  arena.allocator.Free(slot.block);
+  arena.block_slots[slot.block] = GpuBufferHandle::kInvalid;
+
+  slot.block = TlsfAllocator::kInvalidBlock;
+  slot.generation++;
+  free_slots_.push_back(handle.index);
+  handle.index = GpuBufferHandle::kInvalid;
+}
+
+GLuint GpuBufferPool::Buffer(const GpuBufferHandle handle) const noexcept {
+  return arenas_[slots_[handle.index].arena].buffer;
+}
+
+std::uint32_t GpuBufferPool::Offset(
+    const GpuBufferHandle handle) const noexcept {
+  const Slot& slot = slots_[handle.index];
+  return arenas_[slot.arena].allocator.Offset(slot.block);
+}
+
+std::uint32_t GpuBufferPool::Generation(
+    const GpuBufferHandle handle) const noexcept {
+  return slots_[handle.index].generation;
+}
+
+void GpuBufferPool::Compact(const std::uint32_t byte_budget) noexcept {
+  PROFILE_ZONE;
+  std::uint32_t budget = byte_budget;
+
+  for (auto& arena : arenas_) {
+    if (budget == 0) {
+      break;
+    }
+    const auto moves = arena.allocator.Compact(budget);
+    if (moves.empty()) {
+      continue;
+    }
+
+    // Copies are executed in order by the GL, which is what the allocator
+    // requires when a move lands where an earlier one left.
+    glBindBuffer(GL_COPY_READ_BUFFER, arena.buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, arena.buffer);
+    for (const auto& move : moves) {
+      glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                          move.src_offset, move.dst_offset, move.size);
+
+      const std::uint32_t slot = arena.block_slots[move.old_block];
+      arena.block_slots[move.old_block] = GpuBufferHandle::kInvalid;
+      SetBlockSlot(arena, move.new_block, slot);
+      slots_[slot].block = move.new_block;
+      slots_[slot].generation++;
+
+      budget -= std::min(budget, move.size);
+      moved_bytes_ += move.size;
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  }
+}
+
+GpuBufferPoolStats GpuBufferPool::Stats() const noexcept {
+  GpuBufferPoolStats stats;
+  stats.arena_count = arenas_.size();
+  stats.moved_bytes = moved_bytes_;
+
+  for (const auto& arena : arenas_) {
+    const TlsfStats arena_stats = arena.allocator.Stats();
+    stats.total.capacity += arena_stats.capacity;
+    stats.total.used_bytes += arena_stats.used_bytes;
+    stats.total.requested_bytes += arena_stats.requested_bytes;
+    stats.total.free_bytes += arena_stats.free_bytes;
+    stats.total.allocation_count += arena_stats.allocation_count;
+    stats.total.free_block_count += arena_stats.free_block_count;
+    stats.total.largest_free_block = std::max(
+        stats.total.largest_free_block, arena_stats.largest_free_block);
+  }
+  return stats;
+}
+
+void GpuBufferPool::Release() noexcept {
+  for (auto& arena : arenas_) {
+    glDeleteBuffers(1, &arena.buffer);
+  }
+  arenas_.clear();
+  slots_.clear();
+  free_slots_.clear();
+}
+
+std::uint32_t GpuBufferPool::CreateArena(const std::uint32_t min_size) noexcept {
+  Arena arena;
+  arena.allocator = TlsfAllocator(std::max(arena_size_, min_size));
+
+  glGenBuffers(1, &arena.buffer);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, arena.buffer);
+  glBufferData(GL_COPY_WRITE_BUFFER, arena.allocator.capacity(), nullptr,
+               GL_STATIC_DRAW);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+  arenas_.push_back(std::move(arena));
+  return static_cast<std::uint32_t>(arenas_.size() - 1);
+}
+
+std::uint32_t GpuBufferPool::NewSlot() noexcept {
+  if (!free_slots_.empty()) {
+    const std::uint32_t slot = free_slots_.back();
+    free_slots_.pop_back();
+    return slot;
+  }
+  slots_.emplace_back();
+  return static_cast<std::uint32_t>(slots_.size() - 1);
+}
+
+void GpuBufferPool::SetBlockSlot(Arena& arena, const std::uint32_t block,
+                                 const std::uint32_t slot) noexcept {
+  if (block >= arena.block_slots.size()) {
+    arena.block_slots.resize(block + 1, GpuBufferHandle::kInvalid);
+  }
+  arena.block_slots[block] = slot;
+}
@@ -0,0 +1,53 @@
+#include "gpu_memory.h"
+
+#include <algorithm>
+
+std::uint32_t MipCount(std::uint32_t size) noexcept {
+  std::uint32_t count = 1;
+  while (size > 1) {
+    size /= 2;
+    count++;
+  }
+  return count;
+}
+
+std::size_t TextureByteSize(const std::uint32_t width,
+                            const std::uint32_t height,
+                            const std::uint32_t bytes_per_texel,
+                            const std::uint32_t faces,
+                            const std::uint32_t levels) noexcept {
+  std::size_t bytes = 0;
+  for (std::uint32_t level = 0; level < levels; level++) {
+    bytes += static_cast<std::size_t>(std::max(width >> level, 1u)) *
+             std::max(height >> level, 1u);
+  }
+  return bytes * bytes_per_texel * faces;
+}
+
+void GpuMemoryReport::Add(std::string name, const std::size_t bytes) {
+  entries_.push_back(Entry{std::move(name), bytes, false});
+}
+
+void GpuMemoryReport::MarkFreed(const std::string_view name) noexcept {
+  for (auto& entry : entries_) {
+    if (entry.name == name) {
+      entry.is_freed = true;
+    }
+  }
+}
+
+std::size_t GpuMemoryReport::ResidentBytes() const noexcept {
+  std::size_t bytes = 0;
+  for (const auto& entry : entries_) {
+    bytes += entry.is_freed ? 0 : entry.bytes;
+  }
+  return bytes;
+}
+
+std::size_t GpuMemoryReport::FreedBytes() const noexcept {
+  std::size_t bytes = 0;
+  for (const auto& entry : entries_) {
+    bytes += entry.is_freed ? entry.bytes : 0;
+  }
+  return bytes;
+}
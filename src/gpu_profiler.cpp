@@ -0,0 +1,85 @@
+#include "gpu_profiler.h"
+
+#include <algorithm>
+#include <utility>
+
+void GpuProfiler::Begin(std::vector<std::string> zone_names) {
+  zone_count_ = zone_names.size();
+  queries_.resize(kFrameLatency * zone_count_ * 2);
+  glGenQueries(static_cast<GLsizei>(queries_.size()), queries_.data());
+  for (auto& zones : recorded_zones_) {
+    zones.assign(zone_count_, 0);
+  }
+  is_frame_issued_ = {};
+  frame_ = 0;
+  dropped_frame_count_ = 0;
+  milliseconds_.assign(zone_count_, 0.f);
+  history_.Reset(std::move(zone_names));
+}
+
+void GpuProfiler::End() {
+  glDeleteQueries(static_cast<GLsizei>(queries_.size()), queries_.data());
+  queries_.clear();
+  zone_count_ = 0;
+}
+
+void GpuProfiler::BeginFrame() {
+  if (queries_.empty()) {
+    return;
+  }
+  frame_ = (frame_ + 1) % kFrameLatency;
+  if (is_frame_issued_[frame_]) {
+    if (ReadFrame(frame_)) {
+      history_.Push(milliseconds_);
+    } else {
+      dropped_frame_count_++;
+    }
+  }
+  std::fill(recorded_zones_[frame_].begin(), recorded_zones_[frame_].end(),
+            std::uint8_t{0});
+  is_frame_issued_[frame_] = true;
+}
+
+void GpuProfiler::BeginZone(const std::size_t zone) {
+  if (zone >= zone_count_) {
+    return;
+  }
+  glQueryCounter(Query(frame_, zone, false), GL_TIMESTAMP);
+}
+
+void GpuProfiler::EndZone(const std::size_t zone) {
+  if (zone >= zone_count_) {
+    return;
+  }
+  glQueryCounter(Query(frame_, zone, true), GL_TIMESTAMP);
+  recorded_zones_[frame_][zone] = 1;
+}
+
+bool GpuProfiler::ReadFrame(const std::size_t frame) {
+  const auto& zones = recorded_zones_[frame];
+  // Asking for a missing result would wait for the GPU.
+  for (std::size_t zone = 0; zone < zone_count_; zone++) {
+    if (zones[zone] == 0) {
+      continue;
+    }
+    GLint is_available = GL_FALSE;
+    glGetQueryObjectiv(Query(frame, zone, true), GL_QUERY_RESULT_AVAILABLE,
+                       &is_available);
+    if (is_available == GL_FALSE) {
+      return false;
+    }
+  }
+  for (std::size_t zone = 0; zone < zone_count_; zone++) {
+    milliseconds_[zone] = 0.f;
+    if (zones[zone] == 0) {
+      continue;
+    }
+    GLuint64 begin = 0;
+    GLuint64 end = 0;
+    glGetQueryObjectui64v(Query(frame, zone, false), GL_QUERY_RESULT, &begin);
+    glGetQueryObjectui64v(Query(frame, zone, true), GL_QUERY_RESULT, &end);
+    milliseconds_[zone] =
+        end > begin ? static_cast<float>(end - begin) / 1e6f : 0.f;
+  }
+  return true;
+}
@@ -0,0 +1,121 @@
+#include "gpu_timings.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <utility>
+
+void GpuTimingHistory::Reset(std::vector<std::string> zone_names) {
+  zone_names_ = std::move(zone_names);
+  values_.assign(zone_names_.size() * kFrameCount, 0.f);
+  next_ = 0;
+  frame_count_ = 0;
+  ResetSums();
+}
+
+void GpuTimingHistory::ResetSums() noexcept {
+  sums_.assign(zone_names_.size(), 0.0);
+  summed_frame_count_ = 0;
+}
+
+void GpuTimingHistory::Push(const std::vector<float>& milliseconds) {
+  for (std::size_t zone = 0; zone < zone_count(); zone++) {
+    const float value =
+        zone < milliseconds.size() ? std::max(milliseconds[zone], 0.f) : 0.f;
+    values_[zone * kFrameCount + next_] = value;
+    sums_[zone] += value;
+  }
+  summed_frame_count_++;
+  next_ = (next_ + 1) % kFrameCount;
+  frame_count_++;
+}
+
+std::size_t GpuTimingHistory::KeptFrameCount() const noexcept {
+  return std::min(frame_count_, kFrameCount);
+}
+
+float GpuTimingHistory::KeptValue(const std::size_t zone,
+                                  const std::size_t i) const noexcept {
+  const std::size_t first = (next_ + kFrameCount - KeptFrameCount());
+  return Values(zone)[(first + i) % kFrameCount];
+}
+
+float GpuTimingHistory::Latest(const std::size_t zone) const noexcept {
+  if (frame_count_ == 0) {
+    return 0.f;
+  }
+  return Values(zone)[(next_ + kFrameCount - 1) % kFrameCount];
+}
+
+float GpuTimingHistory::Average(const std::size_t zone) const noexcept {
+  const std::size_t count = KeptFrameCount();
+  if (count == 0) {
+    return 0.f;
+  }
+  float sum = 0.f;
+  for (std::size_t i = 0; i < count; i++) {
+    sum += KeptValue(zone, i);
+  }
+  return sum / static_cast<float>(count);
+}
+
+float GpuTimingHistory::Max(const std::size_t zone) const noexcept {
+  float max = 0.f;
+  for (std::size_t i = 0; i < KeptFrameCount(); i++) {
+    max = std::max(max, KeptValue(zone, i));
+  }
+  return max;
+}
+
+float GpuTimingHistory::Mean(const std::size_t zone) const noexcept {
+  if (summed_frame_count_ == 0) {
+    return 0.f;
+  }
+  return static_cast<float>(sums_[zone] / summed_frame_count_);
+}
+
+bool GpuTimingHistory::WriteCsv(const std::string_view path) const {
+  std::ofstream file{std::string(path)};
+  if (!file) {
+    return false;
+  }
+  file << std::fixed << std::setprecision(4) << "frame";
+  for (const auto& name : zone_names_) {
+    file << ',' << name;
+  }
+  file << ",total\n";
+  const std::size_t count = KeptFrameCount();
+  for (std::size_t i = 0; i < count; i++) {
+    file << frame_count_ - count + i;
+    float total = 0.f;
+    for (std::size_t zone = 0; zone < zone_count(); zone++) {
+      const float value = KeptValue(zone, i);
+      total += value;
+      file << ',' << value;
+    }
+    file << ',' << total << '\n';
+  }
+  return static_cast<bool>(file);
+}
+
+bool GpuTimingHistory::WriteJson(const std::string_view path) const {
+  std::ofstream file{std::string(path)};
+  if (!file) {
+    return false;
+  }
+  // The zone names are ours, they don't need escaping.
+  const std::size_t count = KeptFrameCount();
+  file << std::fixed << std::setprecision(4) << "{\n  \"unit\": \"ms\",\n"
+       << "  \"frame_count\": " << count << ",\n  \"zones\": [";
+  for (std::size_t zone = 0; zone < zone_count(); zone++) {
+    file << (zone == 0 ? "\n" : ",\n") << "    {\"name\": \""
+         << zone_names_[zone] << "\", \"average\": " << Average(zone)
+         << ", \"max\": " << Max(zone) << ", \"samples\": [";
+    for (std::size_t i = 0; i < count; i++) {
+      file << (i == 0 ? "" : ", ") << KeptValue(zone, i);
+    }
+    file << "]}";
+  }
+  file << "\n  ]\n}\n";
+  return static_cast<bool>(file);
+}
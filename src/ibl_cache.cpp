@@ -0,0 +1,209 @@
+#include "ibl_cache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+namespace {
+
+constexpr std::uint32_t kIblCacheMagic = 0x43424c49;  // "IBLC"
+constexpr std::uint32_t kIblCacheVersion = 3;
+
+struct IblCacheHeader {
+  std::uint32_t magic = kIblCacheMagic;
+  std::uint32_t version = kIblCacheVersion;
+  std::uint64_t source_hash = 0;
+  std::uint64_t shader_hash = 0;
+  std::uint64_t settings_hash = 0;
+  float bake_milliseconds = 0.f;
+  std::uint32_t texture_count = IblCache::kTextureCount;
+  std::array<float, 27> irradiance_sh{};
+};
+
+struct IblTextureHeader {
+  std::uint32_t width = 0;
+  std::uint32_t height = 0;
+  std::uint32_t channel_count = 0;
+  std::uint32_t face_count = 0;
+  std::uint32_t level_count = 0;
+};
+
+std::uint32_t IblCeilPowerOfTwo(const std::uint32_t value) noexcept {
+  std::uint32_t power = 1;
+  while (power < value) {
+    power *= 2;
+  }
+  return power;
+}
+
+}  // namespace
+
+std::uint32_t EnvironmentCaptureSize(const std::uint32_t source_width,
+                                     const float viewport_height,
+                                     const float vertical_fov,
+                                     const std::uint32_t min_size,
+                                     const std::uint32_t max_size) noexcept {
+  constexpr float kFaceAngle = 1.57079633f;
+  const auto source_size = IblCeilPowerOfTwo(source_width / 4);
+  const auto viewport_size = IblCeilPowerOfTwo(static_cast<std::uint32_t>(
+      viewport_height * kFaceAngle / std::max(vertical_fov, 1e-3f)));
+  return std::clamp(std::min(source_size, viewport_size), min_size, max_size);
+}
+
+std::uint64_t HashBytes(const void* data, const std::size_t size,
+                        std::uint64_t seed) noexcept {
+  const auto* bytes = static_cast<const unsigned char*>(data);
+  for (std::size_t i = 0; i < size; i++) {
+    seed ^= bytes[i];
+    seed *= 0x100000001b3ull;
+  }
+  return seed;
+}
+
+std::uint64_t HashFiles(const std::vector<std::string_view>& paths) noexcept {
+  std::uint64_t hash = HashBytes(nullptr, 0);
+  std::vector<char> buffer(1 << 16);
+  for (const auto path : paths) {
+    hash = HashBytes(path.data(), path.size(), hash);
+    std::ifstream file(std::string(path), std::ios::binary);
+    while (file) {
+      file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+      hash = HashBytes(buffer.data(), static_cast<std::size_t>(file.gcount()),
+                       hash);
+    }
+  }
+  return hash;
+}
+
+void IblTexture::Resize(const std::uint32_t new_width,
+                        const std::uint32_t new_height,
+                        const std::uint32_t channels,
+                        const std::uint32_t faces,
+                        const std::uint32_t levels) {
+  width = new_width;
+  height = new_height;
+  channel_count = channels;
+  face_count = faces;
+  level_count = levels;
+  std::size_t texel_count = 0;
+  for (std::uint32_t level = 0; level < level_count; level++) {
+    texel_count += ImageTexelCount(level) * face_count;
+  }
+  texels.resize(texel_count);
+}
+
+std::uint32_t IblTexture::LevelWidth(const std::uint32_t level) const noexcept {
+  return std::max(width >> level, 1u);
+}
+
+std::uint32_t IblTexture::LevelHeight(
+    const std::uint32_t level) const noexcept {
+  return std::max(height >> level, 1u);
+}
+
+std::size_t IblTexture::ImageTexelCount(
+    const std::uint32_t level) const noexcept {
+  return static_cast<std::size_t>(LevelWidth(level)) * LevelHeight(level) *
+         channel_count;
+}
+
+std::uint16_t* IblTexture::Image(const std::uint32_t level,
+                                 const std::uint32_t face) noexcept {
+  return const_cast<std::uint16_t*>(
+      static_cast<const IblTexture*>(this)->Image(level, face));
+}
+
+const std::uint16_t* IblTexture::Image(
+    const std::uint32_t level, const std::uint32_t face) const noexcept {
+  std::size_t offset = 0;
+  for (std::uint32_t l = 0; l < level; l++) {
+    offset += ImageTexelCount(l) * face_count;
+  }
+  return texels.data() + offset + ImageTexelCount(level) * face;
+}
+
+std::size_t IblCache::byte_size() const noexcept {
+  std::size_t size = 0;
+  for (const auto& texture : textures) {
+    size += texture.byte_size();
+  }
+  return size;
+}
+
+bool SaveIblCache(const std::string_view path, const IblCache& cache) {
+  // Written next to the final file then renamed, a crash never leaves a
+  // truncated cache behind.
+  const std::string temporary_path = std::string(path) + ".tmp";
+  {
+    std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+      return false;
+    }
+    IblCacheHeader header;
+    header.source_hash = cache.key.source_hash;
+    header.shader_hash = cache.key.shader_hash;
+    header.settings_hash = cache.key.settings_hash;
+    header.bake_milliseconds = cache.bake_milliseconds;
+    header.irradiance_sh = cache.irradiance_sh;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const auto& texture : cache.textures) {
+      const IblTextureHeader texture_header{
+          texture.width, texture.height, texture.channel_count,
+          texture.face_count, texture.level_count};
+      file.write(reinterpret_cast<const char*>(&texture_header),
+                 sizeof(texture_header));
+      file.write(reinterpret_cast<const char*>(texture.texels.data()),
+                 static_cast<std::streamsize>(texture.byte_size()));
+    }
+    if (!file) {
+      return false;
+    }
+  }
+  std::remove(std::string(path).c_str());
+  return std::rename(temporary_path.c_str(), std::string(path).c_str()) == 0;
+}
+
+bool LoadIblCache(const std::string_view path, const IblCacheKey& key,
+                  IblCache& cache) {
+  std::ifstream file(std::string(path), std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  IblCacheHeader header;
+  file.read(reinterpret_cast<char*>(&header), sizeof(header));
+  if (!file || header.magic != kIblCacheMagic ||
+      header.version != kIblCacheVersion ||
+      header.texture_count != IblCache::kTextureCount) {
+    return false;
+  }
+  cache.key = {header.source_hash, header.shader_hash, header.settings_hash};
+  if (!(cache.key == key)) {
+    return false;
+  }
+  cache.bake_milliseconds = header.bake_milliseconds;
+  cache.irradiance_sh = header.irradiance_sh;
+
+  // A corrupted header must not make us allocate gigabytes.
+  constexpr std::uint32_t kMaxTextureSize = 16384;
+  for (auto& texture : cache.textures) {
+    IblTextureHeader texture_header;
+    file.read(reinterpret_cast<char*>(&texture_header),
+              sizeof(texture_header));
+    if (!file || texture_header.width > kMaxTextureSize ||
+        texture_header.height > kMaxTextureSize ||
+        texture_header.channel_count > 4 || texture_header.face_count > 6 ||
+        texture_header.level_count > 16) {
+      return false;
+    }
+    texture.Resize(texture_header.width, texture_header.height,
+                   texture_header.channel_count, texture_header.face_count,
+                   texture_header.level_count);
+    file.read(reinterpret_cast<char*>(texture.texels.data()),
+              static_cast<std::streamsize>(texture.byte_size()));
+    if (!file) {
+      return false;
+    }
+  }
+  return true;
+}
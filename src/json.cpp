@@ -0,0 +1,308 @@
+#include "json.h"
+
+#include <cstdlib>
+
+bool JsonValue::AsBool(const bool fallback) const noexcept {
+  return type_ == Type::kBool ? bool_ : fallback;
+}
+
+double JsonValue::AsNumber(const double fallback) const noexcept {
+  return type_ == Type::kNumber ? number_ : fallback;
+}
+
+float JsonValue::AsFloat(const float fallback) const noexcept {
+  return type_ == Type::kNumber ? static_cast<float>(number_) : fallback;
+}
+
+const std::string& JsonValue::AsString() const noexcept {
+  static const std::string kEmpty;
+  return type_ == Type::kString ? string_ : kEmpty;
+}
+
+const JsonValue* JsonValue::Find(const std::string_view key) const noexcept {
+  for (const auto& [name, value] : members_) {
+    if (name == key) {
+      return &value;
+    }
+  }
+  return nullptr;
+}
+
+// Recursive descent over the text, stops at the first error.
+class JsonParser {
+ public:
+  explicit JsonParser(const std::string_view text) noexcept : text_(text) {}
+
+  bool Parse(JsonValue& value, std::string& error) {
+    SkipSpaces();
+    if (!ParseValue(value, 0)) {
+      error = error_ + " at line " + std::to_string(Line());
+      return false;
+    }
+    SkipSpaces();
+    if (position_ != text_.size()) {
+      error = "Unexpected text after the value at line " +
+              std::to_string(Line());
+      return false;
+    }
+    return true;
+  }
+
+ private:
+  // Deeper documents are rejected instead of overflowing the stack.
+  static constexpr int kMaxDepth = 64;
+
+  std::string_view text_;
+  std::size_t position_ = 0;
+  std::string error_{};
+
+  bool Fail(std::string message) {
+    error_ = std::move(message);
+    return false;
+  }
+
+  [[nodiscard]] std::size_t Line() const noexcept {
+    std::size_t line = 1;
+    for (std::size_t i = 0; i < position_ && i < text_.size(); i++) {
+      line += text_[i] == '\n';
+    }
+    return line;
+  }
+
+  void SkipSpaces() noexcept {
+    while (position_ < text_.size() &&
+           (text_[position_] == ' ' || text_[position_] == '\t' ||
+            text_[position_] == '\n' || text_[position_] == '\r')) {
+      position_++;
+    }
+  }
+
+  bool Consume(const std::string_view word) noexcept {
+    if (text_.substr(position_, word.size()) != word) {
+      return false;
+    }
+    position_ += word.size();
+    return true;
+  }
+
+  bool ParseValue(JsonValue& value, const int depth) {
+    if (depth > kMaxDepth) {
+      return Fail("Too deeply nested");
+    }
+    if (position_ >= text_.size()) {
+      return Fail("Unexpected end of the text");
+    }
+    switch (text_[position_]) {
+      case '{':
+        return ParseObject(value, depth);
+      case '[':
+        return ParseArray(value, depth);
+      case '"':
+        value.type_ = JsonValue::Type::kString;
+        return ParseString(value.string_);
+      case 't':
+      case 'f':
+        value.type_ = JsonValue::Type::kBool;
+        value.bool_ = text_[position_] == 't';
+        return Consume(value.bool_ ? "true" : "false") ||
+               Fail("Invalid literal");
+      case 'n':
+        value.type_ = JsonValue::Type::kNull;
+        return Consume("null") || Fail("Invalid literal");
+      default:
+        return ParseNumber(value);
+    }
+  }
+
+  bool ParseObject(JsonValue& value, const int depth) {
+    value.type_ = JsonValue::Type::kObject;
+    position_++;
+    SkipSpaces();
+    if (Consume("}")) {
+      return true;
+    }
+    while (true) {
+      SkipSpaces();
+      if (position_ >= text_.size() || text_[position_] != '"') {
+        return Fail("Expected a member name");
+      }
+      JsonValue::Member member;
+      if (!ParseString(member.first)) {
+        return false;
+      }
+      SkipSpaces();
+      if (!Consume(":")) {
+        return Fail("Expected ':' after a member name");
+      }
+      SkipSpaces();
+      if (!ParseValue(member.second, depth + 1)) {
+        return false;
+      }
+      value.members_.push_back(std::move(member));
+      SkipSpaces();
+      if (Consume("}")) {
+        return true;
+      }
+      if (!Consume(",")) {
+        return Fail("Expected ',' or '}' in an object");
+      }
+    }
+  }
+
+  bool ParseArray(JsonValue& value, const int depth) {
+    value.type_ = JsonValue::Type::kArray;
+    position_++;
+    SkipSpaces();
+    if (Consume("]")) {
+      return true;
+    }
+    while (true) {
+      SkipSpaces();
+      JsonValue& item = value.items_.emplace_back();
+      if (!ParseValue(item, depth + 1)) {
+        return false;
+      }
+      SkipSpaces();
+      if (Consume("]")) {
+        return true;
+      }
+      if (!Consume(",")) {
+        return Fail("Expected ',' or ']' in an array");
+      }
+    }
+  }
+
+  bool ParseHex4(unsigned& code) {
+    if (position_ + 4 > text_.size()) {
+      return Fail("Truncated \\u escape");
+    }
+    code = 0;
+    for (int i = 0; i < 4; i++) {
+      const char c = text_[position_++];
+      code <<= 4;
+      if (c >= '0' && c <= '9') {
+        code |= static_cast<unsigned>(c - '0');
+      } else if (c >= 'a' && c <= 'f') {
+        code |= static_cast<unsigned>(c - 'a' + 10);
+      } else if (c >= 'A' && c <= 'F') {
+        code |= static_cast<unsigned>(c - 'A' + 10);
+      } else {
+        return Fail("Invalid \\u escape");
+      }
+    }
+    return true;
+  }
+
+  static void AppendUtf8(std::string& out, const unsigned code) {
+    if (code < 0x80) {
+      out += static_cast<char>(code);
+    } else if (code < 0x800) {
+      out += static_cast<char>(0xC0 | code >> 6);
+      out += static_cast<char>(0x80 | (code & 0x3F));
+    } else if (code < 0x10000) {
+      out += static_cast<char>(0xE0 | code >> 12);
+      out += static_cast<char>(0x80 | (code >> 6 & 0x3F));
+      out += static_cast<char>(0x80 | (code & 0x3F));
+    } else {
+      out += static_cast<char>(0xF0 | code >> 18);
+      out += static_cast<char>(0x80 | (code >> 12 & 0x3F));
+      out += static_cast<char>(0x80 | (code >> 6 & 0x3F));
+      out += static_cast<char>(0x80 | (code & 0x3F));
+    }
+  }
+
+  bool ParseString(std::string& out) {
+    position_++;
+    while (position_ < text_.size()) {
+      const char c = text_[position_++];
+      if (c == '"') {
+        return true;
+      }
+      if (static_cast<unsigned char>(c) < 0x20) {
+        return Fail("Control character in a string");
+      }
+      if (c != '\\') {
+        out += c;
+        continue;
+      }
+      if (position_ >= text_.size()) {
+        break;
+      }
+      const char escape = text_[position_++];
+      switch (escape) {
+        case '"':
+        case '\\':
+        case '/':
+          out += escape;
+          break;
+        case 'b':
+          out += '\b';
+          break;
+        case 'f':
+          out += '\f';
+          break;
+        case 'n':
+          out += '\n';
+          break;
+        case 'r':
+          out += '\r';
+          break;
+        case 't':
+          out += '\t';
+          break;
+        case 'u': {
+          unsigned code = 0;
+          if (!ParseHex4(code)) {
+            return false;
+          }
+          // A surrogate pair encodes the code points above 0xFFFF.
+          if (code >= 0xD800 && code < 0xDC00) {
+            unsigned low = 0;
+            if (!Consume("\\u") || !ParseHex4(low) || low < 0xDC00 ||
+                low >= 0xE000) {
+              return Fail("Invalid surrogate pair");
+            }
+            code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+          }
+          AppendUtf8(out, code);
+          break;
+        }
+        default:
+          return Fail("Invalid escape in a string");
+      }
+    }
+    return Fail("Unterminated string");
+  }
+
+  bool ParseNumber(JsonValue& value) {
+    const std::size_t begin = position_;
+    const auto is_number_char = [](const char c) {
+      return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' ||
+             c == 'e' || c == 'E';
+    };
+    while (position_ < text_.size() && is_number_char(text_[position_])) {
+      position_++;
+    }
+    // strtod needs a terminated string and accepts more than JSON does,
+    // the whole token must be used.
+    const std::string token(text_.substr(begin, position_ - begin));
+    if (token.empty()) {
+      return Fail("Unexpected character");
+    }
+    char* end = nullptr;
+    value.number_ = std::strtod(token.c_str(), &end);
+    if (end != token.c_str() + token.size()) {
+      position_ = begin;
+      return Fail("Invalid number");
+    }
+    value.type_ = JsonValue::Type::kNumber;
+    return true;
+  }
+};
+
+bool ParseJson(const std::string_view text, JsonValue& value,
+               std::string& error) {
+  value = JsonValue();
+  JsonParser parser(text);
+  return parser.Parse(value, error);
+}
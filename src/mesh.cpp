@@ -1,27 +1,109 @@
 #include "mesh.h"
 
-#ifdef TRACY_ENABLE
-#include <TracyC.h>
+#include <utility>
+
+#include "cpu_profiler.h"
+
+Mesh::Mesh(Mesh&& other) noexcept { *this = std::move(other); }
+
+Mesh& Mesh::operator=(Mesh&& other) noexcept {
+  if (this == &other) {
+    return *this;
+  }
+  // No GL call when there is nothing to give back: the model loading jobs
+  // move meshes without a context.
+  if (geometry_.IsValid() || vao_ != 0) {
+    Delete();
+  }
+  vertices_ = std::move(other.vertices_);
+  tex_coord_ = std::move(other.tex_coord_);
+  normals_ = std::move(other.normals_);
+  tangents_ = std::move(other.tangents_);
+  bitangents_ = std::move(other.bitangents_);
+  indices_ = std::move(other.indices_);
+  bounds_ = other.bounds_;
+  bounding_sphere_ = other.bounding_sphere_;
+  vao_ = std::exchange(other.vao_, 0);
+  pool_ = std::exchange(other.pool_, nullptr);
+  geometry_ = std::exchange(other.geometry_, GpuBufferHandle{});
+  bound_generation_ = other.bound_generation_;
+  attribute_offsets_ = other.attribute_offsets_;
+  attribute_mask_ = other.attribute_mask_;
+  index_offset_ = other.index_offset_;
+  index_count_ = std::exchange(other.index_count_, 0);
+  return *this;
+}
+
+void Mesh::Upload(GpuBufferPool& pool) {
+  ComputeBounds(vertices_, bounds_, bounding_sphere_);
+
+  const std::array<const std::vector<float>*, kAttributeCount> streams = {
+      &vertices_, &tex_coord_, &normals_, &tangents_, &bitangents_};
+
+  std::uint32_t size = 0;
+  attribute_mask_ = 0;
+  for (int i = 0; i < kAttributeCount; i++) {
+    attribute_offsets_[i] = size;
+    if (!streams[i]->empty()) {
+      attribute_mask_ |= 1u << i;
+      size += static_cast<std::uint32_t>(streams[i]->size() * sizeof(float));
+    }
+  }
+  index_offset_ = size;
+  size += static_cast<std::uint32_t>(indices_.size() * sizeof(GLuint));
+
+  if (pool_ != nullptr) {
+    pool_->Free(geometry_);
+  }
+  pool_ = &pool;
+  geometry_ = pool.Allocate(size);
+  if (!geometry_.IsValid()) {
+    std::cerr << "Not enough GPU memory to upload the mesh\n";
+    return;
+  }
+
+  for (int i = 0; i < kAttributeCount; i++) {
+    pool.Upload(geometry_, attribute_offsets_[i], streams[i]->data(),
+                static_cast<std::uint32_t>(streams[i]->size() * sizeof(float)));
+  }
+  pool.Upload(geometry_, index_offset_, indices_.data(),
+              static_cast<std::uint32_t>(indices_.size() * sizeof(GLuint)));
+  index_count_ = static_cast<GLsizei>(indices_.size());
 
-#include <Tracy.hpp>
-#endif
+  if (vao_ == 0) {
+    glGenVertexArrays(1, &vao_);
+  }
+  BindAttributes();
+}
 
-void Mesh::BindVBO(int index, std::vector<float> elements, int size) {
-  glBindBuffer(GL_ARRAY_BUFFER, vbo_[index]);
-  glBufferData(GL_ARRAY_BUFFER, elements.size() * sizeof(float),
-               elements.data(), GL_STATIC_DRAW);
+void Mesh::BindAttributes() {
+  const GLuint buffer = pool_->Buffer(geometry_);
+  const std::uint32_t base = pool_->Offset(geometry_);
 
-  // Associate vertex attributes with the VBO
-  glVertexAttribPointer(index, size, GL_FLOAT, GL_FALSE, size * sizeof(float),
-                        (void*)0);
-  glEnableVertexAttribArray(index);
+  glBindVertexArray(vao_);
+  glBindBuffer(GL_ARRAY_BUFFER, buffer);
+  for (int i = 0; i < kAttributeCount; i++) {
+    if ((attribute_mask_ & (1u << i)) == 0) {
+      glDisableVertexAttribArray(i);
+      continue;
+    }
+    const int components = kAttributeComponents[i];
+    glVertexAttribPointer(
+        i, components, GL_FLOAT, GL_FALSE, components * sizeof(float),
+        reinterpret_cast<void*>(
+            static_cast<std::uintptr_t>(base + attribute_offsets_[i])));
+    glEnableVertexAttribArray(i);
+  }
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+
+  bound_generation_ = pool_->Generation(geometry_);
 }
 
 void Mesh::SetTriangle() {
   vertices_ = {1.0, 1.0, 1.0, 0.0, 1.0, 1.0, 1.0, 0.0, 1.0};
   indices_ = {0, 1, 2};
 }
-void Mesh::SetQuad(float scale) {
+void Mesh::SetQuad(GpuBufferPool& pool, float scale) {
   float size = 0.5f * scale;
   vertices_ = {
       -size, size,  0.0,  // Top-let
@@ -32,23 +114,10 @@ void Mesh::SetQuad(float scale) {
   indices_ = {0, 3, 2, 0, 2, 1};
   tex_coord_ = {0.0f, 1.0f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f};
 
-  glGenVertexArrays(1, &vao_);  // create
-  glBindVertexArray(vao_);
-
-  vbo_.resize(3);
-
-  glGenBuffers(3, &vbo_[0]);
-  BindVBO(0, vertices_, 3);
-  BindVBO(1, tex_coord_, 2);
-  BindVBO(2, normals_, 3);
-
-  glGenBuffers(1, &ebo_);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices_.size() * sizeof(GLuint),
-               indices_.data(), GL_STATIC_DRAW);
+  Upload(pool);
 }
 
-void Mesh::SetCube(float scale, glm::vec2 factor) {
+void Mesh::SetCube(GpuBufferPool& pool, float scale, glm::vec2 factor) {
   vertices_ = {scale,  scale,  scale,  -scale, scale,  scale,  // front
                -scale, -scale, scale,  scale,  -scale, scale,
 
@@ -113,24 +182,10 @@ void Mesh::SetCube(float scale, glm::vec2 factor) {
       0, 0,  -1, 0, 0,  -1, 0, 0,  1,  0, 0,  1,  0,  0,  1,  0, 0,  1,
   };
 
-  glGenVertexArrays(1, &vao_);
-  glBindVertexArray(vao_);
-
-  vbo_.resize(4);
-
-  glGenBuffers(4, &vbo_[0]);
-  BindVBO(0, vertices_, 3);
-  BindVBO(1, tex_coord_, 2);
-  BindVBO(2, normals_, 3);
-  BindVBO(3, tangents_, 3);
-
-  glGenBuffers(1, &ebo_);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices_.size() * sizeof(GLuint),
-               indices_.data(), GL_STATIC_DRAW);
+  Upload(pool);
 }
 
-void Mesh::SetSphere() {
+void Mesh::SetSphere(GpuBufferPool& pool) {
   static unsigned int indexCount;
 
   std::vector<glm::vec3> positions;
@@ -191,28 +246,38 @@ void Mesh::SetSphere() {
     }
   }
 
-  glGenVertexArrays(1, &vao_);  // create
-  glBindVertexArray(vao_);
-
-  vbo_.resize(4);
-
-  glGenBuffers(4, &vbo_[0]);
-  BindVBO(0, vertices_, 3);
-  BindVBO(1, tex_coord_, 2);
-  BindVBO(2, normals_, 3);
-  BindVBO(3, tangents_, 3);
-
-  glGenBuffers(1, &ebo_);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices_.size() * sizeof(GLuint),
-               indices_.data(), GL_STATIC_DRAW);
+  Upload(pool);
 }
 
 void Mesh::Draw(bool is_sphere) {
+  if (!geometry_.IsValid()) {
+    return;
+  }
+  SyncAttributes();
   glBindVertexArray(vao_);
 
-  glDrawElements(!is_sphere ? GL_TRIANGLES : GL_TRIANGLE_STRIP, indices_.size(),
-                 GL_UNSIGNED_INT, 0);
+  glDrawElements(!is_sphere ? GL_TRIANGLES : GL_TRIANGLE_STRIP, index_count_,
+                 GL_UNSIGNED_INT,
+                 reinterpret_cast<void*>(static_cast<std::uintptr_t>(
+                     pool_->Offset(geometry_) + index_offset_)));
+}
+
+void Mesh::SyncAttributes() {
+  // The pool moved the range while defragmenting.
+  if (geometry_.IsValid() &&
+      pool_->Generation(geometry_) != bound_generation_) {
+    BindAttributes();
+  }
+}
+
+DrawIndexedCommand Mesh::DrawCommand(const bool is_sphere) const noexcept {
+  if (!geometry_.IsValid()) {
+    return {};
+  }
+  return {vao_, static_cast<std::uint32_t>(!is_sphere ? GL_TRIANGLES
+                                                      : GL_TRIANGLE_STRIP),
+          static_cast<std::uint32_t>(index_count_),
+          pool_->Offset(geometry_) + index_offset_};
 }
 
 void Mesh::clear() {
@@ -224,6 +289,16 @@ void Mesh::clear() {
   indices_.clear();
 }
 
+void Mesh::Delete() {
+  if (pool_ != nullptr) {
+    pool_->Free(geometry_);
+  }
+  glDeleteVertexArrays(1, &vao_);
+  vao_ = 0;
+  index_count_ = 0;
+  clear();
+}
+
 void Material::Set()
 {
   glActiveTexture(GL_TEXTURE0);
@@ -247,10 +322,8 @@ void Material::Clear()
   roughness = 0;
 }
 
-void Model::Load(std::string_view path, bool flip) {
-#ifdef TRACY_ENABLE
-  ZoneScoped;
-#endif
+void Model::Import(std::string_view path, bool flip) {
+  PROFILE_ZONE;
   Assimp::Importer import;
   auto flags = aiProcess_Triangulate | aiProcess_CalcTangentSpace;
   if (flip) {
@@ -266,21 +339,42 @@ void Model::Load(std::string_view path, bool flip) {
 
   dir_path_ = path.substr(0, path.find_last_of('/'));
 
-  ProcessNode(scene->mRootNode, scene);
+  ProcessNode(scene->mRootNode, scene, TransformStore::kNoParent);
 }
 
-void Model::ProcessNode(aiNode* node, const aiScene* scene) {
-  meshes_.reserve(node->mNumMeshes);
+void Model::Upload(GpuBufferPool& pool) {
+  PROFILE_ZONE;
+  for (auto& mesh : meshes_) {
+    mesh.Upload(pool);
+  }
+}
+
+void Model::ProcessNode(aiNode* node, const aiScene* scene,
+                        const std::uint32_t parent) {
+  // The node transform relative to its parent, a shear is lost.
+  aiVector3D scaling;
+  aiQuaternion rotation;
+  aiVector3D position;
+  node->mTransformation.Decompose(scaling, rotation, position);
+  ModelNode model_node;
+  model_node.local.position = glm::vec3(position.x, position.y, position.z);
+  model_node.local.rotation =
+      glm::quat(rotation.w, rotation.x, rotation.y, rotation.z);
+  model_node.local.scale = glm::vec3(scaling.x, scaling.y, scaling.z);
+  model_node.parent = parent;
+  const auto index = static_cast<std::uint32_t>(nodes_.size());
+  nodes_.push_back(model_node);
 
   // Process all the node's meshes (if any).
   for (std::size_t i = 0; i < node->mNumMeshes; i++) {
     aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
     meshes_.emplace_back(ProcessMesh(mesh, scene));
+    mesh_nodes_.push_back(index);
   }
 
   // Do the same for each of its children.
   for (std::size_t i = 0; i < node->mNumChildren; i++) {
-    ProcessNode(node->mChildren[i], scene);
+    ProcessNode(node->mChildren[i], scene, index);
   }
 }
 
@@ -323,23 +417,6 @@ Mesh Model::ProcessMesh(aiMesh* mesh, const aiScene* scene) {
     }
   }
 
-  glGenVertexArrays(1, &my_mesh.vao_);
-  glBindVertexArray(my_mesh.vao_);
-
-  my_mesh.vbo_.resize(5);
-
-  glGenBuffers(4, &my_mesh.vbo_[0]);
-  my_mesh.BindVBO(0, my_mesh.vertices_, 3);
-  my_mesh.BindVBO(1, my_mesh.tex_coord_, 2);
-  my_mesh.BindVBO(2, my_mesh.normals_, 3);
-  my_mesh.BindVBO(3, my_mesh.tangents_, 3);
-  my_mesh.BindVBO(4, my_mesh.bitangents_, 3);
-
-  glGenBuffers(1, &my_mesh.ebo_);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, my_mesh.ebo_);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-               my_mesh.indices_.size() * sizeof(GLuint),
-               my_mesh.indices_.data(), GL_STATIC_DRAW);
   return my_mesh;
 }
 
@@ -349,9 +426,43 @@ void Model::Draw() {
   }
 }
 
+void Model::SyncAttributes() {
+  for (auto& mesh : meshes_) {
+    mesh.SyncAttributes();
+  }
+}
+
+void Model::DrawMesh(const std::size_t index) { meshes_[index].Draw(); }
+
+ImportModelJob::ImportModelJob(Model* model, std::string path,
+                               const bool flip) noexcept
+    : Job(JobType::kModelLoading),
+      model_(model),
+      path_(std::move(path)),
+      flip_(flip) {}
+
+void ImportModelJob::Work() noexcept {
+  PROFILE_ZONE;
+#ifdef TRACY_ENABLE
+  ZoneText(path_.data(), path_.size());
+#endif  // TRACY_ENABLE
+  model_->Import(path_, flip_);
+}
+
+UploadModelJob::UploadModelJob(Model* model, GpuBufferPool* pool) noexcept
+    : Job(JobType::kMainThread), model_(model), pool_(pool) {}
+
+void UploadModelJob::Work() noexcept {
+  PROFILE_ZONE;
+  model_->Upload(*pool_);
+}
+
 void Model::Clear() {
   for (auto& mesh : meshes_) {
-    mesh.clear();
+    mesh.Delete();
   }
+  meshes_.clear();
+  nodes_.clear();
+  mesh_nodes_.clear();
   mat.Clear();
 }
@@ -9,10 +9,30 @@ void Pipeline::Bind() {
   current_program_ = program_;
 }
 
+void Pipeline::Use(const GLuint program) {
+  glUseProgram(program);
+  current_program_ = program;
+}
+
 void Pipeline::Delete() {
+  // Safe to call twice, the names may have been reused by then.
   glDeleteProgram(program_);
   glDeleteShader(vertex_shader_);
   glDeleteShader(fragment_shader_);
+  if (geometry_shader_ != 0) {
+    glDeleteShader(geometry_shader_);
+    geometry_shader_ = 0;
+  }
+  if (compute_shader_ != 0) {
+    glDeleteShader(compute_shader_);
+    compute_shader_ = 0;
+  }
+  if (current_program_ == program_) {
+    current_program_ = 0;
+  }
+  program_ = 0;
+  vertex_shader_ = 0;
+  fragment_shader_ = 0;
 }
 
 void Pipeline::SetInt(std::string_view name, int value) {
@@ -38,6 +58,33 @@ void Pipeline::SetMat4(std::string_view name, glm::mat4 matrix) {
   glUniformMatrix4fv(glGetUniformLocation(program_, name.data()), 1, GL_FALSE,
                      glm::value_ptr(matrix));
 }
+void Pipeline::SetMat4Array(std::string_view name, const glm::mat4* matrices,
+                            int count) {
+  if (program_ != current_program_) {
+    std::cerr << "Wrong Pipeline binded to set matrix 4 array\n";
+    return;
+  }
+  glUniformMatrix4fv(glGetUniformLocation(program_, name.data()), count,
+                     GL_FALSE, glm::value_ptr(matrices[0]));
+}
+void Pipeline::SetVec4Array(std::string_view name, const glm::vec4* vectors,
+                            int count) {
+  if (program_ != current_program_) {
+    std::cerr << "Wrong Pipeline binded to set vector 4 array\n";
+    return;
+  }
+  glUniform4fv(glGetUniformLocation(program_, name.data()), count,
+               glm::value_ptr(vectors[0]));
+}
+void Pipeline::SetUniformBlockBinding(std::string_view name,
+                                      const GLuint binding) {
+  const GLuint index = glGetUniformBlockIndex(program_, name.data());
+  if (index == GL_INVALID_INDEX) {
+    std::cerr << "Unknown uniform block " << name << '\n';
+    return;
+  }
+  glUniformBlockBinding(program_, index, binding);
+}
 void Pipeline::SetVec2(std::string_view name, glm::vec2 vec2) {
   if (program_ != current_program_) {
     std::cerr << "Wrong Pipeline binded to set vector 2\n";
@@ -45,6 +92,14 @@ void Pipeline::SetVec2(std::string_view name, glm::vec2 vec2) {
   }
   glUniform2f(glGetUniformLocation(program_, name.data()), vec2.x, vec2.y);
 }
+
+void Pipeline::SetIVec2(std::string_view name, glm::ivec2 vec2) {
+  if (program_ != current_program_) {
+    std::cerr << "Wrong Pipeline binded to set int vector 2\n";
+    return;
+  }
+  glUniform2i(glGetUniformLocation(program_, name.data()), vec2.x, vec2.y);
+}
 void Pipeline::SetVec3Color(std::string_view name, glm::vec3 vec3) {
   if (program_ != current_program_) {
     std::cerr << "Wrong Pipeline binded to set vector 3 color\n";
@@ -64,6 +119,11 @@ void Pipeline::SetVec3Position(std::string_view name, glm::vec3 vec3) {
 
 void Pipeline::LoadShader(std::string_view vert_path,
                           std::string_view frag_path) {
+  LoadShaderSource(vert_path, LoadFile(frag_path));
+}
+
+void Pipeline::LoadShaderSource(std::string_view vert_path,
+                                const std::string& frag_source) {
   const auto vertexContent = LoadFile(vert_path);
   const auto *ptr = vertexContent.data();
   vertex_shader_ = glCreateShader(GL_VERTEX_SHADER);
@@ -78,8 +138,7 @@ void Pipeline::LoadShader(std::string_view vert_path,
     return;
   }
 
-  const auto fragmentContent = LoadFile(frag_path);
-  ptr = fragmentContent.data();
+  ptr = frag_source.data();
 
   fragment_shader_ = glCreateShader(GL_FRAGMENT_SHADER);
   glShaderSource(fragment_shader_, 1, &ptr, nullptr);
@@ -91,10 +150,57 @@ void Pipeline::LoadShader(std::string_view vert_path,
   }
 }
 
+void Pipeline::LoadShader(std::string_view vert_path,
+                          std::string_view geom_path,
+                          std::string_view frag_path) {
+  LoadShader(vert_path, frag_path);
+
+  const auto geometryContent = LoadFile(geom_path);
+  const auto *ptr = geometryContent.data();
+
+  geometry_shader_ = glCreateShader(GL_GEOMETRY_SHADER);
+  glShaderSource(geometry_shader_, 1, &ptr, nullptr);
+  glCompileShader(geometry_shader_);
+
+  GLint success;
+  glGetShaderiv(geometry_shader_, GL_COMPILE_STATUS, &success);
+  if (!success) {
+    std::cerr << "Error while loading geometry shader\n";
+  }
+}
+
+void Pipeline::LoadComputeShader(std::string_view comp_path) {
+  const auto computeContent = LoadFile(comp_path);
+  const auto *ptr = computeContent.data();
+
+  compute_shader_ = glCreateShader(GL_COMPUTE_SHADER);
+  glShaderSource(compute_shader_, 1, &ptr, nullptr);
+  glCompileShader(compute_shader_);
+
+  GLint success;
+  glGetShaderiv(compute_shader_, GL_COMPILE_STATUS, &success);
+  if (!success) {
+    std::cerr << "Error while loading compute shader\n";
+  }
+}
+
 void Pipeline::LoadProgram() {
   // Load program/pipeline
   program_ = glCreateProgram();
+  if (compute_shader_ != 0) {
+    glAttachShader(program_, compute_shader_);
+    glLinkProgram(program_);
+    GLint success;
+    glGetProgramiv(program_, GL_LINK_STATUS, &success);
+    if (!success) {
+      std::cerr << "Error while linking compute program\n";
+    }
+    return;
+  }
   glAttachShader(program_, vertex_shader_);
+  if (geometry_shader_ != 0) {
+    glAttachShader(program_, geometry_shader_);
+  }
   glAttachShader(program_, fragment_shader_);
   glLinkProgram(program_);
   // Check if shader program was linked correctly
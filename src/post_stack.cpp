@@ -0,0 +1,68 @@
+#include "post_stack.h"
+
+void PostStack::SetEnabled(const PostEffect effect,
+                           const bool is_enabled) noexcept {
+  if (is_enabled) {
+    enabled_mask_ |= Bit(effect);
+  } else {
+    enabled_mask_ &= ~Bit(effect);
+  }
+}
+
+bool PostStack::IsActive(const PostEffect effect) const noexcept {
+  if (effect == PostEffect::kBrightPass && !IsEnabled(PostEffect::kBloom)) {
+    return false;
+  }
+  return IsEnabled(effect);
+}
+
+std::uint32_t PostStack::Key() const noexcept {
+  std::uint32_t key = 0;
+  for (std::size_t i = 0; i < kPostEffects.size(); i++) {
+    const auto effect = static_cast<PostEffect>(i);
+    if (IsActive(effect)) {
+      key |= Bit(effect);
+    }
+  }
+  return key;
+}
+
+std::string PostStack::GenerateShader(
+    const std::string_view template_source) const {
+  // "#version" has to stay the first line.
+  const auto version_end = template_source.find('\n');
+  const std::size_t header_size = version_end == std::string_view::npos
+                                      ? template_source.size()
+                                      : version_end + 1;
+  std::string source(template_source.substr(0, header_size));
+  if (version_end == std::string_view::npos) {
+    source += '\n';
+  }
+  for (std::size_t i = 0; i < kPostEffects.size(); i++) {
+    if (IsActive(static_cast<PostEffect>(i))) {
+      source += "#define ";
+      source += kPostEffects[i].define;
+      source += '\n';
+    }
+  }
+  source += template_source.substr(header_size);
+  return source;
+}
+
+PostPassCount PostStack::PassCount(
+    const int bloom_level_count, const bool is_bloom_compute) const noexcept {
+  // The composite reads the scene and writes the screen.
+  PostPassCount count{1, 0, 2};
+  if (!IsActive(PostEffect::kBloom)) {
+    return count;
+  }
+  const int up_passes = bloom_level_count - 2;
+  if (is_bloom_compute) {
+    count.compute_passes = (bloom_level_count + 1) / 2 + up_passes;
+  } else {
+    count.fragment_passes += bloom_level_count + up_passes;
+  }
+  // The first downsample reads the scene again.
+  count.full_resolution_accesses++;
+  return count;
+}
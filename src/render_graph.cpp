@@ -0,0 +1,207 @@
+#include "render_graph.h"
+
+#include <algorithm>
+#include <numeric>
+#include <utility>
+
+#include "gpu_memory.h"
+
+namespace {
+
+bool AddUniqueTexture(std::vector<std::uint32_t>& textures,
+                      const std::uint32_t texture) {
+  if (std::find(textures.begin(), textures.end(), texture) != textures.end()) {
+    return false;
+  }
+  textures.push_back(texture);
+  return true;
+}
+
+bool AreViewCompatible(const RenderGraphTextureDesc& a,
+                       const RenderGraphTextureDesc& b) noexcept {
+  if (a.width != b.width || a.height != b.height || a.levels != b.levels ||
+      a.is_depth != b.is_depth) {
+    return false;
+  }
+  return a.is_depth ? a.format == b.format
+                    : a.bytes_per_texel == b.bytes_per_texel;
+}
+
+}  // namespace
+
+void RenderGraph::Clear() noexcept {
+  passes_.clear();
+  textures_.clear();
+  slots_.clear();
+  stats_ = {};
+}
+
+std::uint32_t RenderGraph::CreateTexture(RenderGraphTextureDesc desc) {
+  Texture texture;
+  texture.byte_size = TextureByteSize(static_cast<std::uint32_t>(desc.width),
+                                      static_cast<std::uint32_t>(desc.height),
+                                      desc.bytes_per_texel, 1, desc.levels);
+  texture.desc = std::move(desc);
+  textures_.push_back(std::move(texture));
+  return static_cast<std::uint32_t>(textures_.size() - 1);
+}
+
+std::uint32_t RenderGraph::ImportTexture(std::string name,
+                                         const std::size_t byte_size) {
+  Texture texture;
+  texture.desc.name = std::move(name);
+  texture.byte_size = byte_size;
+  texture.is_imported = true;
+  textures_.push_back(std::move(texture));
+  return static_cast<std::uint32_t>(textures_.size() - 1);
+}
+
+void RenderGraph::MarkOutput(const std::uint32_t texture) noexcept {
+  if (texture < textures_.size()) {
+    textures_[texture].is_output = true;
+  }
+}
+
+std::uint32_t RenderGraph::AddPass(std::string name) {
+  Pass pass;
+  pass.name = std::move(name);
+  passes_.push_back(std::move(pass));
+  return static_cast<std::uint32_t>(passes_.size() - 1);
+}
+
+void RenderGraph::Read(const std::uint32_t pass, const std::uint32_t texture) {
+  if (pass < passes_.size() && texture < textures_.size()) {
+    AddUniqueTexture(passes_[pass].reads, texture);
+  }
+}
+
+void RenderGraph::Write(const std::uint32_t pass,
+                        const std::uint32_t texture) {
+  if (pass < passes_.size() && texture < textures_.size()) {
+    AddUniqueTexture(passes_[pass].writes, texture);
+  }
+}
+
+void RenderGraph::Compile() {
+  Cull();
+  ComputeLifetimes();
+  AssignSlots();
+
+  stats_ = {};
+  stats_.pass_count = passes_.size();
+  stats_.culled_pass_count = static_cast<std::size_t>(
+      std::count_if(passes_.begin(), passes_.end(),
+                    [](const Pass& pass) { return !pass.is_alive; }));
+  for (const auto& texture : textures_) {
+    if (texture.is_imported || texture.slot == kInvalid) {
+      continue;
+    }
+    stats_.texture_count++;
+    stats_.transient_bytes += texture.byte_size;
+  }
+  for (const auto& slot : slots_) {
+    stats_.slot_bytes += slot.byte_size;
+  }
+  stats_.aliased_texture_count = stats_.texture_count - slots_.size();
+}
+
+void RenderGraph::Cull() {
+  // A pass lives while one of the textures it writes is read by a living
+  // pass or is an output. Passes writing nothing have side effects.
+  std::vector<std::size_t> pass_refs(passes_.size());
+  std::vector<std::size_t> texture_refs(textures_.size());
+  std::vector<std::vector<std::uint32_t>> writers(textures_.size());
+  for (std::uint32_t p = 0; p < passes_.size(); p++) {
+    Pass& pass = passes_[p];
+    pass.is_alive = true;
+    pass_refs[p] = pass.writes.size();
+    for (const auto texture : pass.reads) {
+      texture_refs[texture]++;
+    }
+    for (const auto texture : pass.writes) {
+      writers[texture].push_back(p);
+    }
+  }
+  std::vector<std::uint32_t> unused;
+  for (std::uint32_t t = 0; t < textures_.size(); t++) {
+    if (textures_[t].is_output) {
+      texture_refs[t]++;
+    }
+    if (texture_refs[t] == 0) {
+      unused.push_back(t);
+    }
+  }
+
+  while (!unused.empty()) {
+    const std::uint32_t texture = unused.back();
+    unused.pop_back();
+    for (const auto p : writers[texture]) {
+      Pass& pass = passes_[p];
+      if (!pass.is_alive || --pass_refs[p] > 0) {
+        continue;
+      }
+      pass.is_alive = false;
+      for (const auto read : pass.reads) {
+        if (--texture_refs[read] == 0) {
+          unused.push_back(read);
+        }
+      }
+    }
+  }
+}
+
+void RenderGraph::ComputeLifetimes() noexcept {
+  for (auto& texture : textures_) {
+    texture.first_pass = kInvalid;
+    texture.last_pass = kInvalid;
+  }
+  for (std::uint32_t p = 0; p < passes_.size(); p++) {
+    const Pass& pass = passes_[p];
+    if (!pass.is_alive) {
+      continue;
+    }
+    const auto extend = [this, p](const std::uint32_t t) {
+      Texture& texture = textures_[t];
+      texture.first_pass = std::min(texture.first_pass, p);
+      texture.last_pass =
+          texture.last_pass == kInvalid ? p : std::max(texture.last_pass, p);
+    };
+    std::for_each(pass.reads.begin(), pass.reads.end(), extend);
+    std::for_each(pass.writes.begin(), pass.writes.end(), extend);
+  }
+}
+
+void RenderGraph::AssignSlots() {
+  slots_.clear();
+  std::vector<std::uint32_t> order(textures_.size());
+  std::iota(order.begin(), order.end(), 0u);
+  std::stable_sort(order.begin(), order.end(),
+                   [this](const std::uint32_t a, const std::uint32_t b) {
+                     return textures_[a].first_pass < textures_[b].first_pass;
+                   });
+  for (const auto t : order) {
+    Texture& texture = textures_[t];
+    texture.slot = kInvalid;
+    if (texture.is_imported || texture.first_pass == kInvalid) {
+      continue;
+    }
+    for (std::uint32_t s = 0; s < slots_.size(); s++) {
+      RenderGraphSlot& slot = slots_[s];
+      if (slot.last_pass < texture.first_pass &&
+          AreViewCompatible(slot.desc, texture.desc)) {
+        texture.slot = s;
+        break;
+      }
+    }
+    if (texture.slot == kInvalid) {
+      RenderGraphSlot slot;
+      slot.desc = texture.desc;
+      slot.byte_size = texture.byte_size;
+      slots_.push_back(std::move(slot));
+      texture.slot = static_cast<std::uint32_t>(slots_.size() - 1);
+    }
+    RenderGraphSlot& slot = slots_[texture.slot];
+    slot.last_pass = texture.last_pass;
+    slot.texture_count++;
+  }
+}
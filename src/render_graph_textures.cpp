@@ -0,0 +1,49 @@
+#include "render_graph_textures.h"
+
+void RenderGraphTextures::Create(const RenderGraph& graph) {
+  Delete();
+  const auto& slots = graph.slots();
+  storages_.resize(slots.size());
+  glGenTextures(static_cast<GLsizei>(storages_.size()), storages_.data());
+  for (std::size_t s = 0; s < slots.size(); s++) {
+    const RenderGraphTextureDesc& desc = slots[s].desc;
+    glBindTexture(GL_TEXTURE_2D, storages_[s]);
+    glTexStorage2D(GL_TEXTURE_2D, static_cast<GLsizei>(desc.levels),
+                   desc.format, desc.width, desc.height);
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  const auto& textures = graph.textures();
+  views_.assign(textures.size(), 0);
+  for (std::size_t t = 0; t < textures.size(); t++) {
+    const auto& texture = textures[t];
+    if (texture.slot == RenderGraph::kInvalid) {
+      continue;
+    }
+    const RenderGraphTextureDesc& desc = texture.desc;
+    // A view needs a name never bound before.
+    glGenTextures(1, &views_[t]);
+    glTextureView(views_[t], GL_TEXTURE_2D, storages_[texture.slot],
+                  desc.format, 0, desc.levels, 0, 1);
+    glBindTexture(GL_TEXTURE_2D, views_[t]);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                    static_cast<GLint>(desc.filter));
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER,
+                    static_cast<GLint>(desc.filter));
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void RenderGraphTextures::Delete() {
+  // A view keeps its storage alive, both are deleted.
+  for (auto& view : views_) {
+    if (view != 0) {
+      glDeleteTextures(1, &view);
+    }
+  }
+  glDeleteTextures(static_cast<GLsizei>(storages_.size()), storages_.data());
+  views_.clear();
+  storages_.clear();
+}
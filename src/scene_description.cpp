@@ -0,0 +1,297 @@
+#include "scene_description.h"
+
+#include <fstream>
+#include <sstream>
+#include <utility>
+
+#include "cpu_profiler.h"
+#include "json.h"
+
+namespace {
+
+// A number is the same value on the three axes.
+bool ReadSceneVec3(const JsonValue* value, glm::vec3& out) noexcept {
+  if (value == nullptr) {
+    return true;
+  }
+  if (value->IsNumber()) {
+    out = glm::vec3(value->AsFloat());
+    return true;
+  }
+  if (!value->IsArray() || value->items().size() != 3) {
+    return false;
+  }
+  for (int i = 0; i < 3; i++) {
+    if (!value->items()[i].IsNumber()) {
+      return false;
+    }
+    out[i] = value->items()[i].AsFloat();
+  }
+  return true;
+}
+
+const std::string& SceneName(const JsonValue& value) noexcept {
+  static const std::string kNoName;
+  const JsonValue* name = value.Find("name");
+  return name != nullptr ? name->AsString() : kNoName;
+}
+
+template <typename T>
+const T* FindSceneEntry(const std::vector<T>& entries,
+                        const std::string_view name) noexcept {
+  for (const auto& entry : entries) {
+    if (entry.name == name) {
+      return &entry;
+    }
+  }
+  return nullptr;
+}
+
+bool ParseSceneMaterial(const JsonValue& value, SceneDescription& scene,
+                        std::string& error) {
+  SceneMaterialDesc material;
+  material.name = SceneName(value);
+  if (material.name.empty()) {
+    error = "A material has no name";
+    return false;
+  }
+  if (scene.FindMaterial(material.name) != nullptr) {
+    error = "Material " + material.name + " is listed twice";
+    return false;
+  }
+  const JsonValue* flip_y = value.Find("flip_y");
+  const JsonValue* srgb_albedo = value.Find("srgb_albedo");
+  for (int map = 0; map < kSceneMaterialMapCount; map++) {
+    const JsonValue* entry = value.Find(kSceneMaterialMapNames[map]);
+    if (entry == nullptr) {
+      continue;
+    }
+    // A path, or an object overriding the flags of the material.
+    SceneTextureDesc texture;
+    texture.flip_y = flip_y == nullptr || flip_y->AsBool(true);
+    texture.is_srgb = map == kSceneMaterialAlbedo &&
+                      (srgb_albedo == nullptr || srgb_albedo->AsBool(true));
+    const JsonValue* path = entry->IsObject() ? entry->Find("path") : entry;
+    if (path == nullptr || path->AsString().empty()) {
+      error = "Material " + material.name + " has an invalid " +
+              kSceneMaterialMapNames[map] + " map";
+      return false;
+    }
+    texture.path = path->AsString();
+    if (entry->IsObject()) {
+      if (const JsonValue* flag = entry->Find("flip_y")) {
+        texture.flip_y = flag->AsBool(texture.flip_y);
+      }
+      if (const JsonValue* flag = entry->Find("srgb")) {
+        texture.is_srgb = flag->AsBool(texture.is_srgb);
+      }
+    }
+    material.textures[map] = scene.AddTexture(texture);
+  }
+  scene.materials.push_back(std::move(material));
+  return true;
+}
+
+bool ParseSceneObject(const JsonValue& value, SceneDescription& scene,
+                      std::string& error) {
+  SceneObjectDesc object;
+  object.name = SceneName(value);
+  if (object.name.empty()) {
+    error = "An object has no name";
+    return false;
+  }
+  if (scene.FindObject(object.name) != nullptr) {
+    error = "Object " + object.name + " is listed twice";
+    return false;
+  }
+  if (const JsonValue* model = value.Find("model")) {
+    object.model = model->AsString();
+  }
+  if (const JsonValue* material = value.Find("material")) {
+    object.material = material->AsString();
+  }
+  if (const JsonValue* mesh = value.Find("mesh")) {
+    object.mesh = mesh->AsString();
+  }
+  if (const JsonValue* light = value.Find("light")) {
+    object.light = light->AsString();
+  }
+  if (const JsonValue* is_dynamic = value.Find("dynamic")) {
+    object.is_dynamic = is_dynamic->AsBool();
+  }
+  if (object.model.empty() && object.mesh.empty()) {
+    error = "Object " + object.name + " has no model and no mesh";
+    return false;
+  }
+  // Euler angles in degrees, about X, Y then Z.
+  glm::vec3 rotation(0.f);
+  if (!ReadSceneVec3(value.Find("position"), object.transform.position) ||
+      !ReadSceneVec3(value.Find("rotation"), rotation) ||
+      !ReadSceneVec3(value.Find("scale"), object.transform.scale)) {
+    error = "Object " + object.name + " has an invalid transform";
+    return false;
+  }
+  object.transform.rotation = glm::quat(glm::radians(rotation));
+  scene.objects.push_back(std::move(object));
+  return true;
+}
+
+}  // namespace
+
+void SceneDescription::Clear() noexcept {
+  textures.clear();
+  materials.clear();
+  models.clear();
+  objects.clear();
+  lights.clear();
+}
+
+std::uint32_t SceneDescription::AddTexture(const SceneTextureDesc& texture) {
+  for (std::uint32_t i = 0; i < textures.size(); i++) {
+    if (textures[i].path == texture.path &&
+        textures[i].is_srgb == texture.is_srgb &&
+        textures[i].flip_y == texture.flip_y) {
+      return i;
+    }
+  }
+  textures.push_back(texture);
+  return static_cast<std::uint32_t>(textures.size() - 1);
+}
+
+const SceneMaterialDesc* SceneDescription::FindMaterial(
+    const std::string_view name) const noexcept {
+  return FindSceneEntry(materials, name);
+}
+
+const SceneModelDesc* SceneDescription::FindModel(
+    const std::string_view name) const noexcept {
+  return FindSceneEntry(models, name);
+}
+
+const SceneObjectDesc* SceneDescription::FindObject(
+    const std::string_view name) const noexcept {
+  return FindSceneEntry(objects, name);
+}
+
+const SceneLightDesc* SceneDescription::FindLight(
+    const std::string_view name) const noexcept {
+  return FindSceneEntry(lights, name);
+}
+
+bool ParseSceneDescription(const std::string_view text,
+                           SceneDescription& scene, std::string& error) {
+  PROFILE_ZONE;
+  scene.Clear();
+  JsonValue root;
+  if (!ParseJson(text, root, error)) {
+    return false;
+  }
+  if (!root.IsObject()) {
+    error = "The scene isn't a JSON object";
+    return false;
+  }
+
+  // Models, by name: the ones sharing a path and flags share the load.
+  if (const JsonValue* models = root.Find("models")) {
+    for (const auto& value : models->items()) {
+      SceneModelDesc model;
+      model.name = SceneName(value);
+      if (const JsonValue* path = value.Find("path")) {
+        model.path = path->AsString();
+      }
+      if (model.name.empty() || model.path.empty()) {
+        error = "A model has no name or no path";
+        return false;
+      }
+      if (const JsonValue* flip_uvs = value.Find("flip_uvs")) {
+        model.flip_uvs = flip_uvs->AsBool();
+      }
+      if (scene.FindModel(model.name) != nullptr) {
+        error = "Model " + model.name + " is listed twice";
+        return false;
+      }
+      model.source = static_cast<std::uint32_t>(scene.models.size());
+      for (const auto& other : scene.models) {
+        if (other.path == model.path && other.flip_uvs == model.flip_uvs) {
+          model.source = other.source;
+          break;
+        }
+      }
+      scene.models.push_back(std::move(model));
+    }
+  }
+  if (const JsonValue* materials = root.Find("materials")) {
+    for (const auto& value : materials->items()) {
+      if (!ParseSceneMaterial(value, scene, error)) {
+        return false;
+      }
+    }
+  }
+  // Before the objects, which may move with one.
+  if (const JsonValue* lights = root.Find("lights")) {
+    for (const auto& value : lights->items()) {
+      SceneLightDesc light;
+      light.name = SceneName(value);
+      if (scene.FindLight(light.name) != nullptr) {
+        error = "Light " + light.name + " is listed twice";
+        return false;
+      }
+      const JsonValue* radius = value.Find("radius");
+      if (!ReadSceneVec3(value.Find("position"), light.position) ||
+          !ReadSceneVec3(value.Find("color"), light.color) ||
+          (radius != nullptr && !radius->IsNumber())) {
+        error = "Light " + light.name + " is invalid";
+        return false;
+      }
+      if (radius != nullptr) {
+        light.radius = radius->AsFloat();
+      }
+      scene.lights.push_back(std::move(light));
+    }
+  }
+  if (const JsonValue* objects = root.Find("objects")) {
+    for (const auto& value : objects->items()) {
+      if (!ParseSceneObject(value, scene, error)) {
+        return false;
+      }
+      const SceneObjectDesc& object = scene.objects.back();
+      if ((!object.model.empty() && !scene.FindModel(object.model)) ||
+          (!object.material.empty() && !scene.FindMaterial(object.material)) ||
+          (!object.light.empty() && !scene.FindLight(object.light))) {
+        error = "Object " + object.name +
+                " uses an unknown model, material or light";
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool LoadSceneDescription(const std::string_view path,
+                          SceneDescription& scene, std::string& error) {
+  std::ifstream file(std::string(path), std::ios::binary);
+  if (!file) {
+    error = "Can't open " + std::string(path);
+    return false;
+  }
+  std::ostringstream text;
+  text << file.rdbuf();
+  if (!ParseSceneDescription(text.str(), scene, error)) {
+    error = std::string(path) + ": " + error;
+    return false;
+  }
+  return true;
+}
+
+void LoadSceneDescriptionJob::Setup(std::string path,
+                                    SceneDescription* scene) noexcept {
+  path_ = std::move(path);
+  scene_ = scene;
+  is_valid_ = false;
+  error_.clear();
+}
+
+void LoadSceneDescriptionJob::Work() noexcept {
+  PROFILE_ZONE;
+  is_valid_ = LoadSceneDescription(path_, *scene_, error_);
+}
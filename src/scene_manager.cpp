@@ -1,13 +1,21 @@
 #include "scene_manager.h"
 
+#include <iostream>
+
+#include "cpu_profiler.h"
 #include "final_scene.h"
 
 void SceneManager::Setup() {
   scenes_.push_back(std::make_unique<FinalScene>());
+
+  for (auto& scene : scenes_) {
+    scene->SetBufferPool(&buffer_pool_);
+  }
 }
 
-void SceneManager::UpdateScene(const float deltaTime) const noexcept {
+void SceneManager::UpdateScene(const float deltaTime) noexcept {
   scenes_[sceneIdx_]->Update(deltaTime);
+  buffer_pool_.Compact();
 }
 
 void SceneManager::ChangeScene(int index) noexcept {
@@ -40,6 +48,8 @@ void SceneManager::BeginScene() noexcept { scenes_[sceneIdx_]->Begin(); }
 
 void SceneManager::EndScene() noexcept { scenes_[sceneIdx_]->End(); }
 
+void SceneManager::ReleaseGpuMemory() noexcept { buffer_pool_.Release(); }
+
 void SceneManager::DrawImGui() noexcept {
   static bool is_first_frame = true;
   if (is_first_frame) {
@@ -56,6 +66,45 @@ void SceneManager::DrawImGui() noexcept {
 
   ImGui::Spacing();
 
+  if (ImGui::CollapsingHeader("GPU geometry memory")) {
+    constexpr float kMegaByte = 1024.f * 1024.f;
+    const GpuBufferPoolStats stats = buffer_pool_.Stats();
+    ImGui::Text("Arenas: %zu  Allocations: %u", stats.arena_count,
+                stats.total.allocation_count);
+    ImGui::Text("Used: %.2f / %.2f MB", stats.total.used_bytes / kMegaByte,
+                stats.total.capacity / kMegaByte);
+    ImGui::Text("Wasted by rounding: %u B", stats.total.WastedBytes());
+    ImGui::Text("Free blocks: %u  Fragmentation: %.1f %%",
+                stats.total.free_block_count,
+                stats.total.Fragmentation() * 100.f);
+    ImGui::Text("Moved by compaction: %.2f MB",
+                static_cast<float>(stats.moved_bytes) / kMegaByte);
+  }
+
+  if (ImGui::CollapsingHeader("CPU profiler")) {
+    bool is_enabled = CpuProfiler::IsEnabled();
+    if (ImGui::Checkbox("Record zones", &is_enabled)) {
+      CpuProfiler::SetEnabled(is_enabled);
+    }
+    const CpuProfilerStats stats = CpuProfiler::Stats();
+    ImGui::Text("%zu threads, %zu events kept, %llu overwritten",
+                stats.thread_count, stats.event_count,
+                static_cast<unsigned long long>(stats.lost_event_count));
+    static float zone_overhead = 0.f;
+    if (ImGui::Button("Measure zone overhead")) {
+      zone_overhead = CpuProfiler::MeasureZoneOverhead(100'000);
+    }
+    if (zone_overhead > 0.f) {
+      ImGui::SameLine();
+      ImGui::Text("%.1f ns per zone", zone_overhead);
+    }
+    if (ImGui::Button("Write Chrome trace")) {
+      std::cout << (CpuProfiler::WriteChromeTrace("cpu_trace.json")
+                        ? "CPU trace written to cpu_trace.json\n"
+                        : "Can't write cpu_trace.json\n");
+    }
+  }
+
   ImGui::SetCursorPosY(ImGui::GetWindowHeight() -
                        (ImGui::GetFrameHeightWithSpacing()));
 
@@ -65,3 +114,5 @@ void SceneManager::DrawImGui() noexcept {
 Camera& SceneManager::GetCamera() noexcept {
   return scenes_[sceneIdx_]->camera_;
 }
+
+Scene& SceneManager::GetScene() noexcept { return *scenes_[sceneIdx_]; }
@@ -0,0 +1,234 @@
+#include "shadow_atlas.h"
+
+#include <algorithm>
+
+namespace {
+
+std::uint32_t AtlasFloorPowerOfTwo(std::uint32_t value) noexcept {
+  std::uint32_t power = 1;
+  while (power <= value / 2) {
+    power *= 2;
+  }
+  return power;
+}
+
+}  // namespace
+
+ShadowAtlas::ShadowAtlas(const std::uint32_t size,
+                         const std::uint32_t min_resolution,
+                         const std::uint32_t max_resolution) noexcept
+    : size_(AtlasFloorPowerOfTwo(size)),
+      min_resolution_(AtlasFloorPowerOfTwo(min_resolution)),
+      max_resolution_(std::min(AtlasFloorPowerOfTwo(max_resolution),
+                               AtlasFloorPowerOfTwo(size))) {
+  free_tiles_.resize(LevelOf(min_resolution_) + 1);
+  free_tiles_[0].push_back(AtlasTile{0, 0, size_});
+}
+
+std::uint32_t ShadowAtlas::SizeForBudget(
+    const std::size_t byte_budget, const std::uint32_t bytes_per_texel,
+    const std::uint32_t max_size) noexcept {
+  std::uint32_t size = 1;
+  while (size * 2 <= max_size &&
+         static_cast<std::size_t>(size) * 2 * size * 2 * bytes_per_texel <=
+             byte_budget) {
+    size *= 2;
+  }
+  return size;
+}
+
+std::uint32_t ShadowAtlas::ResolutionForCoverage(
+    const float coverage) const noexcept {
+  const float texels = std::clamp(coverage, 0.f, 1.f) *
+                       static_cast<float>(max_resolution_);
+  return std::clamp(AtlasFloorPowerOfTwo(static_cast<std::uint32_t>(texels)),
+                    min_resolution_, max_resolution_);
+}
+
+int ShadowAtlas::LevelOf(const std::uint32_t tile_size) const noexcept {
+  int level = 0;
+  for (std::uint32_t size = size_; size > tile_size; size /= 2) {
+    level++;
+  }
+  return level;
+}
+
+bool ShadowAtlas::AllocateTile(const int level, AtlasTile& tile) noexcept {
+  if (level < 0) {
+    return false;
+  }
+  auto& free_tiles = free_tiles_[level];
+  if (free_tiles.empty()) {
+    // Split a tile of the level above in 4.
+    AtlasTile parent;
+    if (!AllocateTile(level - 1, parent)) {
+      return false;
+    }
+    const std::uint32_t half = parent.size / 2;
+    free_tiles.push_back({parent.x + half, parent.y + half, half});
+    free_tiles.push_back({parent.x, parent.y + half, half});
+    free_tiles.push_back({parent.x + half, parent.y, half});
+    tile = {parent.x, parent.y, half};
+    return true;
+  }
+  tile = free_tiles.back();
+  free_tiles.pop_back();
+  return true;
+}
+
+void ShadowAtlas::FreeTile(const AtlasTile& tile) noexcept {
+  const int level = LevelOf(tile.size);
+  auto& free_tiles = free_tiles_[level];
+  if (level == 0) {
+    free_tiles.push_back(tile);
+    return;
+  }
+
+  // Merge with the 3 siblings when they are all free.
+  const std::uint32_t parent_size = tile.size * 2;
+  const AtlasTile parent{tile.x / parent_size * parent_size,
+                         tile.y / parent_size * parent_size, parent_size};
+  std::array<std::size_t, 3> siblings{};
+  std::size_t sibling_count = 0;
+  for (std::size_t i = 0; i < free_tiles.size() && sibling_count < 3; i++) {
+    const AtlasTile& other = free_tiles[i];
+    if (other.x / parent_size * parent_size == parent.x &&
+        other.y / parent_size * parent_size == parent.y) {
+      siblings[sibling_count++] = i;
+    }
+  }
+  if (sibling_count < 3) {
+    free_tiles.push_back(tile);
+    return;
+  }
+
+  // Erase from the back so that the indices stay valid.
+  std::sort(siblings.begin(), siblings.end());
+  for (auto it = siblings.rbegin(); it != siblings.rend(); ++it) {
+    free_tiles[*it] = free_tiles.back();
+    free_tiles.pop_back();
+  }
+  FreeTile(parent);
+}
+
+bool ShadowAtlas::AllocateLight(const std::uint32_t resolution,
+                                Light& light) noexcept {
+  const int level = LevelOf(resolution);
+  for (int face = 0; face < kFaceCount; face++) {
+    if (!AllocateTile(level, light.tiles[face])) {
+      for (int i = 0; i < face; i++) {
+        FreeTile(light.tiles[i]);
+      }
+      return false;
+    }
+  }
+  light.resolution = resolution;
+  return true;
+}
+
+void ShadowAtlas::FreeLight(const Light& light) noexcept {
+  for (const auto& tile : light.tiles) {
+    FreeTile(tile);
+  }
+}
+
+bool ShadowAtlas::EvictLeastRecentlyUsed() noexcept {
+  auto victim = lights_.end();
+  for (auto it = lights_.begin(); it != lights_.end(); ++it) {
+    // A light acquired last frame is still in use, it may not have been
+    // acquired yet this frame.
+    if (it->second.last_used_frame + 1 >= frame_) {
+      continue;
+    }
+    if (victim == lights_.end() ||
+        it->second.last_used_frame < victim->second.last_used_frame) {
+      victim = it;
+    }
+  }
+  if (victim == lights_.end()) {
+    return false;
+  }
+  FreeLight(victim->second);
+  lights_.erase(victim);
+  eviction_count_++;
+  return true;
+}
+
+const ShadowAtlas::Light* ShadowAtlas::Acquire(
+    const std::uint32_t light_id, const std::uint32_t resolution,
+    bool& reallocated) noexcept {
+  reallocated = false;
+  const std::uint32_t wanted = std::clamp(AtlasFloorPowerOfTwo(resolution),
+                                          min_resolution_, max_resolution_);
+
+  std::uint32_t lowest = min_resolution_;
+  const auto it = lights_.find(light_id);
+  if (it != lights_.end()) {
+    Light& current = it->second;
+    current.last_used_frame = frame_;
+    if (current.resolution == wanted) {
+      return &current;
+    }
+    if (current.resolution > wanted) {
+      // Shrinking always fits in the freed tiles.
+      FreeLight(current);
+      AllocateLight(wanted, current);
+      reallocated = true;
+      return &current;
+    }
+    // Growing: the current tiles stay in use until bigger ones are found.
+    lowest = current.resolution * 2;
+  }
+
+  Light light;
+  light.last_used_frame = frame_;
+  const auto allocate = [&]() {
+    for (std::uint32_t r = wanted; r >= lowest; r /= 2) {
+      if (AllocateLight(r, light)) {
+        return true;
+      }
+    }
+    return false;
+  };
+
+  if (it != lights_.end()) {
+    // Growing only takes free tiles, it never evicts another light.
+    if (!allocate()) {
+      return &it->second;
+    }
+    FreeLight(it->second);
+    it->second = light;
+    reallocated = true;
+    return &it->second;
+  }
+
+  // A new light takes any resolution that fits before evicting anything.
+  while (!allocate()) {
+    if (!EvictLeastRecentlyUsed()) {
+      return nullptr;
+    }
+  }
+  reallocated = true;
+  return &(lights_[light_id] = light);
+}
+
+void ShadowAtlas::Release(const std::uint32_t light_id) noexcept {
+  const auto it = lights_.find(light_id);
+  if (it == lights_.end()) {
+    return;
+  }
+  FreeLight(it->second);
+  lights_.erase(it);
+}
+
+ShadowAtlasStats ShadowAtlas::Stats() const noexcept {
+  ShadowAtlasStats stats;
+  stats.size = size_;
+  stats.light_count = static_cast<std::uint32_t>(lights_.size());
+  stats.eviction_count = eviction_count_;
+  for (const auto& [id, light] : lights_) {
+    stats.used_texels += static_cast<std::uint64_t>(kFaceCount) *
+                         light.resolution * light.resolution;
+  }
+  return stats;
+}
@@ -0,0 +1,105 @@
+#include "shadow_cache.h"
+
+#include <algorithm>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "cpu_profiler.h"
+
+void ShadowFaceScheduler::MarkDirty(const std::uint8_t faces) noexcept {
+  // A face already waiting keeps its place in the queue.
+  const std::uint8_t newly_dirty = faces & ~dirty_faces();
+  for (int face = 0; face < kFaceCount; face++) {
+    if (newly_dirty & (1u << face)) {
+      dirty_since_[face] = frame_;
+    }
+  }
+}
+
+void ShadowFaceScheduler::InvalidateStatic(const std::uint8_t faces) noexcept {
+  MarkDirty(faces);
+  static_dirty_ |= faces & kAllFaces;
+}
+
+void ShadowFaceScheduler::InvalidateDynamic(
+    const std::uint8_t faces) noexcept {
+  MarkDirty(faces);
+  dynamic_dirty_ |= faces & kAllFaces;
+}
+
+ShadowFaceScheduler::FaceUpdate ShadowFaceScheduler::Schedule(
+    const int face_budget) noexcept {
+  std::array<int, kFaceCount> order{};
+  int dirty_count = 0;
+  for (int face = 0; face < kFaceCount; face++) {
+    if (dirty_faces() & (1u << face)) {
+      order[dirty_count++] = face;
+    }
+  }
+  std::stable_sort(order.begin(), order.begin() + dirty_count,
+                   [this](const int a, const int b) {
+                     return dirty_since_[a] < dirty_since_[b];
+                   });
+
+  std::uint8_t faces = 0;
+  for (int i = 0; i < std::min(dirty_count, face_budget); i++) {
+    faces |= static_cast<std::uint8_t>(1u << order[i]);
+  }
+
+  last_update_.static_faces = static_dirty_ & faces;
+  last_update_.composite_faces = faces;
+  static_dirty_ &= ~faces;
+  dynamic_dirty_ &= ~faces;
+  frame_++;
+  return last_update_;
+}
+
+std::array<glm::mat4, ShadowFaceScheduler::kFaceCount> PointLightMatrices(
+    const glm::vec3& position, const float near_plane,
+    const float far_plane) noexcept {
+  static constexpr std::array<glm::vec3, ShadowFaceScheduler::kFaceCount>
+      kDirections = {
+          glm::vec3(1, 0, 0),  glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0),
+          glm::vec3(0, -1, 0), glm::vec3(0, 0, 1),  glm::vec3(0, 0, -1),
+      };
+  static constexpr std::array<glm::vec3, ShadowFaceScheduler::kFaceCount>
+      kUps = {
+          glm::vec3(0, -1, 0), glm::vec3(0, -1, 0), glm::vec3(0, 0, 1),
+          glm::vec3(0, 0, -1), glm::vec3(0, -1, 0), glm::vec3(0, -1, 0),
+      };
+  const glm::mat4 projection =
+      glm::perspective(glm::radians(90.f), 1.0f, near_plane, far_plane);
+  std::array<glm::mat4, ShadowFaceScheduler::kFaceCount> matrices{};
+  for (int face = 0; face < ShadowFaceScheduler::kFaceCount; face++) {
+    matrices[face] =
+        projection * glm::lookAt(position, position + kDirections[face],
+                                 kUps[face]);
+  }
+  return matrices;
+}
+
+void ShadowCasterFaces::Cull(JobSystem& job_system, const CullingSet& set,
+                             const LightMatrices& matrices) {
+  PROFILE_ZONE;
+  masks_.assign(set.size(), 0);
+  stats_ = CullingStats{};
+  for (std::size_t face = 0; face < matrices.size(); face++) {
+    const CullingStats face_stats = culler_.Cull(
+        job_system, Frustum::FromMatrix(matrices[face]), set, visibility_);
+    stats_.tested_count += face_stats.tested_count;
+    stats_.visible_count += face_stats.visible_count;
+    stats_.milliseconds += face_stats.milliseconds;
+    for (std::size_t i = 0; i < masks_.size(); i++) {
+      masks_[i] |= static_cast<std::uint8_t>(visibility_[i] << face);
+    }
+  }
+}
+
+std::uint8_t ShadowCasterFaces::Mask(const std::uint32_t first,
+                                     const std::uint32_t end) const noexcept {
+  std::uint8_t mask = 0;
+  for (std::size_t i = first; i < std::min<std::size_t>(end, masks_.size());
+       i++) {
+    mask |= masks_[i];
+  }
+  return mask;
+}
@@ -0,0 +1,286 @@
+#include "spherical_harmonics.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define SH_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define SH_SSE
+#endif
+
+#include "cpu_profiler.h"
+
+namespace {
+
+constexpr float kShPi = 3.14159265358979f;
+
+// Basis constants of each polynomial and the cosine lobe of its band divided
+// by pi: 1, 2/3 and 1/4.
+constexpr std::array<float, ShIrradiance::kCoefficientCount> kShBasis = {
+    0.282095f, 0.488603f, 0.488603f, 0.488603f, 1.092548f,
+    1.092548f, 0.315392f, 1.092548f, 0.546274f};
+constexpr std::array<float, ShIrradiance::kCoefficientCount> kShBand = {
+    1.f, 2.f / 3.f, 2.f / 3.f, 2.f / 3.f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f};
+
+// One SIMD register of texels, the kernel below is written once for the
+// three widths.
+#if defined(SH_AVX)
+constexpr int kShLanes = 8;
+using ShVec = __m256;
+inline ShVec ShSet1(const float value) { return _mm256_set1_ps(value); }
+inline ShVec ShLoad(const float* values) { return _mm256_loadu_ps(values); }
+inline ShVec ShAdd(const ShVec a, const ShVec b) { return _mm256_add_ps(a, b); }
+inline ShVec ShSub(const ShVec a, const ShVec b) { return _mm256_sub_ps(a, b); }
+inline ShVec ShMul(const ShVec a, const ShVec b) { return _mm256_mul_ps(a, b); }
+inline ShVec ShMulAdd(const ShVec a, const ShVec b, const ShVec c) {
+#if defined(__FMA__)
+  return _mm256_fmadd_ps(a, b, c);
+#else
+  return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+}
+inline float ShSum(const ShVec a) {
+  const __m128 half =
+      _mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+  const __m128 pairs = _mm_add_ps(half, _mm_movehl_ps(half, half));
+  return _mm_cvtss_f32(
+      _mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, _MM_SHUFFLE(1, 1, 1, 1))));
+}
+#elif defined(SH_SSE)
+constexpr int kShLanes = 4;
+using ShVec = __m128;
+inline ShVec ShSet1(const float value) { return _mm_set1_ps(value); }
+inline ShVec ShLoad(const float* values) { return _mm_loadu_ps(values); }
+inline ShVec ShAdd(const ShVec a, const ShVec b) { return _mm_add_ps(a, b); }
+inline ShVec ShSub(const ShVec a, const ShVec b) { return _mm_sub_ps(a, b); }
+inline ShVec ShMul(const ShVec a, const ShVec b) { return _mm_mul_ps(a, b); }
+inline ShVec ShMulAdd(const ShVec a, const ShVec b, const ShVec c) {
+  return _mm_add_ps(_mm_mul_ps(a, b), c);
+}
+inline float ShSum(const ShVec a) {
+  const __m128 pairs = _mm_add_ps(a, _mm_movehl_ps(a, a));
+  return _mm_cvtss_f32(
+      _mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, _MM_SHUFFLE(1, 1, 1, 1))));
+}
+#else
+constexpr int kShLanes = 1;
+using ShVec = float;
+inline ShVec ShSet1(const float value) { return value; }
+inline ShVec ShLoad(const float* values) { return *values; }
+inline ShVec ShAdd(const ShVec a, const ShVec b) { return a + b; }
+inline ShVec ShSub(const ShVec a, const ShVec b) { return a - b; }
+inline ShVec ShMul(const ShVec a, const ShVec b) { return a * b; }
+inline ShVec ShMulAdd(const ShVec a, const ShVec b, const ShVec c) {
+  return a * b + c;
+}
+inline float ShSum(const ShVec a) { return a; }
+#endif
+
+int ShPaddedWidth(const int width) noexcept {
+  return (width + kShLanes - 1) / kShLanes * kShLanes;
+}
+
+// Latitude of the center of a row, rows go from the bottom up.
+float ShRowLatitude(const int row, const int height) noexcept {
+  return ((static_cast<float>(row) + 0.5f) / static_cast<float>(height) -
+          0.5f) *
+         kShPi;
+}
+
+glm::vec3 ShSampleNearest(const ShImage& image, const glm::vec3 direction) {
+  const float u = std::atan2(direction.z, direction.x) / (2.f * kShPi) + 0.5f;
+  const float v =
+      std::asin(std::clamp(direction.y, -1.f, 1.f)) / kShPi + 0.5f;
+  const int col = std::clamp(static_cast<int>(u * image.width), 0,
+                             image.width - 1);
+  const int row = std::clamp(static_cast<int>(v * image.height), 0,
+                             image.height - 1);
+  const float* texel =
+      image.texels + (static_cast<std::size_t>(row) * image.width + col) * 3;
+  return glm::clamp(glm::vec3(texel[0], texel[1], texel[2]), glm::vec3(0.f),
+                    glm::vec3(kShMaxRadiance));
+}
+
+}  // namespace
+
+glm::vec3 ShIrradiance::Evaluate(const glm::vec3 normal) const noexcept {
+  const float x = normal.x, y = normal.y, z = normal.z;
+  return coefficients[0] + coefficients[1] * y + coefficients[2] * z +
+         coefficients[3] * x + coefficients[4] * (x * y) +
+         coefficients[5] * (y * z) + coefficients[6] * (3.f * z * z - 1.f) +
+         coefficients[7] * (x * z) + coefficients[8] * (x * x - y * y);
+}
+
+std::array<glm::vec4, ShIrradiance::kCoefficientCount> ShIrradiance::Std140()
+    const noexcept {
+  std::array<glm::vec4, kCoefficientCount> packed{};
+  for (int i = 0; i < kCoefficientCount; i++) {
+    packed[i] = glm::vec4(coefficients[i], 0.f);
+  }
+  return packed;
+}
+
+void ShProjectionJob::Setup(const ShImage* image, const float* cos_phi,
+                            const float* sin_phi, const int begin_row,
+                            const int end_row) noexcept {
+  image_ = image;
+  cos_phi_ = cos_phi;
+  sin_phi_ = sin_phi;
+  begin_row_ = begin_row;
+  end_row_ = end_row;
+}
+
+void ShProjectionJob::Work() noexcept {
+  PROFILE_ZONE;
+  constexpr int kSumCount = ShIrradiance::kCoefficientCount * 3;
+  sums_.fill(0.0);
+  const int width = image_->width;
+  const int padded_width = ShPaddedWidth(width);
+  // The padding stays black, it adds nothing to the sums.
+  row_.assign(static_cast<std::size_t>(padded_width) * 3, 0.f);
+  float* red = row_.data();
+  float* green = red + padded_width;
+  float* blue = green + padded_width;
+  const float texel_solid_angle = (2.f * kShPi / static_cast<float>(width)) *
+                                  (kShPi / static_cast<float>(image_->height));
+
+  for (int row = begin_row_; row < end_row_; row++) {
+    const float* texels =
+        image_->texels + static_cast<std::size_t>(row) * width * 3;
+    for (int col = 0; col < width; col++) {
+      red[col] = std::clamp(texels[col * 3], 0.f, kShMaxRadiance);
+      green[col] = std::clamp(texels[col * 3 + 1], 0.f, kShMaxRadiance);
+      blue[col] = std::clamp(texels[col * 3 + 2], 0.f, kShMaxRadiance);
+    }
+
+    const float latitude = ShRowLatitude(row, image_->height);
+    const float cos_latitude = std::cos(latitude);
+    const ShVec y = ShSet1(std::sin(latitude));
+    const ShVec ring = ShSet1(cos_latitude);
+    const ShVec one = ShSet1(1.f);
+    const ShVec three = ShSet1(3.f);
+
+    ShVec sums[kSumCount];
+    for (auto& sum : sums) {
+      sum = ShSet1(0.f);
+    }
+    for (int col = 0; col < padded_width; col += kShLanes) {
+      const ShVec x = ShMul(ring, ShLoad(cos_phi_ + col));
+      const ShVec z = ShMul(ring, ShLoad(sin_phi_ + col));
+      const ShVec basis[ShIrradiance::kCoefficientCount] = {
+          one,
+          y,
+          z,
+          x,
+          ShMul(x, y),
+          ShMul(y, z),
+          ShSub(ShMul(three, ShMul(z, z)), one),
+          ShMul(x, z),
+          ShSub(ShMul(x, x), ShMul(y, y))};
+      const ShVec r = ShLoad(red + col);
+      const ShVec g = ShLoad(green + col);
+      const ShVec b = ShLoad(blue + col);
+      for (int i = 0; i < ShIrradiance::kCoefficientCount; i++) {
+        sums[i * 3] = ShMulAdd(basis[i], r, sums[i * 3]);
+        sums[i * 3 + 1] = ShMulAdd(basis[i], g, sums[i * 3 + 1]);
+        sums[i * 3 + 2] = ShMulAdd(basis[i], b, sums[i * 3 + 2]);
+      }
+    }
+
+    // Every texel of a row covers the same solid angle.
+    const double row_weight =
+        static_cast<double>(texel_solid_angle) * cos_latitude;
+    for (int i = 0; i < kSumCount; i++) {
+      sums_[i] += row_weight * ShSum(sums[i]);
+    }
+  }
+}
+
+ShIrradiance ShProjector::Project(JobSystem& job_system,
+                                  const ShImage& image) noexcept {
+  PROFILE_ZONE;
+  const auto start = std::chrono::steady_clock::now();
+
+  const int padded_width = ShPaddedWidth(image.width);
+  cos_phi_.assign(padded_width, 0.f);
+  sin_phi_.assign(padded_width, 0.f);
+  for (int col = 0; col < image.width; col++) {
+    const float phi =
+        ((static_cast<float>(col) + 0.5f) / static_cast<float>(image.width) -
+         0.5f) *
+        2.f * kShPi;
+    cos_phi_[col] = std::cos(phi);
+    sin_phi_[col] = std::sin(phi);
+  }
+
+  const int max_jobs = job_system.compute_worker_count() + 1;
+  const int job_count =
+      std::clamp(image.height / kMinRowsPerJob, 1, max_jobs);
+  const int rows_per_job = (image.height + job_count - 1) / job_count;
+  jobs_.resize(job_count);
+  job_ptrs_.clear();
+  for (int i = 0; i < job_count; i++) {
+    const int begin = i * rows_per_job;
+    const int end = std::min(image.height, begin + rows_per_job);
+    if (begin >= end) {
+      break;
+    }
+    jobs_[i].Reset();
+    jobs_[i].Setup(&image, cos_phi_.data(), sin_phi_.data(), begin, end);
+    job_ptrs_.push_back(&jobs_[i]);
+  }
+  job_system.RunComputeJobs(job_ptrs_.data(), job_ptrs_.size());
+
+  std::array<double, ShIrradiance::kCoefficientCount * 3> sums{};
+  for (const Job* job : job_ptrs_) {
+    const auto& job_sums = static_cast<const ShProjectionJob*>(job)->sums();
+    for (std::size_t i = 0; i < sums.size(); i++) {
+      sums[i] += job_sums[i];
+    }
+  }
+
+  // Projecting gives basis * sum, evaluating multiplies by the basis again.
+  ShIrradiance irradiance;
+  for (int i = 0; i < ShIrradiance::kCoefficientCount; i++) {
+    const double scale =
+        static_cast<double>(kShBand[i]) * kShBasis[i] * kShBasis[i];
+    irradiance.coefficients[i] =
+        glm::vec3(static_cast<float>(sums[i * 3] * scale),
+                  static_cast<float>(sums[i * 3 + 1] * scale),
+                  static_cast<float>(sums[i * 3 + 2] * scale));
+  }
+
+  stats_.texel_count = static_cast<std::size_t>(image.width) * image.height;
+  stats_.milliseconds = std::chrono::duration<float, std::milli>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+  return irradiance;
+}
+
+glm::vec3 ConvolveIrradiance(const ShImage& image, const glm::vec3 normal,
+                             const float sample_delta) {
+  const glm::vec3 n = glm::normalize(normal);
+  // The shader has no fallback at the poles, where its basis is undefined.
+  const glm::vec3 world_up = std::abs(n.y) > 0.999f ? glm::vec3(1.f, 0.f, 0.f)
+                                                    : glm::vec3(0.f, 1.f, 0.f);
+  const glm::vec3 right = glm::normalize(glm::cross(world_up, n));
+  const glm::vec3 up = glm::normalize(glm::cross(n, right));
+
+  glm::vec3 irradiance(0.f);
+  float sample_count = 0.f;
+  for (float phi = 0.f; phi < 2.f * kShPi; phi += sample_delta) {
+    for (float theta = 0.f; theta < 0.5f * kShPi; theta += sample_delta) {
+      const glm::vec3 direction =
+          std::sin(theta) * std::cos(phi) * right +
+          std::sin(theta) * std::sin(phi) * up + std::cos(theta) * n;
+      irradiance += ShSampleNearest(image, direction) * std::cos(theta) *
+                    std::sin(theta);
+      sample_count++;
+    }
+  }
+  return kShPi * irradiance / sample_count;
+}
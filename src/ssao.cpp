@@ -0,0 +1,41 @@
+#include "ssao.h"
+
+#include <cmath>
+#include <random>
+
+std::vector<glm::vec3> GenerateSsaoKernel(const int sample_count,
+                                          const std::uint32_t seed) {
+  std::uniform_real_distribution<float> random_floats(0.0f, 1.0f);
+  std::default_random_engine generator(seed);
+
+  std::vector<glm::vec3> kernel(sample_count);
+  for (int i = 0; i < sample_count; i++) {
+    glm::vec3 sample(random_floats(generator) * 2.0f - 1.0f,
+                     random_floats(generator) * 2.0f - 1.0f,
+                     random_floats(generator));
+    sample = glm::normalize(sample);
+    sample *= random_floats(generator);
+
+    // scale samples s.t. they're more aligned to center of kernel
+    float scale = static_cast<float>(i) / static_cast<float>(sample_count);
+    scale = 0.1f + (scale * scale) * (1.0f - 0.1f);
+    kernel[i] = sample * scale;
+  }
+  return kernel;
+}
+
+float SsaoFrameAngle(const std::uint32_t frame_index) noexcept {
+  constexpr float kGoldenAngle = 2.39996323f;
+  constexpr float kTwoPi = 6.28318531f;
+  // The sequence restarts before the float loses precision.
+  return std::fmod(static_cast<float>(frame_index % 4096u) * kGoldenAngle,
+                   kTwoPi);
+}
+
+std::size_t SsaoSampleTaps(const SsaoPreset& preset, const int width,
+                           const int height) noexcept {
+  const auto divisor = static_cast<std::size_t>(preset.resolution_divisor);
+  const std::size_t low_width = (width + divisor - 1) / divisor;
+  const std::size_t low_height = (height + divisor - 1) / divisor;
+  return low_width * low_height * preset.sample_count;
+}
@@ -4,20 +4,12 @@
 
 #include <iostream>
 
+#include "cpu_profiler.h"
 #include "file_utility.h"
 
 
-#ifdef TRACY_ENABLE
-#include <TracyC.h>
-
-#include <Tracy.hpp>
-#endif
-
-
 GLuint TextureManager::LoadTexture(std::string_view path, bool flip, bool pbr) {
-#ifdef TRACY_ENABLE
-  ZoneScoped;
-#endif
+  PROFILE_ZONE;
 
   // Set STBI flip_ option
   stbi_set_flip_vertically_on_load(flip);
@@ -116,28 +108,48 @@ GLuint TextureManager::LoadCubeMap(std::string path,
 }
 
 GLuint TextureManager::LoadHDR(std::string_view path, bool flip) {
+  return UploadHDR(LoadHDRImage(path, flip));
+}
+
+bool TextureManager::ReadImageSize(std::string_view path, int& width,
+                                   int& height) {
+  int channels;
+  return stbi_info(path.data(), &width, &height, &channels) != 0;
+}
+
+HdrImage TextureManager::LoadHDRImage(std::string_view path, bool flip) {
+  PROFILE_ZONE;
   // pbr: load the HDR environment map
   // ---------------------------------
   stbi_set_flip_vertically_on_load(flip);
-  int width, height, nrComponents;
-  float* data = stbi_loadf(path.data(), &width, &height, &nrComponents, 0);
-  GLuint hdrTexture;
+  HdrImage image;
+  int nrComponents;
+  float* data =
+      stbi_loadf(path.data(), &image.width, &image.height, &nrComponents, 3);
   if (data) {
-    glGenTextures(1, &hdrTexture);
-    glBindTexture(GL_TEXTURE_2D, hdrTexture);
-    glTexImage2D(
-        GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_FLOAT,
-        data);  // note how we specify the texture's data value to be float
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
+    image.texels.assign(
+        data, data + static_cast<std::size_t>(image.width) * image.height * 3);
     stbi_image_free(data);
   } else {
+    image.width = 0;
+    image.height = 0;
     std::cout << "Failed to load HDR image." << std::endl;
   }
+  return image;
+}
+
+GLuint TextureManager::UploadHDR(const HdrImage& image) {
+  GLuint hdrTexture;
+  glGenTextures(1, &hdrTexture);
+  glBindTexture(GL_TEXTURE_2D, hdrTexture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, image.width, image.height, 0,
+               GL_RGB, GL_FLOAT,
+               image.texels.empty() ? nullptr : image.texels.data());
+
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
   return hdrTexture;
 }
 
@@ -166,8 +178,8 @@ ReadJob& ReadJob::operator=(
 ReadJob::~ReadJob() noexcept { file_buffer = nullptr; }
 
 void ReadJob::Work() noexcept {
+  PROFILE_ZONE;
 #ifdef TRACY_ENABLE
-  ZoneScoped;
   ZoneText(file_path.data(), file_path.size());
 #endif  // TRACY_ENABLE
 
@@ -210,9 +222,7 @@ DecompressJob::~DecompressJob() noexcept {
 }
 
 void DecompressJob::Work() noexcept {
-#ifdef TRACY_ENABLE
-  ZoneScoped;
-#endif  // TRACY_ENABLE
+  PROFILE_ZONE;
   stbi_set_flip_vertically_on_load(flip_);
 
   texture_->data = stbi_load_from_memory(
@@ -309,8 +319,6 @@ void LoadTextureToGpu(TextureBuffer* image_buffer, GLuint* id,
 }
 
 void UploadGpuJob::Work() noexcept {
-#ifdef TRACY_ENABLE
-  ZoneScoped;
-#endif  // TRACY_ENABLE
+  PROFILE_ZONE;
   LoadTextureToGpu(image_buffer_, texture_id_, texture_param_);
 }
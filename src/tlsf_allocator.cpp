@@ -0,0 +1,384 @@
+#include "tlsf_allocator.h"
+
+#include <algorithm>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+std::uint32_t TlsfFindLastSet(const std::uint32_t value) noexcept {
+#ifdef _MSC_VER
+  unsigned long index = 0;
+  _BitScanReverse(&index, value);
+  return static_cast<std::uint32_t>(index);
+#else
+  return 31u - static_cast<std::uint32_t>(__builtin_clz(value));
+#endif
+}
+
+std::uint32_t TlsfFindFirstSet(const std::uint32_t value) noexcept {
+#ifdef _MSC_VER
+  unsigned long index = 0;
+  _BitScanForward(&index, value);
+  return static_cast<std::uint32_t>(index);
+#else
+  return static_cast<std::uint32_t>(__builtin_ctz(value));
+#endif
+}
+
+std::uint32_t TlsfRoundUp(const std::uint32_t value,
+                          const std::uint32_t alignment) noexcept {
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+}  // namespace
+
+TlsfAllocator::TlsfAllocator(const std::uint32_t capacity) noexcept
+    : capacity_(capacity & ~(kGranularity - 1)) {
+  Reset();
+}
+
+void TlsfAllocator::Reset() noexcept {
+  blocks_.clear();
+  unused_blocks_.clear();
+  used_bytes_ = 0;
+  requested_bytes_ = 0;
+  allocation_count_ = 0;
+
+  fl_bitmap_ = 0;
+  sl_bitmaps_.fill(0);
+  for (auto& heads : free_heads_) {
+    heads.fill(kInvalidBlock);
+  }
+
+  first_block_ = kInvalidBlock;
+  if (capacity_ == 0) {
+    return;
+  }
+
+  first_block_ = NewBlock();
+  blocks_[first_block_].offset = 0;
+  blocks_[first_block_].size = capacity_;
+  blocks_[first_block_].is_free = true;
+  InsertFree(first_block_);
+}
+
+void TlsfAllocator::Mapping(const std::uint32_t size, std::uint32_t& fl,
+                            std::uint32_t& sl) noexcept {
+  if (size < kSmallBlockSize) {
+    fl = 0;
+    sl = size / (kSmallBlockSize / kSlCount);
+  } else {
+    const std::uint32_t last_bit = TlsfFindLastSet(size);
+    sl = (size >> (last_bit - kSlCountLog2)) ^ kSlCount;
+    fl = last_bit - kFlShift + 1;
+  }
+}
+
+std::uint32_t TlsfAllocator::FindFreeBlock(
+    const std::uint32_t size) const noexcept {
+  std::uint32_t fl = 0, sl = 0;
+
+  // Good fit: round the size up to the next list so that any block found in
+  // the bitmaps is guaranteed to be big enough.
+  std::uint32_t search_size = size;
+  if (size >= kSmallBlockSize) {
+    const std::uint32_t round =
+        (1u << (TlsfFindLastSet(size) - kSlCountLog2)) - 1;
+    if (size <= UINT32_MAX - round) {
+      search_size += round;
+    }
+  }
+  Mapping(search_size, fl, sl);
+
+  if (fl < kFlCount) {
+    std::uint32_t sl_map = sl_bitmaps_[fl] & (~0u << sl);
+    if (sl_map == 0) {
+      const std::uint32_t fl_map =
+          fl + 1 < kFlCount ? fl_bitmap_ & (~0u << (fl + 1)) : 0;
+      if (fl_map != 0) {
+        fl = TlsfFindFirstSet(fl_map);
+        sl_map = sl_bitmaps_[fl];
+      }
+    }
+    if (sl_map != 0) {
+      return free_heads_[fl][TlsfFindFirstSet(sl_map)];
+    }
+  }
+
+  // The rounded up search failed, the exact list may still hold a block that
+  // is big enough.
+  Mapping(size, fl, sl);
+  for (std::uint32_t block = free_heads_[fl][sl]; block != kInvalidBlock;
+       block = blocks_[block].next_free) {
+    if (blocks_[block].size >= size) {
+      return block;
+    }
+  }
+  return kInvalidBlock;
+}
+
+std::uint32_t TlsfAllocator::Allocate(std::uint32_t size,
+                                      std::uint32_t alignment) noexcept {
+  // Checked before the rounding, which wraps around near UINT32_MAX.
+  if (size > capacity_) {
+    return kInvalidBlock;
+  }
+  const std::uint32_t requested = size;
+  alignment = std::max(alignment, kGranularity);
+  size = TlsfRoundUp(std::max(size, 1u), kGranularity);
+
+  // Worst case padding needed to align the start of a free block.
+  const std::uint32_t padding = alignment - kGranularity;
+  if (size > capacity_ || padding > capacity_ - size) {
+    return kInvalidBlock;
+  }
+
+  const std::uint32_t free_block = FindFreeBlock(size + padding);
+  if (free_block == kInvalidBlock) {
+    return kInvalidBlock;
+  }
+  return Place(free_block, size, requested, alignment);
+}
+
+std::uint32_t TlsfAllocator::Place(const std::uint32_t free_block,
+                                   const std::uint32_t size,
+                                   const std::uint32_t requested,
+                                   const std::uint32_t alignment) noexcept {
+  RemoveFree(free_block);
+  const std::uint32_t offset =
+      TlsfRoundUp(blocks_[free_block].offset, alignment);
+  const std::uint32_t block = Carve(free_block, offset, size);
+
+  Block& allocated = blocks_[block];
+  allocated.is_free = false;
+  allocated.requested = requested;
+  allocated.alignment = alignment;
+
+  used_bytes_ += size;
+  requested_bytes_ += requested;
+  allocation_count_++;
+  return block;
+}
+
+std::uint32_t TlsfAllocator::Carve(std::uint32_t block,
+                                   const std::uint32_t offset,
+                                   const std::uint32_t size) noexcept {
+  // Neighbours of a free block are never free, so the leftovers do not need
+  // to be merged.
+  if (offset > blocks_[block].offset) {
+    const std::uint32_t back = NewBlock();
+    Block& front = blocks_[block];
+    Block& aligned = blocks_[back];
+
+    aligned.offset = offset;
+    aligned.size = front.offset + front.size - offset;
+    aligned.prev_phys = block;
+    aligned.next_phys = front.next_phys;
+    if (front.next_phys != kInvalidBlock) {
+      blocks_[front.next_phys].prev_phys = back;
+    }
+    front.next_phys = back;
+    front.size = offset - front.offset;
+    front.is_free = true;
+    InsertFree(block);
+
+    block = back;
+  }
+
+  if (blocks_[block].size > size) {
+    const std::uint32_t tail = NewBlock();
+    Block& head = blocks_[block];
+    Block& rest = blocks_[tail];
+
+    rest.offset = head.offset + size;
+    rest.size = head.size - size;
+    rest.prev_phys = block;
+    rest.next_phys = head.next_phys;
+    rest.is_free = true;
+    if (head.next_phys != kInvalidBlock) {
+      blocks_[head.next_phys].prev_phys = tail;
+    }
+    head.next_phys = tail;
+    head.size = size;
+    InsertFree(tail);
+  }
+  return block;
+}
+
+void TlsfAllocator::Free(std::uint32_t block) noexcept {
+  if (block == kInvalidBlock || blocks_[block].is_free) {
+    return;
+  }
+  Block& freed = blocks_[block];
+  used_bytes_ -= freed.size;
+  requested_bytes_ -= freed.requested;
+  allocation_count_--;
+
+  freed.is_free = true;
+  freed.requested = 0;
+  block = MergeWithNeighbours(block);
+  InsertFree(block);
+}
+
+std::uint32_t TlsfAllocator::MergeWithNeighbours(
+    std::uint32_t block) noexcept {
+  const std::uint32_t prev = blocks_[block].prev_phys;
+  if (prev != kInvalidBlock && blocks_[prev].is_free) {
+    RemoveFree(prev);
+    blocks_[prev].size += blocks_[block].size;
+    blocks_[prev].next_phys = blocks_[block].next_phys;
+    if (blocks_[block].next_phys != kInvalidBlock) {
+      blocks_[blocks_[block].next_phys].prev_phys = prev;
+    }
+    ReleaseBlock(block);
+    block = prev;
+  }
+
+  const std::uint32_t next = blocks_[block].next_phys;
+  if (next != kInvalidBlock && blocks_[next].is_free) {
+    RemoveFree(next);
+    blocks_[block].size += blocks_[next].size;
+    blocks_[block].next_phys = blocks_[next].next_phys;
+    if (blocks_[next].next_phys != kInvalidBlock) {
+      blocks_[blocks_[next].next_phys].prev_phys = block;
+    }
+    ReleaseBlock(next);
+  }
+  return block;
+}
+
+void TlsfAllocator::InsertFree(const std::uint32_t block) noexcept {
+  std::uint32_t fl = 0, sl = 0;
+  Mapping(blocks_[block].size, fl, sl);
+
+  const std::uint32_t head = free_heads_[fl][sl];
+  blocks_[block].prev_free = kInvalidBlock;
+  blocks_[block].next_free = head;
+  if (head != kInvalidBlock) {
+    blocks_[head].prev_free = block;
+  }
+  free_heads_[fl][sl] = block;
+
+  fl_bitmap_ |= 1u << fl;
+  sl_bitmaps_[fl] |= 1u << sl;
+}
+
+void TlsfAllocator::RemoveFree(const std::uint32_t block) noexcept {
+  std::uint32_t fl = 0, sl = 0;
+  Mapping(blocks_[block].size, fl, sl);
+
+  Block& removed = blocks_[block];
+  if (removed.prev_free != kInvalidBlock) {
+    blocks_[removed.prev_free].next_free = removed.next_free;
+  } else {
+    free_heads_[fl][sl] = removed.next_free;
+  }
+  if (removed.next_free != kInvalidBlock) {
+    blocks_[removed.next_free].prev_free = removed.prev_free;
+  }
+  removed.prev_free = kInvalidBlock;
+  removed.next_free = kInvalidBlock;
+
+  if (free_heads_[fl][sl] == kInvalidBlock) {
+    sl_bitmaps_[fl] &= ~(1u << sl);
+    if (sl_bitmaps_[fl] == 0) {
+      fl_bitmap_ &= ~(1u << fl);
+    }
+  }
+}
+
+std::uint32_t TlsfAllocator::NewBlock() noexcept {
+  if (!unused_blocks_.empty()) {
+    const std::uint32_t block = unused_blocks_.back();
+    unused_blocks_.pop_back();
+    blocks_[block] = Block{};
+    return block;
+  }
+  blocks_.emplace_back();
+  return static_cast<std::uint32_t>(blocks_.size() - 1);
+}
+
+void TlsfAllocator::ReleaseBlock(const std::uint32_t block) noexcept {
+  blocks_[block] = Block{};
+  unused_blocks_.push_back(block);
+}
+
+std::vector<TlsfMove> TlsfAllocator::Compact(
+    const std::uint32_t byte_budget) noexcept {
+  std::vector<TlsfMove> moves;
+  if (first_block_ == kInvalidBlock) {
+    return moves;
+  }
+
+  std::uint32_t block = first_block_;
+  while (blocks_[block].next_phys != kInvalidBlock) {
+    block = blocks_[block].next_phys;
+  }
+
+  std::uint32_t moved_bytes = 0;
+  while (block != kInvalidBlock && moved_bytes < byte_budget) {
+    const Block& used = blocks_[block];
+    if (used.is_free) {
+      block = used.prev_phys;
+      continue;
+    }
+
+    // First fit by address among the holes below the block.
+    std::uint32_t target = kInvalidBlock;
+    for (std::uint32_t candidate = first_block_;
+         candidate != kInvalidBlock && blocks_[candidate].offset < used.offset;
+         candidate = blocks_[candidate].next_phys) {
+      const Block& hole = blocks_[candidate];
+      if (!hole.is_free) {
+        continue;
+      }
+      const std::uint32_t aligned = TlsfRoundUp(hole.offset, used.alignment);
+      if (aligned + used.size <= hole.offset + hole.size) {
+        target = candidate;
+        break;
+      }
+    }
+    if (target == kInvalidBlock) {
+      block = used.prev_phys;
+      continue;
+    }
+
+    // Neither placing below the block nor merging it on free can release its
+    // previous neighbour, so the walk can go on from there.
+    const std::uint32_t prev = used.prev_phys;
+
+    TlsfMove move;
+    move.old_block = block;
+    move.src_offset = used.offset;
+    move.size = used.size;
+    move.new_block = Place(target, used.size, blocks_[block].requested,
+                           blocks_[block].alignment);
+    move.dst_offset = blocks_[move.new_block].offset;
+    Free(block);
+
+    moves.push_back(move);
+    moved_bytes += move.size;
+    block = prev;
+  }
+  return moves;
+}
+
+TlsfStats TlsfAllocator::Stats() const noexcept {
+  TlsfStats stats;
+  stats.capacity = capacity_;
+  stats.used_bytes = used_bytes_;
+  stats.requested_bytes = requested_bytes_;
+  stats.allocation_count = allocation_count_;
+  stats.free_bytes = capacity_ - used_bytes_;
+
+  for (std::uint32_t block = first_block_; block != kInvalidBlock;
+       block = blocks_[block].next_phys) {
+    if (blocks_[block].is_free) {
+      stats.free_block_count++;
+      stats.largest_free_block =
+          std::max(stats.largest_free_block, blocks_[block].size);
+    }
+  }
+  return stats;
+}
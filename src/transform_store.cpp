@@ -0,0 +1,215 @@
+#include "transform_store.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "cpu_profiler.h"
+
+void UpdateTransformsJob::Setup(TransformStore* store, const std::size_t begin,
+                                const std::size_t end) noexcept {
+  store_ = store;
+  begin_ = begin;
+  end_ = end;
+  updated_count_ = 0;
+}
+
+void UpdateTransformsJob::Work() noexcept {
+  PROFILE_ZONE;
+  updated_count_ = store_->UpdateRange(begin_, end_);
+}
+
+void TransformStore::Clear() noexcept {
+  positions_.clear();
+  rotations_.clear();
+  scales_.clear();
+  parents_.clear();
+  levels_.clear();
+  dirty_.clear();
+  changed_.clear();
+  worlds_.clear();
+  normal_matrices_.clear();
+  order_.clear();
+  level_offsets_.clear();
+  is_order_stale_ = true;
+  has_dirty_ = false;
+}
+
+std::uint32_t TransformStore::Create(const Transform& local,
+                                     std::uint32_t parent) {
+  const auto entity = static_cast<std::uint32_t>(parents_.size());
+  if (parent >= entity) {
+    parent = kNoParent;
+  }
+  positions_.push_back(local.position);
+  rotations_.push_back(local.rotation);
+  scales_.push_back(local.scale);
+  parents_.push_back(parent);
+  levels_.push_back(parent == kNoParent ? 0 : levels_[parent] + 1);
+  dirty_.push_back(1);
+  changed_.push_back(0);
+  worlds_.emplace_back(1.f);
+  normal_matrices_.emplace_back(1.f);
+  is_order_stale_ = true;
+  has_dirty_ = true;
+  return entity;
+}
+
+void TransformStore::SetPosition(const std::uint32_t entity,
+                                 const glm::vec3& position) noexcept {
+  positions_[entity] = position;
+  dirty_[entity] = 1;
+  has_dirty_ = true;
+}
+
+void TransformStore::SetRotation(const std::uint32_t entity,
+                                 const glm::quat& rotation) noexcept {
+  rotations_[entity] = rotation;
+  dirty_[entity] = 1;
+  has_dirty_ = true;
+}
+
+void TransformStore::SetScale(const std::uint32_t entity,
+                              const glm::vec3& scale) noexcept {
+  scales_[entity] = scale;
+  dirty_[entity] = 1;
+  has_dirty_ = true;
+}
+
+void TransformStore::SetLocal(const std::uint32_t entity,
+                              const Transform& local) noexcept {
+  positions_[entity] = local.position;
+  rotations_[entity] = local.rotation;
+  scales_[entity] = local.scale;
+  dirty_[entity] = 1;
+  has_dirty_ = true;
+}
+
+TransformStats TransformStore::Update(JobSystem& job_system) noexcept {
+  PROFILE_ZONE;
+  const auto start = std::chrono::steady_clock::now();
+  TransformStats stats;
+  stats.entity_count = size();
+  if (!has_dirty_) {
+    std::fill(changed_.begin(), changed_.end(), std::uint8_t{0});
+  } else {
+    if (is_order_stale_) {
+      SortByLevel();
+    }
+    const std::size_t max_jobs =
+        static_cast<std::size_t>(job_system.compute_worker_count()) + 1;
+    // A level only starts once its parents are done.
+    for (std::size_t level = 0; level + 1 < level_offsets_.size(); level++) {
+      const std::size_t level_begin = level_offsets_[level];
+      const std::size_t count = level_offsets_[level + 1] - level_begin;
+      const std::size_t job_count =
+          std::clamp<std::size_t>(count / kMinEntitiesPerJob, 1, max_jobs);
+      if (job_count == 1) {
+        stats.updated_count += UpdateRange(level_begin, level_begin + count);
+        continue;
+      }
+      const std::size_t entities_per_job = (count + job_count - 1) / job_count;
+      jobs_.resize(job_count);
+      job_ptrs_.clear();
+      for (std::size_t i = 0; i < job_count; i++) {
+        const std::size_t begin = level_begin + i * entities_per_job;
+        const std::size_t end =
+            std::min(level_begin + count, begin + entities_per_job);
+        if (begin >= end) {
+          break;
+        }
+        jobs_[i].Reset();
+        jobs_[i].Setup(this, begin, end);
+        job_ptrs_.push_back(&jobs_[i]);
+      }
+      job_system.RunComputeJobs(job_ptrs_.data(), job_ptrs_.size());
+      for (std::size_t i = 0; i < job_ptrs_.size(); i++) {
+        stats.updated_count += jobs_[i].updated_count();
+      }
+    }
+    has_dirty_ = false;
+  }
+  stats.level_count = level_offsets_.empty() ? 0 : level_offsets_.size() - 1;
+  stats.milliseconds = std::chrono::duration<float, std::milli>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+  return stats;
+}
+
+std::size_t TransformStore::UpdateRange(const std::size_t begin,
+                                        const std::size_t end) noexcept {
+  std::size_t updated_count = 0;
+  for (std::size_t i = begin; i < end; i++) {
+    const std::uint32_t entity = order_[i];
+    const std::uint32_t parent = parents_[entity];
+    const bool is_moved =
+        dirty_[entity] != 0 || (parent != kNoParent && changed_[parent] != 0);
+    changed_[entity] = is_moved;
+    if (!is_moved) {
+      continue;
+    }
+    dirty_[entity] = 0;
+    // Translation * rotation * scale without the two matrix products.
+    glm::mat4 local = glm::mat4_cast(rotations_[entity]);
+    local[0] *= scales_[entity].x;
+    local[1] *= scales_[entity].y;
+    local[2] *= scales_[entity].z;
+    local[3] = glm::vec4(positions_[entity], 1.f);
+    worlds_[entity] = parent == kNoParent ? local : worlds_[parent] * local;
+    normal_matrices_[entity] =
+        glm::mat4(glm::transpose(glm::inverse(glm::mat3(worlds_[entity]))));
+    updated_count++;
+  }
+  return updated_count;
+}
+
+void TransformStore::SortByLevel() {
+  // Counting sort, the entities of a level keep their creation order.
+  const std::uint32_t level_count =
+      levels_.empty()
+          ? 0
+          : *std::max_element(levels_.begin(), levels_.end()) + 1;
+  level_offsets_.assign(level_count + 1, 0);
+  for (const auto level : levels_) {
+    level_offsets_[level + 1]++;
+  }
+  for (std::size_t level = 0; level < level_count; level++) {
+    level_offsets_[level + 1] += level_offsets_[level];
+  }
+  order_.resize(levels_.size());
+  std::vector<std::size_t> next(level_offsets_.begin(),
+                                level_offsets_.end() - 1);
+  for (std::uint32_t entity = 0; entity < levels_.size(); entity++) {
+    order_[next[levels_[entity]]++] = entity;
+  }
+  is_order_stale_ = false;
+}
+
+TransformStats RunTransformBenchmark(JobSystem& job_system,
+                                     const std::size_t entity_count,
+                                     const int iterations) noexcept {
+  PROFILE_ZONE;
+  static constexpr std::size_t kChildCount = 8;
+  TransformStore store;
+  for (std::size_t i = 0; i < entity_count; i++) {
+    Transform local;
+    local.position = glm::vec3(static_cast<float>(i % kChildCount), 1.f, 0.f);
+    local.scale = glm::vec3(0.9f);
+    store.Create(local, i == 0 ? TransformStore::kNoParent
+                               : static_cast<std::uint32_t>(
+                                     (i - 1) / kChildCount));
+  }
+  store.Update(job_system);
+
+  TransformStats best{};
+  for (int i = 0; i < iterations; i++) {
+    if (entity_count > 0) {
+      store.SetRotation(0, glm::angleAxis(0.01f * static_cast<float>(i + 1),
+                                          glm::vec3(0.f, 1.f, 0.f)));
+    }
+    const TransformStats stats = store.Update(job_system);
+    if (i == 0 || stats.milliseconds < best.milliseconds) {
+      best = stats;
+    }
+  }
+  return best;
+}
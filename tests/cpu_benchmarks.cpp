@@ -0,0 +1,93 @@
+// Runs the CPU benchmarks of the debug overlay without a window or a GL
+// context: culling, transforms, command buffers and light clustering on the
+// compute workers. Same sizes as the overlay buttons.
+//
+// Usage: cpu_benchmarks [worker count]
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+#include "JobSystem.h"
+#include "clustered_lights.h"
+#include "command_buffer.h"
+#include "frustum_culling.h"
+#include "test_utility.h"
+#include "transform_store.h"
+
+namespace {
+
+constexpr std::size_t kCullingObjectCount = 1'000'000;
+constexpr std::size_t kTransformEntityCount = 1'000'000;
+constexpr std::size_t kCommandDrawCount = 100'000;
+constexpr std::array<std::size_t, 4> kClusterLightCounts = {256, 1024, 4096,
+                                                            16384};
+constexpr int kIterations = 10;
+
+void BenchmarkCulling(JobSystem& job_system) {
+  const CullingStats stats =
+      RunCullingBenchmark(job_system, kCullingObjectCount, kIterations);
+  CHECK(stats.tested_count == kCullingObjectCount);
+  CHECK(stats.visible_count <= stats.tested_count);
+  std::cout << "Culling: " << stats.tested_count << " objects, "
+            << stats.visible_count << " visible, in " << stats.milliseconds
+            << " ms: " << stats.MillionObjectsPerSecond()
+            << " M objects/s\n";
+}
+
+void BenchmarkTransforms(JobSystem& job_system) {
+  const TransformStats stats =
+      RunTransformBenchmark(job_system, kTransformEntityCount, kIterations);
+  CHECK(stats.updated_count == kTransformEntityCount);
+  std::cout << "Transforms: " << stats.updated_count << " world matrices on "
+            << stats.level_count << " levels in " << stats.milliseconds
+            << " ms\n";
+}
+
+void BenchmarkCommandBuffers(JobSystem& job_system) {
+  const CommandBufferStats stats =
+      RunCommandBufferBenchmark(job_system, kCommandDrawCount, kIterations);
+  CHECK(stats.draw_count == kCommandDrawCount);
+  CHECK(stats.command_count >= stats.draw_count);
+  std::cout << "Command buffers: " << stats.draw_count << " draws, "
+            << stats.command_count << " commands in " << stats.buffer_count
+            << " buffers, " << stats.byte_count / 1024 << " KB, record "
+            << stats.record_milliseconds << " ms, replay "
+            << stats.replay_milliseconds << " ms\n";
+}
+
+void BenchmarkClusters(JobSystem& job_system) {
+  for (const auto light_count : kClusterLightCounts) {
+    const ClusterStats stats =
+        RunClusterBenchmark(job_system, light_count, 2 * kIterations);
+    CHECK(stats.light_count == light_count);
+    std::cout << "Clustered lights: " << stats.light_count << " lights in "
+              << stats.milliseconds << " ms, " << stats.index_count
+              << " indices, at most " << stats.max_cluster_light_count
+              << " per cluster\n";
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  // As many workers as the engine: one core is left to the main thread.
+  int worker_count =
+      std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+  if (argc > 1) {
+    worker_count = std::max(1, std::atoi(argv[1]));
+  }
+  JobSystem job_system;
+  job_system.LaunchComputeWorkers(worker_count);
+  std::cout << worker_count << " compute workers\n";
+
+  BenchmarkCulling(job_system);
+  BenchmarkTransforms(job_system);
+  BenchmarkCommandBuffers(job_system);
+  BenchmarkClusters(job_system);
+
+  job_system.StopComputeWorkers();
+  return TestExitCode("cpu_benchmarks");
+}
@@ -0,0 +1,75 @@
+// Parses scene files from strings: shared model loads and the errors of
+// the duplicate names. GL free, like the description.
+
+#include <string>
+
+#include "scene_description.h"
+#include "test_utility.h"
+
+namespace {
+
+// Models of the same path and flags share the load of the first one.
+void TestSharedModels() {
+  SceneDescription scene;
+  std::string error;
+  CHECK(ParseSceneDescription(R"({
+    "models": [
+      {"name": "man", "path": "man.obj"},
+      {"name": "backpack", "path": "backpack.obj"},
+      {"name": "other_man", "path": "man.obj"},
+      {"name": "flipped_man", "path": "man.obj", "flip_uvs": true}
+    ],
+    "objects": [
+      {"name": "a", "model": "man"},
+      {"name": "b", "model": "other_man"}
+    ]
+  })",
+                              scene, error));
+  CHECK(error.empty());
+  CHECK(scene.models.size() == 4);
+  CHECK(scene.models[0].source == 0);
+  CHECK(scene.models[1].source == 1);
+  CHECK(scene.models[2].source == 0);
+  CHECK(scene.models[3].source == 3);
+  CHECK(scene.FindModel(scene.objects[1].model)->source == 0);
+}
+
+// A name used twice in a kind is an error, the lookups would only ever
+// find the first one.
+void TestDuplicateNames() {
+  const char* const kScenes[] = {
+      R"({"models": [{"name": "m", "path": "a.obj"},
+                     {"name": "m", "path": "b.obj"}]})",
+      R"({"materials": [{"name": "m"}, {"name": "m"}]})",
+      R"({"lights": [{"name": "l"}, {"name": "l"}]})",
+      R"({"objects": [{"name": "o", "mesh": "sphere"},
+                      {"name": "o", "mesh": "ground"}]})",
+  };
+  for (const char* text : kScenes) {
+    SceneDescription scene;
+    std::string error;
+    CHECK(!ParseSceneDescription(text, scene, error));
+    CHECK(error.find("is listed twice") != std::string::npos);
+  }
+
+  // The kinds have their own names.
+  SceneDescription scene;
+  std::string error;
+  CHECK(ParseSceneDescription(R"({
+    "models": [{"name": "lamp", "path": "lamp.obj"}],
+    "materials": [{"name": "lamp"}],
+    "lights": [{"name": "lamp"}],
+    "objects": [{"name": "lamp", "model": "lamp", "material": "lamp",
+                 "light": "lamp"}]
+  })",
+                              scene, error));
+  CHECK(error.empty());
+}
+
+}  // namespace
+
+int main() {
+  TestSharedModels();
+  TestDuplicateNames();
+  return TestExitCode("scene_description_tests");
+}
@@ -0,0 +1,100 @@
+// Checks the SH projection of the irradiance against the brute force
+// convolution it replaced, on synthetic environments: no GL, no image file.
+
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+#include "JobSystem.h"
+#include "spherical_harmonics.h"
+#include "test_utility.h"
+
+namespace {
+
+constexpr int kWidth = 512;
+constexpr int kHeight = 256;
+constexpr float kPi = 3.14159265358979f;
+// Largest relative error allowed per channel.
+constexpr float kTolerance = 0.01f;
+
+using Environment = std::function<glm::vec3(glm::vec3)>;
+
+// Fills an equirectangular image laid out as ShImage expects: rows from the
+// bottom up, u following atan(z, x) and v asin(y).
+std::vector<float> MakeImage(const Environment& environment) {
+  std::vector<float> texels(static_cast<std::size_t>(kWidth) * kHeight * 3);
+  for (int row = 0; row < kHeight; row++) {
+    const float latitude =
+        ((static_cast<float>(row) + 0.5f) / kHeight - 0.5f) * kPi;
+    for (int col = 0; col < kWidth; col++) {
+      const float phi =
+          ((static_cast<float>(col) + 0.5f) / kWidth - 0.5f) * 2.f * kPi;
+      const glm::vec3 direction(std::cos(latitude) * std::cos(phi),
+                                std::sin(latitude),
+                                std::cos(latitude) * std::sin(phi));
+      const glm::vec3 radiance = environment(direction);
+      float* texel =
+          texels.data() + (static_cast<std::size_t>(row) * kWidth + col) * 3;
+      texel[0] = radiance.x;
+      texel[1] = radiance.y;
+      texel[2] = radiance.z;
+    }
+  }
+  return texels;
+}
+
+void CheckEnvironment(const char* name, const Environment& environment,
+                      JobSystem& job_system) {
+  const std::vector<float> texels = MakeImage(environment);
+  const ShImage image{texels.data(), kWidth, kHeight};
+  ShProjector projector;
+  const ShIrradiance irradiance = projector.Project(job_system, image);
+
+  const glm::vec3 normals[] = {
+      {1.f, 0.f, 0.f},   {-1.f, 0.f, 0.f},  {0.f, 1.f, 0.f},
+      {0.f, -1.f, 0.f},  {0.f, 0.f, 1.f},   {0.f, 0.f, -1.f},
+      {0.6f, 0.8f, 0.f}, {-0.5f, 0.5f, 0.7f}, {0.3f, -0.4f, -0.866f}};
+  float worst_error = 0.f;
+  for (const auto& normal : normals) {
+    const glm::vec3 n = glm::normalize(normal);
+    const glm::vec3 expected = ConvolveIrradiance(image, n);
+    const glm::vec3 projected = irradiance.Evaluate(n);
+    for (int channel = 0; channel < 3; channel++) {
+      const float error = std::abs(projected[channel] - expected[channel]) /
+                          std::abs(expected[channel]);
+      worst_error = std::max(worst_error, error);
+      CHECK(error <= kTolerance);
+    }
+  }
+  std::cout << name << ": worst relative error " << worst_error * 100.f
+            << "% in " << projector.stats().milliseconds << " ms\n";
+}
+
+}  // namespace
+
+int main() {
+  JobSystem job_system;
+  job_system.LaunchComputeWorkers(3);
+
+  // Sky over a darker ground, brighter towards +x.
+  CheckEnvironment(
+      "gradient",
+      [](const glm::vec3 d) {
+        return glm::vec3(1.f + 0.5f * d.y + 0.2f * d.x,
+                         1.2f + 0.6f * d.y + 0.1f * d.z, 1.5f + 0.8f * d.y);
+      },
+      job_system);
+  // Second band terms, what the 9 coefficients are there for.
+  CheckEnvironment(
+      "quadratic",
+      [](const glm::vec3 d) {
+        return glm::vec3(2.f + d.x * d.y + 0.5f * d.z * d.z,
+                         1.5f + 0.7f * (d.x * d.x - d.y * d.y),
+                         1.8f + 0.6f * d.y * d.z - 0.3f * d.x);
+      },
+      job_system);
+
+  job_system.StopComputeWorkers();
+  return TestExitCode("sh_tests");
+}
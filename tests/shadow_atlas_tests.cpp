@@ -0,0 +1,127 @@
+// CPU tests of the shadow atlas tile allocation and eviction: the atlas is
+// GL free, the renderer only reads the tiles back.
+
+#include <cstdint>
+#include <vector>
+
+#include "shadow_atlas.h"
+#include "test_utility.h"
+
+namespace {
+
+// Every face of every light is inside the atlas and overlaps no other one.
+void CheckTiles(const ShadowAtlas& atlas,
+                const std::vector<const ShadowAtlas::Light*>& lights) {
+  std::vector<AtlasTile> tiles;
+  for (const auto* light : lights) {
+    if (light == nullptr) {
+      continue;
+    }
+    for (const auto& tile : light->tiles) {
+      CHECK(tile.size == light->resolution);
+      CHECK(tile.x + tile.size <= atlas.size());
+      CHECK(tile.y + tile.size <= atlas.size());
+      tiles.push_back(tile);
+    }
+  }
+  for (std::size_t i = 0; i < tiles.size(); i++) {
+    for (std::size_t j = i + 1; j < tiles.size(); j++) {
+      const AtlasTile& a = tiles[i];
+      const AtlasTile& b = tiles[j];
+      CHECK(a.x + a.size <= b.x || b.x + b.size <= a.x ||
+            a.y + a.size <= b.y || b.y + b.size <= a.y);
+    }
+  }
+}
+
+// More lights than the atlas holds at their wanted resolution, acquired in
+// the same order every frame: after the first frame nothing is evicted or
+// reallocated, a growing light no longer pushes out the ones after it.
+void TestSteadyLights() {
+  ShadowAtlas atlas(2048, 64, 512);
+  const std::vector<std::uint32_t> wanted = {512, 512, 256, 512,
+                                             256, 512, 128, 512};
+  std::vector<const ShadowAtlas::Light*> lights(wanted.size());
+
+  std::uint32_t settled_evictions = 0;
+  for (int frame = 0; frame < 30; frame++) {
+    atlas.NextFrame();
+    int reallocation_count = 0;
+    for (std::uint32_t id = 0; id < wanted.size(); id++) {
+      bool reallocated = false;
+      lights[id] = atlas.Acquire(id, wanted[id], reallocated);
+      CHECK(lights[id] != nullptr);
+      reallocation_count += reallocated;
+    }
+    CheckTiles(atlas, lights);
+    if (frame == 0) {
+      CHECK(reallocation_count == static_cast<int>(wanted.size()));
+      settled_evictions = atlas.Stats().eviction_count;
+    } else {
+      CHECK(reallocation_count == 0);
+    }
+  }
+  CHECK(settled_evictions == 0);
+  CHECK(atlas.Stats().eviction_count == 0);
+  CHECK(atlas.Stats().light_count == wanted.size());
+}
+
+// A light that got a lower resolution grows once another one releases its
+// tiles, without evicting anything.
+void TestGrowth() {
+  ShadowAtlas atlas(2048, 64, 512);
+  bool reallocated = false;
+  atlas.NextFrame();
+  CHECK(atlas.Acquire(0, 512, reallocated) != nullptr);
+  CHECK(atlas.Acquire(1, 512, reallocated) != nullptr);
+  const ShadowAtlas::Light* light = atlas.Acquire(2, 512, reallocated);
+  CHECK(light != nullptr && light->resolution == 256);
+
+  atlas.NextFrame();
+  CHECK(atlas.Acquire(0, 512, reallocated) != nullptr);
+  CHECK(atlas.Acquire(1, 512, reallocated) != nullptr);
+  light = atlas.Acquire(2, 512, reallocated);
+  CHECK(!reallocated && light->resolution == 256);
+
+  atlas.Release(0);
+  atlas.NextFrame();
+  CHECK(atlas.Acquire(1, 512, reallocated) != nullptr);
+  light = atlas.Acquire(2, 512, reallocated);
+  CHECK(reallocated && light->resolution == 512);
+  CHECK(atlas.Stats().eviction_count == 0);
+}
+
+// Only lights left out for more than a frame make room for a new one.
+void TestEviction() {
+  // Room for the faces of 2 lights.
+  ShadowAtlas atlas(1024, 256, 256);
+  bool reallocated = false;
+  atlas.NextFrame();
+  CHECK(atlas.Acquire(0, 256, reallocated) != nullptr);
+  CHECK(atlas.Acquire(1, 256, reallocated) != nullptr);
+  CHECK(atlas.Acquire(2, 256, reallocated) == nullptr);
+
+  // Lights 0 and 1 were acquired the previous frame: they are kept.
+  atlas.NextFrame();
+  CHECK(atlas.Acquire(2, 256, reallocated) == nullptr);
+  CHECK(atlas.Stats().eviction_count == 0);
+
+  // Light 1 is acquired every frame, light 0 is left out twice and goes.
+  CHECK(atlas.Acquire(1, 256, reallocated) != nullptr);
+  atlas.NextFrame();
+  CHECK(atlas.Acquire(1, 256, reallocated) != nullptr);
+  CHECK(atlas.Acquire(2, 256, reallocated) != nullptr);
+  CHECK(reallocated);
+  CHECK(atlas.Stats().eviction_count == 1);
+  CHECK(atlas.Stats().light_count == 2);
+  CHECK(atlas.Acquire(1, 256, reallocated) != nullptr && !reallocated);
+}
+
+}  // namespace
+
+int main() {
+  TestSteadyLights();
+  TestGrowth();
+  TestEviction();
+  return TestExitCode("shadow_atlas_tests");
+}
@@ -0,0 +1,135 @@
+// CPU tests of the shadow caster faces and the face scheduler: which faces
+// a moved light or caster dirties, without GL.
+
+#include <cstdint>
+#include <vector>
+
+#include "JobSystem.h"
+#include "shadow_cache.h"
+#include "test_utility.h"
+
+namespace {
+
+constexpr float kNearPlane = 0.5f;
+constexpr float kFarPlane = 100.f;
+// Face bits, in the order of PointLightMatrices.
+constexpr std::uint8_t kPositiveX = 1u << 0;
+constexpr std::uint8_t kNegativeX = 1u << 1;
+constexpr std::uint8_t kPositiveZ = 1u << 4;
+constexpr std::uint8_t kNegativeZ = 1u << 5;
+
+struct Caster {
+  std::uint32_t first_entry = 0;
+  std::uint32_t end_entry = 0;
+  bool is_dynamic = false;
+  bool is_moved = true;
+};
+
+// A unit cube at each position, one caster per cube.
+struct Scene {
+  CullingSet set;
+  std::vector<Caster> casters;
+
+  explicit Scene(const std::vector<glm::vec3>& positions) {
+    for (const auto& position : positions) {
+      const auto entry = static_cast<std::uint32_t>(set.size());
+      set.Add(kBox, kSphere, Translation(position));
+      casters.push_back({entry, entry + 1});
+    }
+  }
+
+  void Move(const std::size_t caster, const glm::vec3& position) {
+    set.Set(casters[caster].first_entry, kBox, kSphere,
+            Translation(position));
+    casters[caster].is_moved = true;
+  }
+
+ private:
+  static constexpr BoundingBox kBox{glm::vec3(-0.5f), glm::vec3(0.5f)};
+  static constexpr BoundingSphere kSphere{glm::vec3(0.f), 0.87f};
+
+  static glm::mat4 Translation(const glm::vec3& position) {
+    glm::mat4 model(1.f);
+    model[3] = glm::vec4(position, 1.f);
+    return model;
+  }
+};
+
+// Bakes every face, as the renderer does once at startup.
+void Bake(ShadowFaceScheduler& scheduler) {
+  scheduler.Schedule(ShadowFaceScheduler::kFaceCount);
+  CHECK(scheduler.dirty_faces() == 0);
+}
+
+// The light moves, no caster does: the casters are culled against the new
+// faces and every face of both layers is redrawn.
+void TestLightMove(JobSystem& job_system) {
+  Scene scene({{10, 0, 0}, {0, 0, 10}});
+  ShadowCasterFaces faces;
+  ShadowFaceScheduler scheduler;
+  faces.Update(job_system, scene.set,
+               PointLightMatrices(glm::vec3(0.f), kNearPlane, kFarPlane),
+               false, scene.casters, scheduler);
+  CHECK(faces.masks()[0] == kPositiveX);
+  CHECK(faces.masks()[1] == kPositiveZ);
+  Bake(scheduler);
+
+  // Seen from (10, 0, 10), the first cube is behind -Z and the second one
+  // behind -X.
+  faces.Update(job_system, scene.set,
+               PointLightMatrices(glm::vec3(10, 0, 10), kNearPlane, kFarPlane),
+               true, scene.casters, scheduler);
+  CHECK(faces.masks()[0] == kNegativeZ);
+  CHECK(faces.masks()[1] == kNegativeX);
+  CHECK(scheduler.dirty_faces() == ShadowFaceScheduler::kAllFaces);
+  const auto update = scheduler.Schedule(ShadowFaceScheduler::kFaceCount);
+  CHECK(update.static_faces == ShadowFaceScheduler::kAllFaces);
+  CHECK(update.composite_faces == ShadowFaceScheduler::kAllFaces);
+}
+
+// A moved caster dirties the faces it left and entered, in its layer only.
+void TestCasterMove(JobSystem& job_system) {
+  Scene scene({{10, 0, 0}, {0, 0, 10}});
+  scene.casters[1].is_dynamic = true;
+  const auto matrices =
+      PointLightMatrices(glm::vec3(0.f), kNearPlane, kFarPlane);
+  ShadowCasterFaces faces;
+  ShadowFaceScheduler scheduler;
+  faces.Update(job_system, scene.set, matrices, false, scene.casters,
+               scheduler);
+  Bake(scheduler);
+
+  // Nothing moved: no face is dirtied.
+  faces.Update(job_system, scene.set, matrices, false, scene.casters,
+               scheduler);
+  CHECK(scheduler.dirty_faces() == 0);
+
+  scene.Move(0, {0, 0, -10});
+  faces.Update(job_system, scene.set, matrices, false, scene.casters,
+               scheduler);
+  CHECK(!scene.casters[0].is_moved);
+  CHECK(faces.masks()[0] == kNegativeZ);
+  auto update = scheduler.Schedule(ShadowFaceScheduler::kFaceCount);
+  CHECK(update.static_faces == (kPositiveX | kNegativeZ));
+  CHECK(update.composite_faces == (kPositiveX | kNegativeZ));
+
+  scene.Move(1, {-10, 0, 0});
+  faces.Update(job_system, scene.set, matrices, false, scene.casters,
+               scheduler);
+  update = scheduler.Schedule(ShadowFaceScheduler::kFaceCount);
+  CHECK(update.static_faces == 0);
+  CHECK(update.composite_faces == (kPositiveZ | kNegativeX));
+}
+
+}  // namespace
+
+int main() {
+  JobSystem job_system;
+  job_system.LaunchComputeWorkers(2);
+
+  TestLightMove(job_system);
+  TestCasterMove(job_system);
+
+  job_system.StopComputeWorkers();
+  return TestExitCode("shadow_cache_tests");
+}
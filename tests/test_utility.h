@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdlib>
+#include <iostream>
+
+// Minimal checks for the GL free test executables: a failed check prints
+// where it failed and the test returns a non zero exit code for ctest.
+inline int& TestFailureCount() noexcept {
+  static int failure_count = 0;
+  return failure_count;
+}
+
+#define CHECK(condition)                                                 \
+  do {                                                                   \
+    if (!(condition)) {                                                  \
+      std::cerr << __FILE__ << ':' << __LINE__ << ": CHECK(" #condition \
+                << ") failed\n";                                         \
+      TestFailureCount()++;                                              \
+    }                                                                    \
+  } while (false)
+
+inline int TestExitCode(const char* name) noexcept {
+  if (TestFailureCount() == 0) {
+    std::cout << name << ": all checks passed\n";
+    return EXIT_SUCCESS;
+  }
+  std::cerr << name << ": " << TestFailureCount() << " checks failed\n";
+  return EXIT_FAILURE;
+}
@@ -0,0 +1,203 @@
+// CPU tests and benchmark of TlsfAllocator: no GL, the allocator only deals
+// in offsets.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "test_utility.h"
+#include "tlsf_allocator.h"
+
+namespace {
+
+constexpr std::uint32_t kCapacity = 1u << 20;
+
+struct Allocation {
+  std::uint32_t block = TlsfAllocator::kInvalidBlock;
+  std::uint32_t size = 0;
+  std::uint32_t alignment = 0;
+  std::uint8_t tag = 0;
+};
+
+// Every live block is aligned, inside the range, at least as big as asked
+// and overlaps no other block.
+void CheckLayout(const TlsfAllocator& allocator,
+                 const std::vector<Allocation>& allocations) {
+  std::vector<std::pair<std::uint32_t, std::uint32_t>> ranges;
+  for (const auto& allocation : allocations) {
+    const std::uint32_t offset = allocator.Offset(allocation.block);
+    const std::uint32_t size = allocator.Size(allocation.block);
+    CHECK(offset % allocation.alignment == 0);
+    CHECK(size >= allocation.size);
+    CHECK(static_cast<std::uint64_t>(offset) + size <= allocator.capacity());
+    ranges.emplace_back(offset, size);
+  }
+  std::sort(ranges.begin(), ranges.end());
+  for (std::size_t i = 1; i < ranges.size(); i++) {
+    CHECK(ranges[i - 1].first + ranges[i - 1].second <= ranges[i].first);
+  }
+}
+
+void TestNoOverlap() {
+  TlsfAllocator allocator(kCapacity);
+  std::mt19937 random(1);
+  std::uniform_int_distribution<std::uint32_t> size_distribution(1, 4096);
+  std::uniform_int_distribution<std::uint32_t> alignment_shift(0, 8);
+  std::vector<Allocation> allocations;
+  for (int step = 0; step < 20000; step++) {
+    if (!allocations.empty() && random() % 3 == 0) {
+      const std::size_t index = random() % allocations.size();
+      allocator.Free(allocations[index].block);
+      allocations[index] = allocations.back();
+      allocations.pop_back();
+    } else {
+      Allocation allocation;
+      allocation.size = size_distribution(random);
+      allocation.alignment = 1u << alignment_shift(random);
+      allocation.block =
+          allocator.Allocate(allocation.size, allocation.alignment);
+      if (allocation.block != TlsfAllocator::kInvalidBlock) {
+        allocation.alignment =
+            std::max(allocation.alignment, TlsfAllocator::kGranularity);
+        allocations.push_back(allocation);
+      }
+    }
+    if (step % 1000 == 0) {
+      CheckLayout(allocator, allocations);
+    }
+  }
+  CheckLayout(allocator, allocations);
+}
+
+void TestCoalescing() {
+  TlsfAllocator allocator(kCapacity);
+  std::vector<std::uint32_t> blocks;
+  for (std::uint32_t block = allocator.Allocate(1000, 16);
+       block != TlsfAllocator::kInvalidBlock;
+       block = allocator.Allocate(1000, 16)) {
+    blocks.push_back(block);
+  }
+  CHECK(blocks.size() == kCapacity / 1008);
+
+  // Freed in a random order, the holes merge back into one block.
+  std::shuffle(blocks.begin(), blocks.end(), std::mt19937(2));
+  for (const auto block : blocks) {
+    allocator.Free(block);
+  }
+  const TlsfStats stats = allocator.Stats();
+  CHECK(stats.allocation_count == 0);
+  CHECK(stats.free_block_count == 1);
+  CHECK(stats.largest_free_block == kCapacity);
+  CHECK(allocator.Allocate(kCapacity, 16) != TlsfAllocator::kInvalidBlock);
+}
+
+void TestOverflow() {
+  TlsfAllocator allocator(kCapacity);
+  CHECK(allocator.Allocate(0xFFFFFFF8u, 16) == TlsfAllocator::kInvalidBlock);
+  CHECK(allocator.Allocate(UINT32_MAX, 16) == TlsfAllocator::kInvalidBlock);
+  CHECK(allocator.Allocate(kCapacity + 1, 16) ==
+        TlsfAllocator::kInvalidBlock);
+  CHECK(allocator.Allocate(16, 1u << 31) == TlsfAllocator::kInvalidBlock);
+  CHECK(allocator.Stats().allocation_count == 0);
+}
+
+// The moves are applied to a CPU copy of the range, every allocation must
+// keep its bytes.
+void TestCompaction() {
+  TlsfAllocator allocator(kCapacity);
+  std::vector<std::uint8_t> memory(kCapacity, 0);
+  std::vector<Allocation> allocations;
+  std::mt19937 random(3);
+  for (std::uint8_t tag = 1; tag != 0; tag++) {
+    Allocation allocation;
+    allocation.size = 256 + random() % 2048;
+    allocation.alignment = 1u << (4 + random() % 3);
+    allocation.block =
+        allocator.Allocate(allocation.size, allocation.alignment);
+    if (allocation.block == TlsfAllocator::kInvalidBlock) {
+      break;
+    }
+    allocation.tag = tag;
+    std::memset(memory.data() + allocator.Offset(allocation.block), tag,
+                allocation.size);
+    allocations.push_back(allocation);
+  }
+  // Frees every other allocation to leave holes all over the range.
+  std::vector<Allocation> kept;
+  for (std::size_t i = 0; i < allocations.size(); i++) {
+    if (i % 2 == 0) {
+      allocator.Free(allocations[i].block);
+    } else {
+      kept.push_back(allocations[i]);
+    }
+  }
+  const TlsfStats before = allocator.Stats();
+
+  const std::vector<TlsfMove> moves = allocator.Compact(UINT32_MAX);
+  CHECK(!moves.empty());
+  for (const auto& move : moves) {
+    std::memmove(memory.data() + move.dst_offset,
+                 memory.data() + move.src_offset, move.size);
+    for (auto& allocation : kept) {
+      if (allocation.block == move.old_block) {
+        allocation.block = move.new_block;
+      }
+    }
+  }
+  for (const auto& allocation : kept) {
+    const std::uint8_t* bytes =
+        memory.data() + allocator.Offset(allocation.block);
+    CHECK(std::all_of(bytes, bytes + allocation.size,
+                      [&](const std::uint8_t byte) {
+                        return byte == allocation.tag;
+                      }));
+  }
+  CheckLayout(allocator, kept);
+  const TlsfStats after = allocator.Stats();
+  CHECK(after.allocation_count == before.allocation_count);
+  CHECK(after.largest_free_block > before.largest_free_block);
+  CHECK(after.Fragmentation() < before.Fragmentation());
+}
+
+// Not a check: prints the cost of an allocate and free pair under a mixed
+// load, to compare changes of the allocator.
+void Benchmark() {
+  constexpr int kIterations = 1000000;
+  constexpr std::size_t kLiveCount = 1024;
+  TlsfAllocator allocator(64u * 1024u * 1024u);
+  std::mt19937 random(4);
+  std::vector<std::uint32_t> sizes(4096);
+  for (auto& size : sizes) {
+    size = 16 + random() % 16384;
+  }
+  std::vector<std::uint32_t> live(kLiveCount, TlsfAllocator::kInvalidBlock);
+
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kIterations; i++) {
+    std::uint32_t& slot = live[static_cast<std::size_t>(i) % kLiveCount];
+    allocator.Free(slot);
+    slot = allocator.Allocate(sizes[static_cast<std::size_t>(i) % 4096], 16);
+  }
+  const double milliseconds =
+      std::chrono::duration<double, std::milli>(
+          std::chrono::steady_clock::now() - start)
+          .count();
+  std::cout << "TLSF: " << kIterations << " allocate and free pairs in "
+            << milliseconds << " ms, "
+            << milliseconds * 1e6 / kIterations << " ns per pair\n";
+}
+
+}  // namespace
+
+int main() {
+  TestNoOverlap();
+  TestCoalescing();
+  TestOverflow();
+  TestCompaction();
+  Benchmark();
+  return TestExitCode("tlsf_tests");
+}
@@ -0,0 +1,184 @@
+// Packs files into one archive read by AssetArchive, so the game maps a
+// single file instead of opening every asset.
+//
+// Usage: asset_packer archive (directory|file)...
+// Entries are named by their path as given, run it from the directory the
+// game runs in: "asset_packer data.pack data".
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "asset_archive_format.h"
+#include "tracy_lz4.hpp"
+#include "tracy_lz4hc.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct PackedFile {
+  std::string name{};
+  AssetArchiveEntry entry{};
+};
+
+bool ReadWholeFile(const fs::path& path, std::vector<char>& content) {
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file) {
+    return false;
+  }
+  content.resize(static_cast<std::size_t>(file.tellg()));
+  file.seekg(0);
+  return static_cast<bool>(
+      file.read(content.data(), static_cast<std::streamsize>(content.size())));
+}
+
+void Pad(std::ofstream& out, const std::uint64_t alignment) {
+  const auto position = static_cast<std::uint64_t>(out.tellp());
+  const std::uint64_t padding = (alignment - position % alignment) % alignment;
+  for (std::uint64_t i = 0; i < padding; i++) {
+    out.put('\0');
+  }
+}
+
+std::vector<std::string> CollectFiles(int argc, char** argv,
+                                      const fs::path& archive_path) {
+  std::vector<std::string> names;
+  const auto add = [&](const fs::path& path) {
+    std::error_code error;
+    if (!fs::equivalent(path, archive_path, error)) {
+      names.push_back(path.lexically_normal().generic_string());
+    }
+  };
+  for (int i = 2; i < argc; i++) {
+    const fs::path input(argv[i]);
+    if (fs::is_directory(input)) {
+      for (const auto& file : fs::recursive_directory_iterator(input)) {
+        if (file.is_regular_file()) {
+          add(file.path());
+        }
+      }
+    } else if (fs::is_regular_file(input)) {
+      add(input);
+    } else {
+      std::cerr << "Can't find " << input.string() << '\n';
+    }
+  }
+  // Sorted, two runs over the same data write the same archive.
+  std::sort(names.begin(), names.end());
+  names.erase(std::unique(names.begin(), names.end()), names.end());
+  return names;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    std::cerr << "Usage: asset_packer archive (directory|file)...\n";
+    return EXIT_FAILURE;
+  }
+  const fs::path archive_path(argv[1]);
+  std::ofstream out(archive_path, std::ios::binary | std::ios::trunc);
+  if (!out) {
+    std::cerr << "Can't write " << archive_path.string() << '\n';
+    return EXIT_FAILURE;
+  }
+  const std::vector<std::string> names =
+      CollectFiles(argc, argv, archive_path);
+
+  AssetArchiveHeader header;
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+  std::vector<PackedFile> files;
+  files.reserve(names.size());
+  std::vector<char> content;
+  std::vector<char> compressed;
+  std::uint64_t total_size = 0;
+  std::uint64_t total_packed_size = 0;
+  for (const auto& name : names) {
+    if (!ReadWholeFile(name, content)) {
+      std::cerr << "Can't read " << name << '\n';
+      return EXIT_FAILURE;
+    }
+    if (content.size() > LZ4_MAX_INPUT_SIZE) {
+      std::cerr << name << " is too big for an LZ4 block\n";
+      return EXIT_FAILURE;
+    }
+    const int size = static_cast<int>(content.size());
+    compressed.resize(
+        static_cast<std::size_t>(tracy::LZ4_compressBound(size)));
+    const int packed_size = tracy::LZ4_compress_HC(
+        content.data(), compressed.data(), size,
+        static_cast<int>(compressed.size()), LZ4HC_CLEVEL_DEFAULT);
+
+    PackedFile file;
+    file.name = name;
+    file.entry.hash = HashAssetPath(name);
+    file.entry.size = static_cast<std::uint32_t>(size);
+    // Already compressed images gain nothing, they are stored as is and
+    // cost a copy instead of a decode.
+    const bool is_compressed = packed_size > 0 && packed_size < size;
+    const std::vector<char>& data = is_compressed ? compressed : content;
+    file.entry.packed_size =
+        static_cast<std::uint32_t>(is_compressed ? packed_size : size);
+    file.entry.flags = is_compressed ? kAssetArchiveCompressed : 0u;
+
+    Pad(out, kAssetArchiveAlignment);
+    file.entry.offset = static_cast<std::uint64_t>(out.tellp());
+    out.write(data.data(), file.entry.packed_size);
+
+    total_size += file.entry.size;
+    total_packed_size += file.entry.packed_size;
+    files.push_back(std::move(file));
+  }
+
+  // The table stays at most half full, the probes are short.
+  std::uint32_t bucket_count = 2;
+  while (bucket_count < 2 * files.size()) {
+    bucket_count *= 2;
+  }
+  std::vector<std::uint32_t> buckets(bucket_count, kAssetArchiveNoEntry);
+  std::string names_block;
+  for (std::uint32_t i = 0; i < files.size(); i++) {
+    AssetArchiveEntry& entry = files[i].entry;
+    entry.name_offset = static_cast<std::uint32_t>(names_block.size());
+    entry.name_size = static_cast<std::uint32_t>(files[i].name.size());
+    names_block += files[i].name;
+
+    std::uint32_t bucket = static_cast<std::uint32_t>(entry.hash);
+    while (buckets[bucket & (bucket_count - 1)] != kAssetArchiveNoEntry) {
+      bucket++;
+    }
+    buckets[bucket & (bucket_count - 1)] = i;
+  }
+
+  header.entry_count = static_cast<std::uint32_t>(files.size());
+  header.bucket_count = bucket_count;
+  Pad(out, kAssetArchiveAlignment);
+  header.entries_offset = static_cast<std::uint64_t>(out.tellp());
+  for (const auto& file : files) {
+    out.write(reinterpret_cast<const char*>(&file.entry), sizeof(file.entry));
+  }
+  header.buckets_offset = static_cast<std::uint64_t>(out.tellp());
+  out.write(reinterpret_cast<const char*>(buckets.data()),
+            static_cast<std::streamsize>(buckets.size() * sizeof(buckets[0])));
+  header.names_offset = static_cast<std::uint64_t>(out.tellp());
+  header.names_size = names_block.size();
+  out.write(names_block.data(),
+            static_cast<std::streamsize>(names_block.size()));
+
+  out.seekp(0);
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  if (!out) {
+    std::cerr << "Can't write " << archive_path.string() << '\n';
+    return EXIT_FAILURE;
+  }
+  std::cout << "Packed " << files.size() << " files, " << total_size
+            << " bytes in " << total_packed_size << " bytes\n";
+  return EXIT_SUCCESS;
+}